@@ -80,6 +80,8 @@
 
 #include <windows.h>
 #include <d3dx9.h>
+#include "../common/FrameTimer.h"
+#include "../common/FixedStep.h"
 
 LPDIRECT3D9 lpD3D9 = NULL;      // will store a pointer to the Direct3D8 object
       // which always exists as part of the directX runtime on the computer
@@ -110,9 +112,11 @@ struct CUSTOMVERTEX   // temp storage for vertices that will be put into a verte
 
 float thetaY = 0.0f;   // this is the angle in radians through which the pyramid is rotated..
       // I used this to keep the code simple and let the user/coder see the pyramid rotate..
-      // a better example would allow for user input or a timer..
-      // since its not timer based.. the spin speed will depend on the CPU..
-      // this as well as Frames per Second are NOT locked, they will run as fast as possible
+      // it turns a bit every step of simClock, 60 steps a second, so the spin speed
+      // doesn't depend on the CPU.. Frames per Second are NOT locked, they run as fast as possible
+float prevThetaY = 0.0f;   // the angle before the last step.. drawn between the two
+FrameTimer frameTimer;     // how long the last frame took..
+FixedStep simClock;        // .. made into whole steps of 1/60 second
 
 
 //*******
@@ -233,10 +237,18 @@ bool initData()
 
 void doMath()
 {
-   thetaY += 0.01f;   // increase rotation.. could go anywhere
+   // as many steps as the time the last frame took calls for.. none on a
+   // fast frame, a few on a slow one
+   unsigned int steps = simClock.advance(frameTimer.lastFrame());
+   while (steps--)
+   {
+      prevThetaY = thetaY;
+      thetaY += 0.01f;   // increase rotation.. could go anywhere
             // sinces it's global.. but it's math so I put it here for now
+   }
    D3DXMATRIX matWorld;      // matrix World..stores the world movements
-   D3DXMatrixRotationY( &matWorld, thetaY);   //  creates rotation for world..
+   //  creates rotation for world.. part way between the last two steps
+   D3DXMatrixRotationY( &matWorld, prevThetaY + (thetaY - prevThetaY) * simClock.alpha());
    lpD3DDevice9->SetTransform( D3DTS_WORLD, &matWorld );   // sets it..
 
    D3DXMATRIX matView;   // this is the view matrix..
@@ -256,6 +268,7 @@ void doMath()
 
 void render()
 {
+   frameTimer.beginFrame();   // the last frame ends here
    doMath();   // do the math.. :-P
     
    // Clear the back buffer to a black... values r g b are 0-256
@@ -10,35 +10,23 @@
 */
 
 #include <d3dx9.h>
+#include "../common/BufferManager.h"
+#include "../common/TextureCache.h"
 
 
 class Rect3D2
 {
 public:
-   Rect3D2(LPDIRECT3DDEVICE9 dev, LPDIRECT3DTEXTURE9 tex);   // default constructor
+   Rect3D2(LPDIRECT3DDEVICE9 dev, const TextureRef & tex);   // default constructor
    ~Rect3D2();   // default destructor
-   
-   void setPosition(float x, float y, float z);
-   void setSize(float x, float y, float z);
 
-   void setYaw( float y, float dy = 0, float ddy = 0);
-   void setPitch( float x, float dx = 0, float ddx = 0);
-   void setRoll( float z, float dz = 0, float ddz = 0);
-
-   void render(DWORD curTime);
+   void draw(const float * world);   // 4x4 world matrix, no time step
 
 private:
    LPDIRECT3DDEVICE9 m_device;
-   LPDIRECT3DVERTEXBUFFER9 m_vertBuffer;
-   LPDIRECT3DTEXTURE9  m_texture;
-   static LPDIRECT3DVERTEXBUFFER9 m_defaultVB;
-   static DWORD m_objectCount;
-   float m_posX, m_posY, m_posZ;
-   float m_width, m_height, m_depth;
-   float m_yaw, m_pitch, m_roll;
-   float m_dYaw, m_dPitch, m_dRoll;
-   float m_ddYaw, m_ddPitch, m_ddRoll;
-   DWORD m_oldTime;
+   BufferRef m_vertBuffer;
+   BufferRef m_indexBuffer;
+   TextureRef m_texture;   // texture() each draw, it may still be streaming
 };
 
 
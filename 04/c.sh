@@ -1 +1 @@
-gcc -fpermissive -static  -I"/C/Program Files/Microsoft DirectX SDK (June 2010)/Include" -L"/C/Program Files/Microsoft DirectX SDK (June 2010)/lib/x86" -o example04G.exe example04.cpp Rect3D2.cpp -ld3d9 -ld3dx9 -lstdc++ -mwindows -fno-exceptions
\ No newline at end of file
+gcc -std=c++11 -fpermissive -static  -I"/C/Program Files/Microsoft DirectX SDK (June 2010)/Include" -L"/C/Program Files/Microsoft DirectX SDK (June 2010)/lib/x86" -o example04G.exe example04.cpp Rect3D2.cpp ../common/MeshWeld.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/Occlusion.cpp ../common/BufferManager.cpp ../common/Hash.cpp ../common/TextureCache.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp -ld3d9 -ld3dx9 -lstdc++ -mwindows -fno-exceptions
\ No newline at end of file
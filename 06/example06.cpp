@@ -22,7 +22,7 @@
 
    We add color information to the vertices.  Opposite corners are white,
    opposite corners are blue, opposite corners are red, and opposite corners
-   are green.  Look in the Rect3D2's render function.  There are several new
+   are green.  Look in the Rect3D2's draw function.  There are several new
    calls added after SetTexture.  The first 3 set up color blending, the last
    3 set up alpha blending.  If we weren't dealing with textures these calls
    wouldn't be needed at all.
@@ -37,9 +37,19 @@
 
 #include <windows.h>
 #include <d3dx9.h>
-#include <time.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 #include "Rect3D2.h"
+#include "../common/Cull.h"
+#include "../common/Camera.h"
+#include "../common/TextureCache.h"
+#include "../common/AssetPack.h"
+#include "../common/FrameTimer.h"
+#include "../common/Profiler.h"
+#include "../common/DeviceCapture.h"
+#include "../common/FixedStep.h"
+#include "../common/SceneStore.h"
 
 LPDIRECT3D9 lpD3D9 = NULL;   // will store a pointer to the Direct3D9 object
       // which always exists as part of the directX runtime on the computer
@@ -47,14 +57,25 @@ LPDIRECT3DDEVICE9 lpD3DDevice9 = NULL;   // will store a pointer to the Direct3D
       // which is createdr.  Think of this as the object that is and controls
       // the portion of (or the entire) screen.
 LPD3DXFONT lpD3DXFont = NULL;   // used for displaying text in D3D
-LPDIRECT3DTEXTURE9 lpD3DTex1 = NULL;
 
-//  five pointers to Rect3D2 objects
-Rect3D2 * myRect1;
-Rect3D2 * myRect2;
-Rect3D2 * myRect3;
-Rect3D2 * myRect4;
-Rect3D2 * myRect5;
+Camera camera;   // set up by doMath, objects outside camera.frustum() are skipped
+
+D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
+      // a scene.. such as swap effect.. size.. windowed or full screen..
+      // kept around since Reset needs them again after the device is lost
+
+TextureRef tex1;   // from the texture cache, shared with anything else that loads the same bitmap
+AssetPack assets;   // assets.pak (tools/pack) if there is one, the loose files if not
+FrameTimer frameTimer;   // times every frame and each part of it, for the fps
+FixedStep simClock;      // the simulation runs in steps of 1/60 second, whatever the frame rate
+bool showTimes = false;   // T.. the percentiles instead of just the fps
+CaptureDevice * deviceCounts = NULL;    // C, R.. lpD3DDevice9 goes through it, it counts the calls each frame
+
+// the cubes are entities in the scene store.. the store keeps where
+// they are and how they spin, and they all share one Rect3D2 to draw with
+SceneStore scene;
+Rect3D2 * cubeMesh = NULL;
+std::vector<DrawItem> drawList;   // refilled every frame with what can be seen
 
 
 //*******
@@ -70,6 +91,21 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
    case WM_KEYFIRST:
 	if (wParam==VK_ESCAPE)
 		PostQuitMessage(0);   // post quit message
+	else if (wParam == 'T')   // frame times: percentiles of each part, or just the fps
+		showTimes = !showTimes;
+	else if (wParam == 'F')   // the frame times to a file, to look at in a spreadsheet
+		frameTimer.writeCsv("frametimes.csv");
+	else if (wParam == 'P')   // the profiling zones to a file, for chrome://tracing
+		Profiler::writeChromeTrace("trace.json");
+	else if (wParam == 'C')   // the device calls of each frame to a file
+		deviceCounts->writeJson("devicecounts.json");
+	else if (wParam == 'R')   // record the device calls, for bench/replaybench, or stop
+	{
+		if (deviceCounts->recording())
+			deviceCounts->stop();
+		else
+			deviceCounts->start("capture.d3dcap");
+	}
 	break;
    case WM_DESTROY:         // on WM_DESTROY message
       // cleanup...
@@ -86,8 +122,6 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
 bool init3D(HWND hWnd)
 {
    D3DDISPLAYMODE d3ddm;   // Direct3D Display Mode..
-   D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
-         // a scene.. such as swap effect.. size.. windowed or full screen.. 
    HFONT fnt;
 
    // create D3D9.. if error (like that ever happens..) return false..
@@ -142,6 +176,11 @@ bool init3D(HWND hWnd)
       lpD3DDevice9->SetRenderState( D3DRS_DITHERENABLE, true);
    }
 
+   // from here on everything asked of the device goes through the counter,
+   // which passes it on.. the classes are none the wiser
+   deviceCounts = new CaptureDevice(lpD3DDevice9);
+   lpD3DDevice9 = deviceCounts;
+
    lpD3DDevice9->SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
    lpD3DDevice9->SetRenderState( D3DRS_ZENABLE, false);
    
@@ -170,46 +209,40 @@ bool init3D(HWND hWnd)
 }
 
 
+// makes a cube entity.. the speeds are radians per second around the x, z
+// and y axis, SceneStore::updateMotion spins it on by them
+Entity addCube(float x, float y, float z, float dPitch, float dRoll, float dYaw, float size)
+{
+   Entity e = scene.create();
+   Transform t = { x, y, z,   size, size, size,   0.0f, 0.0f, 0.0f };
+   Motion m = { dYaw, dPitch, dRoll,   0.0f, 0.0f, 0.0f,   0.0f, 0.0f, 0.0f };
+   Renderable r = { cubeMesh, 0.866f };   // half the diagonal of a unit cube
+
+   scene.addTransform(e, t);
+   scene.addMotion(e, m);
+   scene.addRenderable(e, r);
+   return e;
+}
+
+
 bool initData()
 { 
-   // creates a texture from file with default options
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex1.bmp", &lpD3DTex1 );
+   PROFILE_THREAD("render");   // what this thread is called in the trace
+
+   // one mapped file for everything, when it has been built
+   if (assets.open("assets.pak"))
+      TextureCache::instance().setPack(&assets);
+
+   // starts loading the textures on the loader threads.. grey until they are ready
+   tex1 = TextureCache::instance().stream(lpD3DDevice9, "tex1.bmp");
 
    // initialize objects and give them data..
-   myRect1 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect1->setPosition(2.0f, 0.0f, 0.0f);
-   myRect1->setPitch(0.0, 1.0f, 0.0f); 
-   myRect1->setRoll(0.0f, 0.0f, 0.0f);
-   myRect1->setYaw(0.0f, 1.0f, 0.0f);
-   myRect1->setSize(1.0f, 1.0f, 1.0f);
-
-   myRect2 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect2->setPosition(-2.0f, 0.0f, 0.0f);
-   myRect2->setPitch(0.0f, 1.0f, 0.0f);
-   myRect2->setRoll(0.0f, 0.0f, 0.0f);
-   myRect2->setYaw(0.0f, -1.0f, 0.0f);
-   myRect2->setSize(1.0f, 1.0f, 1.0f);
-
-   myRect3 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect3->setPosition(0.0f, 0.0f, 0.0f);
-   myRect3->setPitch(0.0f, 1.0f, 0.0f);
-   myRect3->setRoll(0.0f, 0.0f, 0.0f);
-   myRect3->setYaw(0.0f, 0.0f, 0.0f);
-   myRect3->setSize(1.0f, 1.0f, 1.0f);
-
-   myRect4 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect4->setPosition(0.0f, 2.0f, 0.0f);
-   myRect4->setPitch(0.0f, 1.0f, 0.0f);
-   myRect4->setRoll(0.0f, -1.0f, 0.0f);
-   myRect4->setYaw(0.0f, 0.0f, 0.0f);
-   myRect4->setSize(1.0f, 1.0f, 1.0f);
-
-   myRect5 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect5->setPosition(0.0f, -2.0f, 0.0f);
-   myRect5->setPitch(0.0f, 1.0f, 0.0f);
-   myRect5->setRoll(0.0f, 1.0f, 0.0f);
-   myRect5->setYaw(0.0f, 0.0f, 0.0f);
-   myRect5->setSize(1.0f, 1.0f, 1.0f);
+   cubeMesh = new Rect3D2(lpD3DDevice9, tex1);
+   addCube(2.0f, 0.0f, 0.0f,   1.0f, 0.0f, 1.0f,   1.0f);
+   addCube(-2.0f, 0.0f, 0.0f,   1.0f, 0.0f, -1.0f,   1.0f);
+   addCube(0.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f);
+   addCube(0.0f, 2.0f, 0.0f,   1.0f, -1.0f, 0.0f,   1.0f);
+   addCube(0.0f, -2.0f, 0.0f,   1.0f, 1.0f, 0.0f,   1.0f);
 
    return true;
 }
@@ -217,33 +250,59 @@ bool initData()
 
 void doMath()
 {
-   D3DXMATRIX matView;   // this is the view matrix..
-   D3DXMatrixLookAtLH( &matView, &D3DXVECTOR3( 0.0f, 1.50f, -6.0f ),    // from point..
-                                 &D3DXVECTOR3(0.0f, 0.0f, 0.0f ),       // to point..
-                                 &D3DXVECTOR3( 0.0f, 1.0f, 0.0f ) );    // world up..
-   lpD3DDevice9->SetTransform( D3DTS_VIEW, &matView );                  // sets above
- 
-   D3DXMATRIX matProj; 
+   PROFILE_ZONE("doMath");
+   camera.lookAt( Vec3( 0.0f, 1.50f, -6.0f ),   // from point..
+                  Vec3(0.0f, 0.0f, 0.0f ),      // to point..
+                  Vec3( 0.0f, 1.0f, 0.0f ) );   // world up..
+
    // set 90 degree view field..height/width aspect(1.3333)..near plane..(1.0f)..far plane (100.0f)
    // everything beyond the far plane is clipped.. you don't see it
-   D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI / 4, 1.3333f, 1.0f, 100.0f );
-
-   lpD3DDevice9->SetTransform( D3DTS_PROJECTION, &matProj );   // set the view field
+   camera.perspective( D3DX_PI / 4, 1.3333f, 1.0f, 100.0f );
+
+   // the matrices and the frustum planes are only worked out again when
+   // something above changed, and only the new ones go to the device
+   unsigned int changed = camera.update();
+   if (changed & Camera::VIEW_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_VIEW, (const D3DMATRIX *) camera.view().m );
+   if (changed & Camera::PROJECTION_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_PROJECTION, (const D3DMATRIX *) camera.projection().m );   // set the view field
 }
 
 
 void render()
 {
-   static RECT rc = {0, 0, 320, 100};   // rectangular region.. used for text drawing
-   static DWORD frameCount = 0;
-   static DWORD startTime = clock();
-   char str[16];
+   static RECT rc = {0, 0, 640, 320};   // rectangular region.. used for text drawing
+   unsigned int i;
+   char str[256];
+
+   frameTimer.beginFrame();   // the last frame ends here, Present and all
+   PROFILE_ZONE("render");
+
+   // after an alt-tab the device is lost.. draw nothing until it can be reset
+   if (!BufferManager::instance().restoreDevice(lpD3DDevice9, d3dpp, lpD3DXFont))
+      return;
+
+   // hand the device whatever the loader threads have finished, a bit a frame
+   TextureCache::instance().uploadPending(lpD3DDevice9);
    DWORD val;
 
+   frameTimer.begin(FRAME_UPDATE);
    doMath();   // do the math.. :-P   
-   
-   frameCount++;   //  increment frame count
-    
+
+   // move the cubes on in as many fixed steps as the time the last frame
+   // took calls for, put them part way between the last two steps, and
+   // find the ones that are inside the view frustum
+   unsigned int steps = simClock.advance(frameTimer.lastFrame());
+   while (steps--)
+      scene.updateMotion(simClock.step());
+   scene.interpolate(simClock.alpha());
+   scene.updateWorld();
+   drawList.clear();
+   scene.collectDraws(camera.frustum(), drawList);
+   frameTimer.end(FRAME_UPDATE);
+
+   frameTimer.begin(FRAME_SUBMIT);
+
    // Clear the back buffer to a black... values r g b are 0-256
    lpD3DDevice9->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(256, 256, 256), 1.0f, 0);
    
@@ -285,42 +344,51 @@ void render()
       lpD3DDevice9->SetRenderState( D3DRS_AMBIENT, 0x00202020 );
    }
 
-   // render the cubes
-   myRect1->render(clock());
-   myRect2->render(clock());
-   myRect3->render(clock());
-   myRect4->render(clock());
-   myRect5->render(clock());
-
-   // this function writes a formatted string to a character string
-   // in this case.. it will write "Avg fps"  followed by the 
-   // frames per second.. with 2 decimal places
-   sprintf(str, "Avg fps %.2f", (float) frameCount / ((clock() - startTime) / 1000.0f));
+   // draw the cubes that are inside the view frustum
+   for (i = 0; i < drawList.size(); i++)
+      ((Rect3D2 *) drawList[i].object)->draw(drawList[i].world);
+
+   // the frame rate from the median frame time, and the 99th percentile..
+   // or with T, a table of the percentiles of the whole frame and each part
+   frameTimer.summary(str, sizeof(str), showTimes);
+   if (showTimes)   // and what the device was asked to do last frame
+   {
+      size_t len = strlen(str);
+      if (len + 1 < sizeof(str))
+      {
+         str[len] = '\n';
+         deviceCounts->summary(str + len + 1, sizeof(str) - len - 1);
+      }
+   }
       
    // draw the text string..
    // lpD3DXFont->Begin();
-   lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   {
+      PROFILE_ZONE("DrawText");
+      lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   }
    // lpD3DXFont->End();
    
    // present the back buffer.. or "flip" the page
+   PROFILE_ZONE("Present");   // to the end of render
    lpD3DDevice9->Present( NULL, NULL, NULL, NULL );   // these options are for using rectangular
       // regions for rendering/drawing...
       // 3rd is which target window.. NULL makes it use the currently set one (default)
       // last one is NEVER used.. that happens with DirectX often
+
+   frameTimer.end(FRAME_SUBMIT);
 }
 
 void cleanup()   // it's a dirty job.. but some function has to do it...
 {
-   if (myRect1)
-      delete myRect1;
-   if (myRect2)
-      delete myRect2;
-   if (myRect3)
-      delete myRect3;
-   if (myRect4)
-      delete myRect4;
-   if (myRect5)
-      delete myRect5;
+   if (cubeMesh)
+      delete cubeMesh;
+
+   // the textures go back to the cache, which lets go of them before the device goes
+   tex1.reset();
+   TextureCache::instance().evictUnused();
+   TextureCache::instance().setPack(NULL);
+   assets.close();
 
    if( lpD3DDevice9 != NULL ) 
       lpD3DDevice9->Release();
@@ -330,9 +398,6 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
 
    if( lpD3DXFont != NULL )
       lpD3DXFont->Release();
-
-   if( lpD3DTex1 != NULL )
-      lpD3DTex1->Release();
 }
 
 // windows stuff.. 
@@ -42,6 +42,11 @@
    correspond to distance; rather it corresponds to the size of the actual
    texture image relative to its raster size on the screen.
 
+   The mip filter picks between the smaller copies of the texture (mip
+   levels) made when it is loaded.  With it off the far side of the cube
+   shimmers, since the min filter only ever looks at the full size image.
+   Press M to switch it off and on.
+
    Below the filtering code in WinProc is some simple code to toggle lighting
    and blending on and off.  Notice that blending also requires the state
    change of culling and the z-buffer.  In an example like this we wouldn't
@@ -66,9 +71,19 @@
 
 #include <windows.h>
 #include <d3dx9.h>
-#include <time.h>
 #include <stdio.h>
+#include <string.h>
+#include <vector>
 #include "Rect3D2.h"
+#include "../common/Cull.h"
+#include "../common/Camera.h"
+#include "../common/TextureCache.h"
+#include "../common/AssetPack.h"
+#include "../common/FrameTimer.h"
+#include "../common/Profiler.h"
+#include "../common/DeviceCapture.h"
+#include "../common/FixedStep.h"
+#include "../common/SceneStore.h"
 
 LPDIRECT3D9 lpD3D9 = NULL;   // will store a pointer to the Direct3D9 object
       // which always exists as part of the directX runtime on the computer
@@ -79,10 +94,24 @@ LPDIRECT3DDEVICE9 lpD3DDevice9 = NULL;   // will store a pointer to the Direct3D
 
 LPD3DXFONT lpD3DXFont = NULL;   // used for displaying text in D3D
 
-LPDIRECT3DTEXTURE9 lpD3DTex1 = NULL;   // pointer to a texture object
+Camera camera;   // set up by doMath, objects outside camera.frustum() are skipped
+
+D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
+      // a scene.. such as swap effect.. size.. windowed or full screen..
+      // kept around since Reset needs them again after the device is lost
+
+TextureRef tex1;                       // the texture, from the texture cache
+AssetPack assets;                      // assets.pak (tools/pack) if there is one, the loose files if not
+FrameTimer frameTimer;                 // times every frame and each part of it, for the fps
+FixedStep simClock;                    // the simulation runs in steps of 1/60 second, whatever the frame rate
+bool showTimes = false;                // T.. the percentiles instead of just the fps
+CaptureDevice * deviceCounts = NULL;    // C, R.. lpD3DDevice9 goes through it, it counts the calls each frame
 
-//  pointer to object
-Rect3D2 * myRect1;
+// the cube is an entity in the scene store.. the store keeps where
+// it is and how it spins, the Rect3D2 only draws it
+SceneStore scene;
+Rect3D2 * cubeMesh = NULL;
+std::vector<DrawItem> drawList;   // refilled every frame with what can be seen
 
 
 // we added some keyboard input
@@ -101,10 +130,34 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
       case VK_ESCAPE:
 	PostQuitMessage(0);   // post quit message
 	break;
+      case 'T':             // frame times: percentiles of each part, or just the fps
+         showTimes = !showTimes;
+         break;
+
+      case 'F':             // the frame times to a file, to look at in a spreadsheet
+         frameTimer.writeCsv("frametimes.csv");
+         break;
+
+      case 'P':             // the profiling zones to a file, for chrome://tracing
+         Profiler::writeChromeTrace("trace.json");
+         break;
+
+      case 'C':             // the device calls of each frame to a file
+         deviceCounts->writeJson("devicecounts.json");
+         break;
+
+      case 'R':             // record the device calls, for bench/replaybench, or stop
+         if (deviceCounts->recording())
+            deviceCounts->stop();
+         else
+            deviceCounts->start("capture.d3dcap");
+         break;
+
       case '1':
          {
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_POINT );
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MINFILTER, D3DTEXF_POINT );
+            lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MIPFILTER, D3DTEXF_POINT );
 /*
             lpD3DDevice9->SetTextureStageState( 0, D3DTSS_MAGFILTER, 
                D3DTEXF_POINT );
@@ -118,6 +171,7 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
          {
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR );
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR );
+            lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR );
             break;
          }
 
@@ -125,6 +179,16 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
          {
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_ANISOTROPIC );
             lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MINFILTER, D3DTEXF_ANISOTROPIC );
+            lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR );
+            break;
+         }
+
+      case 'M':   // mip levels on and off, to see the difference
+         {
+            DWORD val;
+            lpD3DDevice9->GetSamplerState( 0, D3DSAMP_MIPFILTER, &val );
+            lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MIPFILTER,
+                                           val == D3DTEXF_NONE ? D3DTEXF_LINEAR : D3DTEXF_NONE );
             break;
          }
 
@@ -170,8 +234,6 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
 bool init3D(HWND hWnd)
 {
    D3DDISPLAYMODE d3ddm;   // Direct3D Display Mode..
-   D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
-         // a scene.. such as swap effect.. size.. windowed or full screen.. 
    HFONT fnt;
 
    // create D3D9.. if error (like that ever happens..) return false..
@@ -226,6 +288,11 @@ bool init3D(HWND hWnd)
       lpD3DDevice9->SetRenderState( D3DRS_DITHERENABLE, true);
    }
 
+   // from here on everything asked of the device goes through the counter,
+   // which passes it on.. the classes are none the wiser
+   deviceCounts = new CaptureDevice(lpD3DDevice9);
+   lpD3DDevice9 = deviceCounts;
+
    lpD3DDevice9->SetRenderState( D3DRS_CULLMODE, D3DCULL_CCW );
    lpD3DDevice9->SetRenderState( D3DRS_ZENABLE, true);
    
@@ -254,22 +321,41 @@ bool init3D(HWND hWnd)
 }  // end of init3D
 
 
+// makes a cube entity.. the speeds are radians per second around the x, z
+// and y axis, SceneStore::updateMotion spins it on by them
+Entity addCube(float x, float y, float z, float dPitch, float dRoll, float dYaw, float size)
+{
+   Entity e = scene.create();
+   Transform t = { x, y, z,   size, size, size,   0.0f, 0.0f, 0.0f };
+   Motion m = { dYaw, dPitch, dRoll,   0.0f, 0.0f, 0.0f,   0.0f, 0.0f, 0.0f };
+   Renderable r = { cubeMesh, 0.866f };   // half the diagonal of a unit cube
+
+   scene.addTransform(e, t);
+   scene.addMotion(e, m);
+   scene.addRenderable(e, r);
+   return e;
+}
+
+
 bool initData()
 { 
-   // creates a texture from file with default options
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex1.bmp", &lpD3DTex1 );
+   PROFILE_THREAD("render");   // what this thread is called in the trace
+
+   // one mapped file for everything, when it has been built
+   if (assets.open("assets.pak"))
+      TextureCache::instance().setPack(&assets);
+
+   // starts loading the textures on the loader threads.. grey until they are ready
+   tex1 = TextureCache::instance().stream(lpD3DDevice9, "tex1.bmp");
 
    // default blending
    lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_ANISOTROPIC );
    lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MINFILTER, D3DTEXF_ANISOTROPIC );
+   lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR );   // blend between mip levels too
 
    // initialize objects and give them data..
-   myRect1 = new Rect3D2(lpD3DDevice9, lpD3DTex1);
-   myRect1->setPosition(0.0f, 0.0f, 0.0f);
-   myRect1->setPitch(0.0f, .20f, 0.0f);
-   myRect1->setRoll(0.0f, .20f, 0.0f);
-   myRect1->setYaw(0.0f, .20f, 0.0f);
-   myRect1->setSize(3.0f, 3.0f, 3.0f);
+   cubeMesh = new Rect3D2(lpD3DDevice9, tex1);
+   addCube(0.0f, 0.0f, 0.0f,   .20f, .20f, .20f,   3.0f);
 
    return true;
 }
@@ -277,33 +363,59 @@ bool initData()
 
 void doMath()
 {
-   D3DXMATRIX matView;   // this is the view matrix..
-   D3DXMatrixLookAtLH( &matView, &D3DXVECTOR3( 0.0f, 1.50f, -6.0f ),   // from point..
-                                 &D3DXVECTOR3(0.0f, 0.0f, 0.0f ),      // to point..
-                                 &D3DXVECTOR3( 0.0f, 1.0f, 0.0f ) );   // world up..
-   lpD3DDevice9->SetTransform( D3DTS_VIEW, &matView );                 // sets above
- 
-   D3DXMATRIX matProj; 
+   PROFILE_ZONE("doMath");
+   camera.lookAt( Vec3( 0.0f, 1.50f, -6.0f ),   // from point..
+                  Vec3(0.0f, 0.0f, 0.0f ),      // to point..
+                  Vec3( 0.0f, 1.0f, 0.0f ) );   // world up..
+
    // set 90 degree view field..height/width aspect(1.3333)..near plane..(1.0f)..far plane (100.0f)
    // everything beyond the far plane is clipped.. you don't see it
-   D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI / 4, 1.3333f, 1.0f, 200.0f );
-
-   lpD3DDevice9->SetTransform( D3DTS_PROJECTION, &matProj );   // set the view field
+   camera.perspective( D3DX_PI / 4, 1.3333f, 1.0f, 200.0f );
+
+   // the matrices and the frustum planes are only worked out again when
+   // something above changed, and only the new ones go to the device
+   unsigned int changed = camera.update();
+   if (changed & Camera::VIEW_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_VIEW, (const D3DMATRIX *) camera.view().m );
+   if (changed & Camera::PROJECTION_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_PROJECTION, (const D3DMATRIX *) camera.projection().m );   // set the view field
 }
 
 
 void render()
 {
-   static RECT rc = {0, 0, 320, 100};   // rectangular region.. used for text drawing
-   static DWORD frameCount = 0;
-   static DWORD startTime = clock();
-   char str[16];
+   static RECT rc = {0, 0, 640, 320};   // rectangular region.. used for text drawing
+   unsigned int i;
+   char str[256];
+
+   frameTimer.beginFrame();   // the last frame ends here, Present and all
+   PROFILE_ZONE("render");
+
+   // after an alt-tab the device is lost.. draw nothing until it can be reset
+   if (!BufferManager::instance().restoreDevice(lpD3DDevice9, d3dpp, lpD3DXFont))
+      return;
+
+   // hand the device whatever the loader threads have finished, a bit a frame
+   TextureCache::instance().uploadPending(lpD3DDevice9);
    DWORD val;
 
+   frameTimer.begin(FRAME_UPDATE);
    doMath();   // do the math.. :-P   
-   
-   frameCount++;   // increment frame count
-    
+
+   // move the cubes on in as many fixed steps as the time the last frame
+   // took calls for, put them part way between the last two steps, and
+   // find the ones that are inside the view frustum
+   unsigned int steps = simClock.advance(frameTimer.lastFrame());
+   while (steps--)
+      scene.updateMotion(simClock.step());
+   scene.interpolate(simClock.alpha());
+   scene.updateWorld();
+   drawList.clear();
+   scene.collectDraws(camera.frustum(), drawList);
+   frameTimer.end(FRAME_UPDATE);
+
+   frameTimer.begin(FRAME_SUBMIT);
+
    // Clear the back buffer to a black... values r g b are 0-256
    lpD3DDevice9->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(256, 256, 256), 1.0f, 0);
    
@@ -345,31 +457,52 @@ void render()
       lpD3DDevice9->SetRenderState( D3DRS_AMBIENT, 0x00404040 );
    }  // end of lighting enabled code
 
-   // render the cube
-   myRect1->render(clock());
+   // draw the cube that is inside the view frustum
+   for (i = 0; i < drawList.size(); i++)
+      ((Rect3D2 *) drawList[i].object)->draw(drawList[i].world);
 
-   // this function writes a formatted string to a character string
-   // in this case.. it will write "Avg fps" followed by the 
-   // frames per second.. with 2 decimal places
-   sprintf(str, "Avg fps %.2f", (float) frameCount / ((clock() - startTime) / 1000.0f));
+   // the frame rate from the median frame time, and the 99th percentile..
+   // or with T, a table of the percentiles of the whole frame and each part
+   frameTimer.summary(str, sizeof(str), showTimes);
+   if (showTimes)   // and what the device was asked to do last frame
+   {
+      size_t len = strlen(str);
+      if (len + 1 < sizeof(str))
+      {
+         str[len] = '\n';
+         deviceCounts->summary(str + len + 1, sizeof(str) - len - 1);
+      }
+   }
       
    // draw the text string..
    // lpD3DXFont->Begin();
-   lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   {
+      PROFILE_ZONE("DrawText");
+      lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   }
    // lpD3DXFont->End();
    
    // present the back buffer.. or "flip" the page
+   PROFILE_ZONE("Present");   // to the end of render
    lpD3DDevice9->Present( NULL, NULL, NULL, NULL );   // these options are for using rectangular
       // regions for rendering/drawing...
       // 3rd is which target window.. NULL makes it use the currently set one (default)
       // last one is NEVER used.. that happens with DirectX often
+
+   frameTimer.end(FRAME_SUBMIT);
 }   // end of render
 
 
 void cleanup()   // it's a dirty job.. but some function has to do it...
 {
-   if (myRect1)
-      delete myRect1;
+   if (cubeMesh)
+      delete cubeMesh;
+
+   // the textures go back to the cache, which lets go of them before the device goes
+   tex1.reset();
+   TextureCache::instance().evictUnused();
+   TextureCache::instance().setPack(NULL);
+   assets.close();
 
    if ( lpD3DDevice9 != NULL ) 
         lpD3DDevice9->Release();
@@ -379,9 +512,6 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
 
    if ( lpD3DXFont != NULL )
       lpD3DXFont->Release();
-
-   if ( lpD3DTex1 != NULL )
-      lpD3DTex1->Release();
 }
 
 
@@ -394,7 +524,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 
    // display some simple instructions to the user
    MessageBox(NULL, 
-      "Press 1 for Point filtering\nPress 2 for Linear filtering\nPress 3 for Anisotropic filtering\n\nPress B to toggle blending\nPress L to toggle lighting\n",
+      "Press 1 for Point filtering\nPress 2 for Linear filtering\nPress 3 for Anisotropic filtering\nPress M to toggle mip mapping\n\nPress B to toggle blending\nPress L to toggle lighting\n",
       "Filter Instructions", NULL);
 
    // set up and register wndclass wc... windows stuff
@@ -10,6 +10,8 @@
 */
 
 #include "Wall.h"
+#include "../common/Profiler.h"
+#include <stdio.h>
 
 // defines our vertex structure
 struct CUSTOMVERTEX
@@ -36,7 +38,7 @@ const CUSTOMVERTEX WALL_VERTS[] =
 #define D3DFVF_CUSTOMVERTEX (D3DFVF_XYZ | D3DFVF_TEX2)
 
 
-Wall::Wall(LPDIRECT3DDEVICE9 dev, LPDIRECT3DTEXTURE9 tex, LPDIRECT3DTEXTURE9 lightmap)
+Wall::Wall(LPDIRECT3DDEVICE9 dev, const TextureRef & tex, const TextureRef & lightmap)
 {  // init member variables..
    m_device = dev;
    m_texture = tex;
@@ -49,25 +51,18 @@ Wall::Wall(LPDIRECT3DDEVICE9 dev, LPDIRECT3DTEXTURE9 tex, LPDIRECT3DTEXTURE9 lig
    m_updateTexCoords = true;   // texture coordinates need to be updated before rendering
    m_ltMapOp = D3DTOP_MODULATE;   // set default op
 
-   dev->CreateVertexBuffer(sizeof(WALL_VERTS),   // create a vertex buffer..
-               0,                     // type and processing style.. none for this 
-               D3DFVF_CUSTOMVERTEX,   // use our defined properties..
-               D3DPOOL_DEFAULT,       // memory class to place the resource..
-               &m_vertBuffer,         // stored in member variable
-               NULL);
-
-   void * pVertices;   // stores pointer to the data portion of the vertex buffer
-   m_vertBuffer->Lock(0, sizeof(WALL_VERTS), (void**) &pVertices, 0 );
-   memcpy(pVertices, WALL_VERTS, sizeof(WALL_VERTS));   // copies mem..
-   m_vertBuffer->Unlock();   // unlocks vert buffer.. VERY IMPORTANT!!!   
+   // each wall moves its own light map, so each one gets its own buffer
+   char name[32];
+   sprintf(name, "Wall %p", (void *) this);
+   m_vertBuffer = BufferManager::instance().acquireVertices(dev, name, WALL_VERTS,
+                     sizeof(WALL_VERTS), D3DFVF_CUSTOMVERTEX);
 }
 
 
 // cleanup..
 Wall::~Wall()
 {
-   if (m_vertBuffer)
-      m_vertBuffer->Release();
+   // m_vertBuffer lets go of the buffer by itself
 }
 
 
@@ -176,8 +171,30 @@ void Wall::ltMapDisable()
 }
 
 
+void Wall::setLightMap(const TextureRef & lightmap)
+{
+   m_lightMap = lightmap;   // the old one goes back to the cache
+}
+
+
+// the wall is flat, so it is a box with no depth that is moved
+// the same way render moves the vertices
+BoundBox Wall::getBounds() const
+{
+   D3DXMATRIX matWorld, matTemp;
+   D3DXMATRIX matRot, matTranslate, matScale;
+   D3DXMatrixRotationYawPitchRoll( &matRot, m_yaw, m_pitch, m_roll);
+   D3DXMatrixTranslation( &matTranslate, m_posX, m_posY, m_posZ );
+   D3DXMatrixScaling( &matScale, m_width, m_height, 0);
+   D3DXMatrixMultiply( &matTemp, &matScale, &matRot);
+   D3DXMatrixMultiply( &matWorld, &matTemp, &matTranslate);
+   return transformBoundBox(makeBoundBox(0, 0, 0, 0.5f, 0.5f, 0), matWorld);
+}
+
+
 void Wall::render()
 {
+   PROFILE_ZONE("Wall::render");
    // matrices..
    D3DXMATRIX matWorld, matTemp;
    D3DXMATRIX matRot, matTranslate, matScale;   
@@ -193,8 +210,9 @@ void Wall::render()
    // if the lightmap (2nd texture) has been moved.. update its coordinates..
    if (m_updateTexCoords)
    {  // only if lightmap has moved or resized by user
-      CUSTOMVERTEX * ptr;   // stores pointer to the data portion of the vertex buffer
-      m_vertBuffer->Lock(0, sizeof(WALL_VERTS), (void**) &ptr, 0 );
+      // change the saved copy of the vertices, then upload it.. that way
+      // the buffer still has the right coordinates if it has to be made again
+      CUSTOMVERTEX * ptr = (CUSTOMVERTEX *) m_vertBuffer.data();
    
       // set the location of the light map.. a little complex due to 
       // texture coordinates.. note we are using CLAMP for this 
@@ -204,18 +222,19 @@ void Wall::render()
       ptr[0].tv2 = ptr[3].tv2 = (1 - m_ltMapY) / (m_ltMapH / 2);
       ptr[1].tv2 = ptr[2].tv2 = 1 - (m_ltMapY) / (m_ltMapH / 2);
       
-      m_vertBuffer->Unlock();   // unlocks vert buffer.. VERY IMPORTANT!!!
+      if (m_vertBuffer.upload())
+         m_updateTexCoords = false;
    }
 
    // set the first texture and its ops
-   m_device->SetTexture(0, m_texture);
+   m_device->SetTexture(0, m_texture.texture());
    m_device->SetTextureStageState( 0, D3DTSS_COLORARG1, D3DTA_TEXTURE );
    m_device->SetTextureStageState( 0, D3DTSS_COLOROP,   D3DTOP_MODULATE );
    m_device->SetTextureStageState( 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE );
    m_device->SetTextureStageState( 0, D3DTSS_ALPHAOP,   D3DTOP_DISABLE );
 
    // set the 2nd texture (the light map) and its ops
-   m_device->SetTexture(1, m_lightMap);
+   m_device->SetTexture(1, m_lightMap.texture());
    m_device->SetTextureStageState( 1, D3DTSS_COLORARG1, D3DTA_TEXTURE );
    m_device->SetTextureStageState( 1, D3DTSS_COLOROP,   m_ltMapOp );
    m_device->SetTextureStageState( 1, D3DTSS_COLORARG2, D3DTA_CURRENT );
@@ -225,7 +244,7 @@ void Wall::render()
 
    // do usual stuff
    m_device->BeginScene();
-   m_device->SetStreamSource( 0, m_vertBuffer, 0, sizeof(CUSTOMVERTEX) );   // set vertex stream..
+   m_device->SetStreamSource( 0, m_vertBuffer.vertexBuffer(), 0, sizeof(CUSTOMVERTEX) );   // set vertex stream..
    m_device->SetFVF( D3DFVF_CUSTOMVERTEX );
    //m_device->SetVertexShader( D3DFVF_CUSTOMVERTEX );   // set vertex shader options
    m_device->DrawPrimitive(D3DPT_TRIANGLEFAN, 0, 2);
@@ -10,11 +10,14 @@
 */
 
 #include <d3dx9.h>
+#include "../common/Cull.h"
+#include "../common/BufferManager.h"
+#include "../common/TextureCache.h"
 
 class Wall
 {
 public:
-   Wall(LPDIRECT3DDEVICE9 dev, LPDIRECT3DTEXTURE9 tex, LPDIRECT3DTEXTURE9 lightmap);   // default constructor
+   Wall(LPDIRECT3DDEVICE9 dev, const TextureRef & tex, const TextureRef & lightmap);   // default constructor
    ~Wall();   // default destructor
 
    void setHeightWidth(float y, float x);   // sets size of the wall
@@ -25,18 +28,20 @@ public:
    void mvLtL();             // .. left..
    void mvLtR();             // .. right..
    void render();            // render
+   BoundBox getBounds() const;   // world space box for culling
    void ltMapModulate();     // set Modulate as the op
    void ltMapModulate2x();   // set Modulate2x as the op..
    void ltMapModulate4x();   // .. modulate4x...
    void ltMapAdd();          // .. add...
    void ltMapSubtract();     // .. subtract..
    void ltMapDisable();      // disable 2nd texture
+   void setLightMap(const TextureRef & lightmap);   // a different 2nd texture
 
 private:
    LPDIRECT3DDEVICE9         m_device;
-   LPDIRECT3DVERTEXBUFFER9   m_vertBuffer;
-   LPDIRECT3DTEXTURE9        m_texture;    // primary texture..
-   LPDIRECT3DTEXTURE9        m_lightMap;   // 2nd texture..
+   BufferRef                 m_vertBuffer;
+   TextureRef                m_texture;    // primary texture.. may still be streaming
+   TextureRef                m_lightMap;   // 2nd texture..
 
    float m_posX, m_posY, m_posZ;   // position of wall
    float m_height, m_width;        // dimensions of wall
@@ -63,6 +63,10 @@
    texture, and values inside will cause the edge pixels to be smeared across
    the rest of the base.  See MSDN's documentation for more details.  The last
    step is to render the primitives.
+
+   The light map isn't loaded from tex2.bmp any more.  makeLightMap makes one
+   like it with ProcTex, which takes less time than reading the file would,
+   and L switches to a spot light, noise or a checker board instead.
 */
 
 #define D3D_OVERLOADS
@@ -70,9 +74,17 @@
 
 #include <windows.h>
 #include <d3dx9.h>
-#include <time.h>
 #include <stdio.h>
+#include <string.h>
 #include "Wall.h"
+#include "../common/Cull.h"
+#include "../common/Camera.h"
+#include "../common/TextureCache.h"
+#include "../common/AssetPack.h"
+#include "../common/FrameTimer.h"
+#include "../common/Profiler.h"
+#include "../common/DeviceCapture.h"
+#include "../common/ProcTex.h"
 
 LPDIRECT3D9 lpD3D9 = NULL;   // will store a pointer to the Direct3D9 object
       // which always exists as part of the directX runtime on the computer
@@ -83,13 +95,27 @@ LPDIRECT3DDEVICE9 lpD3DDevice9 = NULL;   // will store a pointer to the Direct3D
 
 LPD3DXFONT lpD3DXFont = NULL;   // used for displaying text in D3D
 
-LPDIRECT3DTEXTURE9 lpD3DTex1 = NULL;   // pointer to a texture object
-LPDIRECT3DTEXTURE9 lpD3DTex2 = NULL;   // pointer for light map
+Camera camera;   // set up by doMath, objects outside camera.frustum() are skipped
+
+D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
+      // a scene.. such as swap effect.. size.. windowed or full screen..
+      // kept around since Reset needs them again after the device is lost
+
+TextureRef tex1;                       // the texture, from the texture cache
+TextureRef tex2;                       // light map, made by makeLightMap
+int lightPattern = PROC_RADIAL;        // which one.. L goes to the next
+AssetPack assets;                      // assets.pak (tools/pack) if there is one, the loose files if not
+FrameTimer frameTimer;                 // times every frame and each part of it, for the fps
+bool showTimes = false;                // T.. the percentiles instead of just the fps
+CaptureDevice * deviceCounts = NULL;    // C, R.. lpD3DDevice9 goes through it, it counts the calls each frame
 
 //  pointer to object
 Wall * myWall;
 
 
+TextureRef makeLightMap(int pattern);
+
+
 LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
 {
    switch(uMsg)             // switch for messages..
@@ -105,6 +131,29 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
       case VK_ESCAPE:
 		PostQuitMessage(0);   // post quit message
          break;
+      case 'T':             // frame times: percentiles of each part, or just the fps
+         showTimes = !showTimes;
+         break;
+
+      case 'F':             // the frame times to a file, to look at in a spreadsheet
+         frameTimer.writeCsv("frametimes.csv");
+         break;
+
+      case 'P':             // the profiling zones to a file, for chrome://tracing
+         Profiler::writeChromeTrace("trace.json");
+         break;
+
+      case 'C':             // the device calls of each frame to a file
+         deviceCounts->writeJson("devicecounts.json");
+         break;
+
+      case 'R':             // record the device calls, for bench/replaybench, or stop
+         if (deviceCounts->recording())
+            deviceCounts->stop();
+         else
+            deviceCounts->start("capture.d3dcap");
+         break;
+
       case 'W':             // move the light up on the wall
          if (myWall)
             myWall->mvLtUp();
@@ -165,6 +214,15 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
             myWall->ltMapDisable();
          break;
 
+      case 'L':             // the next kind of light map
+         lightPattern = (lightPattern + 1) % (PROC_CHECKER + 1);
+         if (myWall)
+         {
+            tex2 = makeLightMap(lightPattern);
+            myWall->setLightMap(tex2);
+         }
+         break;
+
       }  // end of wParam switch
    }  // end of the uMsg switch
 
@@ -177,8 +235,6 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
 bool init3D(HWND hWnd)
 {
    D3DDISPLAYMODE d3ddm;   // Direct3D Display Mode..
-   D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
-         // a scene.. such as swap effect.. size.. windowed or full screen.. 
    HFONT fnt;
 
    // create D3D9.. if error (like that ever happens..) return false..
@@ -233,6 +289,11 @@ bool init3D(HWND hWnd)
       lpD3DDevice9->SetRenderState( D3DRS_DITHERENABLE, true);
    }
 
+   // from here on everything asked of the device goes through the counter,
+   // which passes it on.. the classes are none the wiser
+   deviceCounts = new CaptureDevice(lpD3DDevice9);
+   lpD3DDevice9 = deviceCounts;
+
    lpD3DDevice9->SetRenderState( D3DRS_CULLMODE, D3DCULL_CCW );
    lpD3DDevice9->SetRenderState( D3DRS_ZENABLE, true );
    
@@ -261,17 +322,37 @@ bool init3D(HWND hWnd)
 }  // end of init3D
 
 
+// the light map used to be tex2.bmp.. now it is made when it's wanted, a
+// light blob like tex2.bmp had or one of ProcTex's other patterns
+TextureRef makeLightMap(int pattern)
+{
+   static unsigned int pixels[256 * 256];
+   ProcParams params = procParams((ProcPattern) pattern);
+
+   params.inner = 0xFFE5E2DF;   // the colours tex2.bmp had
+   params.outer = 0xFF323232;
+   generateTexture(params, pixels, 256, 256, 256 * 4);
+   return TextureCache::instance().acquireFromPixels(lpD3DDevice9, pixels, 256, 256, 256 * 4);
+}
+
+
 bool initData()
 { 
-   // creates a texture from file with default options
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex1.bmp", &lpD3DTex1 );
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex2.bmp", &lpD3DTex2 );
+   PROFILE_THREAD("render");   // what this thread is called in the trace
+
+   // one mapped file for everything, when it has been built
+   if (assets.open("assets.pak"))
+      TextureCache::instance().setPack(&assets);
+
+   // starts loading the textures on the loader threads.. grey until they are ready
+   tex1 = TextureCache::instance().stream(lpD3DDevice9, "tex1.bmp");
+   tex2 = makeLightMap(lightPattern);
 
    // default blending
    lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR );
    lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR );
 
-   myWall = new Wall(lpD3DDevice9, lpD3DTex1, lpD3DTex2);
+   myWall = new Wall(lpD3DDevice9, tex1, tex2);
    myWall->setHeightWidth(5, 5);
 
    return true;
@@ -280,53 +361,82 @@ bool initData()
 
 void doMath()
 {
-   D3DXMATRIX matView;   // this is the view matrix..
-   D3DXMatrixLookAtLH( &matView, &D3DXVECTOR3( 0.0f, 0.0f, -6.0f ),     // from point..
-                                 &D3DXVECTOR3(0.0f, 0.0f, 0.0f ),       // to point..
-                                 &D3DXVECTOR3( 0.0f, 1.0f, 0.0f ) );    // world up..
-   lpD3DDevice9->SetTransform( D3DTS_VIEW, &matView );                  // sets above
+   PROFILE_ZONE("doMath");
+   camera.lookAt( Vec3( 0.0f, 0.0f, -6.0f ),    // from point..
+                  Vec3(0.0f, 0.0f, 0.0f ),      // to point..
+                  Vec3( 0.0f, 1.0f, 0.0f ) );   // world up..
 
-   D3DXMATRIX matProj; 
    // set 90 degree view field..height/width aspect(1.3333)..near plane..(1.0f)..far plane (100.0f)
    // everything beyond the far plane is clipped.. you don't see it
-   D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI / 4, 1.3333f, 1.0f, 200.0f );
-
-   lpD3DDevice9->SetTransform( D3DTS_PROJECTION, &matProj );   // set the view field
+   camera.perspective( D3DX_PI / 4, 1.3333f, 1.0f, 200.0f );
+
+   // the matrices and the frustum planes are only worked out again when
+   // something above changed, and only the new ones go to the device
+   unsigned int changed = camera.update();
+   if (changed & Camera::VIEW_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_VIEW, (const D3DMATRIX *) camera.view().m );
+   if (changed & Camera::PROJECTION_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_PROJECTION, (const D3DMATRIX *) camera.projection().m );   // set the view field
 }
 
 
 void render()
 {
-   static RECT rc = {0, 0, 320, 100};   // rectangular region.. used for text drawing
-   static DWORD frameCount = 0;
-   static DWORD startTime = clock();
-   char str[16];
+   static RECT rc = {0, 0, 640, 320};   // rectangular region.. used for text drawing
+   char str[256];
+
+   frameTimer.beginFrame();   // the last frame ends here, Present and all
+   PROFILE_ZONE("render");
 
+   // after an alt-tab the device is lost.. draw nothing until it can be reset
+   if (!BufferManager::instance().restoreDevice(lpD3DDevice9, d3dpp, lpD3DXFont))
+      return;
+
+   // hand the device whatever the loader threads have finished, a bit a frame
+   TextureCache::instance().uploadPending(lpD3DDevice9);
+
+   frameTimer.begin(FRAME_UPDATE);
    doMath();   // do the math.. :-P   
-   
-   frameCount++;   //  increment frame count
-    
+   frameTimer.end(FRAME_UPDATE);
+
+   frameTimer.begin(FRAME_SUBMIT);
+
    // Clear the backbuffer to a black... values r g b are 0-256
    lpD3DDevice9->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(256, 256, 256), 1.0f, 0);
 
    // render the wall with the light map on it using the set op
-   myWall->render();
+   if (camera.frustum().testBox(myWall->getBounds()))
+      myWall->render();
 
-   // this function writes a formatted string to a character string
-   // in this case.. it will write "Avg fps" followed by the 
-   // frames per second.. with 2 decimal places
-   sprintf(str, "Avg fps %.2f", (float) frameCount / ((clock() - startTime) / 1000.0f));
+   // the frame rate from the median frame time, and the 99th percentile..
+   // or with T, a table of the percentiles of the whole frame and each part
+   frameTimer.summary(str, sizeof(str), showTimes);
+   if (showTimes)   // and what the device was asked to do last frame
+   {
+      size_t len = strlen(str);
+      if (len + 1 < sizeof(str))
+      {
+         str[len] = '\n';
+         deviceCounts->summary(str + len + 1, sizeof(str) - len - 1);
+      }
+   }
       
    // draw the text string..
    // lpD3DXFont->Begin();
-   lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   {
+      PROFILE_ZONE("DrawText");
+      lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   }
    // lpD3DXFont->End();
    
    // present the back buffer.. or "flip" the page
+   PROFILE_ZONE("Present");   // to the end of render
    lpD3DDevice9->Present( NULL, NULL, NULL, NULL );   // these options are for using rectangular
       // regions for rendering/drawing...
       // 3rd is which target window.. NULL makes it use the currently set one (default)
       // last one is NEVER used.. that happens with DirectX often
+
+   frameTimer.end(FRAME_SUBMIT);
 }
 
 
@@ -335,6 +445,13 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
    if (myWall)
       delete myWall;
 
+   // the textures go back to the cache, which lets go of them before the device goes
+   tex1.reset();
+   tex2.reset();
+   TextureCache::instance().evictUnused();
+   TextureCache::instance().setPack(NULL);
+   assets.close();
+
    if ( lpD3DDevice9 != NULL ) 
         lpD3DDevice9->Release();
 
@@ -343,9 +460,6 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
 
    if ( lpD3DXFont != NULL )
       lpD3DXFont->Release();
-
-   if ( lpD3DTex1 != NULL )
-      lpD3DTex1->Release();
 }
 
 
@@ -358,7 +472,7 @@ int APIENTRY WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLi
 
    // display some simple instructions to the user
    MessageBox(NULL, 
-      "Q/E Light Size\nA/D Left and right\nW/S Up and down\n\nTexture Operations\n1 - Modulate\n2 - Modulate2x\n3 - Modulate4x\n4 - Add\n5 - Subtract\n6 - Disable\n",
+      "Q/E Light Size\nA/D Left and right\nW/S Up and down\n\nTexture Operations\n1 - Modulate\n2 - Modulate2x\n3 - Modulate4x\n4 - Add\n5 - Subtract\n6 - Disable\n\nL - Next light map\n",
       "Instructions", NULL);
 
    // set up and register wndclass wc... windows stuff
@@ -10,6 +10,8 @@
 */
 
 #include "Flag3D.h"
+#include "../common/Profiler.h"
+#include <stdio.h>
 
 // defines our vertex structure
 struct CUSTOMVERTEX
@@ -33,8 +35,6 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
 {
    CUSTOMVERTEX verts[LENGTH][WIDTH];   // big.. 140,000 bytes.. [x][z]
    int i, j;   // counting
-   VOID * pVertices;   // stores pointer to the data portion of the vertex buffer
-   VOID * pIndices;    // stores temp pointer to data portion of index buffer
    unsigned short triIndex[LENGTH - 1][WIDTH - 1][6];
    unsigned short lineIndex[2 * ((LENGTH - 1) * (WIDTH) + (LENGTH) * (WIDTH - 1))];
    unsigned short lineIndex1[LENGTH - 1][WIDTH][2];
@@ -44,8 +44,6 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
    m_primitiveType = 0;   // set default primitive type
    m_device = dev;        // store device pointer
 
-   m_textures[0] = m_textures[1] = NULL;
-   m_indexBuffers[0] = m_indexBuffers[1] = m_indexBuffers[2] = NULL;
 
    // calculates the x and z values for the curve, y values are calculated prior to each render
    for (i = 0; i < LENGTH; i++)
@@ -66,18 +64,11 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
       }
    }
 
-   dev->CreateVertexBuffer(sizeof(verts),   // create a vertex buffer..
-                  0,                        // type and processing style.. none for this 
-                  D3DFVF_CUSTOMVERTEX,      // use our defined properties..
-                  D3DPOOL_DEFAULT,          // memory class to place the resource..
-                  &m_vertBuffer,            // stored in member variable
-                  NULL);
-
-   if (FAILED(m_vertBuffer->Lock(0, sizeof(verts), (void**) &pVertices, 0 )))
-      return ;   // gets and locks data portion of vert buffer
-   memcpy(pVertices, verts, sizeof(verts));   // copies mem..
-   m_vertBuffer->Unlock();   // unlocks vert buffer.. VERY IMPORTANT!!!
-   pVertices = NULL;   // store null in pointer for safety
+   // the heights and normals are written every frame, so each flag has its own
+   char name[32];
+   sprintf(name, "Flag3D %p", (void *) this);
+   m_vertBuffer = BufferManager::instance().acquireVertices(dev, name, verts, sizeof(verts),
+                     D3DFVF_CUSTOMVERTEX, 0);
 
    // calculates all the indices to form the triangles for our wave.  Could be done by hand,
    // but this way you can change the LENGTH and WIDTH.
@@ -95,13 +86,8 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
       }
    }   
 
-   m_device->CreateIndexBuffer(sizeof(triIndex), 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT,
-      &(m_indexBuffers[0]), NULL);
-   if (FAILED(m_indexBuffers[0]->Lock(0, sizeof(triIndex), (void**) &pIndices, 0)))
-      return;
-   memcpy(pIndices, triIndex, sizeof(triIndex));
-   m_indexBuffers[0]->Unlock();
-   pIndices = NULL;
+   m_indexBuffers[0] = BufferManager::instance().acquireIndices(dev, "Flag3D triangles", triIndex,
+                            sizeof(triIndex), D3DFMT_INDEX16);
 
    // calculate all vertices to draw lines.. done in two groups then copied into one buffer
    for (i = 0; i < (LENGTH - 1); i++)
@@ -124,13 +110,8 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
 
    memcpy(lineIndex, lineIndex1, sizeof(lineIndex1));
    memcpy(&(lineIndex[2 * ((LENGTH - 1) * (WIDTH))]), lineIndex2, sizeof(lineIndex2));
-   m_device->CreateIndexBuffer(sizeof(lineIndex), 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT,
-      &(m_indexBuffers[1]), NULL);
-   if (FAILED(m_indexBuffers[1]->Lock(0, sizeof(lineIndex), (void**) &pIndices, 0)))
-      return;
-   memcpy(pIndices, lineIndex,sizeof(lineIndex));
-   m_indexBuffers[1]->Unlock();
-   pIndices = NULL;
+   m_indexBuffers[1] = BufferManager::instance().acquireIndices(dev, "Flag3D lines", lineIndex,
+                            sizeof(lineIndex), D3DFMT_INDEX16);
 
    // does point vertices, which are just counting...
    // could have also just drawn the vertex array instead, but this way
@@ -143,25 +124,13 @@ Flag3D::Flag3D(LPDIRECT3DDEVICE9 dev)
       }
    }
 
-   m_device->CreateIndexBuffer(sizeof(pointIndex), 0, D3DFMT_INDEX16, D3DPOOL_DEFAULT,
-      &(m_indexBuffers[2]), NULL);
-   if (FAILED(m_indexBuffers[2]->Lock(0, sizeof(pointIndex), (void**) &pIndices, 0)))
-      return;
-   memcpy(pIndices, pointIndex, sizeof(pointIndex));
-   m_indexBuffers[2]->Unlock();
-   pIndices = NULL;
+   m_indexBuffers[2] = BufferManager::instance().acquireIndices(dev, "Flag3D points", pointIndex,
+                            sizeof(pointIndex), D3DFMT_INDEX16);
 }
 
 
-Flag3D::~Flag3D()   // cleans up the flag's buffers
+Flag3D::~Flag3D()   // the buffer references let go of the flag's buffers by themselves
 { 
-   int i;
-   if (m_vertBuffer != NULL)
-      m_vertBuffer->Release();
-
-   for (i = 0; i < 3; i++)
-      if (m_indexBuffers[i] != NULL)
-         m_indexBuffers[i]->Release();
 }
 
 
@@ -173,13 +142,13 @@ void Flag3D::TogglePrimitiveType(void)   // toggles between 3 primitive types
 }
 
 
-void Flag3D::SetTexture(int num, LPDIRECT3DTEXTURE9 tex)
+void Flag3D::SetTexture(int num, const TextureRef & tex)
 {
-   if (num <= 2)
+   if (num >= 0 && num < 2)
       m_textures[num] = tex;
    else
    {
-      if (m_textures[0] == NULL)
+      if (!m_textures[0].valid())
          m_textures[0] = tex;
       else   
          m_textures[1] = tex;
@@ -187,9 +156,18 @@ void Flag3D::SetTexture(int num, LPDIRECT3DTEXTURE9 tex)
 }
 
 
-void Flag3D::render(DWORD curTime)
+// the flag is drawn without a world transform, x and z go from -0.5 to 0.5
+// and the waves in render never go higher or lower than 0.1
+BoundBox Flag3D::getBounds() const
+{
+   return makeBoundBox(0.0f, 0.0f, 0.0f, 0.5f, 0.1f, 0.5f);
+}
+
+
+void Flag3D::render(float seconds)
 {
-   float rads = ((curTime / 10) % 360) * (3.141592654f / 180.0f);
+   PROFILE_ZONE("Flag3D::render");
+   float rads = fmodf(seconds * 100.0f, 360.0f) * (3.141592654f / 180.0f);   // 100 degrees a second
    CUSTOMVERTEX * ptr;   // stores pointer to the data portion of the vertex buffer
    float heights[WIDTH];
    float nz[WIDTH];
@@ -208,23 +186,28 @@ void Flag3D::render(DWORD curTime)
       nz[i] = (w / d);
    }
       
-   m_vertBuffer->Lock(0, LENGTH * WIDTH * sizeof(CUSTOMVERTEX), (void**) &ptr, 0);
-   
-   for (i = 0; i < WIDTH; i++)
+   LPDIRECT3DVERTEXBUFFER9 vertBuffer = m_vertBuffer.vertexBuffer();
    {
-      for (j = 0; j < LENGTH; j++)
-      {  // try this commented-out line for a funky looking flag.. 
-         // the lighting isn't correct, however
-         // (ptr + (i + WIDTH * j))->y = heights[i] * (((float) j) / 10.0f);
-
-         (ptr + (i + WIDTH * j))->y = heights[i];
-         (ptr + (i + WIDTH * j))->ny = ny[i];
-         (ptr + (i + WIDTH * j))->nz = nz[i];
-         (ptr + (i + WIDTH * j))->nx = 0;
+      PROFILE_ZONE("Flag3D lock");   // the Lock, the copy and the Unlock on their own
+      if (vertBuffer == NULL || FAILED(vertBuffer->Lock(0, LENGTH * WIDTH * sizeof(CUSTOMVERTEX), (void**) &ptr, 0)))
+         return;
+   
+      for (i = 0; i < WIDTH; i++)
+      {
+         for (j = 0; j < LENGTH; j++)
+         {  // try this commented-out line for a funky looking flag.. 
+            // the lighting isn't correct, however
+            // (ptr + (i + WIDTH * j))->y = heights[i] * (((float) j) / 10.0f);
+
+            (ptr + (i + WIDTH * j))->y = heights[i];
+            (ptr + (i + WIDTH * j))->ny = ny[i];
+            (ptr + (i + WIDTH * j))->nz = nz[i];
+            (ptr + (i + WIDTH * j))->nx = 0;
+         }
       }
-   }
 
-   m_vertBuffer->Unlock();   // unlocks vert buffer.. VERY IMPORTANT!!!   
+      vertBuffer->Unlock();   // unlocks vert buffer.. VERY IMPORTANT!!!   
+   }
    
    D3DMATERIAL9 mtrl;
    ZeroMemory( &mtrl, sizeof(D3DMATERIAL9) );
@@ -236,7 +219,7 @@ void Flag3D::render(DWORD curTime)
    m_device->SetMaterial( &mtrl );   
 
    // set texture's stages for rendering
-   m_device->SetTexture(0, m_textures[0]);
+   m_device->SetTexture(0, m_textures[0].texture());
    m_device->SetTextureStageState( 0, D3DTSS_COLORARG1, D3DTA_TEXTURE );
    m_device->SetTextureStageState( 0, D3DTSS_COLOROP,   D3DTOP_MODULATE );
    m_device->SetTextureStageState( 0, D3DTSS_COLORARG2, D3DTA_DIFFUSE );
@@ -244,7 +227,7 @@ void Flag3D::render(DWORD curTime)
    m_device->SetSamplerState( 0, D3DSAMP_ADDRESSU,  D3DTADDRESS_MIRROR );
    m_device->SetSamplerState( 0, D3DSAMP_ADDRESSV,  D3DTADDRESS_MIRROR );
 
-   m_device->SetTexture(1, m_textures[1]);
+   m_device->SetTexture(1, m_textures[1].texture());
    m_device->SetTextureStageState( 1, D3DTSS_COLORARG1, D3DTA_TEXTURE );
    m_device->SetTextureStageState( 1, D3DTSS_COLOROP,   D3DTOP_ADD );
    m_device->SetTextureStageState( 1, D3DTSS_COLORARG2, D3DTA_CURRENT );
@@ -253,10 +236,10 @@ void Flag3D::render(DWORD curTime)
    m_device->SetSamplerState( 1, D3DSAMP_ADDRESSV,  D3DTADDRESS_MIRROR );
    
    m_device->BeginScene();
-   m_device->SetStreamSource( 0, m_vertBuffer, 0, sizeof(CUSTOMVERTEX) );   // set vertex stream..
+   m_device->SetStreamSource( 0, vertBuffer, 0, sizeof(CUSTOMVERTEX) );   // set vertex stream..
    m_device->SetFVF( D3DFVF_CUSTOMVERTEX );
    //m_device->SetVertexShader( D3DFVF_CUSTOMVERTEX );   // set vertex shader options
-   m_device->SetIndices(m_indexBuffers[m_primitiveType]);
+   m_device->SetIndices(m_indexBuffers[m_primitiveType].indexBuffer());
    if (m_primitiveType == 0)
       m_device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0 , LENGTH * WIDTH,
          0, (LENGTH - 1) * (WIDTH - 1) * 2);
@@ -13,6 +13,9 @@
 
 #include <d3dx9.h>
 #include <math.h>
+#include "../common/Cull.h"
+#include "../common/BufferManager.h"
+#include "../common/TextureCache.h"
 
 
 class Flag3D
@@ -21,14 +24,15 @@ public:
    Flag3D(LPDIRECT3DDEVICE9 dev);
    ~Flag3D();
    void TogglePrimitiveType(void);
-   void SetTexture(int num, LPDIRECT3DTEXTURE9 tex);
-   void render(DWORD curTime);
+   void SetTexture(int num, const TextureRef & tex);
+   BoundBox getBounds() const;   // world space box for culling
+   void render(float seconds);   // the waves are where they are at this simulation time
 
 private:
    LPDIRECT3DDEVICE9 m_device;
-   LPDIRECT3DVERTEXBUFFER9 m_vertBuffer;
-   LPDIRECT3DINDEXBUFFER9 m_indexBuffers[3];   // 0 is triangles, 1 is lines, 2 is points
-   LPDIRECT3DTEXTURE9 m_textures[2];           // primary texture..
+   BufferRef m_vertBuffer;
+   BufferRef m_indexBuffers[3];   // 0 is triangles, 1 is lines, 2 is points
+   TextureRef m_textures[2];                   // primary texture..
    int m_primitiveType;
 };
 
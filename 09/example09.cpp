@@ -23,10 +23,19 @@
 
 #include <windows.h>
 #include <d3dx9.h>
-#include <time.h>
 #include <stdio.h>
+#include <string.h>
 #include "Flag3D.h"
 #include "Light3D.h"
+#include "../common/Cull.h"
+#include "../common/Camera.h"
+#include "../common/TextureCache.h"
+#include "../common/AssetPack.h"
+#include "../common/FrameTimer.h"
+#include "../common/Profiler.h"
+#include "../common/DeviceCapture.h"
+#include "../common/FixedStep.h"
+#include "../common/BufferManager.h"
 
 LPDIRECT3D9 lpD3D9 = NULL;   // will store a pointer to the Direct3D8 object
       // which always exists as part of the directX runtime on the computer
@@ -37,8 +46,19 @@ LPDIRECT3DDEVICE9 lpD3DDevice9 = NULL;   // will store a pointer to the Direct3D
 
 LPD3DXFONT lpD3DXFont = NULL;   // used for displaying text in D3D
 
-LPDIRECT3DTEXTURE9 lpD3DTex1 = NULL;   // pointer to a texture object
-LPDIRECT3DTEXTURE9 lpD3DTex2 = NULL;   // pointer for light map
+Camera camera;   // set up by doMath, objects outside camera.frustum() are skipped
+
+D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
+      // a scene.. such as swap effect.. size.. windowed or full screen..
+      // kept around since Reset needs them again after the device is lost
+
+TextureRef tex1;                       // the texture, from the texture cache
+TextureRef tex2;                       // light map, from the texture cache
+AssetPack assets;                      // assets.pak (tools/pack) if there is one, the loose files if not
+FrameTimer frameTimer;                 // times every frame and each part of it, for the fps
+FixedStep simClock;                    // the simulation runs in steps of 1/60 second, whatever the frame rate
+bool showTimes = false;                // T.. the percentiles instead of just the fps
+CaptureDevice * deviceCounts = NULL;    // C, R.. lpD3DDevice9 goes through it, it counts the calls each frame
 bool funkyLights = false;
 
 //  pointers to objects
@@ -61,6 +81,29 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
       case VK_ESCAPE:
 		PostQuitMessage(0);   // post quit message
 	break;
+      case 'T':             // frame times: percentiles of each part, or just the fps
+         showTimes = !showTimes;
+         break;
+
+      case 'F':             // the frame times to a file, to look at in a spreadsheet
+         frameTimer.writeCsv("frametimes.csv");
+         break;
+
+      case 'P':             // the profiling zones to a file, for chrome://tracing
+         Profiler::writeChromeTrace("trace.json");
+         break;
+
+      case 'C':             // the device calls of each frame to a file
+         deviceCounts->writeJson("devicecounts.json");
+         break;
+
+      case 'R':             // record the device calls, for bench/replaybench, or stop
+         if (deviceCounts->recording())
+            deviceCounts->stop();
+         else
+            deviceCounts->start("capture.d3dcap");
+         break;
+
       case VK_F1:           // F1 key
          if (myFlag)
             myFlag->TogglePrimitiveType();
@@ -85,8 +128,6 @@ LRESULT CALLBACK WinProc(HWND hWnd, unsigned uMsg, WPARAM wParam, LPARAM lParam)
 bool init3D(HWND hWnd)
 {
    D3DDISPLAYMODE d3ddm;          // Direct3D Display Mode..
-   D3DPRESENT_PARAMETERS d3dpp;   // d3d present parameters..details on how it should present
-         // a scene.. such as swap effect.. size.. windowed or full screen.. 
    HFONT fnt;
 
    // create D3D9.. if error (like that ever happens..) return false..
@@ -141,6 +182,11 @@ bool init3D(HWND hWnd)
       lpD3DDevice9->SetRenderState( D3DRS_DITHERENABLE, true);
    }
 
+   // from here on everything asked of the device goes through the counter,
+   // which passes it on.. the classes are none the wiser
+   deviceCounts = new CaptureDevice(lpD3DDevice9);
+   lpD3DDevice9 = deviceCounts;
+
    lpD3DDevice9->SetRenderState( D3DRS_CULLMODE, D3DCULL_NONE );
    lpD3DDevice9->SetRenderState( D3DRS_ZENABLE, true);
    lpD3DDevice9->SetRenderState( D3DRS_LIGHTING, true );
@@ -170,9 +216,15 @@ bool init3D(HWND hWnd)
 
 bool initData()
 { 
-   // creates a texture from file with default options
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex1.bmp", &lpD3DTex1 );
-   D3DXCreateTextureFromFile( lpD3DDevice9, "tex4.bmp", &lpD3DTex2 );
+   PROFILE_THREAD("render");   // what this thread is called in the trace
+
+   // one mapped file for everything, when it has been built
+   if (assets.open("assets.pak"))
+      TextureCache::instance().setPack(&assets);
+
+   // starts loading the textures on the loader threads.. grey until they are ready
+   tex1 = TextureCache::instance().stream(lpD3DDevice9, "tex1.bmp");
+   tex2 = TextureCache::instance().stream(lpD3DDevice9, "tex4.bmp");
 
    // default blending
    lpD3DDevice9->SetSamplerState( 0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR );
@@ -181,8 +233,8 @@ bool initData()
    lpD3DDevice9->SetSamplerState( 1, D3DSAMP_MINFILTER, D3DTEXF_LINEAR );
 
    myFlag = new Flag3D(lpD3DDevice9);
-   myFlag->SetTexture(0, lpD3DTex1);
-   myFlag->SetTexture(1, lpD3DTex2);
+   myFlag->SetTexture(0, tex1);
+   myFlag->SetTexture(1, tex2);
    
    myLights[0] = new Light3D(lpD3DDevice9, 2, 0);
    myLights[0]->setPosition(0.0f, 6.0f, 0.0f);
@@ -221,41 +273,59 @@ bool initData()
 
 void doMath()
 {
-   float rot = ((clock() / 40) % 360) * (3.141592654f / 180.0f);
+   PROFILE_ZONE("doMath");
+   // the camera goes round at 25 degrees a second of simulation time
+   float rot = (float) fmod(simClock.renderTime() * 25.0, 360.0) * (3.141592654f / 180.0f);
    float randomX = cosf(rot) / 5.0f;
    float randomY = sinf(rot) / 5.0f;
-   D3DXMATRIX matView;   // this is the view matrix..
-   D3DXMatrixLookAtLH( &matView, &D3DXVECTOR3(1.2f * cosf(rot), 1.0f, 1.2f * sinf(rot)),   // from point..
-                                 &D3DXVECTOR3(0.0f, 0.0f, 0.0f ),      // to point..
-                                 &D3DXVECTOR3( 0.0f, 1.0f, 0.0f ) );   // world up..
-   lpD3DDevice9->SetTransform( D3DTS_VIEW, &matView );                 // sets above
+   camera.lookAt( Vec3(1.2f * cosf(rot), 1.0f, 1.2f * sinf(rot)),   // from point..
+                  Vec3(0.0f, 0.0f, 0.0f ),                          // to point..
+                  Vec3( 0.0f, 1.0f, 0.0f ) );                       // world up..
 
    myLights[1]->aimAt(cosf(2 * rot) / 5.0f + randomX, 0.0f, sinf(rot) / 5.0f + randomY);
    myLights[2]->aimAt(cosf(2 * rot + (2.094395102f)) / 5.0f + randomX, 0.0f,
       sinf(rot + (2.094395102f)) / 5.0f + randomY);
    myLights[3]->aimAt(cosf(2 * rot + (4.188790205f)) / 5.0f + randomX, 0.0f,
       sinf(rot + (4.188790205f)) / 5.0f + randomY);
- 
-   D3DXMATRIX matProj; 
+
    // set 90 degree view field..height/width aspect(1.3333)..near plane..(1.0f)..far plane (100.0f)
    // everything beyond the far plane is clipped.. you don't see it
-   D3DXMatrixPerspectiveFovLH( &matProj, D3DX_PI / 4, 1.3333f, .10f, 200.0f );
-
-   lpD3DDevice9->SetTransform( D3DTS_PROJECTION, &matProj );   // set the view field
+   camera.perspective( D3DX_PI / 4, 1.3333f, .10f, 200.0f );
+
+   // the matrices and the frustum planes are only worked out again when
+   // something above changed, and only the new ones go to the device
+   unsigned int changed = camera.update();
+   if (changed & Camera::VIEW_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_VIEW, (const D3DMATRIX *) camera.view().m );
+   if (changed & Camera::PROJECTION_CHANGED)
+      lpD3DDevice9->SetTransform( D3DTS_PROJECTION, (const D3DMATRIX *) camera.projection().m );   // set the view field
 }
 
 
 void render()
 {
-   static RECT rc = {0, 0, 320, 100};   // rectangular region.. used for text drawing
-   static DWORD frameCount = 0;
-   static DWORD startTime = clock();
-   char str[16];
+   static RECT rc = {0, 0, 640, 320};   // rectangular region.. used for text drawing
+   char str[256];
 
+   frameTimer.beginFrame();   // the last frame ends here, Present and all
+   PROFILE_ZONE("render");
+
+   // after an alt-tab the device is lost.. draw nothing until it can be reset
+   if (!BufferManager::instance().restoreDevice(lpD3DDevice9, d3dpp, lpD3DXFont))
+      return;
+
+   // hand the device whatever the loader threads have finished, a bit a frame
+   TextureCache::instance().uploadPending(lpD3DDevice9);
+
+   frameTimer.begin(FRAME_UPDATE);
+   // everything here moves with the time, so the steps only need counting..
+   // renderTime is part way between the last two of them
+   simClock.advance(frameTimer.lastFrame());
    doMath();   // do the math.. :-P   
-   
-   frameCount++;   //  increment frame count
-    
+   frameTimer.end(FRAME_UPDATE);
+
+   frameTimer.begin(FRAME_SUBMIT);
+
    // Clear the back buffer to a black... values r g b are 0-256
    lpD3DDevice9->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(256, 256, 256), 1.0f, 0);
    
@@ -269,23 +339,38 @@ void render()
    myLights[3]->render(true);
 
    // render the wall with the light map on it using the set op
-   myFlag->render(clock());
+   if (camera.frustum().testBox(myFlag->getBounds()))
+      myFlag->render((float) simClock.renderTime());
 
-   // this function writes a formatted string to a character string
-   // in this case.. it will write "Avg fps" followed by the 
-   // frames per second.. with 2 decimal places
-   sprintf(str, "Avg fps %.2f", (float) frameCount / ((clock() - startTime) / 1000.0f));
+   // the frame rate from the median frame time, and the 99th percentile..
+   // or with T, a table of the percentiles of the whole frame and each part
+   frameTimer.summary(str, sizeof(str), showTimes);
+   if (showTimes)   // and what the device was asked to do last frame
+   {
+      size_t len = strlen(str);
+      if (len + 1 < sizeof(str))
+      {
+         str[len] = '\n';
+         deviceCounts->summary(str + len + 1, sizeof(str) - len - 1);
+      }
+   }
    
    // draw the text string..
    // lpD3DXFont->Begin();
-   lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   {
+      PROFILE_ZONE("DrawText");
+      lpD3DXFont->DrawText(NULL, str, -1, &rc, DT_LEFT, 0xFFFFFFFF);
+   }
    // lpD3DXFont->End();
    
    // present the back buffer.. or "flip" the page
+   PROFILE_ZONE("Present");   // to the end of render
    lpD3DDevice9->Present( NULL, NULL, NULL, NULL );   // these options are for using rectangular
       // regions for rendering/drawing...
       // 3rd is which target window.. NULL makes it use the currently set one (default)
       // last one is NEVER used.. that happens with DirectX often
+
+   frameTimer.end(FRAME_SUBMIT);
 }  // end of render
 
 
@@ -296,6 +381,13 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
 
    // lights don't really need to be cleaned up if the program is ending, they don't allocate any memmory
 
+   // the textures go back to the cache, which lets go of them before the device goes
+   tex1.reset();
+   tex2.reset();
+   TextureCache::instance().evictUnused();
+   TextureCache::instance().setPack(NULL);
+   assets.close();
+
    if ( lpD3DDevice9 != NULL ) 
         lpD3DDevice9->Release();
 
@@ -304,12 +396,6 @@ void cleanup()   // it's a dirty job.. but some function has to do it...
 
    if ( lpD3DXFont != NULL )
       lpD3DXFont->Release();
-
-   if ( lpD3DTex1 != NULL )
-      lpD3DTex1->Release();
-
-   if ( lpD3DTex2 != NULL )
-      lpD3DTex2->Release();
 }
 
 
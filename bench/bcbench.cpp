@@ -0,0 +1,78 @@
+/* Filename:  bcbench.cpp
+
+   Headless benchmark for the block compressor in common/BlockCompress.h.
+   Each of the examples' bitmaps is compressed to BC1 and BC3 over and
+   over, on one thread and then on all of them, and the result is
+   decompressed again to see how close it came.
+
+   usage:  bcbench [repeats] [threads] [file.bmp ...]
+*/
+
+#include "../common/BlockCompress.h"
+#include "../common/BmpLoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char ** argv)
+{
+   static const char * defaults[] = { "../04/tex1.bmp", "../07/tex1.bmp", "../08/tex2.bmp",
+                                      "../09/tex4.bmp", "../09/tex5.bmp" };
+   static const char * names[] = { "BC1", "BC3" };
+   unsigned int repeats = argc > 1 ? atoi(argv[1]) : 20;
+   unsigned int threads = argc > 2 ? atoi(argv[2]) : std::thread::hardware_concurrency();
+   std::vector<const char *> files;
+   unsigned int i, f, t;
+   int format;
+
+   for (i = 3; i < (unsigned int) argc; i++)
+      files.push_back(argv[i]);
+   if (files.empty())
+      files.assign(defaults, defaults + sizeof(defaults) / sizeof(defaults[0]));
+
+   for (format = BLOCK_BC1; format <= BLOCK_BC3; format++)
+   {
+      double ms[2] = { 0, 0 }, pixels = 0;
+
+      for (f = 0; f < files.size(); f++)
+      {
+         BmpFile bmp;
+         if (!bmp.open(files[f]))
+         {
+            printf("can't load %s\n", files[f]);
+            return 1;
+         }
+         int w = bmp.info().width, h = bmp.info().height;
+         std::vector<unsigned int> image((size_t) w * h), back((size_t) w * h);
+         std::vector<unsigned char> blocks(blockBytes((BlockFormat) format, w, h));
+         bmp.convert(&image[0], w * 4);
+
+         for (t = 0; t < 2; t++)
+         {
+            Clock::time_point start = Clock::now();
+            for (i = 0; i < repeats; i++)
+               compressBlocks((BlockFormat) format, &image[0], w, h, w * 4, &blocks[0], t ? threads : 1);
+            ms[t] += msSince(start);
+         }
+         pixels += (double) w * h * repeats;
+
+         decompressBlocks((BlockFormat) format, &blocks[0], w, h, &back[0], w * 4);
+         printf("%s  %-16s %4dx%-4d  %6.2f dB  %6.1f KB -> %5.1f KB\n", names[format], files[f], w, h,
+                imagePsnr(&image[0], w * 4, &back[0], w * 4, w, h, false),
+                image.size() * 4 / 1024.0, blocks.size() / 1024.0);
+      }
+      printf("%s  1 thread   %8.1f Mpixels/s\n", names[format], pixels / ms[0] / 1000);
+      printf("%s  %u threads  %8.1f Mpixels/s\n\n", names[format], threads, pixels / ms[1] / 1000);
+   }
+   return 0;
+}
@@ -0,0 +1,144 @@
+/* Filename:  bmpbench.cpp
+
+   Headless benchmark for the bitmap loader in common/BmpLoader.h.  It
+   loads the examples' own tex*.bmp files over and over, the way the
+   examples used to (read the whole file into a buffer, then copy it a
+   pixel at a time) and from a mapped file with each of the conversions
+   the processor has.  Every conversion is checked against the plain one.
+
+   D3DX isn't there on Linux, so the first line stands in for it.
+
+   usage:  bmpbench [loads] [file.bmp ...]
+*/
+
+#include "../common/BmpLoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// read into memory and copy a pixel at a time, flipping as it goes
+static bool loadPlain(const char * filename, std::vector<unsigned char> & file,
+                      std::vector<unsigned int> & pixels)
+{
+   FILE * f = fopen(filename, "rb");
+   BmpInfo info;
+   long size;
+   int x, y;
+
+   if (f == NULL)
+      return false;
+   fseek(f, 0, SEEK_END);
+   size = ftell(f);
+   fseek(f, 0, SEEK_SET);
+   file.resize(size);
+   size = (long) fread(&file[0], 1, size, f);
+   fclose(f);
+   if (!readBmpInfo(&file[0], size, info))
+      return false;
+
+   pixels.resize((size_t) info.width * info.height);
+   for (y = 0; y < info.height; y++)
+   {
+      const unsigned char * src = &file[info.bitsOffset + (size_t) info.rowBytes * (info.height - 1 - y)];
+      for (x = 0; x < info.width; x++, src += 3)
+         pixels[(size_t) y * info.width + x] = src[0] | (src[1] << 8) | (src[2] << 16) | 0xFF000000u;
+   }
+   return true;
+}
+
+
+static bool loadMapped(const char * filename, BmpSimd simd, std::vector<unsigned int> & pixels)
+{
+   BmpFile file;
+
+   if (!file.open(filename))
+      return false;
+   pixels.resize((size_t) file.info().width * file.info().height);
+   file.convert(&pixels[0], file.info().width * 4, BMP_BGRA, simd);
+   return true;
+}
+
+
+int main(int argc, char ** argv)
+{
+   static const char * defaults[] = { "../04/tex1.bmp", "../07/tex1.bmp", "../08/tex2.bmp",
+                                      "../09/tex4.bmp", "../09/tex5.bmp" };
+   static const char * names[] = { "mapped, scalar", "mapped, SSSE3 ", "mapped, AVX2  " };
+   unsigned int loads = argc > 1 ? atoi(argv[1]) : 2000;
+   std::vector<const char *> files;
+   std::vector<unsigned char> buffer;
+   std::vector<unsigned int> expected, pixels;
+   double pixelCount = 0, ms;
+   unsigned int i, f;
+   int simd;
+
+   for (i = 2; i < (unsigned int) argc; i++)
+      files.push_back(argv[i]);
+   if (files.empty())
+      files.assign(defaults, defaults + sizeof(defaults) / sizeof(defaults[0]));
+
+   for (f = 0; f < files.size(); f++)
+   {
+      if (!loadPlain(files[f], buffer, expected))
+      {
+         printf("can't load %s\n", files[f]);
+         return 1;
+      }
+      pixelCount += expected.size();
+      for (simd = BMP_SCALAR; simd <= bestBmpSimd(); simd++)
+         if (!loadMapped(files[f], (BmpSimd) simd, pixels) || pixels != expected)
+            printf("%s doesn't match for %s\n", names[simd], files[f]);
+   }
+   pixelCount *= loads;
+
+   printf("files %u  loads %u each\n", (unsigned int) files.size(), loads);
+
+   Clock::time_point start = Clock::now();
+   for (i = 0; i < loads; i++)
+      for (f = 0; f < files.size(); f++)
+         loadPlain(files[f], buffer, pixels);
+   ms = msSince(start);
+   printf("read, per pixel %8.2f us/file  %8.1f Mpixels/s\n",
+          ms * 1000 / (loads * files.size()), pixelCount / ms / 1000);
+
+   for (simd = BMP_SCALAR; simd <= bestBmpSimd(); simd++)
+   {
+      start = Clock::now();
+      for (i = 0; i < loads; i++)
+         for (f = 0; f < files.size(); f++)
+            loadMapped(files[f], (BmpSimd) simd, pixels);
+      ms = msSince(start);
+      printf("%s  %8.2f us/file  %8.1f Mpixels/s\n", names[simd],
+             ms * 1000 / (loads * files.size()), pixelCount / ms / 1000);
+   }
+
+   // just the conversion, with the files already mapped and in the cache
+   std::vector<BmpFile> mapped(files.size());
+   for (f = 0; f < files.size(); f++)
+   {
+      mapped[f].open(files[f]);
+      if (pixels.size() < (size_t) mapped[f].info().width * mapped[f].info().height)
+         pixels.resize((size_t) mapped[f].info().width * mapped[f].info().height);
+   }
+   for (simd = BMP_SCALAR; simd <= bestBmpSimd(); simd++)
+   {
+      start = Clock::now();
+      for (i = 0; i < loads; i++)
+         for (f = 0; f < files.size(); f++)
+            mapped[f].convert(&pixels[0], mapped[f].info().width * 4, BMP_BGRA, (BmpSimd) simd);
+      ms = msSince(start);
+      printf("convert only %s  %8.2f us/file  %8.1f Mpixels/s\n", names[simd] + 8,
+             ms * 1000 / (loads * files.size()), pixelCount / ms / 1000);
+   }
+   return 0;
+}
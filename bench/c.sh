@@ -0,0 +1,22 @@
+g++ -O2 -std=c++11 -pthread -o cullbench cullbench.cpp ../common/Cull.cpp ../common/Camera.cpp
+g++ -O2 -std=c++11 -pthread -o scenebench scenebench.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp ../common/Cull.cpp ../common/Occlusion.cpp
+g++ -O2 -std=c++11 -o bmpbench bmpbench.cpp ../common/BmpLoader.cpp ../common/MappedFile.cpp
+g++ -O2 -std=c++11 -pthread -o bcbench bcbench.cpp ../common/BlockCompress.cpp ../common/MipGen.cpp ../common/BmpLoader.cpp ../common/MappedFile.cpp
+g++ -O2 -std=c++11 -pthread -o procbench procbench.cpp ../common/ProcTex.cpp ../common/BmpLoader.cpp ../common/MappedFile.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=4 -I../04 -I../headless -o examplebench04 examplebench.cpp ../04/Rect3D2.cpp ../common/MeshWeld.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/Occlusion.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=5 -I../05 -I../headless -o examplebench05 examplebench.cpp ../05/Rect3D2.cpp ../common/MeshWeld.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/Occlusion.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=6 -I../06 -I../headless -o examplebench06 examplebench.cpp ../06/Rect3D2.cpp ../common/MeshWeld.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/Occlusion.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=7 -I../07 -I../headless -o examplebench07 examplebench.cpp ../07/Rect3D2.cpp ../common/MeshWeld.cpp ../common/SceneStore.cpp ../common/SceneGraph.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/Occlusion.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=8 -I../08 -I../headless -o examplebench08 examplebench.cpp ../08/Wall.cpp ../common/ProcTex.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -DEXAMPLE=9 -I../09 -I../headless -o examplebench09 examplebench.cpp ../09/Flag3D.cpp ../09/Light3D.cpp ../common/BufferManager.cpp ../common/TextureCache.cpp ../common/Hash.cpp ../common/MappedFile.cpp ../common/BmpLoader.cpp ../common/MipGen.cpp ../common/Dds.cpp ../common/BlockCompress.cpp ../common/AssetPack.cpp ../common/Cull.cpp ../common/Camera.cpp ../common/FrameTimer.cpp ../common/Profiler.cpp ../common/CountingDevice.cpp ../common/DeviceCapture.cpp ../common/FixedStep.cpp ../headless/NullDevice.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -o profbench profbench.cpp ../common/Profiler.cpp
+g++ -O2 -std=c++11 -pthread -I../headless -o replaybench replaybench.cpp ../common/DeviceCapture.cpp ../common/CountingDevice.cpp ../common/FrameTimer.cpp ../common/MappedFile.cpp ../common/Hash.cpp ../common/BmpLoader.cpp ../headless/NullDevice.cpp ../headless/SoftDevice.cpp ../headless/TexSampler.cpp ../headless/OutputMerger.cpp ../headless/VertexTransform.cpp
+g++ -O2 -std=c++11 -I../headless -o samplebench samplebench.cpp ../headless/TexSampler.cpp
+g++ -O2 -std=c++11 -mavx2 -I../headless -o samplebench_avx2 samplebench.cpp ../headless/TexSampler.cpp
+g++ -O2 -std=c++11 -pthread -o occlusionbench occlusionbench.cpp ../common/Occlusion.cpp ../common/Cull.cpp
+g++ -O2 -std=c++11 -I../headless -o mathbench mathbench.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -mavx -I../headless -o mathbench_avx mathbench.cpp ../headless/D3DXMath.cpp
+g++ -O2 -std=c++11 -pthread -I../headless -o vertexbench vertexbench.cpp ../headless/VertexTransform.cpp
+g++ -O2 -std=c++11 -pthread -mavx2 -I../headless -o vertexbench_avx2 vertexbench.cpp ../headless/VertexTransform.cpp
+g++ -O2 -std=c++11 -I../headless -o countbench countbench.cpp ../common/CountingDevice.cpp ../headless/NullDevice.cpp
+g++ -O2 -std=c++11 -o weldbench weldbench.cpp ../common/MeshWeld.cpp
\ No newline at end of file
@@ -0,0 +1,177 @@
+/* Filename:  countbench.cpp
+
+   Headless check and benchmark for ../common/CountingDevice.h.  A
+   NullDevice is wrapped and put through a few frames of calls whose
+   counts are known beforehand: state sets with some of them setting
+   again what was already set, locks of parts of a wrapped vertex and
+   index buffer, and indexed and plain draws.  Every count the frame
+   keeps is checked against what it should be, and it exits 1 if any is
+   off.  Then a frame like the examples' is timed on the NullDevice alone
+   and through the CountingDevice, to see what the counting costs a call.
+
+   usage:  countbench [frames] [draws a frame]
+*/
+
+#include "../common/CountingDevice.h"
+#include "NullDevice.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static bool g_failed = false;
+
+static void expect(const char * name, unsigned int got, unsigned int want)
+{
+   bool ok = got == want;
+   printf("  %-28s %6u%s\n", name, got, ok ? "" : "  <-- should be");
+   if (!ok)
+   {
+      printf("  %-28s %6u\n", "", want);
+      g_failed = true;
+   }
+}
+
+
+// what examplebench's scenes do a frame, more or less
+static void drawFrame(IDirect3DDevice9 * dev, IDirect3DVertexBuffer9 * vb, IDirect3DIndexBuffer9 * ib,
+                      unsigned int draws)
+{
+   D3DMATRIX world = { { { 1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1 } } };
+   unsigned int i;
+
+   dev->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, 0, 1.0f, 0);
+   dev->BeginScene();
+   dev->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+   dev->SetStreamSource(0, vb, 0, 16);
+   dev->SetIndices(ib);
+   for (i = 0; i < draws; i++)
+   {
+      dev->SetRenderState(D3DRS_LIGHTING, FALSE);
+      dev->SetRenderState(D3DRS_CULLMODE, i & 1 ? D3DCULL_CW : D3DCULL_CCW);
+      dev->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_SELECTARG1);
+      world._41 = (float) i;
+      dev->SetTransform(D3DTS_WORLD, &world);
+      dev->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 24, 0, 12);
+   }
+   dev->EndScene();
+   dev->Present(NULL, NULL, NULL, NULL);
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int frames = argc > 1 ? atoi(argv[1]) : 10000;
+   unsigned int draws = argc > 2 ? atoi(argv[2]) : 100;
+   IDirect3DVertexBuffer9 * vb = NULL;
+   IDirect3DIndexBuffer9 * ib = NULL;
+   void * data;
+   unsigned int f;
+
+   if (frames == 0 || draws == 0)
+   {
+      printf("usage:  countbench [frames] [draws a frame]\n");
+      return 1;
+   }
+
+   CountingDevice * device = new CountingDevice(new NullDevice, 16);
+   if (FAILED(device->CreateVertexBuffer(1200, 0, D3DFVF_XYZ | D3DFVF_DIFFUSE, D3DPOOL_MANAGED, &vb, NULL)) ||
+       FAILED(device->CreateIndexBuffer(600, 0, D3DFMT_INDEX16, D3DPOOL_MANAGED, &ib, NULL)))
+   {
+      printf("can't make the buffers\n");
+      return 1;
+   }
+   device->endFrame();
+
+   // a frame with known counts
+   device->SetRenderState(D3DRS_LIGHTING, FALSE);
+   device->SetRenderState(D3DRS_LIGHTING, FALSE);                        // redundant
+   device->SetRenderState(D3DRS_LIGHTING, FALSE);                        // redundant
+   device->SetRenderState(D3DRS_ZENABLE, TRUE);
+   device->SetRenderState(D3DRS_ZENABLE, FALSE);                         // a change, not redundant
+   device->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_MODULATE);
+   device->SetTextureStageState(0, D3DTSS_COLOROP, D3DTOP_MODULATE);     // redundant
+   device->SetTextureStageState(1, D3DTSS_COLOROP, D3DTOP_MODULATE);     // another stage, not redundant
+   device->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+   device->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);        // redundant
+   if (SUCCEEDED(vb->Lock(0, 0, &data, 0)))                              // 0 is all 1200
+      vb->Unlock();
+   if (SUCCEEDED(vb->Lock(240, 480, &data, 0)))
+      vb->Unlock();
+   if (SUCCEEDED(ib->Lock(100, 200, &data, 0)))
+      ib->Unlock();
+   device->SetFVF(D3DFVF_XYZ | D3DFVF_DIFFUSE);
+   device->SetStreamSource(0, vb, 0, 16);
+   device->SetIndices(ib);
+   device->BeginScene();
+   device->DrawIndexedPrimitive(D3DPT_TRIANGLELIST, 0, 0, 75, 0, 40);
+   device->DrawPrimitive(D3DPT_TRIANGLESTRIP, 0, 10);
+   device->EndScene();
+   device->Present(NULL, NULL, NULL, NULL);
+
+   // the states are forgotten with the frame, so the same set isn't redundant in the next
+   device->SetRenderState(D3DRS_LIGHTING, FALSE);
+   device->Present(NULL, NULL, NULL, NULL);
+
+   printf("counts\n");
+   expect("frames kept", device->count(), 3);
+   expect("creates", device->frame(0).calls[CALL_CREATE], 2);
+   const DeviceFrame & fr = device->frame(1);
+   expect("render states", fr.calls[CALL_RENDER_STATE], 5);
+   expect("stage states", fr.calls[CALL_STAGE_STATE], 3);
+   expect("sampler states", fr.calls[CALL_SAMPLER_STATE], 2);
+   expect("redundant", fr.redundant, 4);
+   expect("stream", fr.calls[CALL_STREAM], 3);
+   expect("draws", fr.calls[CALL_DRAW], 1);
+   expect("indexed draws", fr.calls[CALL_DRAW_INDEXED], 1);
+   expect("primitives", fr.primitives, 50);
+   expect("locks", fr.calls[CALL_LOCK], 3);
+   expect("bytes locked", fr.lockBytes, 1880);
+   expect("buffers locked", (unsigned int) fr.buffers.size(), 2);
+   if (fr.buffers.size() == 2)
+   {
+      expect("vertex buffer's number", fr.buffers[0].buffer, 1);
+      expect("vertex buffer index flag", fr.buffers[0].index, 0);
+      expect("vertex buffer locks", fr.buffers[0].locks, 2);
+      expect("vertex buffer bytes", fr.buffers[0].bytes, 1680);
+      expect("index buffer's number", fr.buffers[1].buffer, 2);
+      expect("index buffer index flag", fr.buffers[1].index, 1);
+      expect("index buffer locks", fr.buffers[1].locks, 1);
+      expect("index buffer bytes", fr.buffers[1].bytes, 200);
+   }
+   expect("next frame's render states", device->frame(2).calls[CALL_RENDER_STATE], 1);
+   expect("next frame's redundant", device->frame(2).redundant, 0);
+   expect("next frame's locks", device->frame(2).calls[CALL_LOCK], 0);
+   printf("%s\n", g_failed ? "the counts are NOT right" : "the counts are right");
+
+   // the same frames on the NullDevice alone and through the counter
+   IDirect3DDevice9 * null = device->device();
+   IDirect3DVertexBuffer9 * realVb = ((CountingVertexBuffer *) vb)->buffer();
+   IDirect3DIndexBuffer9 * realIb = ((CountingIndexBuffer *) ib)->buffer();
+   double ms[2] = { 0.0, 0.0 };
+   for (f = 0; f < frames; f++)
+   {
+      Clock::time_point start = Clock::now();
+      drawFrame(null, realVb, realIb, draws);
+      ms[0] += msSince(start);
+      start = Clock::now();
+      drawFrame(device, vb, ib, draws);
+      ms[1] += msSince(start);
+   }
+   double calls = (double) frames * (draws * 5 + 7);
+   printf("%u frames of %u draws\n", frames, draws);
+   printf("  NullDevice        %7.2f ns a call\n", ms[0] * 1e6 / calls);
+   printf("  counted           %7.2f ns a call\n", ms[1] * 1e6 / calls);
+
+   vb->Release();
+   ib->Release();
+   device->Release();
+   return g_failed ? 1 : 0;
+}
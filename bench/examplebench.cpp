@@ -0,0 +1,535 @@
+/* Filename:  examplebench.cpp
+
+   Headless benchmark for the numbered examples.  Runs one example's scene
+   for a fixed number of frames with no window: the same classes, the same
+   scene store, texture cache and buffer manager, driven the way the
+   example's render() drives them, but on the null device from
+   ../headless, which keeps the state and the buffers and draws nothing.
+   So what it times is everything on the CPU side of the driver.
+
+   Each frame runs one step of the simulation, 1/60 second, so every run
+   does exactly the same work whatever the machine.  The timings of every
+   frame and of its update and submit parts go into a FrameTimer, and the
+   percentiles come out on stdout as JSON.  With -trace, the profiling
+   zones of the last few seconds go to that file as a Chrome trace.
+
+   The null device is wrapped in a CountingDevice, so the JSON also has
+   the average calls of each kind, primitives and bytes locked a frame.
+   With -counts every frame's counts, with each buffer's locks, go to that
+   file.  With -capture every frame is recorded there as a capture
+   (DeviceCapture.h) for replaybench and capstat.
+
+   Built once per example, since each example has its own Rect3D2:
+      g++ -DEXAMPLE=4 -I../04 -I../headless ..   (see c.sh)
+
+   What each one does every frame:
+      4 to 7   the spinning cubes, moved by the scene store, culled and drawn
+      8        the wall, with the light map moved, resized and its op changed,
+               and a new procedural light map every 60 frames
+      9        the waving flag and the four spot lights turning around it
+
+      examplebench04 -frames 300 -cubes 1000 -capture cubes.d3dcap
+
+   usage:  examplebench [-frames n] [-cubes n (4 to 7 only)] [-trace file] [-counts file] [-capture file]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <vector>
+#include <chrono>
+#include <thread>
+#include "NullDevice.h"
+#include "../common/DeviceCapture.h"
+#include "../common/TextureCache.h"
+#include "../common/BufferManager.h"
+#include "../common/FrameTimer.h"
+#include "../common/FixedStep.h"
+#include "../common/Profiler.h"
+#include "../common/Camera.h"
+
+#if EXAMPLE >= 4 && EXAMPLE <= 7
+#include "Rect3D2.h"
+#include "../common/SceneStore.h"
+#elif EXAMPLE == 8
+#include "Wall.h"
+#include "../common/ProcTex.h"
+#elif EXAMPLE == 9
+#include "Flag3D.h"
+#include "Light3D.h"
+#else
+#error EXAMPLE must be 4 to 9
+#endif
+
+CaptureDevice * device = NULL;    // wrapping a NullDevice
+D3DPRESENT_PARAMETERS d3dpp;
+Camera camera;
+FixedStep simClock;
+char dir[16];   // the example's folder, where its bitmaps are
+
+
+// a file in the example's folder
+static const char * asset(const char * name)
+{
+   static char path[64];
+   snprintf(path, sizeof(path), "%s%s", dir, name);
+   return path;
+}
+
+
+// as doMath does it, only setting what changed
+static void setCamera(float ex, float ey, float ez, float zn, float zf)
+{
+   camera.lookAt(Vec3(ex, ey, ez), Vec3(0.0f, 0.0f, 0.0f), Vec3(0.0f, 1.0f, 0.0f));
+   camera.perspective(D3DX_PI / 4, 1.3333f, zn, zf);
+
+   unsigned int changed = camera.update();
+   if (changed & Camera::VIEW_CHANGED)
+      device->SetTransform(D3DTS_VIEW, (const D3DMATRIX *) camera.view().m);
+   if (changed & Camera::PROJECTION_CHANGED)
+      device->SetTransform(D3DTS_PROJECTION, (const D3DMATRIX *) camera.projection().m);
+}
+
+
+#if EXAMPLE >= 4 && EXAMPLE <= 7
+
+// examples 4 to 7: cubes in the scene store, all drawn with one Rect3D2
+
+TextureRef tex1;
+SceneStore scene;
+Rect3D2 * cubeMesh = NULL;
+std::vector<DrawItem> drawList;
+
+
+static void addCube(float x, float y, float z, float dPitch, float dRoll, float dYaw, float size)
+{
+   Entity e = scene.create();
+   Transform t = { x, y, z,   size, size, size,   0.0f, 0.0f, 0.0f };
+   Motion m = { dYaw, dPitch, dRoll,   0.0f, 0.0f, 0.0f,   0.0f, 0.0f, 0.0f };
+   Renderable r = { cubeMesh, 0.866f };
+
+   scene.addTransform(e, t);
+   scene.addMotion(e, m);
+   scene.addRenderable(e, r);
+}
+
+
+static void initScene(int cubes)
+{
+   int i;
+
+#if EXAMPLE == 5
+   device->SetRenderState(D3DRS_LIGHTING, true);
+#elif EXAMPLE == 6
+   device->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+   device->SetRenderState(D3DRS_ZENABLE, false);
+   device->SetRenderState(D3DRS_LIGHTING, false);
+   device->SetRenderState(D3DRS_ALPHABLENDENABLE, true);
+   device->SetRenderState(D3DRS_SRCBLEND, D3DBLEND_SRCALPHA);
+   device->SetRenderState(D3DRS_DESTBLEND, D3DBLEND_SRCALPHA);
+#else
+   device->SetRenderState(D3DRS_LIGHTING, false);
+#endif
+#if EXAMPLE == 7
+   device->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_ANISOTROPIC);
+   device->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_ANISOTROPIC);
+   device->SetSamplerState(0, D3DSAMP_MIPFILTER, D3DTEXF_LINEAR);
+#endif
+
+   tex1 = TextureCache::instance().stream(device, asset("tex1.bmp"));
+   cubeMesh = new Rect3D2(device, tex1);
+
+#if EXAMPLE == 7
+   if (cubes <= 0)
+      addCube(0.0f, 0.0f, 0.0f,   .20f, .20f, .20f,   3.0f);
+#else
+   if (cubes <= 0)
+   {
+      addCube(2.0f, 0.0f, 0.0f,   1.0f, 0.0f, 1.0f,   1.0f);
+      addCube(-2.0f, 0.0f, 0.0f,   1.0f, 0.0f, -1.0f,   1.0f);
+      addCube(0.0f, 0.0f, 0.0f,   1.0f, 0.0f, 0.0f,   1.0f);
+      addCube(0.0f, 2.0f, 0.0f,   1.0f, -1.0f, 0.0f,   1.0f);
+      addCube(0.0f, -2.0f, 0.0f,   1.0f, 1.0f, 0.0f,   1.0f);
+   }
+#endif
+   // more than the example has.. a block of small ones around the middle,
+   // some of them off screen
+   for (i = 0; i < cubes; i++)
+      addCube((float) (i % 20) * 0.5f - 5.0f, (float) (i / 20 % 20) * 0.5f - 5.0f, (float) (i / 400) * 0.5f,
+              1.0f, (float) (i % 3) - 1.0f, (float) (i % 5) * 0.5f - 1.0f,   0.25f);
+}
+
+
+static void update()
+{
+#if EXAMPLE == 7
+   setCamera(0.0f, 1.5f, -6.0f, 1.0f, 200.0f);
+#else
+   setCamera(0.0f, 1.5f, -6.0f, 1.0f, 100.0f);
+#endif
+
+   unsigned int steps = simClock.advance(simClock.step());
+   while (steps--)
+      scene.updateMotion(simClock.step());
+   scene.interpolate(simClock.alpha());
+   scene.updateWorld();
+   drawList.clear();
+   scene.collectDraws(camera.frustum(), drawList);
+}
+
+
+static unsigned int submit()
+{
+   DWORD val;
+   unsigned int i;
+
+   device->GetRenderState(D3DRS_LIGHTING, &val);
+   if (val)
+   {
+      D3DLIGHT9 light;
+      ZeroMemory(&light, sizeof(D3DLIGHT9));
+      light.Type = D3DLIGHT_POINT;
+      light.Diffuse.r = light.Diffuse.g = light.Diffuse.b = 1.0f;
+      light.Ambient.r = light.Ambient.g = light.Ambient.b = 0.25f;
+      light.Attenuation0 = .5f;
+      light.Attenuation1 = 0.10f;
+      light.Attenuation2 = 0.01f;
+      light.Position = D3DXVECTOR3(0, 0, -10);
+      light.Range = 15;
+      device->SetLight(0, &light);
+      device->LightEnable(0, true);
+      device->SetRenderState(D3DRS_AMBIENT, 0x00202020);
+   }
+
+   for (i = 0; i < drawList.size(); i++)
+      ((Rect3D2 *) drawList[i].object)->draw(drawList[i].world);
+   return (unsigned int) drawList.size();
+}
+
+
+static void cleanupScene()
+{
+   delete cubeMesh;
+   tex1.reset();
+}
+
+#elif EXAMPLE == 8
+
+// example 8: the wall and its light map
+
+TextureRef tex1, tex2;
+Wall * myWall = NULL;
+int lightPattern = PROC_RADIAL;
+unsigned int frame = 0;
+
+
+static TextureRef makeLightMap(int pattern)
+{
+   static unsigned int pixels[256 * 256];
+   ProcParams params = procParams((ProcPattern) pattern);
+
+   params.inner = 0xFFE5E2DF;
+   params.outer = 0xFF323232;
+   generateTexture(params, pixels, 256, 256, 256 * 4);
+   return TextureCache::instance().acquireFromPixels(device, pixels, 256, 256, 256 * 4);
+}
+
+
+static void initScene(int)
+{
+   device->SetRenderState(D3DRS_CULLMODE, D3DCULL_CCW);
+   device->SetRenderState(D3DRS_ZENABLE, true);
+   device->SetRenderState(D3DRS_LIGHTING, false);
+   device->SetSamplerState(0, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
+   device->SetSamplerState(0, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+
+   tex1 = TextureCache::instance().stream(device, asset("tex1.bmp"));
+   tex2 = makeLightMap(lightPattern);
+   myWall = new Wall(device, tex1, tex2);
+   myWall->setHeightWidth(5, 5);
+}
+
+
+// what the keys do in the example, one a frame: the light goes round in a
+// square, grows and shrinks, and the op changes every 15 frames
+static void update()
+{
+   static void (Wall::*const moves[])() = { &Wall::mvLtUp, &Wall::mvLtR, &Wall::mvLtDn, &Wall::mvLtL };
+   static void (Wall::*const ops[])() = { &Wall::ltMapModulate, &Wall::ltMapModulate2x,
+      &Wall::ltMapModulate4x, &Wall::ltMapAdd, &Wall::ltMapSubtract, &Wall::ltMapDisable };
+
+   setCamera(0.0f, 0.0f, -6.0f, 1.0f, 200.0f);
+   simClock.advance(simClock.step());
+
+   (myWall->*moves[frame / 8 % 4])();
+   if (frame % 32 < 16)
+      myWall->incLtSize();
+   else
+      myWall->decLtSize();
+   if (frame % 15 == 0)
+      (myWall->*ops[frame / 15 % 6])();
+   if (frame % 60 == 59)   // L
+   {
+      lightPattern = (lightPattern + 1) % (PROC_CHECKER + 1);
+      tex2 = makeLightMap(lightPattern);
+      myWall->setLightMap(tex2);
+   }
+   frame++;
+}
+
+
+static unsigned int submit()
+{
+   if (!camera.frustum().testBox(myWall->getBounds()))
+      return 0;
+   myWall->render();
+   return 1;
+}
+
+
+static void cleanupScene()
+{
+   delete myWall;
+   tex1.reset();
+   tex2.reset();
+}
+
+#elif EXAMPLE == 9
+
+// example 9: the flag waving under four spot lights
+
+TextureRef tex1, tex2;
+Flag3D * myFlag = NULL;
+Light3D * myLights[4] = { NULL };
+
+
+static void initScene(int)
+{
+   static const float colours[3][3] = { { 1.0f, 0.0f, 0.0f }, { 0.0f, 1.0f, 0.0f }, { 0.0f, 0.0f, 1.0f } };
+   int i;
+
+   device->SetRenderState(D3DRS_CULLMODE, D3DCULL_NONE);
+   device->SetRenderState(D3DRS_ZENABLE, true);
+   device->SetRenderState(D3DRS_LIGHTING, true);
+   for (i = 0; i < 2; i++)
+   {
+      device->SetSamplerState(i, D3DSAMP_MAGFILTER, D3DTEXF_LINEAR);
+      device->SetSamplerState(i, D3DSAMP_MINFILTER, D3DTEXF_LINEAR);
+   }
+
+   tex1 = TextureCache::instance().stream(device, asset("tex1.bmp"));
+   tex2 = TextureCache::instance().stream(device, asset("tex4.bmp"));
+   myFlag = new Flag3D(device);
+   myFlag->SetTexture(0, tex1);
+   myFlag->SetTexture(1, tex2);
+
+   myLights[0] = new Light3D(device, 2, 0);
+   myLights[0]->setPosition(0.0f, 6.0f, 0.0f);
+   myLights[0]->aimAt(0.0f, 0.0f, 0.0f);
+   myLights[0]->setRange(8.0f);
+   myLights[0]->setSpotProps(.1f, .2f, .2f);
+   myLights[0]->setDiffuse(.250f, .250f, .250f);
+   for (i = 1; i < 4; i++)
+   {
+      myLights[i] = new Light3D(device, 2, i);
+      myLights[i]->setPosition(0.0f, 3.0f, 0.0f);
+      myLights[i]->setRange(15);
+      myLights[i]->setSpotProps(.010f, 0.20f, 1.0f);
+      myLights[i]->setDiffuse(colours[i - 1][0], colours[i - 1][1], colours[i - 1][2]);
+      myLights[i]->setSpecular(colours[i - 1][0], colours[i - 1][1], colours[i - 1][2]);
+   }
+}
+
+
+static void update()
+{
+   simClock.advance(simClock.step());
+
+   float rot = (float) fmod(simClock.renderTime() * 25.0, 360.0) * (3.141592654f / 180.0f);
+   float randomX = cosf(rot) / 5.0f;
+   float randomY = sinf(rot) / 5.0f;
+   setCamera(1.2f * cosf(rot), 1.0f, 1.2f * sinf(rot), .10f, 200.0f);
+
+   myLights[1]->aimAt(cosf(2 * rot) / 5.0f + randomX, 0.0f, sinf(rot) / 5.0f + randomY);
+   myLights[2]->aimAt(cosf(2 * rot + (2.094395102f)) / 5.0f + randomX, 0.0f,
+      sinf(rot + (2.094395102f)) / 5.0f + randomY);
+   myLights[3]->aimAt(cosf(2 * rot + (4.188790205f)) / 5.0f + randomX, 0.0f,
+      sinf(rot + (4.188790205f)) / 5.0f + randomY);
+}
+
+
+static unsigned int submit()
+{
+   int i;
+
+   for (i = 0; i < 4; i++)
+      myLights[i]->render(true);
+   if (!camera.frustum().testBox(myFlag->getBounds()))
+      return 0;
+   myFlag->render((float) simClock.renderTime());
+   return 1;
+}
+
+
+static void cleanupScene()
+{
+   int i;
+
+   delete myFlag;
+   for (i = 0; i < 4; i++)
+      delete myLights[i];
+   tex1.reset();
+   tex2.reset();
+}
+
+#endif
+
+
+static void printStats(const char * name, const FrameStats & st, bool last)
+{
+   printf("  \"%s\": { \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"hitches\": %u }%s\n",
+          name, st.p50, st.p95, st.p99, st.max, st.hitches, last ? "" : ",");
+}
+
+
+// what the device was asked to do, on average a frame
+static void printCounts(const CountingDevice & counter)
+{
+   double calls[DEVICE_CALLS] = { 0.0 }, redundant = 0.0, primitives = 0.0, lockBytes = 0.0;
+   unsigned int i, c, n = counter.count();
+
+   for (i = 0; i < n; i++)
+   {
+      const DeviceFrame & fr = counter.frame(i);
+      for (c = 0; c < DEVICE_CALLS; c++)
+         calls[c] += fr.calls[c];
+      redundant += fr.redundant;
+      primitives += fr.primitives;
+      lockBytes += fr.lockBytes;
+   }
+   if (n == 0)
+      n = 1;
+   printf("  \"calls_per_frame\": {");
+   for (c = 0; c < DEVICE_CALLS; c++)
+      printf("%s \"%s\": %.2f", c ? "," : "", CountingDevice::callName((DeviceCall) c), calls[c] / n);
+   printf(" },\n");
+   printf("  \"redundant_states_per_frame\": %.2f,\n", redundant / n);
+   printf("  \"primitives_per_frame\": %.2f,\n", primitives / n);
+   printf("  \"lock_bytes_per_frame\": %.2f,\n", lockBytes / n);
+}
+
+
+// a whole number, all of s, from 0 up
+static bool readCount(const char * s, unsigned int & n)
+{
+   char * end;
+   long v = strtol(s, &end, 10);
+
+   if (end == s || *end != 0 || v < 0 || v > 0x7FFFFFFF)
+      return false;
+   n = (unsigned int) v;
+   return true;
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int frames = 1000, cubes = 0, f, waits;
+   const char * trace = NULL, * counts = NULL, * capture = NULL;
+   size_t drawn = 0;
+   bool ok = true;
+
+   for (; ok && argc > 2 && argv[1][0] == '-'; argc -= 2, argv += 2)
+   {
+      if (strcmp(argv[1], "-frames") == 0)
+         ok = readCount(argv[2], frames) && frames > 0;
+      else if (strcmp(argv[1], "-cubes") == 0)
+         ok = readCount(argv[2], cubes);
+      else if (strcmp(argv[1], "-trace") == 0)
+         trace = argv[2];
+      else if (strcmp(argv[1], "-counts") == 0)
+         counts = argv[2];
+      else if (strcmp(argv[1], "-capture") == 0)
+         capture = argv[2];
+      else
+         ok = false;
+   }
+   if (!ok || argc > 1)
+   {
+      printf("usage:  examplebench [-frames n] [-cubes n (4 to 7 only)] [-trace file] [-counts file] [-capture file]\n");
+      return 1;
+   }
+   snprintf(dir, sizeof(dir), "../%02d/", EXAMPLE);
+   ZeroMemory(&d3dpp, sizeof(d3dpp));
+   d3dpp.BackBufferWidth = 1024;
+   d3dpp.BackBufferHeight = 768;
+   d3dpp.BackBufferFormat = D3DFMT_R5G6B5;
+   d3dpp.EnableAutoDepthStencil = true;
+   d3dpp.AutoDepthStencilFormat = D3DFMT_D16;
+   PROFILE_THREAD("main");
+   device = new CaptureDevice(new NullDevice, frames);
+   device->SetRenderState(D3DRS_CULLMODE, D3DCULL_CCW);
+
+   initScene((int) cubes);
+
+   // let the loader threads finish first, it's the frames that are being
+   // timed, not the disk.. a bitmap that isn't there stays the placeholder
+   for (waits = 0; TextureCache::instance().pendingCount() && waits < 1000; waits++)
+   {
+      TextureCache::instance().uploadPending(device, 0xFFFFFFFF);
+      std::this_thread::sleep_for(std::chrono::milliseconds(5));
+   }
+   TextureCache::instance().uploadPending(device, 0xFFFFFFFF);
+   if (capture && !device->start(capture))
+      fprintf(stderr, "can't write %s\n", capture);
+   device->endFrame();   // the loading, which drops out of the window by the end
+
+   FrameTimer frameTimer(frames);
+   for (f = 0; f <= frames; f++)   // the last beginFrame finishes the last frame
+   {
+      frameTimer.beginFrame();
+      if (f == frames)
+         break;
+      PROFILE_ZONE("frame");
+      if (!BufferManager::instance().restoreDevice(device, d3dpp, NULL))
+         continue;
+      TextureCache::instance().uploadPending(device);
+
+      frameTimer.begin(FRAME_UPDATE);
+      update();
+      frameTimer.end(FRAME_UPDATE);
+
+      frameTimer.begin(FRAME_SUBMIT);
+      device->Clear(0, NULL, D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER, D3DCOLOR_XRGB(255, 255, 255), 1.0f, 0);
+      drawn += submit();
+      device->Present(NULL, NULL, NULL, NULL);
+      frameTimer.end(FRAME_SUBMIT);
+   }
+
+   if (capture && !device->stop())
+      fprintf(stderr, "can't write %s\n", capture);
+
+   printf("{\n");
+   printf("  \"example\": %d,\n", EXAMPLE);
+   printf("  \"frames\": %u,\n", frameTimer.count());
+   printf("  \"step_ms\": %.4f,\n", simClock.step() * 1000.0f);
+   printf("  \"sim_seconds\": %.4f,\n", simClock.time());
+   printf("  \"draws_per_frame\": %.2f,\n", (double) drawn / frames);
+   printf("  \"texture_bytes\": %u,\n", TextureCache::instance().residentBytes());
+   printCounts(*device);
+   printStats("frame_ms", frameTimer.stats(FRAME_TIME), false);
+   printStats("update_ms", frameTimer.stats(FRAME_UPDATE), false);
+   printStats("submit_ms", frameTimer.stats(FRAME_SUBMIT), true);
+   printf("}\n");
+
+   if (trace && !Profiler::writeChromeTrace(trace))
+      fprintf(stderr, "can't write %s\n", trace);
+   if (counts && !device->writeJson(counts))
+      fprintf(stderr, "can't write %s\n", counts);
+
+   cleanupScene();
+   TextureCache::instance().evictUnused();
+   device->Release();
+   return 0;
+}
@@ -0,0 +1,223 @@
+/* Filename:  mathbench.cpp
+
+   Headless check and benchmark for ../common/VecMath.h.  First every
+   builder is checked against the D3DX function it stands in for (the ones
+   in ../headless/D3DXMath.cpp) on random angles and points, and the
+   quaternions against the matrices, printing the largest difference in
+   each; then the SIMD products and transforms are checked against the
+   ...Scalar ones, which should give the same bits.  Then the batch calls
+   are timed both ways.  It says which path it was built with: c.sh builds
+   it twice, mathbench with SSE and mathbench_avx with -mavx.
+
+   usage:  mathbench [matrices] [million points] [rounds]
+*/
+
+#include "../common/VecMath.h"
+#include "d3dx9.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static float frand(float lo, float hi)
+{
+   return lo + (hi - lo) * (rand() % 100000) * 0.00001f;
+}
+
+static float maxDiff(const float * a, const float * b, int n)
+{
+   float most = 0.0f;
+   int i;
+   for (i = 0; i < n; i++)
+      most = fmaxf(most, fabsf(a[i] - b[i]));
+   return most;
+}
+
+
+static bool g_failed = false;
+
+static void report(const char * name, float diff, float allowed)
+{
+   bool ok = diff <= allowed;
+   printf("  %-28s %.2e%s\n", name, diff, ok ? "" : "  <-- too far off");
+   if (!ok)
+      g_failed = true;
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int matrices = argc > 1 ? atoi(argv[1]) : 10000;
+   double millions = argc > 2 ? atof(argv[2]) : 1.0;
+   unsigned int rounds = argc > 3 ? atoi(argv[3]) : 20;
+   unsigned int points = (unsigned int) (millions * 1000000.0), i, r;
+   const float eps = 1e-5f;   // for things that come out between -1 and 1 or so
+
+   if (matrices == 0 || points == 0 || rounds == 0)
+   {
+      printf("usage:  mathbench [matrices] [million points] [rounds]\n");
+      return 1;
+   }
+   printf("path %s\n", vecMathPath());
+   srand(1);
+
+   // against D3DX
+   float worst[10] = { 0 };
+   for (i = 0; i < 1000; i++)
+   {
+      float yaw = frand(-6.3f, 6.3f), pitch = frand(-6.3f, 6.3f), roll = frand(-6.3f, 6.3f);
+      D3DXMATRIX d, d2, d3;
+      Mat4 m;
+
+      D3DXMatrixRotationYawPitchRoll(&d, yaw, pitch, roll);
+      m = mat4RotationYawPitchRoll(yaw, pitch, roll);
+      worst[0] = fmaxf(worst[0], maxDiff(m, d, 16));
+
+      D3DXMatrixRotationX(&d, yaw);
+      m = mat4RotationX(yaw);
+      worst[1] = fmaxf(worst[1], maxDiff(m, d, 16));
+      D3DXMatrixRotationY(&d, pitch);
+      m = mat4RotationY(pitch);
+      worst[1] = fmaxf(worst[1], maxDiff(m, d, 16));
+      D3DXMatrixRotationZ(&d, roll);
+      m = mat4RotationZ(roll);
+      worst[1] = fmaxf(worst[1], maxDiff(m, d, 16));
+
+      // translations up to 100 away, so relative to that
+      float x = frand(-100, 100), y = frand(-100, 100), z = frand(-100, 100);
+      D3DXMatrixScaling(&d, x, y, z);
+      D3DXMatrixTranslation(&d2, z, x, y);
+      D3DXMatrixMultiply(&d3, &d, &d2);
+      m = mat4Scaling(x, y, z) * mat4Translation(z, x, y);
+      worst[2] = fmaxf(worst[2], maxDiff(m, d3, 16) / 100.0f);
+
+      D3DXVECTOR3 eye(x, y, z), at(frand(-100, 100), frand(-100, 100), frand(-100, 100));
+      D3DXVECTOR3 up(frand(-1, 1), frand(-1, 1), frand(-1, 1));
+      D3DXMatrixLookAtLH(&d, &eye, &at, &up);
+      m = mat4LookAtLH(Vec3(eye.x, eye.y, eye.z), Vec3(at.x, at.y, at.z), Vec3(up.x, up.y, up.z));
+      worst[3] = fmaxf(worst[3], maxDiff(m, d, 16) / 100.0f);
+
+      float fov = frand(0.2f, 2.5f), aspect = frand(0.5f, 2.5f), zn = frand(0.01f, 1.0f), zf = zn + frand(1.0f, 1000.0f);
+      D3DXMatrixPerspectiveFovLH(&d2, fov, aspect, zn, zf);
+      m = mat4PerspectiveFovLH(fov, aspect, zn, zf);
+      worst[4] = fmaxf(worst[4], maxDiff(m, d2, 16) / (1.0f / tanf(fov / 2) / aspect + 1.0f));
+
+      // a view * projection, with what D3DX made, relative to the biggest number in it
+      Mat4 a, b;
+      memcpy(a.m, d, sizeof(a.m));
+      memcpy(b.m, d2, sizeof(b.m));
+      D3DXMatrixMultiply(&d3, &d, &d2);
+      m = a * b;
+      float big = 1.0f;
+      for (int k = 0; k < 16; k++)
+         big = fmaxf(big, fabsf(d3.m[k / 4][k % 4]));
+      worst[5] = fmaxf(worst[5], maxDiff(m, d3, 16) / big);
+
+      D3DXVECTOR3 v(x, y, z), n;
+      D3DXVec3Normalize(&n, &v);
+      Vec3 vn = vec3Normalize(Vec3(x, y, z));
+      worst[6] = fmaxf(worst[6], maxDiff(&vn.x, n, 3));
+
+      // quaternions against the matrices
+      Quat q = quatRotationYawPitchRoll(yaw, pitch, roll);
+      worst[7] = fmaxf(worst[7], maxDiff(mat4RotationQuat(q), mat4RotationYawPitchRoll(yaw, pitch, roll), 16));
+      Quat q2 = quatRotationAxis(Vec3(up.x, up.y, up.z), fov);
+      worst[8] = fmaxf(worst[8], maxDiff(mat4RotationQuat(q2), mat4RotationAxis(Vec3(up.x, up.y, up.z), fov), 16));
+      worst[9] = fmaxf(worst[9], maxDiff(mat4RotationQuat(quatMultiply(q, q2)),
+                                         mat4RotationQuat(q) * mat4RotationQuat(q2), 16));
+   }
+   D3DXVECTOR3 zero(0, 0, 0), zn;
+   D3DXVec3Normalize(&zn, &zero);
+   Vec3 vz = vec3Normalize(Vec3(0, 0, 0));
+   worst[6] = fmaxf(worst[6], maxDiff(&vz.x, zn, 3));
+
+   printf("against D3DX, largest difference\n");
+   report("rotation yaw pitch roll", worst[0], eps);
+   report("rotation x, y, z", worst[1], eps);
+   report("scaling * translation", worst[2], eps);
+   report("look at", worst[3], eps);
+   report("perspective fov", worst[4], eps);
+   report("view * projection", worst[5], eps);
+   report("normalize", worst[6], eps);
+   printf("quaternions against matrices\n");
+   report("yaw pitch roll", worst[7], eps);
+   report("axis", worst[8], eps);
+   report("multiply", worst[9], eps);
+
+   // slerp half way between two turns about y is the turn half way between
+   Quat s = quatSlerp(quatRotationAxis(Vec3(0, 1, 0), 0.4f), quatRotationAxis(Vec3(0, 1, 0), 1.2f), 0.5f);
+   report("slerp", maxDiff(mat4RotationQuat(s), mat4RotationY(0.8f), 16), eps);
+
+   // the batches, SIMD and scalar
+   std::vector<Mat4> mats(matrices), out(matrices), outScalar(matrices);
+   std::vector<Vec3> in(points), coords(points), coordsScalar(points);
+   std::vector<Vec4> transformed(points), transformedScalar(points);
+   for (i = 0; i < matrices; i++)
+      mats[i] = mat4ScaleRotateTranslate(frand(0.5f, 2), frand(0.5f, 2), frand(0.5f, 2), frand(-3, 3), frand(-3, 3),
+                                         frand(-3, 3), frand(-50, 50), frand(-50, 50), frand(-50, 50));
+   for (i = 0; i < points; i++)
+      in[i] = Vec3(frand(-50, 50), frand(-50, 50), frand(-50, 50));
+   Mat4 viewProj = mat4LookAtLH(Vec3(0, 10, -120), Vec3(0, 0, 0), Vec3(0, 1, 0)) *
+                   mat4PerspectiveFovLH(3.141592654f / 4, 1.3333f, 0.1f, 1000.0f);
+
+   mat4MultiplyArray(&out[0], &mats[0], matrices, viewProj);
+   mat4MultiplyArrayScalar(&outScalar[0], &mats[0], matrices, viewProj);
+   vec3TransformArray(&transformed[0], &in[0], points, viewProj);
+   vec3TransformArrayScalar(&transformedScalar[0], &in[0], points, viewProj);
+   vec3TransformCoordArray(&coords[0], &in[0], points, viewProj);
+   vec3TransformCoordArrayScalar(&coordsScalar[0], &in[0], points, viewProj);
+   bool same = memcmp(&out[0], &outScalar[0], matrices * sizeof(Mat4)) == 0 &&
+               memcmp(&transformed[0], &transformedScalar[0], points * sizeof(Vec4)) == 0 &&
+               memcmp(&coords[0], &coordsScalar[0], points * sizeof(Vec3)) == 0;
+   printf("%s the same bits as scalar\n", same ? "SIMD gives" : "SIMD does NOT give");
+   if (!same)
+      g_failed = true;
+
+   double ms[6] = { 0 };
+   float check = 0.0f;
+   for (r = 0; r < rounds; r++)
+   {
+      Clock::time_point start = Clock::now();
+      mat4MultiplyArray(&out[0], &mats[0], matrices, viewProj);
+      ms[0] += msSince(start);
+      start = Clock::now();
+      mat4MultiplyArrayScalar(&outScalar[0], &mats[0], matrices, viewProj);
+      ms[1] += msSince(start);
+      start = Clock::now();
+      vec3TransformArray(&transformed[0], &in[0], points, viewProj);
+      ms[2] += msSince(start);
+      start = Clock::now();
+      vec3TransformArrayScalar(&transformedScalar[0], &in[0], points, viewProj);
+      ms[3] += msSince(start);
+      start = Clock::now();
+      vec3TransformCoordArray(&coords[0], &in[0], points, viewProj);
+      ms[4] += msSince(start);
+      start = Clock::now();
+      vec3TransformCoordArrayScalar(&coordsScalar[0], &in[0], points, viewProj);
+      ms[5] += msSince(start);
+      check += out[r % matrices].m[5] + outScalar[r % matrices].m[5] + transformed[r % points].w +
+               transformedScalar[r % points].w + coords[r % points].z + coordsScalar[r % points].z;
+   }
+
+   static const char * names[] = { "multiply matrices", "transform points", "transform coords" };
+   unsigned int counts[] = { matrices, points, points };
+   printf("%u matrices, %u points, %u rounds\n", matrices, points, rounds);
+   printf("                       %-8s    scalar    speedup\n", vecMathPath());
+   for (i = 0; i < 3; i++)
+   {
+      double simd = ms[i * 2] * 1e6 / ((double) counts[i] * rounds), scalar = ms[i * 2 + 1] * 1e6 / ((double) counts[i] * rounds);
+      printf("%-18s %7.2f ns  %7.2f ns  %6.2fx\n", names[i], simd, scalar, scalar / simd);
+   }
+   printf("(check %g)\n", check);
+   return g_failed ? 1 : 0;
+}
@@ -0,0 +1,180 @@
+/* Filename:  occlusionbench.cpp
+
+   Headless benchmark for the occlusion culling in common/Occlusion.h.
+
+   A town of unit cubes (like Rect3D2's, each turned a random amount) on a
+   grid, with walls (like Wall's, 20 wide and 6 high) standing about
+   between them, and a camera walking round at eye height.  Each frame the
+   cubes are frustum culled, the walls in view and the cubes within 12
+   units of the camera are drawn as occluders, and the cubes that got
+   through the frustum are tested against them.  Then every cube is tested,
+   frustum or not, to time the test on a fixed number of boxes.  Last,
+   testBoxesParallel() is checked against one thread for counts that
+   don't share out evenly, and it exits 1 if they differ.
+
+   usage:  occlusionbench [cubes] [walls] [frames] [threads] [size WxH]
+*/
+
+#include "../common/Occlusion.h"
+#include "../common/VecMath.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+// scale, then a turn about y, then a move, as a row vector matrix
+static void placeMatrix(float * m, float sx, float sy, float sz, float yaw, float x, float y, float z)
+{
+   float c = cosf(yaw), s = sinf(yaw);
+   int i;
+   for (i = 0; i < 16; i++)
+      m[i] = 0;
+   m[0] = c * sx;   m[2] = -s * sx;
+   m[5] = sy;
+   m[8] = s * sz;   m[10] = c * sz;
+   m[12] = x;  m[13] = y;  m[14] = z;  m[15] = 1;
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int count = argc > 1 ? atoi(argv[1]) : 100000;
+   unsigned int wallCount = argc > 2 ? atoi(argv[2]) : 1000;
+   unsigned int frames = argc > 3 ? atoi(argv[3]) : 100;
+   unsigned int threads = argc > 4 ? atoi(argv[4]) : 0;
+   unsigned int width = 320, height = 192, side, i, f;
+
+   if (argc > 5)
+      sscanf(argv[5], "%ux%u", &width, &height);
+   if (count == 0 || frames == 0)
+   {
+      printf("usage:  occlusionbench [cubes] [walls] [frames] [threads] [size WxH]\n");
+      return 1;
+   }
+
+   // the cubes 2.5 apart, one or two high
+   side = (unsigned int) ceilf(sqrtf((float) count));
+   float extent = side * 2.5f * 0.5f;
+   std::vector<float> cubes((size_t) count * 16);
+   BoundBoxArray all;
+   all.resize(count);
+   srand(1);
+   for (i = 0; i < count; i++)
+   {
+      float x = (i % side) * 2.5f - extent, z = (i / side) * 2.5f - extent, y = 0.5f + (rand() % 2);
+      placeMatrix(&cubes[(size_t) i * 16], 1, 1, 1, (rand() % 628) * 0.01f, x, y, z);
+      all.set(i, makeBoundBox(x, y, z, 0.87f, 0.87f, 0.87f));   // a turning unit cube
+   }
+
+   // walls along one axis or the other, off the grid lines
+   std::vector<float> walls((size_t) wallCount * 16);
+   std::vector<BoundBox> wallBounds(wallCount);
+   BoundBox flat = makeBoundBox(0, 0, 0, 0.5f, 0.5f, 0);
+   for (i = 0; i < wallCount; i++)
+   {
+      float x = (rand() % (side * 2)) * 1.25f - extent + 1.25f, z = (rand() % (side * 2)) * 1.25f - extent + 1.25f;
+      float * m = &walls[(size_t) i * 16];
+      placeMatrix(m, 20, 6, 0, rand() % 2 ? 1.5707963f : 0.0f, x, 3.0f, z);
+      wallBounds[i] = transformBoundBox(flat, m);
+   }
+
+   Mat4 view, proj;
+   Frustum frustum;
+   OcclusionBuffer occlusion;
+   std::vector<unsigned int> inFrustum, visible, remap;
+   BoundBoxArray candidates;
+   double drawMs = 0, testMs = 0, allMs = 0, frustumTotal = 0, visibleTotal = 0, allVisible = 0, occluderTotal = 0;
+
+   occlusion.resize(width, height);
+   proj = mat4PerspectiveFovLH(3.141592654f / 4, (float) width / height, 0.1f, 1000.0f);
+
+   for (f = 0; f < frames; f++)
+   {
+      float turn = f * 0.02f, r = extent * 0.5f;
+      float ex = r * cosf(turn), ez = r * sinf(turn);
+      view = mat4LookAtLH(Vec3(ex, 1.7f, ez), Vec3(ex - sinf(turn) * 10.0f, 1.2f, ez + cosf(turn) * 10.0f), Vec3(0, 1, 0));
+      frustum.extract(view, proj);
+
+      inFrustum.clear();
+      frustum.testBoxesParallel(all, inFrustum, threads);
+      frustumTotal += inFrustum.size();
+
+      Clock::time_point start = Clock::now();
+      occlusion.begin(view, proj);
+      for (i = 0; i < wallCount; i++)
+         if (frustum.testBox(wallBounds[i]))
+            occlusion.addOccluderBox(flat, &walls[(size_t) i * 16]);
+      for (i = 0; i < inFrustum.size(); i++)
+      {
+         const float * m = &cubes[(size_t) inFrustum[i] * 16];
+         if ((m[12] - ex) * (m[12] - ex) + (m[14] - ez) * (m[14] - ez) < 12.0f * 12.0f)
+            occlusion.addOccluderBox(makeBoundBox(0, 0, 0, 0.5f, 0.5f, 0.5f), m);
+      }
+      occlusion.drawOccluders(threads);
+      drawMs += msSince(start);
+      occluderTotal += occlusion.occluders();
+
+      candidates.resize((unsigned int) inFrustum.size());
+      for (i = 0; i < inFrustum.size(); i++)
+         candidates.set(i, all.get(inFrustum[i]));
+      visible.clear();
+      start = Clock::now();
+      if (!inFrustum.empty())
+         occlusion.testBoxesParallel(candidates, visible, threads, &inFrustum[0]);
+      testMs += msSince(start);
+      visibleTotal += visible.size();
+
+      visible.clear();
+      start = Clock::now();
+      occlusion.testBoxesParallel(all, visible, threads);
+      allMs += msSince(start);
+      allVisible += visible.size();
+   }
+
+   printf("cubes %u  walls %u  frames %u  threads %u  buffer %ux%u\n", count, wallCount, frames, threads,
+          occlusion.width(), occlusion.height());
+   printf("occluder triangles  %8.0f avg\n", occluderTotal / frames);
+   printf("draw occluders      %8.3f ms/frame\n", drawMs / frames);
+   printf("in frustum          %8.0f avg\n", frustumTotal / frames);
+   printf("test those          %8.3f ms/frame\n", testMs / frames);
+   printf("visible             %8.0f avg\n", visibleTotal / frames);
+   printf("test all %-10u %8.3f ms/frame  (%.0f visible)\n", count, allMs / frames, allVisible / frames);
+
+   // against the last frame's buffer, the threads must between them test
+   // every box, however the count divides up.. two in three of the boxes
+   // here are ones that frame saw, so a lump left out shows
+   static const unsigned int checkCounts[] = { 4097, 4103, 10001 }, checkThreads[] = { 2, 3, 4, 8 };
+   std::vector<unsigned int> serial, parallel;
+   bool same = true;
+   for (size_t c = 0; c < 3 && !visible.empty(); c++)
+   {
+      BoundBoxArray some;
+      some.resize(checkCounts[c]);
+      for (i = 0; i < checkCounts[c]; i++)
+         some.set(i, all.get(i % 3 ? visible[i % visible.size()] : i % count));
+      serial.clear();
+      occlusion.testBoxes(some, 0, some.count, serial);
+      for (size_t t = 0; t < 4; t++)
+      {
+         parallel.clear();
+         occlusion.testBoxesParallel(some, parallel, checkThreads[t]);
+         if (parallel != serial)
+         {
+            printf("%u boxes on %u threads: %u visible, one thread sees %u\n", checkCounts[c], checkThreads[t],
+                   (unsigned int) parallel.size(), (unsigned int) serial.size());
+            same = false;
+         }
+      }
+   }
+   printf("threads %s one thread\n", same ? "agree with" : "do NOT agree with");
+   return same ? 0 : 1;
+}
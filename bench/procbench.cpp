@@ -0,0 +1,80 @@
+/* Filename:  procbench.cpp
+
+   Headless benchmark for the procedural textures in common/ProcTex.h.
+   Each pattern is made at size x size over and over, on one thread and
+   then on all of them.  For comparison it also times loading the light
+   map example 8 used to ship, ../08/tex2.bmp, from disk (mapped and
+   converted, as TextureCache would) against making one like it.
+
+   usage:  procbench [size] [repeats] [threads]
+*/
+
+#include "../common/ProcTex.h"
+#include "../common/BmpLoader.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char ** argv)
+{
+   static const char * names[] = { "radial", "spot", "noise", "checker" };
+   int size = argc > 1 ? atoi(argv[1]) : 1024;
+   unsigned int repeats = argc > 2 ? atoi(argv[2]) : 50;
+   unsigned int threads = argc > 3 ? atoi(argv[3]) : std::thread::hardware_concurrency();
+   std::vector<unsigned int> image((size_t) size * size);
+   unsigned int i, t;
+   int pattern;
+
+   for (pattern = PROC_RADIAL; pattern <= PROC_CHECKER; pattern++)
+   {
+      ProcParams params = procParams((ProcPattern) pattern);
+      double ms[2];
+
+      for (t = 0; t < 2; t++)
+      {
+         Clock::time_point start = Clock::now();
+         for (i = 0; i < repeats; i++)
+            generateTexture(params, &image[0], size, size, size * 4, t ? threads : 1);
+         ms[t] = msSince(start) / repeats;
+      }
+      printf("%-8s %4dx%-4d  1 thread %7.3f ms  %7.1f Mpixels/s   %u threads %7.3f ms\n", names[pattern],
+             size, size, ms[0], (double) size * size / ms[0] / 1000, threads, ms[1]);
+   }
+
+   // the old way, the file from disk (the OS has it cached after the first time)
+   BmpFile bmp;
+   if (bmp.open("../08/tex2.bmp"))
+   {
+      int w = bmp.info().width, h = bmp.info().height;
+      ProcParams params = procParams(PROC_RADIAL);
+      std::vector<unsigned int> pixels((size_t) w * h);
+      double load, make;
+
+      bmp.close();
+      Clock::time_point start = Clock::now();
+      for (i = 0; i < repeats; i++)
+      {
+         bmp.open("../08/tex2.bmp");
+         bmp.convert(&pixels[0], w * 4);
+         bmp.close();
+      }
+      load = msSince(start) / repeats;
+
+      start = Clock::now();
+      for (i = 0; i < repeats; i++)
+         generateTexture(params, &pixels[0], w, h, w * 4, 1);
+      make = msSince(start) / repeats;
+      printf("\n%dx%d light map:  tex2.bmp from disk %7.3f ms   made %7.3f ms\n", w, h, load, make);
+   }
+   return 0;
+}
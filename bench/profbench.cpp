@@ -0,0 +1,104 @@
+/* Filename:  profbench.cpp
+
+   Headless benchmark for the profiling zones in common/Profiler.h.  Times
+   a loop of empty zones, and the same loop with no zones, on one thread
+   and on several at once, and prints what a zone costs.  Then writes the
+   rings out as a Chrome trace, timing that too.
+
+   usage:  profbench [zones per thread] [threads] [trace file]
+*/
+
+#include "../common/Profiler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static volatile unsigned int sink;
+
+static void emptyLoop(unsigned int count)
+{
+   for (unsigned int i = 0; i < count; i++)
+      sink = i;
+}
+
+
+static void zoneLoop(unsigned int count)
+{
+   for (unsigned int i = 0; i < count; i++)
+   {
+      PROFILE_ZONE("zone");
+      sink = i;
+   }
+}
+
+
+// a frame's worth of nested zones, like a render loop makes
+static void worker(unsigned int count, unsigned int index)
+{
+   static const char * names[4] = { "worker 0", "worker 1", "worker 2", "worker 3" };
+
+   PROFILE_THREAD(names[index % 4]);
+   for (unsigned int i = 0; i < count / 4; i++)
+   {
+      PROFILE_ZONE("frame");
+      {
+         PROFILE_ZONE("update");
+         sink = i;
+      }
+      {
+         PROFILE_ZONE("submit");
+         PROFILE_ZONE("draw");
+         sink = i;
+      }
+   }
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int count = argc > 1 ? atoi(argv[1]) : 10000000;
+   unsigned int threads = argc > 2 ? atoi(argv[2]) : 4;
+   const char * trace = argc > 3 ? argv[3] : "profbench.json";
+   std::vector<std::thread> pool;
+   double emptyMs, zoneMs, threadMs, writeMs;
+   unsigned int i;
+
+   PROFILE_THREAD("main");
+   zoneLoop(1000);   // the ring is made on the first zone, not timed
+
+   Clock::time_point start = Clock::now();
+   emptyLoop(count);
+   emptyMs = msSince(start);
+
+   start = Clock::now();
+   zoneLoop(count);
+   zoneMs = msSince(start);
+
+   start = Clock::now();
+   for (i = 0; i < threads; i++)
+      pool.push_back(std::thread(worker, count, i));
+   for (i = 0; i < threads; i++)
+      pool[i].join();
+   threadMs = msSince(start);
+
+   start = Clock::now();
+   bool ok = Profiler::writeChromeTrace(trace);
+   writeMs = msSince(start);
+
+   printf("%u zones:  %.2f ns a zone (%.1f ms, %.1f ms without)\n", count,
+          (zoneMs - emptyMs) * 1e6 / count, zoneMs, emptyMs);
+   printf("%u threads, %u zones each:  %.2f ns a zone\n", threads, count / 4 * 4,
+          threads ? threadMs * 1e6 / ((double) threads * (count / 4 * 4)) : 0.0);
+   printf("trace:  %s, %.1f ms%s\n", trace, writeMs, ok ? "" : " (failed)");
+   return ok ? 0 : 1;
+}
@@ -0,0 +1,192 @@
+/* Filename:  replaybench.cpp
+
+   Headless benchmark that plays a device capture (see DeviceCapture.h)
+   back onto the null device from ../headless, through a CountingDevice,
+   and times each frame.  None of the example's own code runs, only the
+   calls it made, so what it times is the cost of the device calls on the
+   CPU side, and the same capture can be timed on any machine.  Played
+   more than once, the buffers and textures are made again each time.
+
+   The percentiles of the frame times, and the calls of each kind a frame
+   as CountingDevice counted them, come out on stdout as JSON.  The counts
+   should be the ones examplebench printed when it made the capture, less
+   the loading, which isn't in it.
+
+   With -soft, it is played onto a SoftDevice (../headless/SoftDevice.h)
+   of that size instead, so the frames are drawn, and the times are what
+   the CPU renderer takes.  -bmp saves the last frame it drew, -depth 24
+   gives it a 24 bit depth buffer rather than 16.  -golden checks the last
+   frame against a bitmap -bmp saved before, a pixel out if any channel is
+   more than 2 off, and it exits with 1 if any are; that's how a change to
+   the renderer is checked against the frames it drew before.
+
+      replaybench -soft 1024x768 -bmp last.bmp cubes.d3dcap 4
+      replaybench -soft 1024x768 -golden last.bmp cubes.d3dcap
+
+   usage:  replaybench [-soft WxH] [-depth 16|24] [-bmp file] [-golden file] capture [passes] [device counts file]
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "NullDevice.h"
+#include "SoftDevice.h"
+#include "../common/DeviceCapture.h"
+#include "../common/FrameTimer.h"
+#include "../common/BmpLoader.h"
+#include <vector>
+#include <algorithm>
+
+
+// frames in the capture, and its size
+static unsigned int countFrames(const char * filename, size_t & bytes)
+{
+   CaptureReader reader;
+   CaptureRecord r;
+   unsigned int frames = 0;
+
+   bytes = 0;
+   if (!reader.open(filename))
+      return 0;
+   while (reader.next(r))
+   {
+      bytes += r.bytes;
+      frames += r.op == CAP_FRAME;
+   }
+   return frames;
+}
+
+
+// pixels of the soft device's last frame more than 2 off in any channel
+// from the bitmap's, and the most any was off.. false if it can't be read
+// or isn't the same size
+static bool compareGolden(const SoftDevice * soft, const char * filename, unsigned int & wrong, unsigned int & most)
+{
+   BmpFile bmp;
+   size_t i;
+   int k;
+
+   if (!bmp.open(filename) || bmp.info().width != (int) soft->width() || bmp.info().height != (int) soft->height())
+      return false;
+   std::vector<unsigned int> golden((size_t) soft->width() * soft->height());
+   bmp.convert(&golden[0], soft->width() * 4);
+   wrong = most = 0;
+   for (i = 0; i < golden.size(); i++)
+   {
+      unsigned int off = 0;
+      for (k = 0; k < 24; k += 8)
+      {
+         int d = (int) ((soft->pixels()[i] >> k) & 0xFF) - (int) ((golden[i] >> k) & 0xFF);
+         off = std::max(off, (unsigned int) (d < 0 ? -d : d));
+      }
+      wrong += off > 2;
+      most = std::max(most, off);
+   }
+   return true;
+}
+
+
+static void printStats(const char * name, const FrameStats & st, bool last)
+{
+   printf("  \"%s\": { \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f, \"hitches\": %u }%s\n",
+          name, st.p50, st.p95, st.p99, st.max, st.hitches, last ? "" : ",");
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int softWidth = 0, softHeight = 0, softDepth = 16, frames, pass, c, i, wrong = 0, most = 0;
+   const char * bmp = NULL, * golden = NULL;
+   double calls[DEVICE_CALLS] = { 0.0 }, primitives = 0.0, lockBytes = 0.0;
+   size_t bytes;
+   CaptureReplay replay;
+
+   for (; argc > 2 && argv[1][0] == '-'; argc -= 2, argv += 2)
+   {
+      if (strcmp(argv[1], "-soft") == 0)
+         sscanf(argv[2], "%ux%u", &softWidth, &softHeight);
+      else if (strcmp(argv[1], "-depth") == 0)
+         softDepth = atoi(argv[2]);
+      else if (strcmp(argv[1], "-bmp") == 0)
+         bmp = argv[2];
+      else if (strcmp(argv[1], "-golden") == 0)
+         golden = argv[2];
+      else
+         break;
+   }
+   const char * filename = argc > 1 && argv[1][0] != '-' ? argv[1] : NULL;
+   unsigned int passes = argc > 2 ? atoi(argv[2]) : 1;
+   const char * counts = argc > 3 && argv[3][0] ? argv[3] : NULL;
+
+   if (filename == NULL || ((bmp || golden) && softWidth == 0) || (softDepth != 16 && softDepth != 24))
+   {
+      printf("usage:  replaybench [-soft WxH] [-depth 16|24] [-bmp file] [-golden file] capture [passes] [device counts file]\n");
+      return 1;
+   }
+   if (passes == 0)
+      passes = 1;
+   frames = countFrames(filename, bytes);
+   if (!replay.open(filename) || frames == 0)
+   {
+      fprintf(stderr, "%s isn't a capture, or has no whole frames\n", filename);
+      return 1;
+   }
+
+   SoftDevice * soft = softWidth && softHeight ? new SoftDevice(softWidth, softHeight, softDepth == 24 ? D3DFMT_D24X8 : D3DFMT_D16) : NULL;
+   CountingDevice * device = new CountingDevice(soft ? soft : new NullDevice, frames * passes);
+   FrameTimer frameTimer(frames * passes);
+   frameTimer.beginFrame();
+   for (pass = 0; pass < passes; pass++)
+   {
+      if (pass)
+         replay.rewind();   // in the next pass's first frame, with making it all again
+      while (replay.playFrame(device))
+         frameTimer.beginFrame();   // Present ended the frame, and the counting device's too
+   }
+
+   for (i = 0; i < device->count(); i++)
+   {
+      const DeviceFrame & fr = device->frame(i);
+      for (c = 0; c < DEVICE_CALLS; c++)
+         calls[c] += fr.calls[c];
+      primitives += fr.primitives;
+      lockBytes += fr.lockBytes;
+   }
+   i = device->count() ? device->count() : 1;
+
+   if (golden && !compareGolden(soft, golden, wrong, most))
+   {
+      fprintf(stderr, "%s isn't a %ux%u bitmap\n", golden, soft->width(), soft->height());
+      return 1;
+   }
+
+   printf("{\n");
+   printf("  \"capture_bytes\": %lu,\n", (unsigned long) bytes);
+   printf("  \"frames\": %u,\n", frames);
+   printf("  \"passes\": %u,\n", passes);
+   if (soft)
+      printf("  \"soft\": { \"width\": %u, \"height\": %u, \"depth_bits\": %u, \"triangles_last_frame\": %u, "
+             "\"sampler\": \"%s\", \"merger\": \"%s\" },\n", soft->width(), soft->height(), soft->depthBits(),
+             soft->trianglesDrawn(), texSamplerPath(), outputMergerPath());
+   if (golden)
+      printf("  \"golden\": { \"file\": \"%s\", \"pixels_off\": %u, \"most_off\": %u },\n", golden, wrong, most);
+   printf("  \"failed_calls\": %u,\n", replay.failed());
+   printf("  \"calls_per_frame\": {");
+   for (c = 0; c < DEVICE_CALLS; c++)
+      printf("%s \"%s\": %.2f", c ? "," : "", CountingDevice::callName((DeviceCall) c), calls[c] / i);
+   printf(" },\n");
+   printf("  \"primitives_per_frame\": %.2f,\n", primitives / i);
+   printf("  \"lock_bytes_per_frame\": %.2f,\n", lockBytes / i);
+   printStats("frame_ms", frameTimer.stats(FRAME_TIME), true);
+   printf("}\n");
+
+   if (counts && !device->writeJson(counts))
+      fprintf(stderr, "can't write %s\n", counts);
+
+   if (bmp && !soft->writeBmp(bmp))
+      fprintf(stderr, "can't write %s\n", bmp);
+
+   replay.close();
+   device->Release();
+   return wrong ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+/* Filename:  samplebench.cpp
+
+   Headless benchmark for the texture sampler in ../headless/TexSampler.h.
+   Each filter is timed with each address mode on one thread, sampling a
+   size x size texture with a full mip chain in spans of 8, the way
+   SoftDevice does.  The spans walk across the texture on a slant, with
+   gradients that make a pixel about 3 texels one way and 12 the other,
+   so the mip level is between 1 and 2 and anisotropic filtering has
+   something to do.  It says which path it was built with: c.sh builds it
+   twice, samplebench with none and samplebench_avx2 with -mavx2.
+
+   usage:  samplebench [size] [million samples]
+*/
+
+#include "TexSampler.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char ** argv)
+{
+   static const char * filterNames[] = { "point", "bilinear", "trilinear", "aniso 4x", "aniso 16x" };
+   static const char * addressNames[] = { "wrap", "mirror", "clamp" };
+   static const DWORD addresses[] = { D3DTADDRESS_WRAP, D3DTADDRESS_MIRROR, D3DTADDRESS_CLAMP };
+   int size = argc > 1 ? atoi(argv[1]) : 256;
+   double millions = argc > 2 ? atof(argv[2]) : 4.0;
+   unsigned int spans = (unsigned int) (millions * 1000000.0 / SAMPLE_WIDTH), level, i, n;
+   SampledTexture texture;
+   std::vector<unsigned int> pixels;
+   float u[SAMPLE_WIDTH], v[SAMPLE_WIDTH], out[4][SAMPLE_WIDTH], check = 0.0f;
+   int filter, address, x, y;
+
+   if (size < 1 || spans == 0)
+   {
+      printf("usage:  samplebench [size] [million samples]\n");
+      return 1;
+   }
+
+   // noise, so no two texels of a fetch are likely to be the same
+   texture.resize(size, size, 0);
+   for (level = 0; level < texture.levels(); level++)
+   {
+      pixels.resize((size_t) texture.width(level) * texture.height(level));
+      for (y = 0; y < (int) texture.height(level); y++)
+         for (x = 0; x < (int) texture.width(level); x++)
+            pixels[(size_t) y * texture.width(level) + x] = (x * 73856093u) ^ (y * 19349663u) ^ (level * 83492791u);
+      texture.setLevel(level, &pixels[0], texture.width(level) * 4);
+   }
+
+   SampleGradients g;
+   g.dudx = 3.0f / size;
+   g.dvdx = 0.5f / size;
+   g.dudy = -2.0f / size;
+   g.dvdy = 12.0f / size;
+
+   printf("%s sampler, %dx%d texture, %.1f million samples each\n\n", texSamplerPath(), size, size,
+          spans * (double) SAMPLE_WIDTH / 1000000.0);
+   for (filter = 0; filter < 5; filter++)
+   {
+      printf("%-10s", filterNames[filter]);
+      for (address = 0; address < 3; address++)
+      {
+         SamplerSettings s;
+         s.minFilter = filter == 0 ? D3DTEXF_POINT : filter < 3 ? D3DTEXF_LINEAR : D3DTEXF_ANISOTROPIC;
+         s.magFilter = filter == 0 ? D3DTEXF_POINT : D3DTEXF_LINEAR;
+         s.mipFilter = filter == 0 ? D3DTEXF_POINT : filter == 1 ? D3DTEXF_NONE : D3DTEXF_LINEAR;
+         s.addressU = s.addressV = addresses[address];
+         s.maxAnisotropy = filter == 3 ? 4 : 16;
+         s.lodBias = 0.0f;
+
+         Clock::time_point start = Clock::now();
+         for (n = 0; n < spans; n++)
+         {
+            // along a slanted row, wandering a little past the edges for the address modes
+            float u0 = (n % 4096) * (g.dudx * SAMPLE_WIDTH) - 0.25f, v0 = (n % 4096) * (g.dvdx * SAMPLE_WIDTH) +
+                       (n / 4096 % 64) * g.dvdy - 0.25f;
+            for (i = 0; i < SAMPLE_WIDTH; i++)
+            {
+               u[i] = u0 + i * g.dudx;
+               v[i] = v0 + i * g.dvdx;
+            }
+            sampleTexture(texture, s, u, v, g, out);
+            check += out[0][n & 7];
+         }
+         double ms = msSince(start);
+         printf("  %-6s %7.1f Msamples/s", addressNames[address], spans * (double) SAMPLE_WIDTH / (ms * 1000.0));
+      }
+      printf("\n");
+   }
+   printf("\n(%.0f)\n", check);   // so none of it can be left out
+   return 0;
+}
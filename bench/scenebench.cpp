@@ -0,0 +1,152 @@
+/* Filename:  scenebench.cpp
+
+   Headless benchmark for the scene store in common/SceneStore.h.  No window
+   or Direct3D is needed, so it runs on any box with a C++11 compiler.
+
+   Fills a scene with cubes (like the Rect3D2 cubes of example04) in groups
+   of ten: one spinning, drifting cube with nine smaller ones orbiting it as
+   its children.  Only some of the groups move, the rest stand still.  Then
+   for every frame it times the passes an example makes: a step of moving
+   things, putting them between that step and the one before, building the
+   world matrices and collecting what the camera can see.  Part of the way through a batch of entities is destroyed and made
+   again, so the arrays get shuffled the way they would in a real scene.
+
+   usage:  scenebench [entities] [frames] [threads] [percent of groups moving]
+*/
+
+#include "../common/SceneStore.h"
+#include "../common/VecMath.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static float frand(float lo, float hi)
+{
+   return lo + (hi - lo) * (rand() % 10000) * 0.0001f;
+}
+
+
+// a parent cube somewhere in space, or a child a little way from its parent
+static Entity addCube(SceneStore & scene, Entity parent, bool moving)
+{
+   Entity e = scene.create();
+   Transform t = { frand(-200, 200), frand(-200, 200), frand(-200, 200),
+                   1.0f, 1.0f, 1.0f,   0.0f, 0.0f, 0.0f };
+   Renderable r = { NULL, 0.866f };
+
+   if (scene.alive(parent))
+   {
+      t.posX = frand(-3, 3);  t.posY = frand(-3, 3);  t.posZ = frand(-3, 3);
+      t.width = t.height = t.depth = 0.3f;
+   }
+   scene.addTransform(e, t);
+   scene.setParent(e, parent);
+   scene.addRenderable(e, r);
+   if (moving)
+   {
+      Motion m = { frand(-1, 1), frand(-1, 1), frand(-1, 1),   0.0f, 0.0f, 0.0f,
+                   frand(-1, 1), 0.0f, frand(-1, 1) };
+      scene.addMotion(e, m);
+   }
+   return e;
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int count = argc > 1 ? atoi(argv[1]) : 1000000;
+   unsigned int frames = argc > 2 ? atoi(argv[2]) : 100;
+   unsigned int threads = argc > 3 ? atoi(argv[3]) : 0;
+   unsigned int moving = argc > 4 ? atoi(argv[4]) : 10;
+   std::vector<Entity> entities(count);
+   std::vector<DrawItem> draws;
+   Mat4 view, proj;
+   Frustum frustum;
+   SceneStore scene;
+   double motionMs = 0, lerpMs = 0, worldMs = 0, collectMs = 0;
+   size_t drawTotal = 0, updatedTotal = 0;
+   Entity none = { 0xFFFFFFFF, 0 };
+   unsigned int i, f;
+
+   srand(1);
+   Clock::time_point start = Clock::now();
+   scene.reserve(count + 8);
+   for (i = 0; i < count; i++)
+   {
+      if (i % 10 == 0)
+         entities[i] = addCube(scene, none, (i / 10) % 100 < moving);
+      else
+         entities[i] = addCube(scene, entities[i - i % 10], false);
+   }
+   for (i = 0; i < 8; i++)
+   {  // lights only.. nothing to draw
+      Entity e = scene.create();
+      Light l = { NULL, 0.0f, 0.0f, 0.0f, true };
+      scene.addLight(e, l);
+   }
+   double createMs = msSince(start);
+
+   // throw away every 7th cube and make new ones, so the arrays aren't in order
+   start = Clock::now();
+   for (i = 0; i < count; i += 7)
+      scene.destroy(entities[i]);
+   for (i = 0; i < count; i += 7)
+      entities[i] = addCube(scene, none, false);
+   scene.updateWorld(threads);   // sorts the tree again after all that
+   double churnMs = msSince(start);
+
+   proj = mat4PerspectiveFovLH(3.141592654f / 4, 1.3333f, 0.1f, 200.0f);
+
+   for (f = 0; f < frames; f++)
+   {
+      float rot = f * 0.05f;
+      view = mat4LookAtLH(Vec3(20.0f * cosf(rot), 5.0f, 20.0f * sinf(rot)), Vec3(0, 0, 0), Vec3(0, 1, 0));
+      frustum.extract(view, proj);
+
+      start = Clock::now();
+      scene.updateMotion(1.0f / 60, threads);
+      motionMs += msSince(start);
+
+      start = Clock::now();
+      scene.interpolate(0.5f, threads);   // drawn half way between two steps
+      lerpMs += msSince(start);
+
+      start = Clock::now();
+      updatedTotal += scene.updateWorld(threads);
+      worldMs += msSince(start);
+
+      draws.clear();
+      start = Clock::now();
+      scene.collectDraws(frustum, draws, threads);
+      collectMs += msSince(start);
+      drawTotal += draws.size();
+   }
+
+   // nothing moved since the last update
+   start = Clock::now();
+   scene.updateWorld(threads);
+   double staticMs = msSince(start);
+
+   printf("entities %u  frames %u  threads %u  groups moving %u%%\n", scene.count(), frames,
+          threads, moving);
+   printf("create         %8.3f ms\n", createMs);
+   printf("destroy/create %8.3f ms for %u\n", churnMs, (count + 6) / 7);
+   printf("motion         %8.3f ms/frame\n", motionMs / frames);
+   printf("interpolate    %8.3f ms/frame\n", lerpMs / frames);
+   printf("world matrices %8.3f ms/frame  (%.0f recomputed)\n", worldMs / frames,
+          (double) updatedTotal / frames);
+   printf("nothing moved  %8.3f ms\n", staticMs);
+   printf("collect draws  %8.3f ms/frame\n", collectMs / frames);
+   printf("drawn          %8.0f avg\n", (double) drawTotal / frames);
+   return 0;
+}
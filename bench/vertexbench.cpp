@@ -0,0 +1,200 @@
+/* Filename:  vertexbench.cpp
+
+   Headless check and benchmark for the batch vertex transform in
+   ../headless/VertexTransform.h.  A cloud of points around the origin,
+   some in front of a camera, some beside and behind it, is put through
+   a view * projection the way SoftDevice does it, and checked against a
+   plain one-vertex-at-a-time loop written out here, which should give
+   the same bits for every clip space position, code and screen position.
+   Then the batch is timed against that loop, and on 1, 2, 4 .. threads
+   up to one per core.  It says which path it was built with: c.sh builds
+   it twice, vertexbench with none and vertexbench_avx2 with -mavx2.
+
+   usage:  vertexbench [million vertices ..] [rounds]   (1 and 10 million if none)
+*/
+
+#include "VertexTransform.h"
+#include "../common/VecMath.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+static float frand(float lo, float hi)
+{
+   return lo + (hi - lo) * (rand() % 100000) * 0.00001f;
+}
+
+
+// the loop the batch stands in for.. SoftDevice's before it, arrays of
+// vertices with the clip space position in each
+struct PlainVertex
+{
+   float x, y, z, w;
+   float sx, sy;
+   unsigned int clip;
+};
+
+static void transformPlain(const VertexTransform & t, const float * in, PlainVertex * out, unsigned int count)
+{
+   const float * m = t.matrix;
+   unsigned int i;
+
+   for (i = 0; i < count; i++, in += 3)
+   {
+      PlainVertex & v = out[i];
+      v.x = in[0] * m[0] + in[1] * m[4] + in[2] * m[8] + m[12];
+      v.y = in[0] * m[1] + in[1] * m[5] + in[2] * m[9] + m[13];
+      v.z = in[0] * m[2] + in[1] * m[6] + in[2] * m[10] + m[14];
+      v.w = in[0] * m[3] + in[1] * m[7] + in[2] * m[11] + m[15];
+      v.clip = (v.z < 0.0f ? CLIP_NEAR : 0) | (v.w - v.z < 0.0f ? CLIP_FAR : 0) |
+               (v.x + t.guardX * v.w < 0.0f ? CLIP_LEFT : 0) | (t.guardX * v.w - v.x < 0.0f ? CLIP_RIGHT : 0) |
+               (v.y + t.guardY * v.w < 0.0f ? CLIP_BOTTOM : 0) | (t.guardY * v.w - v.y < 0.0f ? CLIP_TOP : 0);
+      v.sx = (v.x / v.w + 1.0f) * 0.5f * t.width;
+      v.sy = (1.0f - v.y / v.w) * 0.5f * t.height;
+   }
+}
+
+
+static bool sameBits(float a, float b)
+{
+   return memcmp(&a, &b, sizeof(float)) == 0;
+}
+
+
+int main(int argc, char ** argv)
+{
+   std::vector<double> sizes;
+   unsigned int rounds = 5, cores = std::thread::hardware_concurrency(), i, r, n;
+   int a;
+
+   for (a = 1; a < argc; a++)
+      sizes.push_back(atof(argv[a]));
+   if (sizes.size() > 1)   // the last is the rounds
+   {
+      rounds = (unsigned int) sizes.back();
+      sizes.pop_back();
+   }
+   if (sizes.empty())
+   {
+      sizes.push_back(1.0);
+      sizes.push_back(10.0);
+   }
+   if (rounds == 0 || sizes[0] <= 0.0)
+   {
+      printf("usage:  vertexbench [million vertices ..] [rounds]\n");
+      return 1;
+   }
+   if (cores == 0)
+      cores = 1;
+   printf("path %s, %u cores\n", vertexTransformPath(), cores);
+
+   VertexTransform t;
+   Mat4 viewProj = mat4LookAtLH(Vec3(0, 10, -120), Vec3(0, 0, 0), Vec3(0, 1, 0)) *
+                   mat4PerspectiveFovLH(3.141592654f / 4, 1.3333f, 1.0f, 400.0f);
+   memcpy(t.matrix, viewProj.m, sizeof(t.matrix));
+   t.width = 800.0f;
+   t.height = 600.0f;
+   t.guardX = 2.0f * 4096.0f / t.width - 1.0f;   // SoftDevice's guard band
+   t.guardY = 2.0f * 4096.0f / t.height - 1.0f;
+
+   bool failed = false;
+   for (size_t k = 0; k < sizes.size(); k++)
+   {
+      unsigned int count = (unsigned int) (sizes[k] * 1000000.0);
+      std::vector<float> in((size_t) count * 3), streams((size_t) count * 9);
+      std::vector<unsigned char> codes(count);
+      std::vector<PlainVertex> plain(count);
+      VertexStreams s;
+      float * f = &streams[0];
+
+      srand(1);
+      for (i = 0; i < count; i++)
+      {
+         // a few behind the camera and past the far plane, most in front
+         in[i * 3] = frand(-150, 150);
+         in[i * 3 + 1] = frand(-100, 100);
+         in[i * 3 + 2] = frand(-150, 300);
+         f[i] = in[i * 3];
+         f[count + i] = in[i * 3 + 1];
+         f[count * 2 + i] = in[i * 3 + 2];
+      }
+      s.x = f;
+      s.y = f + count;
+      s.z = f + count * 2;
+      s.clipX = f + count * 3;
+      s.clipY = f + count * 4;
+      s.clipZ = f + count * 5;
+      s.clipW = f + count * 6;
+      s.screenX = f + count * 7;
+      s.screenY = f + count * 8;
+      s.screenZ = s.rhw = NULL;
+      s.clip = &codes[0];
+
+      ClipCodes all = transformVerticesParallel(t, s, count);
+      transformPlain(t, &in[0], &plain[0], count);
+      unsigned int wrong = 0, inside = 0, any = 0;
+      for (i = 0; i < count; i++)
+      {
+         const PlainVertex & v = plain[i];
+         bool same = sameBits(s.clipX[i], v.x) && sameBits(s.clipY[i], v.y) && sameBits(s.clipZ[i], v.z) &&
+                     sameBits(s.clipW[i], v.w) && codes[i] == v.clip;
+         if (v.clip == 0)   // the screen positions only count inside
+            same = same && sameBits(s.screenX[i], v.sx) && sameBits(s.screenY[i], v.sy);
+         if (!same)
+            wrong++;
+         inside += v.clip == 0;
+         any |= v.clip;
+      }
+      if (any != all.any)
+         wrong++;
+      printf("%u vertices, %u inside, %s the same bits as one at a time", count, inside,
+             wrong ? "does NOT give" : "gives");
+      if (wrong)
+         printf(" (%u off)", wrong);
+      printf("\n");
+      failed = failed || wrong;
+
+      // the same rounds of each, ns a vertex
+      double ms = 0.0;
+      float check = 0.0f;
+      for (r = 0; r < rounds; r++)
+      {
+         Clock::time_point start = Clock::now();
+         transformPlain(t, &in[0], &plain[0], count);
+         ms += msSince(start);
+         check += plain[r % count].sx;
+      }
+      double plainNs = ms * 1e6 / ((double) count * rounds);
+      printf("  one at a time     %7.2f ns\n", plainNs);
+
+      for (n = 1; ; n = n * 2 > cores ? cores : n * 2)
+      {
+         ms = 0.0;
+         for (r = 0; r < rounds; r++)
+         {
+            Clock::time_point start = Clock::now();
+            transformVerticesParallel(t, s, count, n);
+            ms += msSince(start);
+            check += s.screenX[r % count];
+         }
+         double ns = ms * 1e6 / ((double) count * rounds);
+         printf("  %-6s %2u thread%s %7.2f ns  %6.2fx\n", vertexTransformPath(), n, n == 1 ? " " : "s", ns,
+                plainNs / ns);
+         if (n == cores)
+            break;
+      }
+      printf("  (check %g)\n", check);
+   }
+   return failed ? 1 : 0;
+}
@@ -0,0 +1,171 @@
+/* Filename:  weldbench.cpp
+
+   Headless check and benchmark for ../common/MeshWeld.h.  A grid of
+   quads a side long is made as a plain triangle list, six vertices a
+   quad with a position, a normal and texture coordinates, so the corners
+   the quads share come up four or six times over, and welded.  With the
+   default 600 that is over 2 million vertices in, 361201 out.
+
+   The welded mesh is checked against the grid: it has one vertex a grid
+   corner, every input vertex comes back byte for byte through its index,
+   and since there are more than 0xFFFF of them the indices are 32 bit and
+   copyIndices writes them that way.  Lists of 0xFFFF and 0x10000 distinct
+   vertices check either side of that line.  It exits 1 if anything is
+   off.  Then the weld is timed, in ns an input vertex.
+
+   usage:  weldbench [quads a side] [rounds]
+*/
+
+#include "../common/MeshWeld.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+struct GridVertex
+{
+   float x, y, z;
+   float nx, ny, nz;
+   float tu, tv;
+};
+
+// corner (i, j) of a side x side grid of unit quads, bent a little so the
+// positions aren't all round numbers
+static GridVertex corner(unsigned int i, unsigned int j, unsigned int side)
+{
+   GridVertex v;
+
+   v.x = (float) i - side * 0.5f;
+   v.z = (float) j - side * 0.5f;
+   v.y = (float) ((i * 7 + j * 13) % 17) * 0.0625f;
+   v.nx = v.nz = 0.0f;
+   v.ny = 1.0f;
+   v.tu = (float) i / side;
+   v.tv = (float) j / side;
+   return v;
+}
+
+static void makeGrid(unsigned int side, std::vector<GridVertex> & out)
+{
+   unsigned int i, j;
+
+   out.clear();
+   out.reserve((size_t) side * side * 6);
+   for (j = 0; j < side; j++)
+      for (i = 0; i < side; i++)
+      {
+         out.push_back(corner(i, j, side));
+         out.push_back(corner(i, j + 1, side));
+         out.push_back(corner(i + 1, j, side));
+         out.push_back(corner(i + 1, j, side));
+         out.push_back(corner(i, j + 1, side));
+         out.push_back(corner(i + 1, j + 1, side));
+      }
+}
+
+
+// every input vertex back through its index, and copyIndices the same
+// indices at indexSize() bytes each.. the ones that differ
+static unsigned int checkWeld(const WeldedMesh & mesh, const void * verts, unsigned int count, unsigned int stride)
+{
+   const unsigned char * in = (const unsigned char *) verts;
+   const unsigned char * out = (const unsigned char *) mesh.vertices();
+   const unsigned int * indices = mesh.indices();
+   std::vector<unsigned char> copied(mesh.indexBytes());
+   unsigned int i, wrong = 0;
+
+   if (mesh.indexCount() != count || mesh.stride() != stride)
+      return count ? count : 1;
+   if (count)
+      mesh.copyIndices(&copied[0]);
+   for (i = 0; i < count; i++)
+   {
+      unsigned int index = indices[i], back;
+      if (index >= mesh.vertexCount() ||
+          memcmp(out + (size_t) index * stride, in + (size_t) i * stride, stride) != 0)
+      {
+         wrong++;
+         continue;
+      }
+      if (mesh.indexSize() == 4)
+         memcpy(&back, &copied[(size_t) i * 4], 4);
+      else
+      {
+         unsigned short s;
+         memcpy(&s, &copied[(size_t) i * 2], 2);
+         back = s;
+      }
+      wrong += back != indices[i];
+   }
+   return wrong;
+}
+
+
+static bool g_failed = false;
+
+static void report(const char * what, bool ok)
+{
+   printf("  %-44s %s\n", what, ok ? "ok" : "WRONG");
+   g_failed = g_failed || !ok;
+}
+
+
+int main(int argc, char ** argv)
+{
+   unsigned int side = argc > 1 ? atoi(argv[1]) : 600;
+   unsigned int rounds = argc > 2 ? atoi(argv[2]) : 5;
+   std::vector<GridVertex> grid;
+   WeldedMesh mesh;
+   unsigned int r, i;
+   char what[80];
+
+   if (side == 0 || rounds == 0)
+   {
+      printf("usage:  weldbench [quads a side] [rounds]\n");
+      return 1;
+   }
+
+   makeGrid(side, grid);
+   unsigned int count = (unsigned int) grid.size(), corners = (side + 1) * (side + 1);
+   printf("%u x %u grid, %u vertices in\n", side, side, count);
+   report("welds", mesh.weld(&grid[0], count, sizeof(GridVertex)));
+   snprintf(what, sizeof(what), "%u vertices out, one a corner", mesh.vertexCount());
+   report(what, mesh.vertexCount() == corners);
+   report("every vertex comes back through its index", checkWeld(mesh, &grid[0], count, sizeof(GridVertex)) == 0);
+   snprintf(what, sizeof(what), "%u bit indices", mesh.indexSize() * 8);
+   report(what, mesh.indexSize() == (corners > 0xFFFF ? 4u : 2u));
+   report("index bytes", mesh.indexBytes() == count * mesh.indexSize());
+
+   // either side of 16 bit indices: every vertex distinct, so none weld
+   for (unsigned int n = 0xFFFF; n <= 0x10000; n++)
+   {
+      std::vector<unsigned int> distinct(n);
+      WeldedMesh small;
+      for (i = 0; i < n; i++)
+         distinct[i] = i * 2654435761u;   // all different, not in order
+      small.weld(&distinct[0], n, sizeof(unsigned int));
+      snprintf(what, sizeof(what), "%u distinct: all kept, %u bit indices", n, small.indexSize() * 8);
+      report(what, small.vertexCount() == n && small.indexSize() == (n > 0xFFFF ? 4u : 2u) &&
+                   checkWeld(small, &distinct[0], n, sizeof(unsigned int)) == 0);
+   }
+   printf("%s\n", g_failed ? "the welds are NOT right" : "the welds are right");
+
+   double ms = 0.0;
+   for (r = 0; r < rounds; r++)
+   {
+      Clock::time_point start = Clock::now();
+      mesh.weld(&grid[0], count, sizeof(GridVertex));
+      ms += msSince(start);
+   }
+   printf("%u rounds  %8.2f ms a weld  %6.2f ns a vertex\n", rounds, ms / rounds, ms * 1e6 / ((double) count * rounds));
+   return g_failed ? 1 : 0;
+}
@@ -0,0 +1,421 @@
+/* Filename:  AssetPack.cpp
+
+   This file accompanies AssetPack.h.
+*/
+
+#include "AssetPack.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#define PACK_MAGIC    0x4B415041   // "APAK"
+#define PACK_VERSION  1
+#define PACK_ALIGN    4096         // every file starts on a page
+#define PACK_CHUNK    65536        // LZ4 chunks, each unpacks on its own
+#define CHUNK_STORED  0x80000000   // in a chunk's size: it didn't shrink, so it's as it is
+#define FLAG_LZ4      1
+
+// the layout on disk, little endian.. the header, then the entries, then
+// the names (each ending in a 0), then the files
+struct PackHeader
+{
+   unsigned int magic;
+   unsigned int version;
+   unsigned int count;
+   unsigned int nameBytes;
+   unsigned long long tocOffset;
+   unsigned long long reserved;
+};
+
+struct PackEntry
+{
+   unsigned long long offset;
+   unsigned long long bytes;
+   unsigned long long rawBytes;
+   unsigned long long hash;
+   unsigned int nameOffset;
+   unsigned short nameLength;
+   unsigned short flags;
+};
+
+
+// LZ4 block format: a token (literal count, match length - 4), the
+// literals, a 2 byte offset back to the match.. counts of 15 or more
+// carry on in the bytes after.  The last 5 bytes are always literals and
+// no match starts in the last 12
+#define LZ4_MIN_MATCH   4
+#define LZ4_LAST_LITS   5
+#define LZ4_MATCH_LIMIT 12
+#define LZ4_HASH_BITS   12
+
+static inline unsigned int read32(const unsigned char * p)
+{
+   unsigned int v;
+   memcpy(&v, p, 4);
+   return v;
+}
+
+
+// a run count of 15 or more, in the bytes after the token
+static inline unsigned char * putCount(unsigned char * op, size_t n)
+{
+   for (; n >= 255; n -= 255)
+      *op++ = 255;
+   *op++ = (unsigned char) n;
+   return op;
+}
+
+
+size_t lz4Compress(const void * src, size_t bytes, void * dst, size_t capacity)
+{
+   const unsigned char * in = (const unsigned char *) src;
+   unsigned char * out = (unsigned char *) dst, * op = out;
+   unsigned int table[1 << LZ4_HASH_BITS];
+   size_t anchor = 0, i = 0;
+
+   memset(table, 0, sizeof(table));
+   while (bytes > LZ4_MATCH_LIMIT && i < bytes - LZ4_MATCH_LIMIT)
+   {
+      unsigned int seq = read32(in + i);
+      unsigned int h = (seq * 2654435761u) >> (32 - LZ4_HASH_BITS);
+      size_t ref = table[h], len, lits;
+      table[h] = (unsigned int) i;
+
+      if (ref >= i || i - ref > 65535 || read32(in + ref) != seq)
+      {
+         i++;
+         continue;
+      }
+
+      len = LZ4_MIN_MATCH;
+      while (i + len < bytes - LZ4_LAST_LITS && in[ref + len] == in[i + len])
+         len++;
+
+      // worst case for this sequence: token, counts, literals, offset
+      lits = i - anchor;
+      if ((size_t) (op - out) + lits + lits / 255 + len / 255 + 8 > capacity)
+         return 0;
+      *op++ = (unsigned char) ((std::min(lits, (size_t) 15) << 4) | std::min(len - LZ4_MIN_MATCH, (size_t) 15));
+      if (lits >= 15)
+         op = putCount(op, lits - 15);
+      memcpy(op, in + anchor, lits);
+      op += lits;
+      *op++ = (unsigned char) (i - ref);
+      *op++ = (unsigned char) ((i - ref) >> 8);
+      if (len - LZ4_MIN_MATCH >= 15)
+         op = putCount(op, len - LZ4_MIN_MATCH - 15);
+
+      i += len;
+      anchor = i;
+   }
+
+   // what is left goes out as literals
+   size_t lits = bytes - anchor;
+   if ((size_t) (op - out) + lits + lits / 255 + 2 > capacity)
+      return 0;
+   *op++ = (unsigned char) (std::min(lits, (size_t) 15) << 4);
+   if (lits >= 15)
+      op = putCount(op, lits - 15);
+   memcpy(op, in + anchor, lits);
+   return (op - out) + lits;
+}
+
+
+// checks every count and offset, so a damaged pack can't write past dst
+bool lz4Decompress(const void * src, size_t bytes, void * dst, size_t rawBytes)
+{
+   const unsigned char * ip = (const unsigned char *) src, * end = ip + bytes;
+   unsigned char * out = (unsigned char *) dst, * op = out, * opEnd = out + rawBytes;
+
+   while (ip < end)
+   {
+      unsigned int token = *ip++;
+      size_t lits = token >> 4, len = token & 15, offset;
+      unsigned char c;
+
+      if (lits == 15)
+         do
+         {
+            if (ip >= end)
+               return false;
+            c = *ip++;
+            lits += c;
+         } while (c == 255);
+      if (lits > (size_t) (end - ip) || lits > (size_t) (opEnd - op))
+         return false;
+      memcpy(op, ip, lits);
+      ip += lits;
+      op += lits;
+      if (ip == end)   // the last sequence has no match
+         break;
+
+      if (end - ip < 2)
+         return false;
+      offset = ip[0] | (ip[1] << 8);
+      ip += 2;
+      if (offset == 0 || offset > (size_t) (op - out))
+         return false;
+      if (len == 15)
+         do
+         {
+            if (ip >= end)
+               return false;
+            c = *ip++;
+            len += c;
+         } while (c == 255);
+      len += LZ4_MIN_MATCH;
+      if (len > (size_t) (opEnd - op))
+         return false;
+      for (; len > 0; len--, op++)   // a byte at a time, the match can overlap what it writes
+         *op = op[-(ptrdiff_t) offset];
+   }
+   return op == opEnd;
+}
+
+
+AssetPack::AssetPack()
+{
+   m_header = NULL;
+   m_entries = NULL;
+   m_names = NULL;
+}
+
+
+bool AssetPack::open(const char * filename)
+{
+   unsigned int i;
+
+   close();
+   if (!m_file.open(filename) || m_file.size() < sizeof(PackHeader))
+   {
+      close();
+      return false;
+   }
+   m_header = (const PackHeader *) m_file.data();   // the mapping is page aligned
+
+   size_t size = m_file.size(), toc = (size_t) m_header->tocOffset;
+   if (m_header->magic != PACK_MAGIC || m_header->version != PACK_VERSION || toc % 8 != 0 ||
+       toc > size || (size - toc) / sizeof(PackEntry) < m_header->count ||
+       size - toc - m_header->count * sizeof(PackEntry) < m_header->nameBytes)
+   {
+      close();
+      return false;
+   }
+   m_entries = (const PackEntry *) (m_file.data() + toc);
+   m_names = (const char *) (m_entries + m_header->count);
+
+   // everything the table points at has to be inside the file.. and what a
+   // file unpacks to has to be what's there if it's stored as it is, or no
+   // more than its table of chunk sizes covers if it's packed, since
+   // contents() and its callers take rawBytes at its word
+   for (i = 0; i < m_header->count; i++)
+   {
+      const PackEntry & e = m_entries[i];
+      unsigned long long chunks = e.rawBytes / PACK_CHUNK + (e.rawBytes % PACK_CHUNK != 0);
+      if (e.offset > size || e.bytes > size - e.offset ||
+          (size_t) e.nameOffset + e.nameLength >= m_header->nameBytes ||
+          m_names[e.nameOffset + e.nameLength] != 0 ||
+          (e.flags & ~FLAG_LZ4) != 0 || (size_t) e.rawBytes != e.rawBytes ||
+          ((e.flags & FLAG_LZ4) ? chunks > e.bytes / 4 : e.rawBytes != e.bytes))
+      {
+         close();
+         return false;
+      }
+   }
+   return true;
+}
+
+
+void AssetPack::close()
+{
+   m_file.close();
+   m_header = NULL;
+   m_entries = NULL;
+   m_names = NULL;
+}
+
+
+unsigned int AssetPack::count() const
+{
+   return m_header ? m_header->count : 0;
+}
+
+
+PackItem AssetPack::item(unsigned int i) const
+{
+   const PackEntry & e = m_entries[i];
+   PackItem item;
+
+   item.name = m_names + e.nameOffset;
+   item.data = m_file.data() + e.offset;
+   item.bytes = (size_t) e.bytes;
+   item.rawBytes = (size_t) e.rawBytes;
+   item.hash = e.hash;
+   item.compressed = (e.flags & FLAG_LZ4) != 0;
+   return item;
+}
+
+
+bool AssetPack::find(const char * name, PackItem & item) const
+{
+   unsigned int first = 0, last = count();
+
+   while (first < last)
+   {
+      unsigned int mid = (first + last) / 2;
+      int c = strcmp(m_names + m_entries[mid].nameOffset, name);
+      if (c == 0)
+      {
+         item = this->item(mid);
+         return true;
+      }
+      if (c < 0)
+         first = mid + 1;
+      else
+         last = mid;
+   }
+   return false;
+}
+
+
+const unsigned char * AssetPack::contents(const PackItem & item, std::vector<unsigned char> & scratch) const
+{
+   if (!item.compressed)
+      return item.data;
+
+   // a table of chunk sizes, then the chunks
+   size_t chunks = (item.rawBytes + PACK_CHUNK - 1) / PACK_CHUNK, i, at, raw;
+   const unsigned char * p = item.data + chunks * 4, * end = item.data + item.bytes;
+
+   if (item.bytes < chunks * 4)
+      return NULL;
+   scratch.resize(item.rawBytes);
+   for (i = 0, at = 0; i < chunks; i++, at += raw)
+   {
+      unsigned int packed = read32(item.data + i * 4), stored = packed & CHUNK_STORED;
+      packed &= ~CHUNK_STORED;
+      raw = std::min(item.rawBytes - at, (size_t) PACK_CHUNK);
+      if (packed > (size_t) (end - p))
+         return NULL;
+      if (stored ? packed != raw : !lz4Decompress(p, packed, &scratch[at], raw))
+         return NULL;
+      if (stored)
+         memcpy(&scratch[at], p, raw);
+      p += packed;
+   }
+   return scratch.empty() ? item.data : &scratch[0];
+}
+
+
+// packs data in chunks the way contents() unpacks them.. false if that
+// isn't worth it (it doesn't save an eighth)
+static bool packChunks(const unsigned char * data, size_t bytes, std::vector<unsigned char> & out)
+{
+   size_t chunks = (bytes + PACK_CHUNK - 1) / PACK_CHUNK, i, raw, packed;
+   std::vector<unsigned char> buffer(PACK_CHUNK);
+
+   out.assign(chunks * 4, 0);
+   for (i = 0; i < chunks; i++)
+   {
+      unsigned int size;
+      raw = std::min(bytes - i * PACK_CHUNK, (size_t) PACK_CHUNK);
+      packed = lz4Compress(data + i * PACK_CHUNK, raw, &buffer[0], raw - 1);
+      if (packed)
+      {
+         size = (unsigned int) packed;
+         out.insert(out.end(), buffer.begin(), buffer.begin() + packed);
+      }
+      else
+      {
+         size = (unsigned int) raw | CHUNK_STORED;
+         out.insert(out.end(), data + i * PACK_CHUNK, data + i * PACK_CHUNK + raw);
+      }
+      memcpy(&out[i * 4], &size, 4);
+   }
+   return out.size() < bytes - bytes / 8;
+}
+
+
+static bool byName(const PackInput * a, const PackInput * b)
+{
+   return a->name < b->name;
+}
+
+
+bool writePack(const char * filename, const std::vector<PackInput> & inputs, bool compress)
+{
+   std::string temp = std::string(filename) + ".tmp";
+   std::vector<const PackInput *> sorted;
+   std::vector<PackEntry> entries(inputs.size());
+   std::vector<std::vector<unsigned char> > packed(inputs.size());
+   std::string names;
+   PackHeader header;
+   unsigned long long at;
+   static const unsigned char zeros[PACK_ALIGN] = { 0 };
+   size_t i;
+   FILE * file;
+   bool ok;
+
+   for (i = 0; i < inputs.size(); i++)
+      sorted.push_back(&inputs[i]);
+   std::sort(sorted.begin(), sorted.end(), byName);
+
+   for (i = 0; i < sorted.size(); i++)
+   {
+      const PackInput & in = *sorted[i];
+      if ((i > 0 && in.name == sorted[i - 1]->name) || in.name.size() > 65535)
+         return false;
+      memset(&entries[i], 0, sizeof(PackEntry));
+      entries[i].nameOffset = (unsigned int) names.size();
+      entries[i].nameLength = (unsigned short) in.name.size();
+      entries[i].rawBytes = in.bytes;
+      entries[i].bytes = in.bytes;
+      entries[i].hash = xxHash64(in.data, in.bytes);
+      names.append(in.name.c_str(), in.name.size() + 1);
+
+      if (compress && in.bytes > 0 && packChunks((const unsigned char *) in.data, in.bytes, packed[i]))
+      {
+         entries[i].bytes = packed[i].size();
+         entries[i].flags = FLAG_LZ4;
+      }
+   }
+
+   memset(&header, 0, sizeof(header));
+   header.magic = PACK_MAGIC;
+   header.version = PACK_VERSION;
+   header.count = (unsigned int) entries.size();
+   header.nameBytes = (unsigned int) names.size();
+   header.tocOffset = sizeof(header);
+
+   at = sizeof(header) + entries.size() * sizeof(PackEntry) + names.size();
+   for (i = 0; i < entries.size(); i++)
+   {
+      at = (at + PACK_ALIGN - 1) / PACK_ALIGN * PACK_ALIGN;
+      entries[i].offset = at;
+      at += entries[i].bytes;
+   }
+
+   file = fopen(temp.c_str(), "wb");
+   if (file == NULL)
+      return false;
+   ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+        (entries.empty() || fwrite(&entries[0], sizeof(PackEntry), entries.size(), file) == entries.size()) &&
+        fwrite(names.data(), 1, names.size(), file) == names.size();
+   at = sizeof(header) + entries.size() * sizeof(PackEntry) + names.size();
+   for (i = 0; ok && i < entries.size(); i++)
+   {
+      const void * data = entries[i].flags & FLAG_LZ4 ? (const void *) &packed[i][0] : sorted[i]->data;
+      ok = fwrite(zeros, 1, (size_t) (entries[i].offset - at), file) == entries[i].offset - at &&
+           fwrite(data, 1, (size_t) entries[i].bytes, file) == entries[i].bytes;
+      at = entries[i].offset + entries[i].bytes;
+   }
+   ok = fclose(file) == 0 && ok;
+
+   remove(filename);   // rename won't replace a file on Windows
+   if (!ok || rename(temp.c_str(), filename) != 0)
+   {
+      remove(temp.c_str());
+      return false;
+   }
+   return true;
+}
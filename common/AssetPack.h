@@ -0,0 +1,93 @@
+/* Filename:  AssetPack.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Puts all of an example's files (bitmaps, their saved mip levels, or
+   anything else) into one pack file, which is mapped once when it is
+   opened.  After that nothing is opened or read: finding a file is a
+   binary search through the table of contents at the front, and its
+   bytes are used right where they lie in the mapping.
+
+   The table of contents is sorted by name.  Each file starts on a 4 KB
+   boundary, so it begins on a page of its own and the pages it covers
+   are read from disk the first time they are touched.  A file can be
+   stored LZ4 compressed instead, in 64 KB chunks that each unpack on
+   their own; those are the one case that has to be copied, into a
+   buffer the caller passes in.
+
+   Every file carries the xxHash64 of its contents (unpacked), the same
+   one TextureCache keys its textures by, so it doesn't have to hash
+   them again.  tools/pack builds the files.
+*/
+
+#ifndef ASSETPACK_H
+#define ASSETPACK_H
+
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include "Hash.h"
+#include "MappedFile.h"
+
+struct PackHeader;
+struct PackEntry;
+
+
+// one file in a pack
+struct PackItem
+{
+   const char * name;
+   const unsigned char * data;   // in the mapping, packed if compressed
+   size_t bytes;                 // what data covers..
+   size_t rawBytes;              // .. and what it unpacks to
+   Hash64 hash;                  // xxHash64 of the unpacked contents
+   bool compressed;
+};
+
+// one file to go into a pack.. data has to stay put until writePack returns
+struct PackInput
+{
+   std::string name;
+   const void * data;
+   size_t bytes;
+};
+
+
+class AssetPack
+{
+public:
+   AssetPack();
+
+   bool open(const char * filename);   // false if it isn't a pack, or a damaged one
+   void close();
+   bool isOpen() const { return m_entries != NULL; }
+
+   unsigned int count() const;
+   PackItem item(unsigned int i) const;   // in name order
+   bool find(const char * name, PackItem & item) const;
+
+   // the file's contents.. item.data itself if it is stored as it is,
+   // otherwise unpacked into scratch.  NULL if it won't unpack
+   const unsigned char * contents(const PackItem & item, std::vector<unsigned char> & scratch) const;
+
+private:
+   AssetPack(const AssetPack &);              // not copyable
+   AssetPack & operator=(const AssetPack &);
+
+   MappedFile m_file;
+   const PackHeader * m_header;
+   const PackEntry * m_entries;
+   const char * m_names;
+};
+
+// sorts the inputs by name and writes them out, LZ4 compressing the ones it
+// helps if compress is set.. false if it can't be written or two inputs
+// have the same name
+bool writePack(const char * filename, const std::vector<PackInput> & inputs, bool compress);
+
+// LZ4 block format, for anything else that wants it.. lz4Compress returns
+// the packed size, 0 if it doesn't fit in capacity
+size_t lz4Compress(const void * src, size_t bytes, void * dst, size_t capacity);
+bool lz4Decompress(const void * src, size_t bytes, void * dst, size_t rawBytes);
+
+#endif
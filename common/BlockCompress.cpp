@@ -0,0 +1,552 @@
+/* Filename:  BlockCompress.cpp
+
+   This file accompanies BlockCompress.h.
+*/
+
+#include "BlockCompress.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define BLOCK_SSE 1
+#endif
+
+
+// one 4x4 block, split into channels so 4 pixels load at once
+struct Block
+{
+   float r[16], g[16], b[16];
+   unsigned char a[16];
+};
+
+
+static void loadBlock(const unsigned char * src, int pitch, int width, int height, int bx, int by,
+                      Block & blk)
+{
+   int x, y;
+
+   // blocks hanging over the edge repeat the last row and column
+   for (y = 0; y < 4; y++)
+   {
+      const unsigned char * row = src + (ptrdiff_t) pitch * std::min(by * 4 + y, height - 1);
+      for (x = 0; x < 4; x++)
+      {
+         const unsigned char * p = row + std::min(bx * 4 + x, width - 1) * 4;
+         blk.b[y * 4 + x] = p[0];
+         blk.g[y * 4 + x] = p[1];
+         blk.r[y * 4 + x] = p[2];
+         blk.a[y * 4 + x] = p[3];
+      }
+   }
+}
+
+
+static unsigned int to565(const float * c)
+{
+   int r = (int) (c[0] * (31 / 255.0f) + 0.5f);
+   int g = (int) (c[1] * (63 / 255.0f) + 0.5f);
+   int b = (int) (c[2] * (31 / 255.0f) + 0.5f);
+   r = std::max(0, std::min(r, 31));
+   g = std::max(0, std::min(g, 63));
+   b = std::max(0, std::min(b, 31));
+   return (r << 11) | (g << 5) | b;
+}
+
+
+static void from565(unsigned int c, int * rgb)
+{
+   int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+   rgb[0] = (r << 3) | (r >> 2);
+   rgb[1] = (g << 2) | (g >> 4);
+   rgb[2] = (b << 3) | (b >> 2);
+}
+
+
+// the 4 colours of a 4 colour block: c0, c1, 2/3 c0 + 1/3 c1, 1/3 c0 + 2/3 c1
+static void palette(unsigned int c0, unsigned int c1, float pal[4][3])
+{
+   int a[3], b[3], i;
+
+   from565(c0, a);
+   from565(c1, b);
+   for (i = 0; i < 3; i++)
+   {
+      pal[0][i] = (float) a[i];
+      pal[1][i] = (float) b[i];
+      pal[2][i] = (float) ((2 * a[i] + b[i]) / 3);
+      pal[3][i] = (float) ((a[i] + 2 * b[i]) / 3);
+   }
+}
+
+
+// picks the closest of the 4 colours for every pixel.. returns the squared error
+static float fitIndices(const Block & blk, unsigned int c0, unsigned int c1, unsigned int & indices)
+{
+   float pal[4][3];
+   int i, p;
+
+   palette(c0, c1, pal);
+   indices = 0;
+
+#ifdef BLOCK_SSE
+   __m128 total = _mm_setzero_ps();
+   for (i = 0; i < 16; i += 4)
+   {
+      __m128 r = _mm_loadu_ps(blk.r + i), g = _mm_loadu_ps(blk.g + i), b = _mm_loadu_ps(blk.b + i);
+      __m128 best = _mm_set1_ps(1e30f);
+      __m128i bestIndex = _mm_setzero_si128();
+      for (p = 0; p < 4; p++)
+      {
+         __m128 dr = _mm_sub_ps(r, _mm_set1_ps(pal[p][0]));
+         __m128 dg = _mm_sub_ps(g, _mm_set1_ps(pal[p][1]));
+         __m128 db = _mm_sub_ps(b, _mm_set1_ps(pal[p][2]));
+         __m128 d = _mm_add_ps(_mm_add_ps(_mm_mul_ps(dr, dr), _mm_mul_ps(dg, dg)), _mm_mul_ps(db, db));
+         __m128i closer = _mm_castps_si128(_mm_cmplt_ps(d, best));
+         best = _mm_min_ps(d, best);
+         bestIndex = _mm_or_si128(_mm_andnot_si128(closer, bestIndex),
+                                  _mm_and_si128(closer, _mm_set1_epi32(p)));
+      }
+      total = _mm_add_ps(total, best);
+      int idx[4];
+      _mm_storeu_si128((__m128i *) idx, bestIndex);
+      for (p = 0; p < 4; p++)
+         indices |= idx[p] << ((i + p) * 2);
+   }
+   float sums[4];
+   _mm_storeu_ps(sums, total);
+   return sums[0] + sums[1] + sums[2] + sums[3];
+#else
+   float total = 0;
+   for (i = 0; i < 16; i++)
+   {
+      float best = 1e30f;
+      int bestIndex = 0;
+      for (p = 0; p < 4; p++)
+      {
+         float dr = blk.r[i] - pal[p][0], dg = blk.g[i] - pal[p][1], db = blk.b[i] - pal[p][2];
+         float d = dr * dr + dg * dg + db * db;
+         if (d < best)
+         {
+            best = d;
+            bestIndex = p;
+         }
+      }
+      total += best;
+      indices |= bestIndex << (i * 2);
+   }
+   return total;
+#endif
+}
+
+
+// the end colours that best fit the chosen indices, by least squares..
+// false if the indices don't pin them down
+static bool refit(const Block & blk, unsigned int indices, float * e0, float * e1)
+{
+   static const float WEIGHT[4] = { 1.0f, 0.0f, 2.0f / 3, 1.0f / 3 };   // of c0 for each index
+   float aa = 0, ab = 0, bb = 0, ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+   int i;
+
+   for (i = 0; i < 16; i++)
+   {
+      float a = WEIGHT[(indices >> (i * 2)) & 3], b = 1 - a;
+      aa += a * a;
+      ab += a * b;
+      bb += b * b;
+      ax[0] += a * blk.r[i];  ax[1] += a * blk.g[i];  ax[2] += a * blk.b[i];
+      bx[0] += b * blk.r[i];  bx[1] += b * blk.g[i];  bx[2] += b * blk.b[i];
+   }
+
+   float det = aa * bb - ab * ab;
+   if (fabsf(det) < 1e-6f)
+      return false;
+   for (i = 0; i < 3; i++)
+   {
+      e0[i] = (ax[i] * bb - bx[i] * ab) / det;
+      e1[i] = (bx[i] * aa - ax[i] * ab) / det;
+   }
+   return true;
+}
+
+
+// for a block of one colour: for each 8 bit value the pair of 5 (or 6) bit
+// ends whose 2/3 : 1/3 mix comes closest, which is nearer than rounding it
+struct SolidTables
+{
+   unsigned char hi5[256], lo5[256], hi6[256], lo6[256];
+
+   SolidTables()
+   {
+      fill(hi5, lo5, 5);
+      fill(hi6, lo6, 6);
+   }
+
+   static void fill(unsigned char * hi, unsigned char * lo, int bits)
+   {
+      int top = (1 << bits) - 1, v, a, b;
+      for (v = 0; v < 256; v++)
+      {
+         int bestError = 256;
+         for (a = 0; a <= top; a++)
+            for (b = 0; b <= top; b++)
+            {
+               int ea = bits == 5 ? (a << 3) | (a >> 2) : (a << 2) | (a >> 4);
+               int eb = bits == 5 ? (b << 3) | (b >> 2) : (b << 2) | (b >> 4);
+               int error = abs((2 * ea + eb) / 3 - v);
+               if (error < bestError)
+               {
+                  bestError = error;
+                  hi[v] = (unsigned char) a;
+                  lo[v] = (unsigned char) b;
+               }
+            }
+      }
+   }
+};
+
+
+static bool encodeSolid(const Block & blk, unsigned char * out)
+{
+   static const SolidTables tables;
+   unsigned int c0, c1, indices = 0xAAAAAAAA;   // every pixel index 2
+   int i, r = (int) blk.r[0], g = (int) blk.g[0], b = (int) blk.b[0];
+
+   for (i = 1; i < 16; i++)
+      if (blk.r[i] != blk.r[0] || blk.g[i] != blk.g[0] || blk.b[i] != blk.b[0])
+         return false;
+
+   c0 = (tables.hi5[r] << 11) | (tables.hi6[g] << 5) | tables.hi5[b];
+   c1 = (tables.lo5[r] << 11) | (tables.lo6[g] << 5) | tables.lo5[b];
+   if (c0 < c1)
+   {
+      std::swap(c0, c1);
+      indices = 0xFFFFFFFF;   // index 3 is the same mix the other way round
+   }
+   else if (c0 == c1)
+      indices = 0;
+
+   out[0] = (unsigned char) c0;
+   out[1] = (unsigned char) (c0 >> 8);
+   out[2] = (unsigned char) c1;
+   out[3] = (unsigned char) (c1 >> 8);
+   for (i = 0; i < 4; i++)
+      out[4 + i] = (unsigned char) (indices >> (i * 8));
+   return true;
+}
+
+
+// range fit along the principal axis, then a refit.. 8 bytes
+static void encodeColor(const Block & blk, unsigned char * out)
+{
+   float mean[3] = { 0, 0, 0 }, cov[6] = { 0, 0, 0, 0, 0, 0 }, axis[3], e0[3], e1[3];
+   float tMin = 1e30f, tMax = -1e30f, inset;
+   unsigned int c0, c1, indices, bestIndices, best0, best1;
+   float error, bestError;
+   int i, k;
+
+   if (encodeSolid(blk, out))
+      return;
+
+   for (i = 0; i < 16; i++)
+   {
+      mean[0] += blk.r[i];
+      mean[1] += blk.g[i];
+      mean[2] += blk.b[i];
+   }
+   for (k = 0; k < 3; k++)
+      mean[k] /= 16;
+   for (i = 0; i < 16; i++)
+   {
+      float r = blk.r[i] - mean[0], g = blk.g[i] - mean[1], b = blk.b[i] - mean[2];
+      cov[0] += r * r;  cov[1] += r * g;  cov[2] += r * b;
+      cov[3] += g * g;  cov[4] += g * b;  cov[5] += b * b;
+   }
+
+   // power iteration for the direction the colours spread along most
+   axis[0] = axis[1] = axis[2] = 1;
+   for (k = 0; k < 8; k++)
+   {
+      float x = cov[0] * axis[0] + cov[1] * axis[1] + cov[2] * axis[2];
+      float y = cov[1] * axis[0] + cov[3] * axis[1] + cov[4] * axis[2];
+      float z = cov[2] * axis[0] + cov[4] * axis[1] + cov[5] * axis[2];
+      float len = std::max(fabsf(x), std::max(fabsf(y), fabsf(z)));
+      if (len < 1e-12f)
+         break;   // every pixel the same colour.. keep (1, 1, 1)
+      axis[0] = x / len;
+      axis[1] = y / len;
+      axis[2] = z / len;
+   }
+   float len = sqrtf(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+   for (k = 0; k < 3; k++)
+      axis[k] /= len;
+
+   for (i = 0; i < 16; i++)
+   {
+      float t = (blk.r[i] - mean[0]) * axis[0] + (blk.g[i] - mean[1]) * axis[1] +
+                (blk.b[i] - mean[2]) * axis[2];
+      tMin = std::min(tMin, t);
+      tMax = std::max(tMax, t);
+   }
+
+   // pull the ends in a little, the 565 rounding makes up for it
+   inset = (tMax - tMin) / 16;
+   for (k = 0; k < 3; k++)
+   {
+      e0[k] = mean[k] + axis[k] * (tMax - inset);
+      e1[k] = mean[k] + axis[k] * (tMin + inset);
+   }
+   best0 = to565(e0);
+   best1 = to565(e1);
+   bestError = fitIndices(blk, best0, best1, bestIndices);
+
+   if (bestError > 0 && refit(blk, bestIndices, e0, e1))
+   {
+      c0 = to565(e0);
+      c1 = to565(e1);
+      error = fitIndices(blk, c0, c1, indices);
+      if (error < bestError)
+      {
+         bestError = error;
+         best0 = c0;
+         best1 = c1;
+         bestIndices = indices;
+      }
+   }
+
+   // c0 > c1 means 4 colours.. equal would mean 3 and transparent black
+   if (best0 < best1)
+   {
+      std::swap(best0, best1);
+      bestIndices ^= 0x55555555;   // 0 <-> 1 and 2 <-> 3
+   }
+   else if (best0 == best1)
+      bestIndices = 0;
+
+   out[0] = (unsigned char) best0;
+   out[1] = (unsigned char) (best0 >> 8);
+   out[2] = (unsigned char) best1;
+   out[3] = (unsigned char) (best1 >> 8);
+   out[4] = (unsigned char) bestIndices;
+   out[5] = (unsigned char) (bestIndices >> 8);
+   out[6] = (unsigned char) (bestIndices >> 16);
+   out[7] = (unsigned char) (bestIndices >> 24);
+}
+
+
+static void alphaPalette(int a0, int a1, int * pal)
+{
+   int k;
+
+   pal[0] = a0;
+   pal[1] = a1;
+   if (a0 > a1)
+      for (k = 2; k < 8; k++)
+         pal[k] = ((8 - k) * a0 + (k - 1) * a1) / 7;
+   else
+   {
+      for (k = 2; k < 6; k++)
+         pal[k] = ((6 - k) * a0 + (k - 1) * a1) / 5;
+      pal[6] = 0;
+      pal[7] = 255;
+   }
+}
+
+
+// 8 alpha levels between the lowest and highest.. 8 bytes
+static void encodeAlpha(const Block & blk, unsigned char * out)
+{
+   int aMin = 255, aMax = 0, pal[8], i, p;
+   unsigned long long indices = 0;
+
+   for (i = 0; i < 16; i++)
+   {
+      aMin = std::min(aMin, (int) blk.a[i]);
+      aMax = std::max(aMax, (int) blk.a[i]);
+   }
+
+   if (aMin != aMax)
+   {
+      alphaPalette(aMax, aMin, pal);
+      for (i = 0; i < 16; i++)
+      {
+         int best = 0;
+         for (p = 1; p < 8; p++)
+            if (abs(pal[p] - blk.a[i]) < abs(pal[best] - blk.a[i]))
+               best = p;
+         indices |= (unsigned long long) best << (i * 3);
+      }
+   }
+
+   out[0] = (unsigned char) aMax;
+   out[1] = (unsigned char) aMin;
+   for (i = 0; i < 6; i++)
+      out[2 + i] = (unsigned char) (indices >> (i * 8));
+}
+
+
+template <class Fn>
+static void parallelRows(int rows, unsigned int numThreads, Fn fn)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads > (unsigned int) rows)
+      numThreads = rows;
+   if (numThreads <= 1)
+   {
+      fn(0, rows);
+      return;
+   }
+
+   std::vector<std::thread> threads;
+   int chunk = (rows + numThreads - 1) / numThreads;
+   unsigned int t;
+   for (t = 1; t < numThreads; t++)
+      threads.push_back(std::thread(fn, std::min((int) t * chunk, rows), std::min((int) (t + 1) * chunk, rows)));
+   fn(0, std::min(chunk, rows));
+   for (t = 0; t < threads.size(); t++)
+      threads[t].join();
+}
+
+
+size_t blockBytes(BlockFormat format, int width, int height)
+{
+   return (size_t) ((width + 3) / 4) * ((height + 3) / 4) * (format == BLOCK_BC1 ? 8 : 16);
+}
+
+
+void compressBlocks(BlockFormat format, const void * src, int width, int height, int pitch,
+                    void * dst, unsigned int numThreads)
+{
+   int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+   int size = format == BLOCK_BC1 ? 8 : 16;
+
+   // small levels aren't worth a thread
+   if (blocksX * blocksY < 256)
+      numThreads = 1;
+
+   parallelRows(blocksY, numThreads, [=](int first, int last)
+   {
+      Block blk;
+      int bx, by;
+      for (by = first; by < last; by++)
+         for (bx = 0; bx < blocksX; bx++)
+         {
+            unsigned char * out = (unsigned char *) dst + ((size_t) by * blocksX + bx) * size;
+            loadBlock((const unsigned char *) src, pitch, width, height, bx, by, blk);
+            if (format == BLOCK_BC3)
+            {
+               encodeAlpha(blk, out);
+               out += 8;
+            }
+            encodeColor(blk, out);
+         }
+   });
+}
+
+
+void decompressBlocks(BlockFormat format, const void * src, int width, int height,
+                      void * dst, int pitch)
+{
+   const unsigned char * in = (const unsigned char *) src;
+   int blocksX = (width + 3) / 4, blocksY = (height + 3) / 4;
+   int bx, by, i, k;
+
+   for (by = 0; by < blocksY; by++)
+      for (bx = 0; bx < blocksX; bx++)
+      {
+         int alpha[16], colors[4][3], a[3], b[3], apal[8];
+         unsigned int c0, c1, indices;
+
+         for (i = 0; i < 16; i++)
+            alpha[i] = 255;
+         if (format == BLOCK_BC3)
+         {
+            unsigned long long bits = 0;
+            for (i = 0; i < 6; i++)
+               bits |= (unsigned long long) in[2 + i] << (i * 8);
+            alphaPalette(in[0], in[1], apal);
+            for (i = 0; i < 16; i++)
+               alpha[i] = apal[(bits >> (i * 3)) & 7];
+            in += 8;
+         }
+
+         c0 = in[0] | (in[1] << 8);
+         c1 = in[2] | (in[3] << 8);
+         indices = in[4] | (in[5] << 8) | (in[6] << 16) | ((unsigned int) in[7] << 24);
+         from565(c0, a);
+         from565(c1, b);
+         for (k = 0; k < 3; k++)
+         {
+            colors[0][k] = a[k];
+            colors[1][k] = b[k];
+            if (c0 > c1 || format == BLOCK_BC3)
+            {
+               colors[2][k] = (2 * a[k] + b[k]) / 3;
+               colors[3][k] = (a[k] + 2 * b[k]) / 3;
+            }
+            else
+            {
+               colors[2][k] = (a[k] + b[k]) / 2;
+               colors[3][k] = 0;
+            }
+         }
+         in += 8;
+
+         for (i = 0; i < 16; i++)
+         {
+            int x = bx * 4 + (i & 3), y = by * 4 + (i >> 2), c = (indices >> (i * 2)) & 3;
+            if (x >= width || y >= height)
+               continue;
+            unsigned char * p = (unsigned char *) dst + (ptrdiff_t) pitch * y + x * 4;
+            bool black = format == BLOCK_BC1 && c0 <= c1 && c == 3;
+            p[0] = (unsigned char) colors[c][2];
+            p[1] = (unsigned char) colors[c][1];
+            p[2] = (unsigned char) colors[c][0];
+            p[3] = (unsigned char) (black ? 0 : alpha[i]);
+         }
+      }
+}
+
+
+void compressMipChain(BlockFormat format, const MipChain & chain, std::vector<unsigned char> & out,
+                      unsigned int numThreads)
+{
+   size_t total = 0, at = 0;
+   unsigned int i;
+
+   for (i = 0; i < chain.levels(); i++)
+      total += blockBytes(format, chain.width[i], chain.height[i]);
+   out.resize(total);
+   for (i = 0; i < chain.levels(); i++)
+   {
+      compressBlocks(format, chain.level(i), chain.width[i], chain.height[i], chain.width[i] * 4,
+                     &out[at], numThreads);
+      at += blockBytes(format, chain.width[i], chain.height[i]);
+   }
+}
+
+
+double imagePsnr(const void * a, int pitchA, const void * b, int pitchB, int width, int height,
+                 bool alpha)
+{
+   int channels = alpha ? 4 : 3, x, y, c;
+   double sum = 0, mse;
+
+   for (y = 0; y < height; y++)
+   {
+      const unsigned char * pa = (const unsigned char *) a + (ptrdiff_t) pitchA * y;
+      const unsigned char * pb = (const unsigned char *) b + (ptrdiff_t) pitchB * y;
+      for (x = 0; x < width; x++)
+         for (c = 0; c < channels; c++)
+         {
+            int d = pa[x * 4 + c] - pb[x * 4 + c];
+            sum += d * d;
+         }
+   }
+
+   mse = sum / ((double) width * height * channels);
+   return mse == 0 ? 100.0 : 10 * log10(255.0 * 255.0 / mse);
+}
@@ -0,0 +1,55 @@
+/* Filename:  BlockCompress.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Compresses 32 bit textures to BC1 (DXT1) or BC3 (DXT5), which the
+   video card reads as they are: 4 bits a pixel for BC1 and 8 for BC3,
+   against 32 for X8R8G8B8.  BC1 is for textures without alpha, which is
+   all of the examples' bitmaps; BC3 keeps an 8 level alpha as well.
+
+   Each 4x4 block gets two 5:6:5 end colours and picks one of 4 colours
+   between them for every pixel.  The end colours come from a range fit
+   along the block's principal axis, then one least squares refit from the
+   chosen indices, keeping whichever is closer.  The index search is done
+   4 pixels at a time with SSE and the rows of blocks are split between
+   threads.
+
+   The pixels are laid out like D3DFMT_A8R8G8B8: B, G, R, A in memory.
+*/
+
+#ifndef BLOCKCOMPRESS_H
+#define BLOCKCOMPRESS_H
+
+#include <stddef.h>
+#include <vector>
+#include "MipGen.h"
+
+
+enum BlockFormat
+{
+   BLOCK_BC1,   // D3DFMT_DXT1, 8 bytes a block
+   BLOCK_BC3    // D3DFMT_DXT5, 16 bytes a block
+};
+
+// bytes a width x height image takes, rounded up to whole blocks
+size_t blockBytes(BlockFormat format, int width, int height);
+
+// src is width x height pixels with pitch bytes from one row to the next..
+// dst gets the blocks in rows, blockBytes() of them.  numThreads 0 = all cores
+void compressBlocks(BlockFormat format, const void * src, int width, int height, int pitch,
+                    void * dst, unsigned int numThreads = 0);
+
+// the other way, for checking.. BC1 comes back with alpha 255
+void decompressBlocks(BlockFormat format, const void * src, int width, int height,
+                      void * dst, int pitch);
+
+// every level of a chain, packed one after the other like a .dds file has them
+void compressMipChain(BlockFormat format, const MipChain & chain, std::vector<unsigned char> & out,
+                      unsigned int numThreads = 0);
+
+// peak signal to noise ratio in dB over R, G, B (and A if alpha), higher
+// is closer.. 100 if the images are the same
+double imagePsnr(const void * a, int pitchA, const void * b, int pitchB, int width, int height,
+                 bool alpha);
+
+#endif
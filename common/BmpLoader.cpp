@@ -0,0 +1,224 @@
+/* Filename:  BmpLoader.cpp
+
+   This file accompanies BmpLoader.h.
+*/
+
+#include "BmpLoader.h"
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BMP_X86 1
+#define BMP_TARGET(x) __attribute__((target(x)))
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#include <immintrin.h>
+#define BMP_X86 1
+#define BMP_TARGET(x)
+#endif
+
+
+// little endian values at any alignment
+static unsigned int read16(const unsigned char * p)
+{
+   return p[0] | (p[1] << 8);
+}
+
+static unsigned int read32(const unsigned char * p)
+{
+   return p[0] | (p[1] << 8) | (p[2] << 16) | ((unsigned int) p[3] << 24);
+}
+
+
+bool readBmpInfo(const void * file, size_t bytes, BmpInfo & info)
+{
+   const unsigned char * p = (const unsigned char *) file;
+   int width, height;
+   unsigned int offset, rowBytes, rows;
+
+   // BITMAPFILEHEADER is 14 bytes, then at least a 40 byte BITMAPINFOHEADER
+   if (bytes < 54 || p[0] != 'B' || p[1] != 'M' || read32(p + 14) < 40)
+      return false;
+   if (read16(p + 26) != 1 || read16(p + 28) != 24 || read32(p + 30) != 0)   // planes, bits, BI_RGB
+      return false;
+
+   width = (int) read32(p + 18);
+   height = (int) read32(p + 22);   // negative for a top down bitmap
+   offset = read32(p + 10);
+   if (width <= 0 || height == 0 || width > 65536 || height > 65536 || height < -65536)
+      return false;
+
+   rows = height < 0 ? -height : height;
+   rowBytes = (width * 3 + 3) & ~3u;
+   // the last row doesn't need its padding
+   if (offset < 54 || offset > bytes || (bytes - offset) / rowBytes < rows - 1 ||
+       bytes - offset - (size_t) rowBytes * (rows - 1) < (size_t) width * 3)
+      return false;
+
+   info.width = width;
+   info.height = rows;
+   info.bottomUp = height > 0;
+   info.bitsOffset = offset;
+   info.rowBytes = rowBytes;
+   return true;
+}
+
+
+// the pixels from x on, one at a time
+static void convertRowScalar(const unsigned char * src, unsigned int * dst, int x, int width,
+                             BmpOrder order)
+{
+   src += x * 3;
+   if (order == BMP_BGRA)
+      for (; x < width; x++, src += 3)
+         dst[x] = src[0] | (src[1] << 8) | (src[2] << 16) | 0xFF000000u;
+   else
+      for (; x < width; x++, src += 3)
+         dst[x] = src[2] | (src[1] << 8) | (src[0] << 16) | 0xFF000000u;
+}
+
+
+#ifdef BMP_X86
+
+// picks the 3 bytes of each of 4 pixels out of 16 and leaves room for alpha
+static const char SHUFFLE_BGRA[16] = { 0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1 };
+static const char SHUFFLE_RGBA[16] = { 2, 1, 0, -1, 5, 4, 3, -1, 8, 7, 6, -1, 11, 10, 9, -1 };
+
+
+BMP_TARGET("ssse3")
+static void convertRowSSSE3(const unsigned char * src, unsigned int * dst, int width, BmpOrder order)
+{
+   __m128i shuffle = _mm_loadu_si128((const __m128i *) (order == BMP_BGRA ? SHUFFLE_BGRA : SHUFFLE_RGBA));
+   __m128i alpha = _mm_set1_epi32((int) 0xFF000000u);
+   int x = 0;
+
+   // each load reads 16 bytes to use 12, so stop before it would run past the row
+   for (; (x + 4) * 3 + 4 <= width * 3; x += 4)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i *) (src + x * 3));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+      _mm_storeu_si128((__m128i *) (dst + x), v);
+   }
+   convertRowScalar(src, dst, x, width, order);
+}
+
+
+BMP_TARGET("avx2")
+static void convertRowAVX2(const unsigned char * src, unsigned int * dst, int width, BmpOrder order)
+{
+   const char * table = order == BMP_BGRA ? SHUFFLE_BGRA : SHUFFLE_RGBA;
+   __m128i half = _mm_loadu_si128((const __m128i *) table);
+   __m256i shuffle = _mm256_inserti128_si256(_mm256_castsi128_si256(half), half, 1);
+   __m256i spread = _mm256_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0);   // 12 bytes to each half
+   __m256i alpha = _mm256_set1_epi32((int) 0xFF000000u);
+   int x = 0;
+
+   // 8 pixels are 24 bytes of the 32 loaded
+   for (; (x + 8) * 3 + 8 <= width * 3; x += 8)
+   {
+      __m256i v = _mm256_loadu_si256((const __m256i *) (src + x * 3));
+      v = _mm256_permutevar8x32_epi32(v, spread);
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+      _mm256_storeu_si256((__m256i *) (dst + x), v);
+   }
+   // the rest 4 at a time here rather than calling convertRowSSSE3, whose
+   // non-VEX instructions would pay for the dirty upper halves
+   for (; (x + 4) * 3 + 4 <= width * 3; x += 4)
+   {
+      __m128i v = _mm_loadu_si128((const __m128i *) (src + x * 3));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, half), _mm256_castsi256_si128(alpha));
+      _mm_storeu_si128((__m128i *) (dst + x), v);
+   }
+   _mm256_zeroupper();
+   convertRowScalar(src, dst, x, width, order);
+}
+
+
+static BmpSimd detectSimd()
+{
+#if defined(__GNUC__) || defined(__clang__)
+   __builtin_cpu_init();
+   if (__builtin_cpu_supports("avx2"))
+      return BMP_AVX2;
+   if (__builtin_cpu_supports("ssse3"))
+      return BMP_SSSE3;
+#else
+   int regs[4];
+   __cpuid(regs, 0);
+   int maxLeaf = regs[0];
+   __cpuid(regs, 1);
+   bool ssse3 = (regs[2] & (1 << 9)) != 0;
+   bool osAvx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) &&   // OSXSAVE, AVX..
+                (_xgetbv(0) & 6) == 6;                              // .. and the OS saves ymm
+   if (osAvx && maxLeaf >= 7)
+   {
+      __cpuidex(regs, 7, 0);
+      if (regs[1] & (1 << 5))
+         return BMP_AVX2;
+   }
+   if (ssse3)
+      return BMP_SSSE3;
+#endif
+   return BMP_SCALAR;
+}
+
+#else
+
+static BmpSimd detectSimd()
+{
+   return BMP_SCALAR;
+}
+
+#endif
+
+
+BmpSimd bestBmpSimd()
+{
+   static const BmpSimd best = detectSimd();
+   return best;
+}
+
+
+void convertBmp(const BmpInfo & info, const void * file, void * dst, int dstPitch,
+                BmpOrder order, BmpSimd simd)
+{
+   const unsigned char * bits = (const unsigned char *) file + info.bitsOffset;
+   int y;
+
+   if (simd == BMP_BEST || simd > bestBmpSimd())
+      simd = bestBmpSimd();
+
+   for (y = 0; y < info.height; y++)
+   {
+      const unsigned char * src = bits + (size_t) info.rowBytes * (info.bottomUp ? info.height - 1 - y : y);
+      unsigned int * row = (unsigned int *) ((unsigned char *) dst + (ptrdiff_t) dstPitch * y);
+
+      switch (simd)
+      {
+#ifdef BMP_X86
+      case BMP_AVX2:
+         convertRowAVX2(src, row, info.width, order);
+         break;
+      case BMP_SSSE3:
+         convertRowSSSE3(src, row, info.width, order);
+         break;
+#endif
+      default:
+         convertRowScalar(src, row, 0, info.width, order);
+         break;
+      }
+   }
+}
+
+
+bool BmpFile::open(const char * filename)
+{
+   if (!m_file.open(filename))
+      return false;
+   if (!readBmpInfo(m_file.data(), m_file.size(), m_info))
+   {
+      m_file.close();
+      return false;
+   }
+   return true;
+}
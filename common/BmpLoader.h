@@ -0,0 +1,75 @@
+/* Filename:  BmpLoader.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Reads the uncompressed 24 bit Windows bitmaps all the examples use for
+   textures, without going through D3DX.  The file is mapped into memory
+   rather than read, and the bottom up BGR rows are turned into top down
+   32 bit pixels straight into memory the caller hands over, normally a
+   locked texture, so the pixels are only copied once.
+
+   The conversion does 4 pixels at a time with an SSSE3 shuffle, or 8 with
+   AVX2, whichever the processor has; that is checked once at run time, so
+   the same exe works everywhere.
+*/
+
+#ifndef BMPLOADER_H
+#define BMPLOADER_H
+
+#include <stddef.h>
+#include "MappedFile.h"
+
+
+enum BmpOrder
+{
+   BMP_BGRA,   // bytes in memory.. same as D3DFMT_X8R8G8B8 and A8R8G8B8
+   BMP_RGBA    // same as D3DFMT_A8B8G8R8 or GL_RGBA
+};
+
+enum BmpSimd
+{
+   BMP_SCALAR,
+   BMP_SSSE3,
+   BMP_AVX2,
+   BMP_BEST    // the best one this processor has
+};
+
+struct BmpInfo
+{
+   int width, height;
+   bool bottomUp;              // rows stored last one first, as most bitmaps are
+   unsigned int bitsOffset;    // from the start of the file
+   unsigned int rowBytes;      // width * 3 padded to 4
+};
+
+// checks the headers.. false unless it is an uncompressed 24 bit bitmap
+// whose pixels all fit in the bytes given
+bool readBmpInfo(const void * file, size_t bytes, BmpInfo & info);
+
+// the whole image, first row at the top, alpha 255.. dst holds
+// info.height rows of dstPitch bytes, at least info.width * 4 each
+void convertBmp(const BmpInfo & info, const void * file, void * dst, int dstPitch,
+                BmpOrder order = BMP_BGRA, BmpSimd simd = BMP_BEST);
+
+BmpSimd bestBmpSimd();
+
+
+// a bitmap file mapped into memory and checked, ready to be converted
+class BmpFile
+{
+public:
+   bool open(const char * filename);   // false if it can't be read or isn't 24 bit
+   void close() { m_file.close(); }
+
+   const BmpInfo & info() const { return m_info; }
+   void convert(void * dst, int dstPitch, BmpOrder order = BMP_BGRA, BmpSimd simd = BMP_BEST) const
+   {
+      convertBmp(m_info, m_file.data(), dst, dstPitch, order, simd);
+   }
+
+private:
+   MappedFile m_file;
+   BmpInfo m_info;
+};
+
+#endif
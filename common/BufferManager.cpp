@@ -0,0 +1,343 @@
+/* Filename:  BufferManager.cpp
+
+   This file accompanies BufferManager.h.
+*/
+
+#include "BufferManager.h"
+
+struct BufferEntry
+{
+   std::string name;
+   std::atomic<long> refs;
+   LPDIRECT3DDEVICE9 device;
+   std::vector<unsigned char> data;   // what the buffer is made from
+   bool index;                        // index buffer or vertex buffer..
+   DWORD format;                      // .. so this is a D3DFORMAT or an FVF
+   DWORD usage;
+   LPDIRECT3DVERTEXBUFFER9 vb;        // NULL until first used
+   LPDIRECT3DINDEXBUFFER9 ib;
+};
+
+// render states the examples change.. these go back after a Reset
+static const D3DRENDERSTATETYPE SAVED_RENDER_STATES[] =
+{
+   D3DRS_ZENABLE, D3DRS_ZWRITEENABLE, D3DRS_CULLMODE, D3DRS_LIGHTING, D3DRS_AMBIENT,
+   D3DRS_DITHERENABLE, D3DRS_SPECULARENABLE, D3DRS_ALPHABLENDENABLE,
+   D3DRS_SRCBLEND, D3DRS_DESTBLEND
+};
+
+static const D3DSAMPLERSTATETYPE SAVED_SAMPLER_STATES[] =
+{
+   D3DSAMP_MAGFILTER, D3DSAMP_MINFILTER, D3DSAMP_MIPFILTER, D3DSAMP_ADDRESSU, D3DSAMP_ADDRESSV
+};
+
+#define SAVED_STAGES 2
+#define NUM_RENDER_STATES (sizeof(SAVED_RENDER_STATES) / sizeof(SAVED_RENDER_STATES[0]))
+#define NUM_SAMPLER_STATES (sizeof(SAVED_SAMPLER_STATES) / sizeof(SAVED_SAMPLER_STATES[0]))
+
+
+BufferRef::BufferRef()
+{
+   m_entry = NULL;
+}
+
+
+BufferRef::BufferRef(BufferEntry * entry)
+{
+   m_entry = entry;
+}
+
+
+BufferRef::BufferRef(const BufferRef & other)
+{
+   m_entry = other.m_entry;
+   if (m_entry)
+      m_entry->refs++;
+}
+
+
+BufferRef::~BufferRef()
+{
+   reset();
+}
+
+
+BufferRef & BufferRef::operator=(const BufferRef & other)
+{
+   if (other.m_entry)   // add first in case it is the same buffer
+      other.m_entry->refs++;
+   reset();
+   m_entry = other.m_entry;
+   return *this;
+}
+
+
+void BufferRef::reset()
+{
+   if (m_entry)
+      BufferManager::instance().release(m_entry);
+   m_entry = NULL;
+}
+
+
+LPDIRECT3DVERTEXBUFFER9 BufferRef::vertexBuffer()
+{
+   if (m_entry == NULL || m_entry->index)
+      return NULL;
+   if (m_entry->vb == NULL)
+      BufferManager::instance().create(m_entry);
+   return m_entry->vb;
+}
+
+
+LPDIRECT3DINDEXBUFFER9 BufferRef::indexBuffer()
+{
+   if (m_entry == NULL || !m_entry->index)
+      return NULL;
+   if (m_entry->ib == NULL)
+      BufferManager::instance().create(m_entry);
+   return m_entry->ib;
+}
+
+
+UINT BufferRef::size() const
+{
+   return m_entry ? (UINT) m_entry->data.size() : 0;
+}
+
+
+void * BufferRef::data()
+{
+   return (m_entry && !m_entry->data.empty()) ? &m_entry->data[0] : NULL;
+}
+
+
+bool BufferRef::upload()
+{
+   void * ptr;
+   HRESULT hr;
+   DWORD flags;
+
+   if (m_entry == NULL)
+      return false;
+   if (m_entry->vb == NULL && m_entry->ib == NULL)
+      return true;   // nothing made yet.. it will get the new data when it is
+
+   flags = (m_entry->usage & D3DUSAGE_DYNAMIC) ? D3DLOCK_DISCARD : 0;
+   if (m_entry->index)
+      hr = m_entry->ib->Lock(0, size(), &ptr, flags);
+   else
+      hr = m_entry->vb->Lock(0, size(), &ptr, flags);
+   if (FAILED(hr))
+      return false;
+
+   memcpy(ptr, data(), size());
+   if (m_entry->index)
+      m_entry->ib->Unlock();
+   else
+      m_entry->vb->Unlock();
+   return true;
+}
+
+
+BufferManager & BufferManager::instance()
+{
+   static BufferManager manager;
+   return manager;
+}
+
+
+BufferRef BufferManager::acquireVertices(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                                         UINT bytes, DWORD fvf, DWORD usage)
+{
+   return acquire(dev, name, data, bytes, false, fvf, usage);
+}
+
+
+BufferRef BufferManager::acquireIndices(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                                        UINT bytes, D3DFORMAT format, DWORD usage)
+{
+   return acquire(dev, name, data, bytes, true, format, usage);
+}
+
+
+BufferRef BufferManager::find(const char * name)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   std::map<std::string, BufferEntry *>::iterator it = m_entries.find(name);
+
+   if (it == m_entries.end())
+      return BufferRef();
+   it->second->refs++;
+   return BufferRef(it->second);
+}
+
+
+BufferRef BufferManager::acquire(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                                 UINT bytes, bool index, DWORD format, DWORD usage)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   std::map<std::string, BufferEntry *>::iterator it = m_entries.find(name);
+
+   if (it != m_entries.end())
+   {  // somebody already made it.. share
+      it->second->refs++;
+      return BufferRef(it->second);
+   }
+
+   BufferEntry * entry = new BufferEntry;
+   entry->name = name;
+   entry->refs = 1;
+   entry->device = dev;
+   entry->index = index;
+   entry->format = format;
+   entry->usage = usage;
+   entry->vb = NULL;
+   entry->ib = NULL;
+   if (data)
+      entry->data.assign((const unsigned char *) data, (const unsigned char *) data + bytes);
+   else
+      entry->data.assign(bytes, 0);
+
+   m_entries[entry->name] = entry;
+   return BufferRef(entry);
+}
+
+
+void BufferManager::release(BufferEntry * entry)
+{
+   long n = entry->refs;
+
+   // while other references are left just count down without locking..
+   while (n > 1)
+      if (entry->refs.compare_exchange_weak(n, n - 1))
+         return;
+
+   // .. the last one is only let go while holding the lock, since that is
+   // when find() and acquire() hand out new references
+   std::lock_guard<std::mutex> guard(m_lock);
+   if (--entry->refs > 0)
+      return;
+
+   m_entries.erase(entry->name);
+   if (entry->vb)
+      entry->vb->Release();
+   if (entry->ib)
+      entry->ib->Release();
+   delete entry;
+}
+
+
+bool BufferManager::create(BufferEntry * entry)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   void * ptr;
+   UINT bytes = (UINT) entry->data.size();
+
+   if (entry->vb || entry->ib)
+      return true;   // made while we waited for the lock
+
+   if (entry->index)
+   {
+      if (FAILED(entry->device->CreateIndexBuffer(bytes, entry->usage, (D3DFORMAT) entry->format,
+                                                  D3DPOOL_DEFAULT, &entry->ib, NULL)))
+      {
+         entry->ib = NULL;
+         return false;
+      }
+      if (SUCCEEDED(entry->ib->Lock(0, bytes, &ptr, 0)))
+      {
+         memcpy(ptr, &entry->data[0], bytes);
+         entry->ib->Unlock();
+      }
+   }
+   else
+   {
+      if (FAILED(entry->device->CreateVertexBuffer(bytes, entry->usage, entry->format,
+                                                   D3DPOOL_DEFAULT, &entry->vb, NULL)))
+      {
+         entry->vb = NULL;
+         return false;
+      }
+      if (SUCCEEDED(entry->vb->Lock(0, bytes, &ptr, 0)))
+      {
+         memcpy(ptr, &entry->data[0], bytes);
+         entry->vb->Unlock();
+      }
+   }
+   return true;
+}
+
+
+void BufferManager::onLostDevice()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   std::map<std::string, BufferEntry *>::iterator it;
+
+   for (it = m_entries.begin(); it != m_entries.end(); ++it)
+   {
+      BufferEntry * entry = it->second;
+      if (entry->vb)
+         entry->vb->Release();
+      if (entry->ib)
+         entry->ib->Release();
+      entry->vb = NULL;
+      entry->ib = NULL;
+   }
+}
+
+
+UINT BufferManager::residentBytes()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   std::map<std::string, BufferEntry *>::iterator it;
+   UINT total = 0;
+
+   for (it = m_entries.begin(); it != m_entries.end(); ++it)
+      if (it->second->vb || it->second->ib)
+         total += (UINT) it->second->data.size();
+   return total;
+}
+
+
+bool BufferManager::restoreDevice(LPDIRECT3DDEVICE9 dev, D3DPRESENT_PARAMETERS & pp, LPD3DXFONT font)
+{
+   DWORD renderStates[NUM_RENDER_STATES];
+   DWORD samplerStates[SAVED_STAGES][NUM_SAMPLER_STATES];
+   D3DMATRIX view, projection;
+   HRESULT hr = dev->TestCooperativeLevel();
+   unsigned int i, s;
+
+   if (hr == D3DERR_DEVICELOST)   // still lost.. nothing can be done until we get it back
+      return false;
+   if (hr != D3DERR_DEVICENOTRESET)
+      return SUCCEEDED(hr);
+
+   // Reset puts every state back to its default, so remember the ones we use
+   for (i = 0; i < NUM_RENDER_STATES; i++)
+      dev->GetRenderState(SAVED_RENDER_STATES[i], &renderStates[i]);
+   for (s = 0; s < SAVED_STAGES; s++)
+      for (i = 0; i < NUM_SAMPLER_STATES; i++)
+         dev->GetSamplerState(s, SAVED_SAMPLER_STATES[i], &samplerStates[s][i]);
+   dev->GetTransform(D3DTS_VIEW, &view);
+   dev->GetTransform(D3DTS_PROJECTION, &projection);
+
+   // everything in D3DPOOL_DEFAULT has to be released before Reset will work
+   if (font)
+      font->OnLostDevice();
+   onLostDevice();
+
+   if (FAILED(dev->Reset(&pp)))
+      return false;
+
+   if (font)
+      font->OnResetDevice();
+   for (i = 0; i < NUM_RENDER_STATES; i++)
+      dev->SetRenderState(SAVED_RENDER_STATES[i], renderStates[i]);
+   for (s = 0; s < SAVED_STAGES; s++)
+      for (i = 0; i < NUM_SAMPLER_STATES; i++)
+         dev->SetSamplerState(s, SAVED_SAMPLER_STATES[i], samplerStates[s][i]);
+   dev->SetTransform(D3DTS_VIEW, &view);
+   dev->SetTransform(D3DTS_PROJECTION, &projection);
+   return true;
+}
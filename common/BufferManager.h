@@ -0,0 +1,94 @@
+/* Filename:  BufferManager.h
+
+   This file is shared by the numbered examples.
+
+   Keeps every vertex and index buffer the examples use, together with a
+   copy of the data that went into it.  Objects ask for a buffer by name
+   and get a BufferRef back; objects asking for the same name share one
+   buffer (like all the Rect3D2 cubes do) and the buffer goes away when
+   the last BufferRef does.  The count is atomic, so refs can be made and
+   copied on a loader thread.
+
+   The D3D buffer itself isn't made until vertexBuffer() or indexBuffer()
+   is called, which should be on the thread that owns the device.  Because
+   all of them live in D3DPOOL_DEFAULT they are lost along with the device
+   (alt-tab out of full screen).  restoreDevice() notices that, lets go of
+   them, resets the device and puts the render and sampler states and the
+   view and projection back (a Camera only sets them when they change);
+   the buffers are made again from the saved data the next time they are
+   used.
+*/
+
+#ifndef BUFFERMANAGER_H
+#define BUFFERMANAGER_H
+
+#include <d3dx9.h>
+#include <atomic>
+#include <mutex>
+#include <map>
+#include <string>
+#include <vector>
+
+struct BufferEntry;
+
+
+class BufferRef
+{
+public:
+   BufferRef();
+   BufferRef(const BufferRef & other);
+   ~BufferRef();
+   BufferRef & operator=(const BufferRef & other);
+
+   bool valid() const { return m_entry != NULL; }
+   void reset();   // drops this reference
+
+   LPDIRECT3DVERTEXBUFFER9 vertexBuffer();   // made on first use..
+   LPDIRECT3DINDEXBUFFER9 indexBuffer();     // .. NULL if it couldn't be
+   UINT size() const;                        // in bytes
+
+   // the saved copy of the data.. change it, then upload() to update the
+   // D3D buffer too (and so the change survives a lost device)
+   void * data();
+   bool upload();
+
+private:
+   friend class BufferManager;
+   explicit BufferRef(BufferEntry * entry);   // takes over one reference
+   BufferEntry * m_entry;
+};
+
+
+class BufferManager
+{
+public:
+   static BufferManager & instance();
+
+   // returns the buffer called name, making it from data if there isn't one yet..
+   // usage is the D3DUSAGE flags, data can be NULL to start with zeros
+   BufferRef acquireVertices(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                             UINT bytes, DWORD fvf, DWORD usage = D3DUSAGE_WRITEONLY);
+   BufferRef acquireIndices(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                            UINT bytes, D3DFORMAT format, DWORD usage = D3DUSAGE_WRITEONLY);
+   BufferRef find(const char * name);   // not valid() if there is no such buffer
+
+   void onLostDevice();    // releases every D3D buffer but keeps the data
+   UINT residentBytes();   // bytes of buffers that are on the device right now
+
+   // call once a frame before drawing.. returns false while the device is
+   // lost and nothing should be drawn
+   bool restoreDevice(LPDIRECT3DDEVICE9 dev, D3DPRESENT_PARAMETERS & pp, LPD3DXFONT font);
+
+private:
+   friend class BufferRef;
+   BufferManager() {}
+   BufferRef acquire(LPDIRECT3DDEVICE9 dev, const char * name, const void * data,
+                     UINT bytes, bool index, DWORD format, DWORD usage);
+   void release(BufferEntry * entry);
+   bool create(BufferEntry * entry);
+
+   std::mutex m_lock;
+   std::map<std::string, BufferEntry *> m_entries;
+};
+
+#endif
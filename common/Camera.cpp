@@ -0,0 +1,150 @@
+/* Filename:  Camera.cpp
+
+   This file accompanies Camera.h.
+*/
+
+#include "Camera.h"
+
+
+static bool sameVec3(const Vec3 & a, const Vec3 & b)
+{
+   return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+
+Camera::Camera()
+   : m_eye(0.0f, 0.0f, -1.0f), m_at(0.0f, 0.0f, 0.0f), m_up(0.0f, 1.0f, 0.0f),
+     m_fovy(3.141592654f / 4), m_aspect(1.3333f), m_zn(1.0f), m_zf(100.0f),
+     m_jitterX(0.0f), m_jitterY(0.0f), m_reversedZ(false), m_infiniteFar(false),
+     m_dirty(VIEW_CHANGED | PROJECTION_CHANGED)
+{
+   m_view = m_projection = m_viewProj = mat4Identity();
+   m_inverseView = m_inverseProjection = m_inverseViewProj = mat4Identity();
+}
+
+
+void Camera::lookAt(const Vec3 & eye, const Vec3 & at, const Vec3 & up)
+{
+   if (sameVec3(eye, m_eye) && sameVec3(at, m_at) && sameVec3(up, m_up))
+      return;
+   m_eye = eye;
+   m_at = at;
+   m_up = up;
+   m_dirty |= VIEW_CHANGED;
+}
+
+
+void Camera::perspective(float fovy, float aspect, float zn, float zf)
+{
+   if (fovy == m_fovy && aspect == m_aspect && zn == m_zn && zf == m_zf)
+      return;
+   m_fovy = fovy;
+   m_aspect = aspect;
+   m_zn = zn;
+   m_zf = zf;
+   m_dirty |= PROJECTION_CHANGED;
+}
+
+
+void Camera::setReversedZ(bool reversed)
+{
+   if (reversed != m_reversedZ)
+   {
+      m_reversedZ = reversed;
+      m_dirty |= PROJECTION_CHANGED;
+   }
+}
+
+
+void Camera::setInfiniteFar(bool infinite)
+{
+   if (infinite != m_infiniteFar)
+   {
+      m_infiniteFar = infinite;
+      m_dirty |= PROJECTION_CHANGED;
+   }
+}
+
+
+void Camera::setJitter(float x, float y, unsigned int width, unsigned int height)
+{
+   // clip space y goes up, pixels go down
+   float jx = 2.0f * x / (float) width, jy = -2.0f * y / (float) height;
+   if (jx == m_jitterX && jy == m_jitterY)
+      return;
+   m_jitterX = jx;
+   m_jitterY = jy;
+   m_dirty |= PROJECTION_CHANGED;
+}
+
+
+Mat4 Camera::makeProjection(float fovy, float aspect, float zn, float zf, bool reversedZ, bool infiniteFar,
+                            float jitterX, float jitterY)
+{
+   float ys = 1.0f / tanf(fovy / 2), q, r;
+
+   // z comes out as (q * view z + r) / view z
+   if (infiniteFar)
+   {
+      q = reversedZ ? 0.0f : 1.0f;
+      r = reversedZ ? zn : -zn;
+   }
+   else if (reversedZ)
+   {
+      q = zn / (zn - zf);
+      r = zn * zf / (zf - zn);
+   }
+   else
+   {
+      q = zf / (zf - zn);   // D3DXMatrixPerspectiveFovLH
+      r = -zn * zf / (zf - zn);
+   }
+
+   // the jitter is added to x and y once they are divided by w
+   return Mat4(ys / aspect, 0, 0, 0,  0, ys, 0, 0,  jitterX, jitterY, q, 1,  0, 0, r, 0);
+}
+
+
+unsigned int Camera::update()
+{
+   unsigned int changed = m_dirty;
+   int i, j;
+
+   if (changed & VIEW_CHANGED)
+   {
+      m_view = mat4LookAtLH(m_eye, m_at, m_up);
+
+      // the view only turns and moves, so its inverse is the turn the other
+      // way (the transpose) and the eye
+      m_inverseView = mat4Identity();
+      for (i = 0; i < 3; i++)
+         for (j = 0; j < 3; j++)
+            m_inverseView.m[i * 4 + j] = m_view.m[j * 4 + i];
+      m_inverseView.m[12] = m_eye.x;
+      m_inverseView.m[13] = m_eye.y;
+      m_inverseView.m[14] = m_eye.z;
+   }
+
+   if (changed & PROJECTION_CHANGED)
+   {
+      Mat4 & p = m_projection;
+      p = makeProjection(m_fovy, m_aspect, m_zn, m_zf, m_reversedZ, m_infiniteFar, m_jitterX, m_jitterY);
+
+      // written out: x and y scaled back and the jitter taken off, view z
+      // from w, and w from z
+      float xs = p.m[0], ys = p.m[5], q = p.m[10], r = p.m[14];
+      m_inverseProjection = Mat4(1.0f / xs, 0, 0, 0,
+                                 0, 1.0f / ys, 0, 0,
+                                 0, 0, 0, 1.0f / r,
+                                 -m_jitterX / xs, -m_jitterY / ys, 1.0f, -q / r);
+   }
+
+   if (changed)
+   {
+      mat4Multiply(m_viewProj, m_view, m_projection);
+      mat4Multiply(m_inverseViewProj, m_inverseProjection, m_inverseView);
+      m_frustum.extract(m_viewProj);
+   }
+   m_dirty = 0;
+   return changed;
+}
@@ -0,0 +1,81 @@
+/* Filename:  Camera.h
+
+   This file is shared by the numbered examples and the tools.
+
+   The view and projection matrices, kept from one frame to the next
+   instead of being built again in every doMath().  lookAt() and
+   perspective() take what D3DXMatrixLookAtLH and PerspectiveFovLH take
+   and only mark something changed if it did; update() then builds just
+   the matrices that need it, with the view * projection, the inverses
+   of all three and the Frustum planes after them, and says which of view
+   and projection are new so SetTransform is only called for those.
+   Nothing changed, nothing is done.
+
+   Besides the D3DX projection there are three kinds the software device
+   and the benches can use.  Reversed z puts the near plane at 1 and the
+   far one at 0, which spreads a float depth buffer's precision out over
+   the distance instead of piling it up close (the depth test becomes
+   D3DCMP_GREATER and the buffer is cleared to 0).  An infinite far plane
+   never clips anything for being too far away.  Jitter moves the whole
+   image a fraction of a pixel, a different one each frame, for
+   antialiasing by averaging frames.  The Frustum comes out right for all
+   of them, but OcclusionBuffer wants z growing with distance, so give it
+   a camera without reversed z.
+*/
+
+#ifndef CAMERA_H
+#define CAMERA_H
+
+#include "VecMath.h"
+#include "Cull.h"
+
+
+class Camera
+{
+public:
+   enum { VIEW_CHANGED = 1, PROJECTION_CHANGED = 2 };   // update()'s bits
+
+   Camera();
+
+   void lookAt(const Vec3 & eye, const Vec3 & at, const Vec3 & up);
+   void perspective(float fovy, float aspect, float zn, float zf);   // zf is ignored with an infinite far plane
+   void setReversedZ(bool reversed);
+   void setInfiniteFar(bool infinite);
+   // moves the image x, y pixels (right and down) in a width x height viewport..
+   // setJitter(0, 0, 1, 1) for none
+   void setJitter(float x, float y, unsigned int width, unsigned int height);
+
+   // builds what changed since the last update, and returns which it was
+   unsigned int update();
+
+   // as of the last update()
+   const Mat4 & view() const { return m_view; }
+   const Mat4 & projection() const { return m_projection; }
+   const Mat4 & viewProj() const { return m_viewProj; }
+   const Mat4 & inverseView() const { return m_inverseView; }
+   const Mat4 & inverseProjection() const { return m_inverseProjection; }
+   const Mat4 & inverseViewProj() const { return m_inverseViewProj; }
+   const Frustum & frustum() const { return m_frustum; }
+
+   const Vec3 & eye() const { return m_eye; }
+   bool reversedZ() const { return m_reversedZ; }
+   bool infiniteFar() const { return m_infiniteFar; }
+
+   // the projection on its own.. jitterX and jitterY are in clip space
+   // (2 / width is one pixel)
+   static Mat4 makeProjection(float fovy, float aspect, float zn, float zf, bool reversedZ, bool infiniteFar,
+                              float jitterX = 0.0f, float jitterY = 0.0f);
+
+private:
+   Vec3 m_eye, m_at, m_up;
+   float m_fovy, m_aspect, m_zn, m_zf;
+   float m_jitterX, m_jitterY;   // clip space
+   bool m_reversedZ, m_infiniteFar;
+   unsigned int m_dirty;
+
+   Mat4 m_view, m_projection, m_viewProj;
+   Mat4 m_inverseView, m_inverseProjection, m_inverseViewProj;
+   Frustum m_frustum;
+};
+
+#endif
@@ -0,0 +1,1277 @@
+/* Filename:  CountingDevice.cpp
+
+   This file accompanies CountingDevice.h.
+*/
+
+#include "CountingDevice.h"
+#include <stdio.h>
+#include <string.h>
+
+
+//*******
+// the buffers.. only Lock is counted, the rest is passed on
+
+CountingVertexBuffer::CountingVertexBuffer(CountingDevice * device, IDirect3DVertexBuffer9 * buffer,
+                                           UINT bytes, unsigned int id)
+   : m_device(device), m_buffer(buffer), m_bytes(bytes), m_id(id), m_refs(1), m_lockData(NULL),
+     m_lockOffset(0), m_lockBytes(0)
+{
+   m_device->AddRef();   // as a D3D resource does.. the device lasts until its buffers are gone
+}
+
+
+CountingVertexBuffer::~CountingVertexBuffer()
+{
+   for (int i = 0; i < CountingDevice::STREAMS; i++)
+      if (m_device->m_streams[i] == this)
+         m_device->m_streams[i] = NULL;
+   m_device->released(m_id);
+   m_buffer->Release();
+   m_device->Release();
+}
+
+
+STDMETHODIMP_(ULONG) CountingVertexBuffer::AddRef()
+{
+   return ++m_refs;
+}
+
+
+STDMETHODIMP_(ULONG) CountingVertexBuffer::Release()
+{
+   ULONG refs = --m_refs;
+
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+// a size of 0 is the whole buffer from offset on
+static UINT lockSize(UINT size, UINT offset, UINT bytes)
+{
+   if (bytes)
+      return bytes;
+   return offset < size ? size - offset : 0;
+}
+
+
+STDMETHODIMP CountingVertexBuffer::Lock(UINT offset, UINT bytes, void ** data, DWORD flags)
+{
+   HRESULT hr = m_buffer->Lock(offset, bytes, data, flags);
+
+   if (SUCCEEDED(hr))
+   {
+      m_lockBytes = lockSize(m_bytes, offset, bytes);
+      m_lockOffset = offset;
+      m_lockData = (flags & D3DLOCK_READONLY) ? NULL : *data;
+      m_device->locked(m_id, false, m_lockBytes);
+   }
+   return hr;
+}
+
+
+STDMETHODIMP CountingVertexBuffer::Unlock()
+{
+   if (m_lockData)
+      m_device->unlocked(m_id, m_lockOffset, m_lockBytes, m_lockData);
+   m_lockData = NULL;
+   return m_buffer->Unlock();
+}
+
+
+CountingIndexBuffer::CountingIndexBuffer(CountingDevice * device, IDirect3DIndexBuffer9 * buffer,
+                                         UINT bytes, unsigned int id)
+   : m_device(device), m_buffer(buffer), m_bytes(bytes), m_id(id), m_refs(1), m_lockData(NULL),
+     m_lockOffset(0), m_lockBytes(0)
+{
+   m_device->AddRef();
+}
+
+
+CountingIndexBuffer::~CountingIndexBuffer()
+{
+   if (m_device->m_indices == this)
+      m_device->m_indices = NULL;
+   m_device->released(m_id);
+   m_buffer->Release();
+   m_device->Release();
+}
+
+
+STDMETHODIMP_(ULONG) CountingIndexBuffer::AddRef()
+{
+   return ++m_refs;
+}
+
+
+STDMETHODIMP_(ULONG) CountingIndexBuffer::Release()
+{
+   ULONG refs = --m_refs;
+
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+STDMETHODIMP CountingIndexBuffer::Lock(UINT offset, UINT bytes, void ** data, DWORD flags)
+{
+   HRESULT hr = m_buffer->Lock(offset, bytes, data, flags);
+
+   if (SUCCEEDED(hr))
+   {
+      m_lockBytes = lockSize(m_bytes, offset, bytes);
+      m_lockOffset = offset;
+      m_lockData = (flags & D3DLOCK_READONLY) ? NULL : *data;
+      m_device->locked(m_id, true, m_lockBytes);
+   }
+   return hr;
+}
+
+
+STDMETHODIMP CountingIndexBuffer::Unlock()
+{
+   if (m_lockData)
+      m_device->unlocked(m_id, m_lockOffset, m_lockBytes, m_lockData);
+   m_lockData = NULL;
+   return m_buffer->Unlock();
+}
+
+
+#ifdef _WIN32
+STDMETHODIMP CountingVertexBuffer::QueryInterface(REFIID riid, void ** object)
+{
+   if (riid == IID_IUnknown || riid == IID_IDirect3DResource9 || riid == IID_IDirect3DVertexBuffer9)
+   {
+      *object = this;
+      AddRef();
+      return S_OK;
+   }
+   return m_buffer->QueryInterface(riid, object);
+}
+
+STDMETHODIMP CountingVertexBuffer::GetDevice(IDirect3DDevice9 ** device)
+{
+   if (device == NULL)
+      return D3DERR_INVALIDCALL;
+   *device = m_device;
+   m_device->AddRef();
+   return D3D_OK;
+}
+
+STDMETHODIMP CountingVertexBuffer::SetPrivateData(REFGUID guid, const void * data, DWORD size, DWORD flags)
+{
+   return m_buffer->SetPrivateData(guid, data, size, flags);
+}
+
+STDMETHODIMP CountingVertexBuffer::GetPrivateData(REFGUID guid, void * data, DWORD * size)
+{
+   return m_buffer->GetPrivateData(guid, data, size);
+}
+
+STDMETHODIMP CountingVertexBuffer::FreePrivateData(REFGUID guid)
+{
+   return m_buffer->FreePrivateData(guid);
+}
+
+STDMETHODIMP_(DWORD) CountingVertexBuffer::SetPriority(DWORD priority)
+{
+   return m_buffer->SetPriority(priority);
+}
+
+STDMETHODIMP_(DWORD) CountingVertexBuffer::GetPriority()
+{
+   return m_buffer->GetPriority();
+}
+
+STDMETHODIMP_(void) CountingVertexBuffer::PreLoad()
+{
+   m_buffer->PreLoad();
+}
+
+STDMETHODIMP_(D3DRESOURCETYPE) CountingVertexBuffer::GetType()
+{
+   return m_buffer->GetType();
+}
+
+STDMETHODIMP CountingVertexBuffer::GetDesc(D3DVERTEXBUFFER_DESC * desc)
+{
+   return m_buffer->GetDesc(desc);
+}
+
+
+STDMETHODIMP CountingIndexBuffer::QueryInterface(REFIID riid, void ** object)
+{
+   if (riid == IID_IUnknown || riid == IID_IDirect3DResource9 || riid == IID_IDirect3DIndexBuffer9)
+   {
+      *object = this;
+      AddRef();
+      return S_OK;
+   }
+   return m_buffer->QueryInterface(riid, object);
+}
+
+STDMETHODIMP CountingIndexBuffer::GetDevice(IDirect3DDevice9 ** device)
+{
+   if (device == NULL)
+      return D3DERR_INVALIDCALL;
+   *device = m_device;
+   m_device->AddRef();
+   return D3D_OK;
+}
+
+STDMETHODIMP CountingIndexBuffer::SetPrivateData(REFGUID guid, const void * data, DWORD size, DWORD flags)
+{
+   return m_buffer->SetPrivateData(guid, data, size, flags);
+}
+
+STDMETHODIMP CountingIndexBuffer::GetPrivateData(REFGUID guid, void * data, DWORD * size)
+{
+   return m_buffer->GetPrivateData(guid, data, size);
+}
+
+STDMETHODIMP CountingIndexBuffer::FreePrivateData(REFGUID guid)
+{
+   return m_buffer->FreePrivateData(guid);
+}
+
+STDMETHODIMP_(DWORD) CountingIndexBuffer::SetPriority(DWORD priority)
+{
+   return m_buffer->SetPriority(priority);
+}
+
+STDMETHODIMP_(DWORD) CountingIndexBuffer::GetPriority()
+{
+   return m_buffer->GetPriority();
+}
+
+STDMETHODIMP_(void) CountingIndexBuffer::PreLoad()
+{
+   m_buffer->PreLoad();
+}
+
+STDMETHODIMP_(D3DRESOURCETYPE) CountingIndexBuffer::GetType()
+{
+   return m_buffer->GetType();
+}
+
+STDMETHODIMP CountingIndexBuffer::GetDesc(D3DINDEXBUFFER_DESC * desc)
+{
+   return m_buffer->GetDesc(desc);
+}
+#endif
+
+
+//*******
+// the device
+
+CountingDevice::CountingDevice(IDirect3DDevice9 * device, unsigned int window)
+   : m_device(device), m_refs(1), m_nextBuffer(1), m_indices(NULL),
+     m_frames(window ? window : 1), m_next(0), m_count(0), m_frameNumber(0)
+{
+   for (int i = 0; i < STREAMS; i++)
+      m_streams[i] = NULL;
+   memset(m_current.calls, 0, sizeof(m_current.calls));
+   m_current.redundant = 0;
+   m_current.primitives = 0;
+   m_current.lockBytes = 0;
+   forgetStates();
+}
+
+
+CountingDevice::~CountingDevice()
+{
+   m_device->Release();
+}
+
+
+STDMETHODIMP_(ULONG) CountingDevice::AddRef()
+{
+   return ++m_refs;
+}
+
+
+STDMETHODIMP_(ULONG) CountingDevice::Release()
+{
+   ULONG refs = --m_refs;
+
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+// nothing set is known.. at the start of each frame, since a state block
+// (ID3DXSprite, behind DrawText, uses one) can put states back without
+// coming through here
+void CountingDevice::forgetStates()
+{
+   memset(m_renderKnown, 0, sizeof(m_renderKnown));
+   memset(m_stageKnown, 0, sizeof(m_stageKnown));
+   memset(m_samplerKnown, 0, sizeof(m_samplerKnown));
+}
+
+
+void CountingDevice::locked(unsigned int id, bool index, UINT bytes)
+{
+   m_current.calls[CALL_LOCK]++;
+   m_current.lockBytes += bytes;
+
+   if (id >= m_slots.size())
+      m_slots.resize(id + 1, 0);
+   if (m_slots[id] == 0)
+   {
+      BufferLocks b = { id, index, 0, 0 };
+      m_current.buffers.push_back(b);
+      m_slots[id] = (unsigned int) m_current.buffers.size();
+   }
+   BufferLocks & b = m_current.buffers[m_slots[id] - 1];
+   b.locks++;
+   b.bytes += bytes;
+}
+
+
+void CountingDevice::endFrame()
+{
+   DeviceFrame & f = m_frames[m_next];
+   size_t i;
+
+   for (i = 0; i < m_current.buffers.size(); i++)
+      m_slots[m_current.buffers[i].buffer] = 0;
+
+   // the ring's frames keep their buffer lists, so after the first lap
+   // finishing a frame doesn't allocate
+   memcpy(f.calls, m_current.calls, sizeof(f.calls));
+   f.redundant = m_current.redundant;
+   f.primitives = m_current.primitives;
+   f.lockBytes = m_current.lockBytes;
+   f.buffers.swap(m_current.buffers);
+
+   memset(m_current.calls, 0, sizeof(m_current.calls));
+   m_current.redundant = 0;
+   m_current.primitives = 0;
+   m_current.lockBytes = 0;
+   m_current.buffers.clear();
+
+   m_next = (m_next + 1) % (unsigned int) m_frames.size();
+   if (m_count < m_frames.size())
+      m_count++;
+   m_frameNumber++;
+   forgetStates();
+}
+
+
+const DeviceFrame & CountingDevice::frame(unsigned int i) const
+{
+   unsigned int oldest = m_count < m_frames.size() ? 0 : m_next;
+
+   return m_frames[(oldest + i) % m_frames.size()];
+}
+
+
+const char * CountingDevice::callName(DeviceCall call)
+{
+   static const char * names[DEVICE_CALLS] =
+   {
+      "render_state", "stage_state", "sampler_state", "texture", "transform", "lighting", "stream",
+      "draw", "draw_indexed", "clear", "lock", "create", "other"
+   };
+
+   return (unsigned int) call < DEVICE_CALLS ? names[call] : "";
+}
+
+
+void CountingDevice::summary(char * str, size_t size) const
+{
+   const DeviceFrame & f = m_count ? frame(m_count - 1) : m_current;
+   unsigned int states = f.calls[CALL_RENDER_STATE] + f.calls[CALL_STAGE_STATE] + f.calls[CALL_SAMPLER_STATE];
+
+   if (size == 0)
+      return;
+   snprintf(str, size, "draws %u  states %u (%u same)  prims %u  locked %.1f KB",
+            f.calls[CALL_DRAW] + f.calls[CALL_DRAW_INDEXED], states, f.redundant, f.primitives,
+            f.lockBytes / 1024.0f);
+   str[size - 1] = '\0';
+}
+
+
+bool CountingDevice::writeJson(const char * filename) const
+{
+   FILE * f = fopen(filename, "w");
+   unsigned int i, c;
+   size_t b;
+   bool ok;
+
+   if (f == NULL)
+      return false;
+   fprintf(f, "{\"frames\":[");
+   for (i = 0; i < m_count; i++)
+   {
+      const DeviceFrame & fr = frame(i);
+
+      fprintf(f, "%s\n{\"frame\":%u,\"calls\":{", i ? "," : "", m_frameNumber - m_count + i);
+      for (c = 0; c < DEVICE_CALLS; c++)
+         fprintf(f, "%s\"%s\":%u", c ? "," : "", callName((DeviceCall) c), fr.calls[c]);
+      fprintf(f, "},\"redundant\":%u,\"primitives\":%u,\"lock_bytes\":%u,\"buffers\":[",
+              fr.redundant, fr.primitives, fr.lockBytes);
+      for (b = 0; b < fr.buffers.size(); b++)
+         fprintf(f, "%s{\"buffer\":%u,\"type\":\"%s\",\"locks\":%u,\"bytes\":%u}", b ? "," : "",
+                 fr.buffers[b].buffer, fr.buffers[b].index ? "index" : "vertex", fr.buffers[b].locks,
+                 fr.buffers[b].bytes);
+      fprintf(f, "]}");
+   }
+   fprintf(f, "\n]}\n");
+   ok = ferror(f) == 0;
+   return fclose(f) == 0 && ok;
+}
+
+
+//*******
+// what is counted
+
+STDMETHODIMP CountingDevice::TestCooperativeLevel()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->TestCooperativeLevel();
+}
+
+
+STDMETHODIMP CountingDevice::Reset(D3DPRESENT_PARAMETERS * params)
+{
+   m_current.calls[CALL_OTHER]++;
+   forgetStates();
+   return m_device->Reset(params);
+}
+
+
+STDMETHODIMP CountingDevice::Present(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty)
+{
+   HRESULT hr;
+
+   m_current.calls[CALL_OTHER]++;
+   hr = m_device->Present(src, dst, window, dirty);
+   endFrame();
+   return hr;
+}
+
+
+STDMETHODIMP CountingDevice::CreateTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format,
+                                           D3DPOOL pool, IDirect3DTexture9 ** texture, HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateTexture(width, height, levels, usage, format, pool, texture, shared);
+}
+
+
+STDMETHODIMP CountingDevice::CreateVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                                IDirect3DVertexBuffer9 ** buffer, HANDLE * shared)
+{
+   IDirect3DVertexBuffer9 * real = NULL;
+   HRESULT hr;
+
+   m_current.calls[CALL_CREATE]++;
+   if (buffer == NULL)
+      return D3DERR_INVALIDCALL;
+   hr = m_device->CreateVertexBuffer(bytes, usage, fvf, pool, &real, shared);
+   *buffer = SUCCEEDED(hr) ? new CountingVertexBuffer(this, real, bytes, m_nextBuffer++) : NULL;
+   return hr;
+}
+
+
+STDMETHODIMP CountingDevice::CreateIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                               IDirect3DIndexBuffer9 ** buffer, HANDLE * shared)
+{
+   IDirect3DIndexBuffer9 * real = NULL;
+   HRESULT hr;
+
+   m_current.calls[CALL_CREATE]++;
+   if (buffer == NULL)
+      return D3DERR_INVALIDCALL;
+   hr = m_device->CreateIndexBuffer(bytes, usage, format, pool, &real, shared);
+   *buffer = SUCCEEDED(hr) ? new CountingIndexBuffer(this, real, bytes, m_nextBuffer++) : NULL;
+   return hr;
+}
+
+
+STDMETHODIMP CountingDevice::BeginScene()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->BeginScene();
+}
+
+
+STDMETHODIMP CountingDevice::EndScene()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->EndScene();
+}
+
+
+STDMETHODIMP CountingDevice::Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z,
+                                   DWORD stencil)
+{
+   m_current.calls[CALL_CLEAR]++;
+   return m_device->Clear(count, rects, flags, color, z, stencil);
+}
+
+
+STDMETHODIMP CountingDevice::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix)
+{
+   m_current.calls[CALL_TRANSFORM]++;
+   return m_device->SetTransform(state, matrix);
+}
+
+
+STDMETHODIMP CountingDevice::GetTransform(D3DTRANSFORMSTATETYPE state, D3DMATRIX * matrix)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetTransform(state, matrix);
+}
+
+
+STDMETHODIMP CountingDevice::SetMaterial(const D3DMATERIAL9 * material)
+{
+   m_current.calls[CALL_LIGHTING]++;
+   return m_device->SetMaterial(material);
+}
+
+
+STDMETHODIMP CountingDevice::SetLight(DWORD index, const D3DLIGHT9 * light)
+{
+   m_current.calls[CALL_LIGHTING]++;
+   return m_device->SetLight(index, light);
+}
+
+
+STDMETHODIMP CountingDevice::LightEnable(DWORD index, BOOL enable)
+{
+   m_current.calls[CALL_LIGHTING]++;
+   return m_device->LightEnable(index, enable);
+}
+
+
+STDMETHODIMP CountingDevice::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+   unsigned int s = (unsigned int) state;
+
+   m_current.calls[CALL_RENDER_STATE]++;
+   if (s < RENDER_STATES)
+   {
+      if ((m_renderKnown[s / 32] & (1u << (s % 32))) && m_renderStates[s] == value)
+         m_current.redundant++;
+      m_renderStates[s] = value;
+      m_renderKnown[s / 32] |= 1u << (s % 32);
+   }
+   return m_device->SetRenderState(state, value);
+}
+
+
+STDMETHODIMP CountingDevice::GetRenderState(D3DRENDERSTATETYPE state, DWORD * value)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetRenderState(state, value);
+}
+
+
+STDMETHODIMP CountingDevice::SetTexture(DWORD stage, IDirect3DBaseTexture9 * texture)
+{
+   m_current.calls[CALL_TEXTURE]++;
+   return m_device->SetTexture(stage, texture);
+}
+
+
+STDMETHODIMP CountingDevice::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+   unsigned int t = (unsigned int) type;
+
+   m_current.calls[CALL_STAGE_STATE]++;
+   if (stage < STAGES && t < STAGE_STATES)
+   {
+      if ((m_stageKnown[stage] & (1ull << t)) && m_stageStates[stage][t] == value)
+         m_current.redundant++;
+      m_stageStates[stage][t] = value;
+      m_stageKnown[stage] |= 1ull << t;
+   }
+   return m_device->SetTextureStageState(stage, type, value);
+}
+
+
+STDMETHODIMP CountingDevice::GetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD * value)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetTextureStageState(stage, type, value);
+}
+
+
+STDMETHODIMP CountingDevice::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+   unsigned int t = (unsigned int) type;
+
+   m_current.calls[CALL_SAMPLER_STATE]++;
+   if (sampler < STAGES && t < SAMPLER_STATES)   // not the displacement or vertex samplers
+   {
+      if ((m_samplerKnown[sampler] & (1u << t)) && m_samplerStates[sampler][t] == value)
+         m_current.redundant++;
+      m_samplerStates[sampler][t] = value;
+      m_samplerKnown[sampler] |= 1u << t;
+   }
+   return m_device->SetSamplerState(sampler, type, value);
+}
+
+
+STDMETHODIMP CountingDevice::GetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD * value)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetSamplerState(sampler, type, value);
+}
+
+
+STDMETHODIMP CountingDevice::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count)
+{
+   m_current.calls[CALL_DRAW]++;
+   m_current.primitives += count;
+   return m_device->DrawPrimitive(type, startVertex, count);
+}
+
+
+STDMETHODIMP CountingDevice::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                                  UINT numVertices, UINT startIndex, UINT count)
+{
+   m_current.calls[CALL_DRAW_INDEXED]++;
+   m_current.primitives += count;
+   return m_device->DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, count);
+}
+
+
+STDMETHODIMP CountingDevice::SetFVF(DWORD fvf)
+{
+   m_current.calls[CALL_STREAM]++;
+   return m_device->SetFVF(fvf);
+}
+
+
+// the buffers handed out are all wrapped ones, the real device gets what is inside
+STDMETHODIMP CountingDevice::SetStreamSource(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset,
+                                             UINT stride)
+{
+   CountingVertexBuffer * wrapped = static_cast<CountingVertexBuffer *>(buffer);
+
+   m_current.calls[CALL_STREAM]++;
+   if (stream < STREAMS)
+      m_streams[stream] = wrapped;   // not a reference.. a buffer takes itself out when it goes
+   return m_device->SetStreamSource(stream, wrapped ? wrapped->buffer() : NULL, offset, stride);
+}
+
+
+STDMETHODIMP CountingDevice::SetIndices(IDirect3DIndexBuffer9 * buffer)
+{
+   CountingIndexBuffer * wrapped = static_cast<CountingIndexBuffer *>(buffer);
+
+   m_current.calls[CALL_STREAM]++;
+   m_indices = wrapped;
+   return m_device->SetIndices(wrapped ? wrapped->buffer() : NULL);
+}
+
+
+#ifdef _WIN32
+//*******
+// the rest, straight through
+
+STDMETHODIMP CountingDevice::QueryInterface(REFIID riid, void ** object)
+{
+   if (riid == IID_IUnknown || riid == IID_IDirect3DDevice9)
+   {
+      *object = this;
+      AddRef();
+      return S_OK;
+   }
+   return m_device->QueryInterface(riid, object);
+}
+
+STDMETHODIMP_(UINT) CountingDevice::GetAvailableTextureMem()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetAvailableTextureMem();
+}
+
+STDMETHODIMP CountingDevice::EvictManagedResources()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->EvictManagedResources();
+}
+
+STDMETHODIMP CountingDevice::GetDirect3D(IDirect3D9 ** d3d)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetDirect3D(d3d);
+}
+
+STDMETHODIMP CountingDevice::GetDeviceCaps(D3DCAPS9 * caps)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetDeviceCaps(caps);
+}
+
+STDMETHODIMP CountingDevice::GetDisplayMode(UINT swapChain, D3DDISPLAYMODE * mode)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetDisplayMode(swapChain, mode);
+}
+
+STDMETHODIMP CountingDevice::GetCreationParameters(D3DDEVICE_CREATION_PARAMETERS * params)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetCreationParameters(params);
+}
+
+STDMETHODIMP CountingDevice::SetCursorProperties(UINT x, UINT y, IDirect3DSurface9 * bitmap)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetCursorProperties(x, y, bitmap);
+}
+
+STDMETHODIMP_(void) CountingDevice::SetCursorPosition(int x, int y, DWORD flags)
+{
+   m_current.calls[CALL_OTHER]++;
+   m_device->SetCursorPosition(x, y, flags);
+}
+
+STDMETHODIMP_(BOOL) CountingDevice::ShowCursor(BOOL show)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->ShowCursor(show);
+}
+
+STDMETHODIMP CountingDevice::CreateAdditionalSwapChain(D3DPRESENT_PARAMETERS * params,
+                                                       IDirect3DSwapChain9 ** swapChain)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateAdditionalSwapChain(params, swapChain);
+}
+
+STDMETHODIMP CountingDevice::GetSwapChain(UINT index, IDirect3DSwapChain9 ** swapChain)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetSwapChain(index, swapChain);
+}
+
+STDMETHODIMP_(UINT) CountingDevice::GetNumberOfSwapChains()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetNumberOfSwapChains();
+}
+
+STDMETHODIMP CountingDevice::GetBackBuffer(UINT swapChain, UINT index, D3DBACKBUFFER_TYPE type,
+                                           IDirect3DSurface9 ** surface)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetBackBuffer(swapChain, index, type, surface);
+}
+
+STDMETHODIMP CountingDevice::GetRasterStatus(UINT swapChain, D3DRASTER_STATUS * status)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetRasterStatus(swapChain, status);
+}
+
+STDMETHODIMP CountingDevice::SetDialogBoxMode(BOOL enable)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetDialogBoxMode(enable);
+}
+
+STDMETHODIMP_(void) CountingDevice::SetGammaRamp(UINT swapChain, DWORD flags, const D3DGAMMARAMP * ramp)
+{
+   m_current.calls[CALL_OTHER]++;
+   m_device->SetGammaRamp(swapChain, flags, ramp);
+}
+
+STDMETHODIMP_(void) CountingDevice::GetGammaRamp(UINT swapChain, D3DGAMMARAMP * ramp)
+{
+   m_current.calls[CALL_OTHER]++;
+   m_device->GetGammaRamp(swapChain, ramp);
+}
+
+STDMETHODIMP CountingDevice::CreateVolumeTexture(UINT width, UINT height, UINT depth, UINT levels, DWORD usage,
+                                                 D3DFORMAT format, D3DPOOL pool,
+                                                 IDirect3DVolumeTexture9 ** texture, HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateVolumeTexture(width, height, depth, levels, usage, format, pool, texture, shared);
+}
+
+STDMETHODIMP CountingDevice::CreateCubeTexture(UINT edge, UINT levels, DWORD usage, D3DFORMAT format,
+                                               D3DPOOL pool, IDirect3DCubeTexture9 ** texture, HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateCubeTexture(edge, levels, usage, format, pool, texture, shared);
+}
+
+STDMETHODIMP CountingDevice::CreateRenderTarget(UINT width, UINT height, D3DFORMAT format,
+                                                D3DMULTISAMPLE_TYPE multiSample, DWORD quality, BOOL lockable,
+                                                IDirect3DSurface9 ** surface, HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateRenderTarget(width, height, format, multiSample, quality, lockable, surface, shared);
+}
+
+STDMETHODIMP CountingDevice::CreateDepthStencilSurface(UINT width, UINT height, D3DFORMAT format,
+                                                       D3DMULTISAMPLE_TYPE multiSample, DWORD quality,
+                                                       BOOL discard, IDirect3DSurface9 ** surface,
+                                                       HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateDepthStencilSurface(width, height, format, multiSample, quality, discard, surface,
+                                              shared);
+}
+
+STDMETHODIMP CountingDevice::UpdateSurface(IDirect3DSurface9 * src, const RECT * srcRect, IDirect3DSurface9 * dst,
+                                           const POINT * dstPoint)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->UpdateSurface(src, srcRect, dst, dstPoint);
+}
+
+STDMETHODIMP CountingDevice::UpdateTexture(IDirect3DBaseTexture9 * src, IDirect3DBaseTexture9 * dst)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->UpdateTexture(src, dst);
+}
+
+STDMETHODIMP CountingDevice::GetRenderTargetData(IDirect3DSurface9 * target, IDirect3DSurface9 * dst)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetRenderTargetData(target, dst);
+}
+
+STDMETHODIMP CountingDevice::GetFrontBufferData(UINT swapChain, IDirect3DSurface9 * dst)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetFrontBufferData(swapChain, dst);
+}
+
+STDMETHODIMP CountingDevice::StretchRect(IDirect3DSurface9 * src, const RECT * srcRect, IDirect3DSurface9 * dst,
+                                         const RECT * dstRect, D3DTEXTUREFILTERTYPE filter)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->StretchRect(src, srcRect, dst, dstRect, filter);
+}
+
+STDMETHODIMP CountingDevice::ColorFill(IDirect3DSurface9 * surface, const RECT * rect, D3DCOLOR color)
+{
+   m_current.calls[CALL_CLEAR]++;
+   return m_device->ColorFill(surface, rect, color);
+}
+
+STDMETHODIMP CountingDevice::CreateOffscreenPlainSurface(UINT width, UINT height, D3DFORMAT format, D3DPOOL pool,
+                                                         IDirect3DSurface9 ** surface, HANDLE * shared)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateOffscreenPlainSurface(width, height, format, pool, surface, shared);
+}
+
+STDMETHODIMP CountingDevice::SetRenderTarget(DWORD index, IDirect3DSurface9 * target)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetRenderTarget(index, target);
+}
+
+STDMETHODIMP CountingDevice::GetRenderTarget(DWORD index, IDirect3DSurface9 ** target)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetRenderTarget(index, target);
+}
+
+STDMETHODIMP CountingDevice::SetDepthStencilSurface(IDirect3DSurface9 * surface)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetDepthStencilSurface(surface);
+}
+
+STDMETHODIMP CountingDevice::GetDepthStencilSurface(IDirect3DSurface9 ** surface)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetDepthStencilSurface(surface);
+}
+
+STDMETHODIMP CountingDevice::MultiplyTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix)
+{
+   m_current.calls[CALL_TRANSFORM]++;
+   return m_device->MultiplyTransform(state, matrix);
+}
+
+STDMETHODIMP CountingDevice::SetViewport(const D3DVIEWPORT9 * viewport)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetViewport(viewport);
+}
+
+STDMETHODIMP CountingDevice::GetViewport(D3DVIEWPORT9 * viewport)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetViewport(viewport);
+}
+
+STDMETHODIMP CountingDevice::GetMaterial(D3DMATERIAL9 * material)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetMaterial(material);
+}
+
+STDMETHODIMP CountingDevice::GetLight(DWORD index, D3DLIGHT9 * light)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetLight(index, light);
+}
+
+STDMETHODIMP CountingDevice::GetLightEnable(DWORD index, BOOL * enable)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetLightEnable(index, enable);
+}
+
+STDMETHODIMP CountingDevice::SetClipPlane(DWORD index, const float * plane)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetClipPlane(index, plane);
+}
+
+STDMETHODIMP CountingDevice::GetClipPlane(DWORD index, float * plane)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetClipPlane(index, plane);
+}
+
+STDMETHODIMP CountingDevice::CreateStateBlock(D3DSTATEBLOCKTYPE type, IDirect3DStateBlock9 ** block)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->CreateStateBlock(type, block);
+}
+
+STDMETHODIMP CountingDevice::BeginStateBlock()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->BeginStateBlock();
+}
+
+STDMETHODIMP CountingDevice::EndStateBlock(IDirect3DStateBlock9 ** block)
+{
+   m_current.calls[CALL_OTHER]++;
+   forgetStates();   // what was set while recording went into the block, not the device
+   return m_device->EndStateBlock(block);
+}
+
+STDMETHODIMP CountingDevice::SetClipStatus(const D3DCLIPSTATUS9 * status)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetClipStatus(status);
+}
+
+STDMETHODIMP CountingDevice::GetClipStatus(D3DCLIPSTATUS9 * status)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetClipStatus(status);
+}
+
+STDMETHODIMP CountingDevice::GetTexture(DWORD stage, IDirect3DBaseTexture9 ** texture)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetTexture(stage, texture);
+}
+
+STDMETHODIMP CountingDevice::ValidateDevice(DWORD * passes)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->ValidateDevice(passes);
+}
+
+STDMETHODIMP CountingDevice::SetPaletteEntries(UINT palette, const PALETTEENTRY * entries)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetPaletteEntries(palette, entries);
+}
+
+STDMETHODIMP CountingDevice::GetPaletteEntries(UINT palette, PALETTEENTRY * entries)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetPaletteEntries(palette, entries);
+}
+
+STDMETHODIMP CountingDevice::SetCurrentTexturePalette(UINT palette)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetCurrentTexturePalette(palette);
+}
+
+STDMETHODIMP CountingDevice::GetCurrentTexturePalette(UINT * palette)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetCurrentTexturePalette(palette);
+}
+
+STDMETHODIMP CountingDevice::SetScissorRect(const RECT * rect)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetScissorRect(rect);
+}
+
+STDMETHODIMP CountingDevice::GetScissorRect(RECT * rect)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetScissorRect(rect);
+}
+
+STDMETHODIMP CountingDevice::SetSoftwareVertexProcessing(BOOL software)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetSoftwareVertexProcessing(software);
+}
+
+STDMETHODIMP_(BOOL) CountingDevice::GetSoftwareVertexProcessing()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetSoftwareVertexProcessing();
+}
+
+STDMETHODIMP CountingDevice::SetNPatchMode(float segments)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetNPatchMode(segments);
+}
+
+STDMETHODIMP_(float) CountingDevice::GetNPatchMode()
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetNPatchMode();
+}
+
+STDMETHODIMP CountingDevice::DrawPrimitiveUP(D3DPRIMITIVETYPE type, UINT count, const void * vertices, UINT stride)
+{
+   m_current.calls[CALL_DRAW]++;
+   m_current.primitives += count;
+   m_streams[0] = NULL;   // the UP draws unset stream 0
+   return m_device->DrawPrimitiveUP(type, count, vertices, stride);
+}
+
+STDMETHODIMP CountingDevice::DrawIndexedPrimitiveUP(D3DPRIMITIVETYPE type, UINT minIndex, UINT numVertices,
+                                                    UINT count, const void * indices, D3DFORMAT indexFormat,
+                                                    const void * vertices, UINT stride)
+{
+   m_current.calls[CALL_DRAW_INDEXED]++;
+   m_current.primitives += count;
+   m_streams[0] = NULL;   // .. and the indices
+   m_indices = NULL;
+   return m_device->DrawIndexedPrimitiveUP(type, minIndex, numVertices, count, indices, indexFormat, vertices,
+                                           stride);
+}
+
+STDMETHODIMP CountingDevice::ProcessVertices(UINT srcStart, UINT dstIndex, UINT count,
+                                             IDirect3DVertexBuffer9 * dst, IDirect3DVertexDeclaration9 * decl,
+                                             DWORD flags)
+{
+   CountingVertexBuffer * wrapped = static_cast<CountingVertexBuffer *>(dst);
+
+   m_current.calls[CALL_OTHER]++;
+   return m_device->ProcessVertices(srcStart, dstIndex, count, wrapped ? wrapped->buffer() : NULL, decl, flags);
+}
+
+STDMETHODIMP CountingDevice::CreateVertexDeclaration(const D3DVERTEXELEMENT9 * elements,
+                                                     IDirect3DVertexDeclaration9 ** decl)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateVertexDeclaration(elements, decl);
+}
+
+STDMETHODIMP CountingDevice::SetVertexDeclaration(IDirect3DVertexDeclaration9 * decl)
+{
+   m_current.calls[CALL_STREAM]++;
+   return m_device->SetVertexDeclaration(decl);
+}
+
+STDMETHODIMP CountingDevice::GetVertexDeclaration(IDirect3DVertexDeclaration9 ** decl)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetVertexDeclaration(decl);
+}
+
+STDMETHODIMP CountingDevice::GetFVF(DWORD * fvf)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetFVF(fvf);
+}
+
+STDMETHODIMP CountingDevice::CreateVertexShader(const DWORD * function, IDirect3DVertexShader9 ** shader)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateVertexShader(function, shader);
+}
+
+STDMETHODIMP CountingDevice::SetVertexShader(IDirect3DVertexShader9 * shader)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetVertexShader(shader);
+}
+
+STDMETHODIMP CountingDevice::GetVertexShader(IDirect3DVertexShader9 ** shader)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetVertexShader(shader);
+}
+
+STDMETHODIMP CountingDevice::SetVertexShaderConstantF(UINT start, const float * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetVertexShaderConstantF(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetVertexShaderConstantF(UINT start, float * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetVertexShaderConstantF(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::SetVertexShaderConstantI(UINT start, const int * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetVertexShaderConstantI(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetVertexShaderConstantI(UINT start, int * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetVertexShaderConstantI(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::SetVertexShaderConstantB(UINT start, const BOOL * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetVertexShaderConstantB(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetVertexShaderConstantB(UINT start, BOOL * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetVertexShaderConstantB(start, data, count);
+}
+
+// the wrapped buffer that was set, with the real device's offset and stride
+STDMETHODIMP CountingDevice::GetStreamSource(UINT stream, IDirect3DVertexBuffer9 ** buffer, UINT * offset,
+                                             UINT * stride)
+{
+   IDirect3DVertexBuffer9 * real = NULL;
+   HRESULT hr;
+
+   m_current.calls[CALL_OTHER]++;
+   if (buffer == NULL || stream >= STREAMS)
+      return D3DERR_INVALIDCALL;
+   hr = m_device->GetStreamSource(stream, &real, offset, stride);
+   if (real)
+      real->Release();
+   *buffer = SUCCEEDED(hr) ? m_streams[stream] : NULL;
+   if (*buffer)
+      (*buffer)->AddRef();
+   return hr;
+}
+
+STDMETHODIMP CountingDevice::SetStreamSourceFreq(UINT stream, UINT setting)
+{
+   m_current.calls[CALL_STREAM]++;
+   return m_device->SetStreamSourceFreq(stream, setting);
+}
+
+STDMETHODIMP CountingDevice::GetStreamSourceFreq(UINT stream, UINT * setting)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetStreamSourceFreq(stream, setting);
+}
+
+STDMETHODIMP CountingDevice::GetIndices(IDirect3DIndexBuffer9 ** buffer)
+{
+   m_current.calls[CALL_OTHER]++;
+   if (buffer == NULL)
+      return D3DERR_INVALIDCALL;
+   *buffer = m_indices;
+   if (*buffer)
+      (*buffer)->AddRef();
+   return D3D_OK;
+}
+
+STDMETHODIMP CountingDevice::CreatePixelShader(const DWORD * function, IDirect3DPixelShader9 ** shader)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreatePixelShader(function, shader);
+}
+
+STDMETHODIMP CountingDevice::SetPixelShader(IDirect3DPixelShader9 * shader)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetPixelShader(shader);
+}
+
+STDMETHODIMP CountingDevice::GetPixelShader(IDirect3DPixelShader9 ** shader)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetPixelShader(shader);
+}
+
+STDMETHODIMP CountingDevice::SetPixelShaderConstantF(UINT start, const float * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetPixelShaderConstantF(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetPixelShaderConstantF(UINT start, float * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetPixelShaderConstantF(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::SetPixelShaderConstantI(UINT start, const int * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetPixelShaderConstantI(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetPixelShaderConstantI(UINT start, int * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetPixelShaderConstantI(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::SetPixelShaderConstantB(UINT start, const BOOL * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->SetPixelShaderConstantB(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::GetPixelShaderConstantB(UINT start, BOOL * data, UINT count)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->GetPixelShaderConstantB(start, data, count);
+}
+
+STDMETHODIMP CountingDevice::DrawRectPatch(UINT handle, const float * segments, const D3DRECTPATCH_INFO * info)
+{
+   m_current.calls[CALL_DRAW]++;
+   return m_device->DrawRectPatch(handle, segments, info);
+}
+
+STDMETHODIMP CountingDevice::DrawTriPatch(UINT handle, const float * segments, const D3DTRIPATCH_INFO * info)
+{
+   m_current.calls[CALL_DRAW]++;
+   return m_device->DrawTriPatch(handle, segments, info);
+}
+
+STDMETHODIMP CountingDevice::DeletePatch(UINT handle)
+{
+   m_current.calls[CALL_OTHER]++;
+   return m_device->DeletePatch(handle);
+}
+
+STDMETHODIMP CountingDevice::CreateQuery(D3DQUERYTYPE type, IDirect3DQuery9 ** query)
+{
+   m_current.calls[CALL_CREATE]++;
+   return m_device->CreateQuery(type, query);
+}
+#endif
@@ -0,0 +1,360 @@
+/* Filename:  CountingDevice.h
+
+   This file is shared by the numbered examples and the tools.
+
+   A Direct3D 9 device that counts what is asked of it and passes every
+   call on to the real one.  It is an IDirect3DDevice9 itself, so it goes
+   in wherever the device pointer did:
+      lpD3DDevice9 = new CountingDevice(lpD3DDevice9);
+   and nothing else changes.  It takes over the reference it is given and
+   lets go of the real device when its own last reference goes.
+
+   Per frame (Present ends one) it counts each kind of call, the state
+   sets that only set again what was set earlier in the frame, the
+   primitives drawn and the bytes locked in every vertex and index
+   buffer.  Buffers made through it
+   are wrapped so their Lock can be counted; to the code using them they
+   are the same buffers.  It keeps the last few seconds of frames, which
+   can be written out as JSON.
+
+   On Windows all of the interface is there, the parts nothing is counted
+   for passed straight through.  The headless builds wrap a NullDevice
+   with it, which is how the counts are checked without a GPU:
+   bench/countbench makes calls whose counts are known and checks them.
+*/
+
+#ifndef COUNTINGDEVICE_H
+#define COUNTINGDEVICE_H
+
+#include <d3dx9.h>
+#include <stddef.h>
+#include <vector>
+
+class CountingDevice;
+
+
+enum DeviceCall
+{
+   CALL_RENDER_STATE,    // SetRenderState
+   CALL_STAGE_STATE,     // SetTextureStageState
+   CALL_SAMPLER_STATE,   // SetSamplerState
+   CALL_TEXTURE,         // SetTexture
+   CALL_TRANSFORM,       // SetTransform, MultiplyTransform
+   CALL_LIGHTING,        // SetLight, LightEnable, SetMaterial
+   CALL_STREAM,          // SetStreamSource, SetIndices, SetFVF, SetVertexDeclaration
+   CALL_DRAW,            // DrawPrimitive, DrawPrimitiveUP
+   CALL_DRAW_INDEXED,    // DrawIndexedPrimitive, DrawIndexedPrimitiveUP
+   CALL_CLEAR,           // Clear
+   CALL_LOCK,            // Lock on a vertex or index buffer
+   CALL_CREATE,          // textures and buffers made
+   CALL_OTHER,           // everything else.. the Gets, shaders, scenes, state blocks
+   DEVICE_CALLS
+};
+
+// one buffer's locks in one frame
+struct BufferLocks
+{
+   unsigned int buffer;   // numbered as they are made, from 1
+   bool index;            // an index buffer, not a vertex buffer
+   unsigned int locks;
+   unsigned int bytes;
+};
+
+struct DeviceFrame
+{
+   unsigned int calls[DEVICE_CALLS];
+   unsigned int redundant;    // render, stage and sampler states set to what they were already set to this frame
+   unsigned int primitives;   // triangles, lines and points drawn
+   unsigned int lockBytes;    // all the buffers' together
+   std::vector<BufferLocks> buffers;   // only the ones locked this frame
+};
+
+
+class CountingVertexBuffer : public IDirect3DVertexBuffer9
+{
+public:
+   CountingVertexBuffer(CountingDevice * device, IDirect3DVertexBuffer9 * buffer, UINT bytes, unsigned int id);
+
+   STDMETHOD_(ULONG, AddRef)();
+   STDMETHOD_(ULONG, Release)();
+   STDMETHOD(Lock)(UINT offset, UINT bytes, void ** data, DWORD flags);
+   STDMETHOD(Unlock)();
+
+#ifdef _WIN32
+   STDMETHOD(QueryInterface)(REFIID riid, void ** object);
+   STDMETHOD(GetDevice)(IDirect3DDevice9 ** device);
+   STDMETHOD(SetPrivateData)(REFGUID guid, const void * data, DWORD size, DWORD flags);
+   STDMETHOD(GetPrivateData)(REFGUID guid, void * data, DWORD * size);
+   STDMETHOD(FreePrivateData)(REFGUID guid);
+   STDMETHOD_(DWORD, SetPriority)(DWORD priority);
+   STDMETHOD_(DWORD, GetPriority)();
+   STDMETHOD_(void, PreLoad)();
+   STDMETHOD_(D3DRESOURCETYPE, GetType)();
+   STDMETHOD(GetDesc)(D3DVERTEXBUFFER_DESC * desc);
+#endif
+
+   IDirect3DVertexBuffer9 * buffer() const { return m_buffer; }   // the real one
+   unsigned int id() const { return m_id; }
+
+private:
+   ~CountingVertexBuffer();
+
+   CountingDevice * m_device;
+   IDirect3DVertexBuffer9 * m_buffer;
+   UINT m_bytes;
+   unsigned int m_id;
+   ULONG m_refs;
+   void * m_lockData;   // the last Lock, for unlocked().. NULL if it was read only
+   UINT m_lockOffset, m_lockBytes;
+};
+
+
+class CountingIndexBuffer : public IDirect3DIndexBuffer9
+{
+public:
+   CountingIndexBuffer(CountingDevice * device, IDirect3DIndexBuffer9 * buffer, UINT bytes, unsigned int id);
+
+   STDMETHOD_(ULONG, AddRef)();
+   STDMETHOD_(ULONG, Release)();
+   STDMETHOD(Lock)(UINT offset, UINT bytes, void ** data, DWORD flags);
+   STDMETHOD(Unlock)();
+
+#ifdef _WIN32
+   STDMETHOD(QueryInterface)(REFIID riid, void ** object);
+   STDMETHOD(GetDevice)(IDirect3DDevice9 ** device);
+   STDMETHOD(SetPrivateData)(REFGUID guid, const void * data, DWORD size, DWORD flags);
+   STDMETHOD(GetPrivateData)(REFGUID guid, void * data, DWORD * size);
+   STDMETHOD(FreePrivateData)(REFGUID guid);
+   STDMETHOD_(DWORD, SetPriority)(DWORD priority);
+   STDMETHOD_(DWORD, GetPriority)();
+   STDMETHOD_(void, PreLoad)();
+   STDMETHOD_(D3DRESOURCETYPE, GetType)();
+   STDMETHOD(GetDesc)(D3DINDEXBUFFER_DESC * desc);
+#endif
+
+   IDirect3DIndexBuffer9 * buffer() const { return m_buffer; }   // the real one
+   unsigned int id() const { return m_id; }
+
+private:
+   ~CountingIndexBuffer();
+
+   CountingDevice * m_device;
+   IDirect3DIndexBuffer9 * m_buffer;
+   UINT m_bytes;
+   unsigned int m_id;
+   ULONG m_refs;
+   void * m_lockData;   // the last Lock, for unlocked().. NULL if it was read only
+   UINT m_lockOffset, m_lockBytes;
+};
+
+
+class CountingDevice : public IDirect3DDevice9
+{
+public:
+   // takes over the one reference to device.. frames kept for the JSON
+   explicit CountingDevice(IDirect3DDevice9 * device, unsigned int window = 1024);
+
+   STDMETHOD_(ULONG, AddRef)();
+   STDMETHOD_(ULONG, Release)();
+
+   STDMETHOD(TestCooperativeLevel)();
+   STDMETHOD(Reset)(D3DPRESENT_PARAMETERS * params);
+   STDMETHOD(Present)(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty);
+
+   STDMETHOD(CreateTexture)(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format,
+                            D3DPOOL pool, IDirect3DTexture9 ** texture, HANDLE * shared);
+   STDMETHOD(CreateVertexBuffer)(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                 IDirect3DVertexBuffer9 ** buffer, HANDLE * shared);
+   STDMETHOD(CreateIndexBuffer)(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                IDirect3DIndexBuffer9 ** buffer, HANDLE * shared);
+
+   STDMETHOD(BeginScene)();
+   STDMETHOD(EndScene)();
+   STDMETHOD(Clear)(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+
+   STDMETHOD(SetTransform)(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix);
+   STDMETHOD(GetTransform)(D3DTRANSFORMSTATETYPE state, D3DMATRIX * matrix);
+   STDMETHOD(SetMaterial)(const D3DMATERIAL9 * material);
+   STDMETHOD(SetLight)(DWORD index, const D3DLIGHT9 * light);
+   STDMETHOD(LightEnable)(DWORD index, BOOL enable);
+   STDMETHOD(SetRenderState)(D3DRENDERSTATETYPE state, DWORD value);
+   STDMETHOD(GetRenderState)(D3DRENDERSTATETYPE state, DWORD * value);
+   STDMETHOD(SetTexture)(DWORD stage, IDirect3DBaseTexture9 * texture);
+   STDMETHOD(SetTextureStageState)(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+   STDMETHOD(GetTextureStageState)(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD * value);
+   STDMETHOD(SetSamplerState)(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+   STDMETHOD(GetSamplerState)(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD * value);
+
+   STDMETHOD(DrawPrimitive)(D3DPRIMITIVETYPE type, UINT startVertex, UINT count);
+   STDMETHOD(DrawIndexedPrimitive)(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                   UINT numVertices, UINT startIndex, UINT count);
+   STDMETHOD(SetFVF)(DWORD fvf);
+   STDMETHOD(SetStreamSource)(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset, UINT stride);
+   STDMETHOD(SetIndices)(IDirect3DIndexBuffer9 * buffer);
+
+#ifdef _WIN32
+   // the rest of IDirect3DDevice9
+   STDMETHOD(QueryInterface)(REFIID riid, void ** object);
+   STDMETHOD_(UINT, GetAvailableTextureMem)();
+   STDMETHOD(EvictManagedResources)();
+   STDMETHOD(GetDirect3D)(IDirect3D9 ** d3d);
+   STDMETHOD(GetDeviceCaps)(D3DCAPS9 * caps);
+   STDMETHOD(GetDisplayMode)(UINT swapChain, D3DDISPLAYMODE * mode);
+   STDMETHOD(GetCreationParameters)(D3DDEVICE_CREATION_PARAMETERS * params);
+   STDMETHOD(SetCursorProperties)(UINT x, UINT y, IDirect3DSurface9 * bitmap);
+   STDMETHOD_(void, SetCursorPosition)(int x, int y, DWORD flags);
+   STDMETHOD_(BOOL, ShowCursor)(BOOL show);
+   STDMETHOD(CreateAdditionalSwapChain)(D3DPRESENT_PARAMETERS * params, IDirect3DSwapChain9 ** swapChain);
+   STDMETHOD(GetSwapChain)(UINT index, IDirect3DSwapChain9 ** swapChain);
+   STDMETHOD_(UINT, GetNumberOfSwapChains)();
+   STDMETHOD(GetBackBuffer)(UINT swapChain, UINT index, D3DBACKBUFFER_TYPE type, IDirect3DSurface9 ** surface);
+   STDMETHOD(GetRasterStatus)(UINT swapChain, D3DRASTER_STATUS * status);
+   STDMETHOD(SetDialogBoxMode)(BOOL enable);
+   STDMETHOD_(void, SetGammaRamp)(UINT swapChain, DWORD flags, const D3DGAMMARAMP * ramp);
+   STDMETHOD_(void, GetGammaRamp)(UINT swapChain, D3DGAMMARAMP * ramp);
+   STDMETHOD(CreateVolumeTexture)(UINT width, UINT height, UINT depth, UINT levels, DWORD usage,
+                                  D3DFORMAT format, D3DPOOL pool, IDirect3DVolumeTexture9 ** texture,
+                                  HANDLE * shared);
+   STDMETHOD(CreateCubeTexture)(UINT edge, UINT levels, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                IDirect3DCubeTexture9 ** texture, HANDLE * shared);
+   STDMETHOD(CreateRenderTarget)(UINT width, UINT height, D3DFORMAT format, D3DMULTISAMPLE_TYPE multiSample,
+                                 DWORD quality, BOOL lockable, IDirect3DSurface9 ** surface, HANDLE * shared);
+   STDMETHOD(CreateDepthStencilSurface)(UINT width, UINT height, D3DFORMAT format,
+                                        D3DMULTISAMPLE_TYPE multiSample, DWORD quality, BOOL discard,
+                                        IDirect3DSurface9 ** surface, HANDLE * shared);
+   STDMETHOD(UpdateSurface)(IDirect3DSurface9 * src, const RECT * srcRect, IDirect3DSurface9 * dst,
+                            const POINT * dstPoint);
+   STDMETHOD(UpdateTexture)(IDirect3DBaseTexture9 * src, IDirect3DBaseTexture9 * dst);
+   STDMETHOD(GetRenderTargetData)(IDirect3DSurface9 * target, IDirect3DSurface9 * dst);
+   STDMETHOD(GetFrontBufferData)(UINT swapChain, IDirect3DSurface9 * dst);
+   STDMETHOD(StretchRect)(IDirect3DSurface9 * src, const RECT * srcRect, IDirect3DSurface9 * dst,
+                          const RECT * dstRect, D3DTEXTUREFILTERTYPE filter);
+   STDMETHOD(ColorFill)(IDirect3DSurface9 * surface, const RECT * rect, D3DCOLOR color);
+   STDMETHOD(CreateOffscreenPlainSurface)(UINT width, UINT height, D3DFORMAT format, D3DPOOL pool,
+                                          IDirect3DSurface9 ** surface, HANDLE * shared);
+   STDMETHOD(SetRenderTarget)(DWORD index, IDirect3DSurface9 * target);
+   STDMETHOD(GetRenderTarget)(DWORD index, IDirect3DSurface9 ** target);
+   STDMETHOD(SetDepthStencilSurface)(IDirect3DSurface9 * surface);
+   STDMETHOD(GetDepthStencilSurface)(IDirect3DSurface9 ** surface);
+   STDMETHOD(MultiplyTransform)(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix);
+   STDMETHOD(SetViewport)(const D3DVIEWPORT9 * viewport);
+   STDMETHOD(GetViewport)(D3DVIEWPORT9 * viewport);
+   STDMETHOD(GetMaterial)(D3DMATERIAL9 * material);
+   STDMETHOD(GetLight)(DWORD index, D3DLIGHT9 * light);
+   STDMETHOD(GetLightEnable)(DWORD index, BOOL * enable);
+   STDMETHOD(SetClipPlane)(DWORD index, const float * plane);
+   STDMETHOD(GetClipPlane)(DWORD index, float * plane);
+   STDMETHOD(CreateStateBlock)(D3DSTATEBLOCKTYPE type, IDirect3DStateBlock9 ** block);
+   STDMETHOD(BeginStateBlock)();
+   STDMETHOD(EndStateBlock)(IDirect3DStateBlock9 ** block);
+   STDMETHOD(SetClipStatus)(const D3DCLIPSTATUS9 * status);
+   STDMETHOD(GetClipStatus)(D3DCLIPSTATUS9 * status);
+   STDMETHOD(GetTexture)(DWORD stage, IDirect3DBaseTexture9 ** texture);
+   STDMETHOD(ValidateDevice)(DWORD * passes);
+   STDMETHOD(SetPaletteEntries)(UINT palette, const PALETTEENTRY * entries);
+   STDMETHOD(GetPaletteEntries)(UINT palette, PALETTEENTRY * entries);
+   STDMETHOD(SetCurrentTexturePalette)(UINT palette);
+   STDMETHOD(GetCurrentTexturePalette)(UINT * palette);
+   STDMETHOD(SetScissorRect)(const RECT * rect);
+   STDMETHOD(GetScissorRect)(RECT * rect);
+   STDMETHOD(SetSoftwareVertexProcessing)(BOOL software);
+   STDMETHOD_(BOOL, GetSoftwareVertexProcessing)();
+   STDMETHOD(SetNPatchMode)(float segments);
+   STDMETHOD_(float, GetNPatchMode)();
+   STDMETHOD(DrawPrimitiveUP)(D3DPRIMITIVETYPE type, UINT count, const void * vertices, UINT stride);
+   STDMETHOD(DrawIndexedPrimitiveUP)(D3DPRIMITIVETYPE type, UINT minIndex, UINT numVertices, UINT count,
+                                     const void * indices, D3DFORMAT indexFormat, const void * vertices,
+                                     UINT stride);
+   STDMETHOD(ProcessVertices)(UINT srcStart, UINT dstIndex, UINT count, IDirect3DVertexBuffer9 * dst,
+                              IDirect3DVertexDeclaration9 * decl, DWORD flags);
+   STDMETHOD(CreateVertexDeclaration)(const D3DVERTEXELEMENT9 * elements, IDirect3DVertexDeclaration9 ** decl);
+   STDMETHOD(SetVertexDeclaration)(IDirect3DVertexDeclaration9 * decl);
+   STDMETHOD(GetVertexDeclaration)(IDirect3DVertexDeclaration9 ** decl);
+   STDMETHOD(GetFVF)(DWORD * fvf);
+   STDMETHOD(CreateVertexShader)(const DWORD * function, IDirect3DVertexShader9 ** shader);
+   STDMETHOD(SetVertexShader)(IDirect3DVertexShader9 * shader);
+   STDMETHOD(GetVertexShader)(IDirect3DVertexShader9 ** shader);
+   STDMETHOD(SetVertexShaderConstantF)(UINT start, const float * data, UINT count);
+   STDMETHOD(GetVertexShaderConstantF)(UINT start, float * data, UINT count);
+   STDMETHOD(SetVertexShaderConstantI)(UINT start, const int * data, UINT count);
+   STDMETHOD(GetVertexShaderConstantI)(UINT start, int * data, UINT count);
+   STDMETHOD(SetVertexShaderConstantB)(UINT start, const BOOL * data, UINT count);
+   STDMETHOD(GetVertexShaderConstantB)(UINT start, BOOL * data, UINT count);
+   STDMETHOD(GetStreamSource)(UINT stream, IDirect3DVertexBuffer9 ** buffer, UINT * offset, UINT * stride);
+   STDMETHOD(SetStreamSourceFreq)(UINT stream, UINT setting);
+   STDMETHOD(GetStreamSourceFreq)(UINT stream, UINT * setting);
+   STDMETHOD(GetIndices)(IDirect3DIndexBuffer9 ** buffer);
+   STDMETHOD(CreatePixelShader)(const DWORD * function, IDirect3DPixelShader9 ** shader);
+   STDMETHOD(SetPixelShader)(IDirect3DPixelShader9 * shader);
+   STDMETHOD(GetPixelShader)(IDirect3DPixelShader9 ** shader);
+   STDMETHOD(SetPixelShaderConstantF)(UINT start, const float * data, UINT count);
+   STDMETHOD(GetPixelShaderConstantF)(UINT start, float * data, UINT count);
+   STDMETHOD(SetPixelShaderConstantI)(UINT start, const int * data, UINT count);
+   STDMETHOD(GetPixelShaderConstantI)(UINT start, int * data, UINT count);
+   STDMETHOD(SetPixelShaderConstantB)(UINT start, const BOOL * data, UINT count);
+   STDMETHOD(GetPixelShaderConstantB)(UINT start, BOOL * data, UINT count);
+   STDMETHOD(DrawRectPatch)(UINT handle, const float * segments, const D3DRECTPATCH_INFO * info);
+   STDMETHOD(DrawTriPatch)(UINT handle, const float * segments, const D3DTRIPATCH_INFO * info);
+   STDMETHOD(DeletePatch)(UINT handle);
+   STDMETHOD(CreateQuery)(D3DQUERYTYPE type, IDirect3DQuery9 ** query);
+#endif
+
+   IDirect3DDevice9 * device() const { return m_device; }   // the real one
+
+   // finishes the frame being counted.. Present does this, call it by hand
+   // if the frame ends some other way
+   virtual void endFrame();
+
+   const DeviceFrame & current() const { return m_current; }   // so far this frame
+   unsigned int count() const { return m_count; }              // frames kept
+   const DeviceFrame & frame(unsigned int i) const;            // 0 is the oldest, count() - 1 the last
+   unsigned int frameNumber() const { return m_frameNumber; }  // frames finished, ever
+
+   // one line about the last frame: draws, state sets, primitives, bytes locked
+   void summary(char * str, size_t size) const;
+
+   // {"frames":[{"frame":n,"calls":{..},..,"buffers":[..]},..]}.. oldest frame first
+   bool writeJson(const char * filename) const;
+
+   static const char * callName(DeviceCall call);   // as it is in the JSON
+
+protected:
+   virtual ~CountingDevice();
+
+   // for a device built on this one.. buffer id is about to be unlocked
+   // after being written (offset, bytes, what was written), or it has gone
+   virtual void unlocked(unsigned int, UINT, UINT, const void *) {}
+   virtual void released(unsigned int) {}
+
+private:
+   friend class CountingVertexBuffer;
+   friend class CountingIndexBuffer;
+
+   void locked(unsigned int id, bool index, UINT bytes);
+   void forgetStates();
+
+   enum { STAGES = 8, STAGE_STATES = 33, SAMPLER_STATES = 14, RENDER_STATES = 256 };
+   enum { STREAMS = 16 };
+
+   // the states as last set, so a set that changes nothing can be spotted..
+   // a bit in the known masks says the value is there
+   DWORD m_renderStates[RENDER_STATES];
+   DWORD m_stageStates[STAGES][STAGE_STATES];
+   DWORD m_samplerStates[STAGES][SAMPLER_STATES];
+   unsigned int m_renderKnown[RENDER_STATES / 32];
+   unsigned long long m_stageKnown[STAGES];   // a bit a state, there are 33
+   unsigned int m_samplerKnown[STAGES];
+
+   IDirect3DDevice9 * m_device;
+   ULONG m_refs;
+   unsigned int m_nextBuffer;
+   CountingVertexBuffer * m_streams[STREAMS];   // what GetStreamSource and GetIndices give back
+   CountingIndexBuffer * m_indices;
+
+   DeviceFrame m_current;
+   std::vector<unsigned int> m_slots;   // where each buffer is in m_current.buffers, + 1, 0 if it isn't
+   std::vector<DeviceFrame> m_frames;   // a ring, m_next is the oldest once it is full
+   unsigned int m_next, m_count, m_frameNumber;
+};
+
+#endif
@@ -0,0 +1,480 @@
+/* Filename:  Cull.cpp
+
+   This file accompanies Cull.h.
+*/
+
+#include "Cull.h"
+#include "VecMath.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define CULL_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define CULL_WIDTH 4
+#else
+#define CULL_WIDTH 1
+#endif
+
+#define LEAF_SIZE 8   // boxes per leaf.. one AVX test
+
+
+BoundBox makeBoundBox(float cx, float cy, float cz, float hx, float hy, float hz)
+{
+   BoundBox b;
+   b.minX = cx - hx;  b.maxX = cx + hx;
+   b.minY = cy - hy;  b.maxY = cy + hy;
+   b.minZ = cz - hz;  b.maxZ = cz + hz;
+   return b;
+}
+
+
+BoundBox transformBoundBox(const BoundBox & local, const float * m)
+{
+   // transform the center, then the half sizes by the absolute value of the matrix
+   float c[3] = { (local.minX + local.maxX) * 0.5f, (local.minY + local.maxY) * 0.5f,
+                  (local.minZ + local.maxZ) * 0.5f };
+   float h[3] = { (local.maxX - local.minX) * 0.5f, (local.maxY - local.minY) * 0.5f,
+                  (local.maxZ - local.minZ) * 0.5f };
+   float wc[3], wh[3];
+   int i;
+
+   for (i = 0; i < 3; i++)
+   {
+      wc[i] = c[0] * m[i] + c[1] * m[4 + i] + c[2] * m[8 + i] + m[12 + i];
+      wh[i] = h[0] * fabsf(m[i]) + h[1] * fabsf(m[4 + i]) + h[2] * fabsf(m[8 + i]);
+   }
+   return makeBoundBox(wc[0], wc[1], wc[2], wh[0], wh[1], wh[2]);
+}
+
+
+void BoundBoxArray::resize(unsigned int n)
+{
+   unsigned int padded = (n + 7) & ~7u;
+   count = n;
+   // padding boxes are inside out, so they always fail the plane tests
+   minX.assign(padded, FLT_MAX);   maxX.assign(padded, -FLT_MAX);
+   minY.assign(padded, FLT_MAX);   maxY.assign(padded, -FLT_MAX);
+   minZ.assign(padded, FLT_MAX);   maxZ.assign(padded, -FLT_MAX);
+}
+
+
+void BoundBoxArray::set(unsigned int i, const BoundBox & b)
+{
+   minX[i] = b.minX;  minY[i] = b.minY;  minZ[i] = b.minZ;
+   maxX[i] = b.maxX;  maxY[i] = b.maxY;  maxZ[i] = b.maxZ;
+}
+
+
+BoundBox BoundBoxArray::get(unsigned int i) const
+{
+   BoundBox b;
+   b.minX = minX[i];  b.minY = minY[i];  b.minZ = minZ[i];
+   b.maxX = maxX[i];  b.maxY = maxY[i];  b.maxZ = maxZ[i];
+   return b;
+}
+
+
+Frustum::Frustum()
+{
+   int i;
+   for (i = 0; i < 6; i++)   // everything is visible until extract is called
+   {
+      m_planes[i][0] = m_planes[i][1] = m_planes[i][2] = 0.0f;
+      m_planes[i][3] = 1.0f;
+   }
+}
+
+
+void Frustum::extract(const float * view, const float * proj)
+{
+   float vp[16];
+
+   mat4Multiply(vp, view, proj);
+   extract(vp);
+}
+
+
+void Frustum::extract(const float * m)
+{
+   // with row vectors clip = v * M, so the planes come from the columns of M..
+   // D3D clips to -w <= x <= w, -w <= y <= w and 0 <= z <= w
+   int i, k;
+   for (k = 0; k < 4; k++)
+   {
+      float c0 = m[k * 4 + 0], c1 = m[k * 4 + 1], c2 = m[k * 4 + 2], c3 = m[k * 4 + 3];
+      m_planes[0][k] = c3 + c0;   // left
+      m_planes[1][k] = c3 - c0;   // right
+      m_planes[2][k] = c3 + c1;   // bottom
+      m_planes[3][k] = c3 - c1;   // top
+      m_planes[4][k] = c2;        // near
+      m_planes[5][k] = c3 - c2;   // far
+   }
+
+   for (i = 0; i < 6; i++)   // normalize so d is a real distance
+   {
+      float len = sqrtf(m_planes[i][0] * m_planes[i][0] + m_planes[i][1] * m_planes[i][1] +
+                        m_planes[i][2] * m_planes[i][2]);
+      if (len > 0.0f)
+         for (k = 0; k < 4; k++)
+            m_planes[i][k] /= len;
+   }
+}
+
+
+bool Frustum::testBox(const BoundBox & b) const
+{
+   int i;
+   for (i = 0; i < 6; i++)
+   {  // the corner furthest along the plane normal..
+      const float * p = m_planes[i];
+      float x = p[0] > 0 ? b.maxX : b.minX;
+      float y = p[1] > 0 ? b.maxY : b.minY;
+      float z = p[2] > 0 ? b.maxZ : b.minZ;
+      if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0)
+         return false;   // .. is behind it, so all of the box is
+   }
+   return true;
+}
+
+
+bool Frustum::containsBox(const BoundBox & b) const
+{
+   int i;
+   for (i = 0; i < 6; i++)
+   {  // the corner nearest along the plane normal must be in front
+      const float * p = m_planes[i];
+      float x = p[0] > 0 ? b.minX : b.maxX;
+      float y = p[1] > 0 ? b.minY : b.maxY;
+      float z = p[2] > 0 ? b.minZ : b.maxZ;
+      if (p[0] * x + p[1] * y + p[2] * z + p[3] < 0)
+         return false;
+   }
+   return true;
+}
+
+
+void Frustum::testBoxes(const BoundBoxArray & boxes, unsigned int first, unsigned int last,
+                        std::vector<unsigned int> & visible, const unsigned int * remap) const
+{
+   const float * px[6], * py[6], * pz[6];   // which side of the box each plane looks at
+   unsigned int i = first;
+   int k;
+
+   if (last > boxes.count)
+      last = boxes.count;
+
+   for (k = 0; k < 6; k++)
+   {
+      px[k] = m_planes[k][0] > 0 ? &boxes.maxX[0] : &boxes.minX[0];
+      py[k] = m_planes[k][1] > 0 ? &boxes.maxY[0] : &boxes.minY[0];
+      pz[k] = m_planes[k][2] > 0 ? &boxes.maxZ[0] : &boxes.minZ[0];
+   }
+
+#if CULL_WIDTH == 8
+   for (; i + 8 <= last; i += 8)
+   {
+      __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+      for (k = 0; k < 6; k++)
+      {
+         __m256 d = _mm256_add_ps(
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m_planes[k][0]), _mm256_loadu_ps(px[k] + i)),
+                          _mm256_mul_ps(_mm256_set1_ps(m_planes[k][1]), _mm256_loadu_ps(py[k] + i))),
+            _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(m_planes[k][2]), _mm256_loadu_ps(pz[k] + i)),
+                          _mm256_set1_ps(m_planes[k][3])));
+         inside = _mm256_and_ps(inside, _mm256_cmp_ps(d, _mm256_setzero_ps(), _CMP_GE_OQ));
+      }
+      int mask = _mm256_movemask_ps(inside);
+      int bit;
+      for (bit = 0; mask; bit++, mask >>= 1)
+         if (mask & 1)
+            visible.push_back(remap ? remap[i + bit] : i + bit);
+   }
+#elif CULL_WIDTH == 4
+   for (; i + 4 <= last; i += 4)
+   {
+      __m128 inside = _mm_cmpeq_ps(_mm_setzero_ps(), _mm_setzero_ps());
+      for (k = 0; k < 6; k++)
+      {
+         __m128 d = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[k][0]), _mm_loadu_ps(px[k] + i)),
+                       _mm_mul_ps(_mm_set1_ps(m_planes[k][1]), _mm_loadu_ps(py[k] + i))),
+            _mm_add_ps(_mm_mul_ps(_mm_set1_ps(m_planes[k][2]), _mm_loadu_ps(pz[k] + i)),
+                       _mm_set1_ps(m_planes[k][3])));
+         inside = _mm_and_ps(inside, _mm_cmpge_ps(d, _mm_setzero_ps()));
+      }
+      int mask = _mm_movemask_ps(inside);
+      int bit;
+      for (bit = 0; mask; bit++, mask >>= 1)
+         if (mask & 1)
+            visible.push_back(remap ? remap[i + bit] : i + bit);
+   }
+#endif
+
+   for (; i < last; i++)   // whatever is left over
+   {
+      bool in = true;
+      for (k = 0; k < 6 && in; k++)
+         in = m_planes[k][0] * px[k][i] + m_planes[k][1] * py[k][i] +
+              m_planes[k][2] * pz[k][i] + m_planes[k][3] >= 0;
+      if (in)
+         visible.push_back(remap ? remap[i] : i);
+   }
+}
+
+
+static unsigned int threadCount(unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   return numThreads ? numThreads : 1;
+}
+
+
+void Frustum::testBoxesParallel(const BoundBoxArray & boxes, std::vector<unsigned int> & visible,
+                                unsigned int numThreads) const
+{
+   unsigned int n = threadCount(numThreads);
+   unsigned int chunk = ((boxes.count + n - 1) / n + 7) & ~7u;   // rounded up, so the last lump takes the rest
+   std::vector<std::vector<unsigned int> > results(n);
+   std::vector<std::thread> threads;
+   unsigned int t;
+
+   if (n == 1 || boxes.count < 4096)   // not worth starting threads
+   {
+      testBoxes(boxes, 0, boxes.count, visible);
+      return;
+   }
+
+   for (t = 1; t < n; t++)
+      threads.push_back(std::thread(&Frustum::testBoxes, this, std::cref(boxes),
+                                    std::min(t * chunk, boxes.count), std::min((t + 1) * chunk, boxes.count),
+                                    std::ref(results[t]), (const unsigned int *) 0));
+   testBoxes(boxes, 0, std::min(chunk, boxes.count), visible);
+
+   for (t = 1; t < n; t++)   // join in order so the results stay sorted
+   {
+      threads[t - 1].join();
+      visible.insert(visible.end(), results[t].begin(), results[t].end());
+   }
+}
+
+
+static float surfaceArea(const BoundBox & b)
+{
+   float x = b.maxX - b.minX, y = b.maxY - b.minY, z = b.maxZ - b.minZ;
+   return 2.0f * (x * y + y * z + z * x);
+}
+
+
+static void growBox(BoundBox & a, const BoundBox & b)
+{
+   a.minX = std::min(a.minX, b.minX);  a.maxX = std::max(a.maxX, b.maxX);
+   a.minY = std::min(a.minY, b.minY);  a.maxY = std::max(a.maxY, b.maxY);
+   a.minZ = std::min(a.minZ, b.minZ);  a.maxZ = std::max(a.maxZ, b.maxZ);
+}
+
+
+CullBVH::CullBVH()
+{
+   m_count = 0;
+   m_builtArea = 0.0f;
+}
+
+
+void CullBVH::build(const BoundBox * boxes, unsigned int count)
+{
+   std::vector<float> centers((size_t) count * 3);
+   unsigned int i;
+
+   m_count = count;
+   m_nodes.clear();
+   m_nodes.reserve(2 * (count / LEAF_SIZE + 1));
+   m_order.resize(count);
+   m_leafBoxes.resize(count);
+
+   for (i = 0; i < count; i++)
+   {
+      m_order[i] = i;
+      centers[i * 3 + 0] = boxes[i].minX + boxes[i].maxX;
+      centers[i * 3 + 1] = boxes[i].minY + boxes[i].maxY;
+      centers[i * 3 + 2] = boxes[i].minZ + boxes[i].maxZ;
+   }
+
+   if (count == 0)
+      return;
+
+   buildNode(0, count, centers);
+   refit(boxes);
+   m_builtArea = surfaceArea(m_nodes[0].box);
+}
+
+
+unsigned int CullBVH::buildNode(unsigned int first, unsigned int count, std::vector<float> & centers)
+{
+   unsigned int index = (unsigned int) m_nodes.size();
+   m_nodes.push_back(Node());
+
+   if (count <= LEAF_SIZE)
+   {
+      m_nodes[index].first = first;
+      m_nodes[index].count = count;
+      return index;
+   }
+
+   // split at the median along the axis the centers are most spread out on
+   float lo[3] = { FLT_MAX, FLT_MAX, FLT_MAX }, hi[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+   unsigned int i, axis = 0;
+   for (i = first; i < first + count; i++)
+   {
+      const float * c = &centers[(size_t) m_order[i] * 3];
+      for (int k = 0; k < 3; k++)
+      {
+         lo[k] = std::min(lo[k], c[k]);
+         hi[k] = std::max(hi[k], c[k]);
+      }
+   }
+   if (hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+   if (hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+
+   // keep the left half a multiple of the leaf size so leaves stay full
+   unsigned int half = ((count / 2) + LEAF_SIZE - 1) / LEAF_SIZE * LEAF_SIZE;
+   const float * c = &centers[axis];
+   std::nth_element(m_order.begin() + first, m_order.begin() + first + half,
+                    m_order.begin() + first + count,
+                    [c](unsigned int a, unsigned int b) { return c[(size_t) a * 3] < c[(size_t) b * 3]; });
+
+   buildNode(first, half, centers);
+   unsigned int right = buildNode(first + half, count - half, centers);
+   m_nodes[index].first = right;
+   m_nodes[index].count = 0;
+   return index;
+}
+
+
+void CullBVH::refit(const BoundBox * boxes)
+{
+   unsigned int i, j;
+
+   for (i = 0; i < m_count; i++)
+      m_leafBoxes.set(i, boxes[m_order[i]]);
+
+   // children always come after their parent, so walk backwards
+   for (i = (unsigned int) m_nodes.size(); i-- > 0; )
+   {
+      Node & n = m_nodes[i];
+      if (n.count)
+      {
+         n.box = m_leafBoxes.get(n.first);
+         for (j = 1; j < n.count; j++)
+            growBox(n.box, m_leafBoxes.get(n.first + j));
+      }
+      else
+      {
+         n.box = m_nodes[i + 1].box;
+         growBox(n.box, m_nodes[n.first].box);
+      }
+   }
+}
+
+
+bool CullBVH::needsRebuild() const
+{
+   return m_count && surfaceArea(m_nodes[0].box) > 2.0f * m_builtArea;
+}
+
+
+void CullBVH::addAll(unsigned int node, std::vector<unsigned int> & visible) const
+{
+   // nodes of a subtree are contiguous and so are the boxes under them
+   unsigned int last = node;
+   while (m_nodes[last].count == 0)
+      last = m_nodes[last].first;   // rightmost leaf
+   unsigned int begin = node;
+   while (m_nodes[begin].count == 0)
+      begin++;                      // leftmost leaf
+   visible.insert(visible.end(), m_order.begin() + m_nodes[begin].first,
+                  m_order.begin() + m_nodes[last].first + m_nodes[last].count);
+}
+
+
+void CullBVH::queryNode(const Frustum & frustum, unsigned int node,
+                        std::vector<unsigned int> & visible) const
+{
+   const Node & n = m_nodes[node];
+
+   if (!frustum.testBox(n.box))
+      return;
+   if (frustum.containsBox(n.box))
+   {  // no need to test anything below this one
+      addAll(node, visible);
+      return;
+   }
+   if (n.count)
+      frustum.testBoxes(m_leafBoxes, n.first, n.first + n.count, visible, &m_order[0]);
+   else
+   {
+      queryNode(frustum, node + 1, visible);
+      queryNode(frustum, n.first, visible);
+   }
+}
+
+
+void CullBVH::query(const Frustum & frustum, std::vector<unsigned int> & visible,
+                    unsigned int numThreads) const
+{
+   unsigned int n = threadCount(numThreads);
+   std::vector<unsigned int> tasks;
+   unsigned int i;
+
+   if (m_count == 0)
+      return;
+
+   if (n == 1 || m_count < 4096)
+   {
+      queryNode(frustum, 0, visible);
+      return;
+   }
+
+   // split the top of the tree into about 4 subtrees per thread..
+   // subtrees that are already culled or fully visible are dealt with here
+   tasks.push_back(0);
+   while (tasks.size() < n * 4)
+   {
+      std::vector<unsigned int> next;
+      bool split = false;
+      for (i = 0; i < tasks.size(); i++)
+      {
+         const Node & node = m_nodes[tasks[i]];
+         if (node.count == 0)
+         {
+            next.push_back(tasks[i] + 1);
+            next.push_back(node.first);
+            split = true;
+         }
+         else
+            next.push_back(tasks[i]);
+      }
+      tasks.swap(next);
+      if (!split)
+         break;
+   }
+
+   std::vector<std::vector<unsigned int> > results(tasks.size());
+   std::vector<std::thread> threads;
+   unsigned int t;
+   for (t = 0; t < n; t++)
+      threads.push_back(std::thread([&, t]()
+      {
+         for (unsigned int k = t; k < tasks.size(); k += n)
+            queryNode(frustum, tasks[k], results[k]);
+      }));
+   for (t = 0; t < n; t++)
+      threads[t].join();
+   for (i = 0; i < results.size(); i++)
+      visible.insert(visible.end(), results[i].begin(), results[i].end());
+}
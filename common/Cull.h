@@ -0,0 +1,119 @@
+/* Filename:  Cull.h
+
+   This file is shared by the numbered examples and the tools.
+
+   View frustum culling.  Every object that can be drawn hands out an axis
+   aligned bounding box (BoundBox).  The Frustum is pulled out of the same
+   view and projection matrices doMath() gives to SetTransform, and a box
+   is thrown away if it is completely behind any one of the 6 planes.
+
+   For big scenes CullBVH keeps the boxes in a bounding volume hierarchy.
+   Moving objects only need refit() each frame; build() is only needed
+   again when objects are added or removed or when needsRebuild() says the
+   tree has become too loose.  The boxes in the leaves are tested 4 (SSE)
+   or 8 (AVX) at a time, and query() can split the tree between threads.
+*/
+
+#ifndef CULL_H
+#define CULL_H
+
+#include <vector>
+
+
+struct BoundBox
+{
+   float minX, minY, minZ;
+   float maxX, maxY, maxZ;
+};
+
+// box from a center point and half sizes
+BoundBox makeBoundBox(float cx, float cy, float cz, float hx, float hy, float hz);
+
+// box around a box that has been transformed by a (row vector) world matrix
+BoundBox transformBoundBox(const BoundBox & local, const float * world);
+
+
+// boxes stored as separate arrays so they can be loaded 4 or 8 at a time..
+// the arrays are padded with empty boxes to a multiple of 8
+struct BoundBoxArray
+{
+   std::vector<float> minX, minY, minZ;
+   std::vector<float> maxX, maxY, maxZ;
+   unsigned int count;
+
+   BoundBoxArray() { count = 0; }
+   void resize(unsigned int n);
+   void set(unsigned int i, const BoundBox & b);
+   BoundBox get(unsigned int i) const;
+};
+
+
+class Frustum
+{
+public:
+   Frustum();
+
+   // view and proj are D3D style (row vector, z from 0 to 1) 4x4 matrices,
+   // so a D3DXMATRIX can be passed straight in
+   void extract(const float * view, const float * proj);
+   void extract(const float * viewProj);
+
+   bool testBox(const BoundBox & b) const;          // true if any part may be visible
+   bool containsBox(const BoundBox & b) const;      // true if completely inside
+
+   // tests boxes [first, last) and appends the visible indices to visible..
+   // if remap is given remap[i] is appended instead of i
+   void testBoxes(const BoundBoxArray & boxes, unsigned int first, unsigned int last,
+                  std::vector<unsigned int> & visible, const unsigned int * remap = 0) const;
+
+   // same for every box, split over numThreads threads (0 = all cores)
+   void testBoxesParallel(const BoundBoxArray & boxes, std::vector<unsigned int> & visible,
+                          unsigned int numThreads = 0) const;
+
+   const float * plane(int i) const { return m_planes[i]; }
+
+private:
+   float m_planes[6][4];   // a, b, c, d with the normal pointing inward
+};
+
+
+class CullBVH
+{
+public:
+   CullBVH();
+
+   // builds the tree over count boxes, index i in the results is boxes[i]
+   void build(const BoundBox * boxes, unsigned int count);
+
+   // boxes moved but none were added or removed.. update the tree in place
+   void refit(const BoundBox * boxes);
+
+   // true if the tree has grown loose enough (from refits) that build() would pay off
+   bool needsRebuild() const;
+
+   // appends the indices of all boxes that may be visible
+   void query(const Frustum & frustum, std::vector<unsigned int> & visible,
+              unsigned int numThreads = 1) const;
+
+   unsigned int size() const { return m_count; }
+
+private:
+   struct Node
+   {
+      BoundBox box;
+      unsigned int first;   // leaf: first box in m_leafBoxes.. inner: right child
+      unsigned int count;   // leaf: number of boxes.. inner: 0 (left child is next node)
+   };
+
+   unsigned int buildNode(unsigned int first, unsigned int count, std::vector<float> & centers);
+   void queryNode(const Frustum & frustum, unsigned int node, std::vector<unsigned int> & visible) const;
+   void addAll(unsigned int node, std::vector<unsigned int> & visible) const;
+
+   std::vector<Node> m_nodes;           // depth first order, root is 0
+   std::vector<unsigned int> m_order;   // tree order -> caller's box index
+   BoundBoxArray m_leafBoxes;           // boxes in tree order
+   unsigned int m_count;
+   float m_builtArea;                   // root surface area right after build()
+};
+
+#endif
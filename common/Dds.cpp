@@ -0,0 +1,257 @@
+/* Filename:  Dds.cpp
+
+   This file accompanies Dds.h.
+*/
+
+#include "Dds.h"
+#include <stdio.h>
+#include <string.h>
+#include <string>
+
+#define FOURCC(a, b, c, d) ((unsigned int) (a) | ((unsigned int) (b) << 8) | \
+                            ((unsigned int) (c) << 16) | ((unsigned int) (d) << 24))
+
+// DDS_HEADER as dwords, counted from the magic number
+enum
+{
+   HDR_MAGIC, HDR_SIZE, HDR_FLAGS, HDR_HEIGHT, HDR_WIDTH, HDR_PITCH, HDR_DEPTH, HDR_MIPS,
+   HDR_RESERVED1,
+   HDR_PF_SIZE = HDR_RESERVED1 + 11, HDR_PF_FLAGS, HDR_PF_FOURCC, HDR_PF_BITS,
+   HDR_PF_RMASK, HDR_PF_GMASK, HDR_PF_BMASK, HDR_PF_AMASK,
+   HDR_CAPS, HDR_CAPS2, HDR_CAPS3, HDR_CAPS4, HDR_RESERVED2,
+   HDR_DWORDS
+};
+
+enum
+{
+   DDSD_CAPS = 0x1, DDSD_HEIGHT = 0x2, DDSD_WIDTH = 0x4, DDSD_PITCH = 0x8,
+   DDSD_PIXELFORMAT = 0x1000, DDSD_MIPMAPCOUNT = 0x20000, DDSD_LINEARSIZE = 0x80000,
+   DDPF_ALPHAPIXELS = 0x1, DDPF_FOURCC = 0x4, DDPF_RGB = 0x40,
+   DDSCAPS_COMPLEX = 0x8, DDSCAPS_TEXTURE = 0x1000, DDSCAPS_MIPMAP = 0x400000
+};
+
+static const unsigned int SOURCE_TAG = FOURCC('X', 'X', 'H', '6');   // in reserved1[0]
+
+
+static bool isBlocks(DdsFormat format)
+{
+   return format == DDS_DXT1 || format == DDS_DXT5;
+}
+
+
+int ddsPitch(DdsFormat format, int width)
+{
+   switch (format)
+   {
+   case DDS_BGRA8:
+   case DDS_BGRX8:
+      return width * 4;
+   case DDS_DXT1:
+      return (width + 3) / 4 * 8;
+   case DDS_DXT5:
+      return (width + 3) / 4 * 16;
+   default:
+      return 0;
+   }
+}
+
+
+int ddsRows(DdsFormat format, int height)
+{
+   return isBlocks(format) ? (height + 3) / 4 : height;
+}
+
+
+size_t ddsLevelBytes(DdsFormat format, int width, int height)
+{
+   return (size_t) ddsPitch(format, width) * ddsRows(format, height);
+}
+
+
+static int nextSize(int n)
+{
+   return n > 1 ? n / 2 : 1;
+}
+
+
+bool writeDds(const char * filename, DdsFormat format, int width, int height,
+              unsigned int levels, const void * data, Hash64 sourceHash)
+{
+   unsigned int h[HDR_DWORDS];
+   std::string temp = std::string(filename) + ".tmp";
+   size_t total = 0;
+   unsigned int i;
+   int w = width, ht = height;
+   FILE * file;
+   bool ok;
+
+   for (i = 0; i < levels; i++)
+   {
+      total += ddsLevelBytes(format, w, ht);
+      w = nextSize(w);
+      ht = nextSize(ht);
+   }
+   if (total == 0)
+      return false;
+
+   memset(h, 0, sizeof(h));
+   h[HDR_MAGIC] = FOURCC('D', 'D', 'S', ' ');
+   h[HDR_SIZE] = 124;
+   h[HDR_FLAGS] = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT;
+   h[HDR_HEIGHT] = height;
+   h[HDR_WIDTH] = width;
+   if (isBlocks(format))
+   {  // compressed formats give the size of the top level instead of the pitch
+      h[HDR_FLAGS] |= DDSD_LINEARSIZE;
+      h[HDR_PITCH] = (unsigned int) ddsLevelBytes(format, width, height);
+   }
+   else
+   {
+      h[HDR_FLAGS] |= DDSD_PITCH;
+      h[HDR_PITCH] = ddsPitch(format, width);
+   }
+   h[HDR_CAPS] = DDSCAPS_TEXTURE;
+   if (levels > 1)
+   {
+      h[HDR_FLAGS] |= DDSD_MIPMAPCOUNT;
+      h[HDR_MIPS] = levels;
+      h[HDR_CAPS] |= DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
+   }
+   if (sourceHash)
+   {
+      h[HDR_RESERVED1] = SOURCE_TAG;
+      h[HDR_RESERVED1 + 1] = (unsigned int) sourceHash;
+      h[HDR_RESERVED1 + 2] = (unsigned int) (sourceHash >> 32);
+   }
+
+   h[HDR_PF_SIZE] = 32;
+   if (isBlocks(format))
+   {
+      h[HDR_PF_FLAGS] = DDPF_FOURCC;
+      h[HDR_PF_FOURCC] = format == DDS_DXT1 ? FOURCC('D', 'X', 'T', '1') : FOURCC('D', 'X', 'T', '5');
+   }
+   else
+   {
+      h[HDR_PF_FLAGS] = DDPF_RGB | (format == DDS_BGRA8 ? DDPF_ALPHAPIXELS : 0);
+      h[HDR_PF_BITS] = 32;
+      h[HDR_PF_RMASK] = 0x00FF0000;
+      h[HDR_PF_GMASK] = 0x0000FF00;
+      h[HDR_PF_BMASK] = 0x000000FF;
+      h[HDR_PF_AMASK] = format == DDS_BGRA8 ? 0xFF000000 : 0;
+   }
+
+   file = fopen(temp.c_str(), "wb");
+   if (file == NULL)
+      return false;
+   ok = fwrite(h, sizeof(h), 1, file) == 1 && fwrite(data, total, 1, file) == 1;
+   ok = fclose(file) == 0 && ok;
+
+   remove(filename);   // rename won't replace a file on Windows
+   if (!ok || rename(temp.c_str(), filename) != 0)
+   {
+      remove(temp.c_str());
+      return false;
+   }
+   return true;
+}
+
+
+DdsFile::DdsFile()
+{
+   m_data = NULL;
+   m_size = 0;
+   m_format = DDS_UNKNOWN;
+   m_width = m_height = 0;
+   m_levels = 0;
+   m_sourceHash = 0;
+}
+
+
+bool DdsFile::open(const char * filename)
+{
+   if (!m_file.open(filename))
+      return false;
+   if (!open(m_file.data(), m_file.size()))
+   {
+      close();
+      return false;
+   }
+   return true;
+}
+
+
+bool DdsFile::open(const void * data, size_t bytes)
+{
+   unsigned int h[HDR_DWORDS];
+   size_t total = 0;
+   unsigned int i;
+   int w, ht;
+
+   m_data = (const unsigned char *) data;
+   m_size = bytes;
+   if (m_size < sizeof(h))
+   {
+      close();
+      return false;
+   }
+   memcpy(h, m_data, sizeof(h));
+
+   m_format = DDS_UNKNOWN;
+   if ((h[HDR_PF_FLAGS] & DDPF_FOURCC) && h[HDR_PF_FOURCC] == FOURCC('D', 'X', 'T', '1'))
+      m_format = DDS_DXT1;
+   else if ((h[HDR_PF_FLAGS] & DDPF_FOURCC) && h[HDR_PF_FOURCC] == FOURCC('D', 'X', 'T', '5'))
+      m_format = DDS_DXT5;
+   else if ((h[HDR_PF_FLAGS] & DDPF_RGB) && h[HDR_PF_BITS] == 32 && h[HDR_PF_RMASK] == 0x00FF0000 &&
+       h[HDR_PF_GMASK] == 0x0000FF00 && h[HDR_PF_BMASK] == 0x000000FF)
+      m_format = (h[HDR_PF_FLAGS] & DDPF_ALPHAPIXELS) && h[HDR_PF_AMASK] == 0xFF000000 ? DDS_BGRA8 : DDS_BGRX8;
+
+   m_width = (int) h[HDR_WIDTH];
+   m_height = (int) h[HDR_HEIGHT];
+   m_levels = (h[HDR_FLAGS] & DDSD_MIPMAPCOUNT) && h[HDR_MIPS] ? h[HDR_MIPS] : 1;
+   m_sourceHash = h[HDR_RESERVED1] == SOURCE_TAG ?
+                  h[HDR_RESERVED1 + 1] | ((Hash64) h[HDR_RESERVED1 + 2] << 32) : 0;
+
+   // cube maps and volumes (caps2) aren't wanted here
+   if (h[HDR_MAGIC] != FOURCC('D', 'D', 'S', ' ') || h[HDR_SIZE] != 124 || h[HDR_PF_SIZE] != 32 ||
+       m_format == DDS_UNKNOWN || h[HDR_CAPS2] != 0 || m_width <= 0 || m_height <= 0 ||
+       m_width > 65536 || m_height > 65536 || m_levels > 17)
+   {
+      close();
+      return false;
+   }
+
+   for (i = 0, w = m_width, ht = m_height; i < m_levels; i++)
+   {
+      total += ddsLevelBytes(m_format, w, ht);
+      w = nextSize(w);
+      ht = nextSize(ht);
+   }
+   if (m_size - sizeof(h) < total)
+   {
+      close();
+      return false;
+   }
+   return true;
+}
+
+
+DdsLevel DdsFile::level(unsigned int i) const
+{
+   DdsLevel l;
+   const unsigned char * p = m_data + HDR_DWORDS * 4;
+   unsigned int k;
+
+   l.width = m_width;
+   l.height = m_height;
+   for (k = 0; k < i; k++)
+   {
+      p += ddsLevelBytes(m_format, l.width, l.height);
+      l.width = nextSize(l.width);
+      l.height = nextSize(l.height);
+   }
+   l.data = p;
+   l.pitch = ddsPitch(m_format, l.width);
+   l.rows = ddsRows(m_format, l.height);
+   l.bytes = ddsLevelBytes(m_format, l.width, l.height);
+   return l;
+}
@@ -0,0 +1,79 @@
+/* Filename:  Dds.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Reads and writes DirectDraw Surface (.dds) files, the format D3DX and
+   the DirectX texture tool use, holding a texture with all its mip levels
+   ready to copy into a locked texture.  Files are read through a
+   MappedFile, or straight out of memory such as an AssetPack, so the
+   levels are used where they lie.
+
+   The files the tools write carry the xxHash64 of the file they were made
+   from in the header's reserved words, so a loader can tell whether a
+   cached .dds still matches its source.  Other programs ignore it.
+*/
+
+#ifndef DDS_H
+#define DDS_H
+
+#include <stddef.h>
+#include "Hash.h"
+#include "MappedFile.h"
+
+
+enum DdsFormat
+{
+   DDS_UNKNOWN,
+   DDS_BGRA8,   // D3DFMT_A8R8G8B8
+   DDS_BGRX8,   // D3DFMT_X8R8G8B8
+   DDS_DXT1,    // D3DFMT_DXT1, BLOCK_BC1 in BlockCompress.h
+   DDS_DXT5     // D3DFMT_DXT5, BLOCK_BC3
+};
+
+struct DdsLevel
+{
+   int width, height;
+   const void * data;
+   int pitch;        // bytes from one row to the next..
+   int rows;         // .. and how many, which for DXT is rows of 4x4 blocks
+   size_t bytes;
+};
+
+// bytes one level of the format takes, rows packed
+size_t ddsLevelBytes(DdsFormat format, int width, int height);
+int ddsPitch(DdsFormat format, int width);
+int ddsRows(DdsFormat format, int height);
+
+// levels is every level, largest first, rows packed one after the other..
+// written to a temporary file first so a half written file is never seen
+bool writeDds(const char * filename, DdsFormat format, int width, int height,
+              unsigned int levels, const void * data, Hash64 sourceHash = 0);
+
+
+class DdsFile
+{
+public:
+   DdsFile();
+
+   bool open(const char * filename);   // false unless it is a 2D texture in one of the formats above
+   bool open(const void * data, size_t bytes);   // one already in memory, which must outlive this
+   void close() { m_file.close(); m_data = NULL; m_size = 0; }
+
+   DdsFormat format() const { return m_format; }
+   int width() const { return m_width; }
+   int height() const { return m_height; }
+   unsigned int levels() const { return m_levels; }
+   DdsLevel level(unsigned int i) const;
+   Hash64 sourceHash() const { return m_sourceHash; }   // 0 if it doesn't have one
+
+private:
+   MappedFile m_file;
+   const unsigned char * m_data;
+   size_t m_size;
+   DdsFormat m_format;
+   int m_width, m_height;
+   unsigned int m_levels;
+   Hash64 m_sourceHash;
+};
+
+#endif
@@ -0,0 +1,980 @@
+/* Filename:  DeviceCapture.cpp
+
+   This file accompanies DeviceCapture.h.
+*/
+
+#include "DeviceCapture.h"
+#include <string.h>
+
+static_assert(sizeof(D3DMATRIX) == 16 * 4, "a matrix is 16 words in a capture");
+static_assert(sizeof(D3DMATERIAL9) == 17 * 4, "a material is 17 words in a capture");
+static_assert(sizeof(D3DLIGHT9) == 26 * 4, "a light is 26 words in a capture");
+
+
+UINT captureRowBytes(D3DFORMAT format, UINT width)
+{
+   switch (format)
+   {
+   case D3DFMT_DXT1:
+      return (width + 3) / 4 * 8;
+   case D3DFMT_DXT2:
+   case D3DFMT_DXT3:
+   case D3DFMT_DXT4:
+   case D3DFMT_DXT5:
+      return (width + 3) / 4 * 16;
+   case D3DFMT_A8R8G8B8:
+   case D3DFMT_X8R8G8B8:
+      return width * 4;
+   case D3DFMT_R8G8B8:
+      return width * 3;
+   case D3DFMT_R5G6B5:
+   case D3DFMT_X1R5G5B5:
+   case D3DFMT_A1R5G5B5:
+   case D3DFMT_A4R4G4B4:
+      return width * 2;
+   case D3DFMT_A8:
+   case D3DFMT_P8:
+   case D3DFMT_L8:
+      return width;
+   default:
+      return 0;
+   }
+}
+
+
+UINT captureRows(D3DFORMAT format, UINT height)
+{
+   if (format == D3DFMT_DXT1 || format == D3DFMT_DXT2 || format == D3DFMT_DXT3 ||
+       format == D3DFMT_DXT4 || format == D3DFMT_DXT5)
+      return (height + 3) / 4;
+   return height;
+}
+
+
+//*******
+// reading
+
+CaptureReader::CaptureReader()
+   : m_pos(0), m_damaged(false)
+{
+}
+
+
+bool CaptureReader::open(const char * filename)
+{
+   close();
+   if (!m_file.open(filename))
+      return false;
+   if (m_file.size() < 8 || memcmp(m_file.data(), CAPTURE_MAGIC, 8) != 0)
+   {
+      m_file.close();
+      return false;
+   }
+   rewind();
+   return true;
+}
+
+
+void CaptureReader::close()
+{
+   m_file.close();
+   m_pos = 0;
+   m_damaged = false;
+}
+
+
+void CaptureReader::rewind()
+{
+   m_pos = 8;
+   m_damaged = false;
+}
+
+
+int CaptureReader::argCount(CaptureOp op)
+{
+   static const signed char counts[CAPTURE_OPS] =
+   {
+      -1,            // 0 isn't used
+      0, 0, 0,       // frame, begin scene, end scene
+      6,             // clear
+      5, 5, 1,       // create vb, create ib, release
+      3, 6, 2,       // buffer data, texture, set texture
+      2, 3, 3,       // render, stage and sampler states
+      17, 17, 27, 2, // transform, material, light, light enable
+      1, 4, 1,       // fvf, stream, indices
+      3, 6           // draw, draw indexed
+   };
+
+   return (unsigned int) op < CAPTURE_OPS ? counts[op] : -1;
+}
+
+
+const char * CaptureReader::opName(CaptureOp op)
+{
+   static const char * names[CAPTURE_OPS] =
+   {
+      "", "frame", "begin_scene", "end_scene", "clear", "create_vb", "create_ib", "release",
+      "buffer_data", "texture", "set_texture", "render_state", "stage_state", "sampler_state",
+      "transform", "material", "light", "light_enable", "fvf", "stream", "indices", "draw",
+      "draw_indexed"
+   };
+
+   return (unsigned int) op < CAPTURE_OPS ? names[op] : "";
+}
+
+
+bool CaptureReader::next(CaptureRecord & record)
+{
+   const unsigned char * p = m_file.data();
+   size_t size = m_file.size(), fixed, tail = 0;
+   int count;
+
+   if (m_damaged || m_pos >= size)
+      return false;
+   record.op = (CaptureOp) p[m_pos];
+   count = argCount(record.op);
+   fixed = 1 + (size_t) (count < 0 ? 0 : count) * 4;
+   if (count < 0 || size - m_pos < fixed)
+   {
+      m_damaged = true;
+      return false;
+   }
+   memcpy(record.args, p + m_pos + 1, fixed - 1);   // the file needn't be aligned
+   if (record.op == CAP_CLEAR || record.op == CAP_BUFFER_DATA || record.op == CAP_TEXTURE)
+      tail = record.args[count - 1];
+   if (size - m_pos - fixed < tail)
+   {
+      m_damaged = true;
+      return false;
+   }
+   record.data = tail ? p + m_pos + fixed : NULL;
+   record.dataBytes = (UINT) tail;
+   record.bytes = (UINT) (fixed + tail);
+   m_pos += fixed + tail;
+   return true;
+}
+
+
+//*******
+// recording
+
+CaptureDevice::CaptureDevice(IDirect3DDevice9 * device, unsigned int window)
+   : CountingDevice(device, window), m_file(NULL), m_live(false), m_writeFailed(false), m_framesRecorded(0),
+     m_indices(0), m_fvf(0), m_nextTexture(1)
+{
+   int i;
+
+   for (i = 0; i < STREAMS; i++)
+      m_streams[i].id = m_streams[i].offset = m_streams[i].stride = 0;
+   for (i = 0; i < STAGES; i++)
+      m_stageTextures[i] = NULL;
+   for (i = 0; i < LIGHTS; i++)
+      m_lightSet[i] = m_lightOn[i] = false;
+   memset(&m_material, 0, sizeof(m_material));
+}
+
+
+CaptureDevice::~CaptureDevice()
+{
+   stop();
+}
+
+
+bool CaptureDevice::start(const char * filename)
+{
+   stop();
+   m_file = fopen(filename, "wb");
+   if (m_file == NULL)
+      return false;
+   setvbuf(m_file, NULL, _IOFBF, 1 << 20);
+   m_writeFailed = fwrite(CAPTURE_MAGIC, 8, 1, m_file) != 1;
+   m_live = false;   // until the next frame
+   m_framesRecorded = 0;
+   return true;
+}
+
+
+bool CaptureDevice::stop()
+{
+   bool ok;
+
+   if (m_file == NULL)
+      return true;
+   ok = !m_writeFailed && ferror(m_file) == 0;
+   ok = fclose(m_file) == 0 && ok;
+   m_file = NULL;
+   m_live = false;
+   m_textures.clear();
+   return ok;
+}
+
+
+void CaptureDevice::put(CaptureOp op, const UINT * args, const void * data, UINT bytes)
+{
+   unsigned char code = (unsigned char) op;
+   int count = CaptureReader::argCount(op);
+
+   if (fwrite(&code, 1, 1, m_file) != 1 || (count > 0 && fwrite(args, 4, count, m_file) != (size_t) count) ||
+       (bytes && fwrite(data, 1, bytes, m_file) != bytes))
+      m_writeFailed = true;
+}
+
+
+void CaptureDevice::putBuffer(unsigned int id)
+{
+   const BufferCopy & b = m_buffers[id];
+   UINT bytes = (UINT) b.data.size();
+   UINT create[5] = { id, bytes, b.usage, b.format, (UINT) b.pool };
+   UINT data[3] = { id, 0, bytes };
+
+   put(b.index ? CAP_CREATE_IB : CAP_CREATE_VB, create);
+   if (bytes)
+      put(CAP_BUFFER_DATA, data, &b.data[0], bytes);
+}
+
+
+// the first frame of a recording starts with what is already there
+void CaptureDevice::beginRecording()
+{
+   unsigned int i;
+
+   memset(m_renderWritten, 0, sizeof(m_renderWritten));
+   memset(m_stageWritten, 0, sizeof(m_stageWritten));
+   memset(m_samplerWritten, 0, sizeof(m_samplerWritten));
+   memset(m_transformWritten, 0, sizeof(m_transformWritten));
+   m_textures.clear();
+   m_nextTexture = 1;
+   m_live = true;
+
+   for (i = 0; i < m_buffers.size(); i++)
+      if (m_buffers[i].live)
+         putBuffer(i);
+
+   UINT material[17];
+   memcpy(material, &m_material, sizeof(material));
+   put(CAP_MATERIAL, material);
+   for (i = 0; i < LIGHTS; i++)
+      if (m_lightSet[i])
+      {
+         UINT light[27] = { i }, enable[2] = { i, (UINT) m_lightOn[i] };
+         memcpy(light + 1, &m_lights[i], sizeof(D3DLIGHT9));
+         put(CAP_LIGHT, light);
+         put(CAP_LIGHT_ENABLE, enable);
+      }
+
+   UINT fvf[1] = { m_fvf };
+   put(CAP_FVF, fvf);
+   for (i = 0; i < STREAMS; i++)
+      if (m_streams[i].id)
+      {
+         UINT stream[4] = { i, m_streams[i].id, m_streams[i].offset, m_streams[i].stride };
+         put(CAP_STREAM, stream);
+      }
+   UINT indices[1] = { m_indices };
+   put(CAP_INDICES, indices);
+   for (i = 0; i < STAGES; i++)
+      if (m_stageTextures[i])
+      {
+         UINT texture[2] = { i, textureId(m_stageTextures[i]) };
+         put(CAP_SET_TEXTURE, texture);
+      }
+
+   readBackStates();
+}
+
+
+int CaptureDevice::transformSlot(D3DTRANSFORMSTATETYPE state)
+{
+   if (state == D3DTS_VIEW)
+      return 0;
+   if (state == D3DTS_PROJECTION)
+      return 1;
+   if (state == D3DTS_WORLD)
+      return 2;
+   return -1;
+}
+
+
+// every state the device has that the recording doesn't say it has..
+// after the first frame that is only what a state block put back
+void CaptureDevice::readBackStates()
+{
+   static const D3DTRANSFORMSTATETYPE transforms[3] = { D3DTS_VIEW, D3DTS_PROJECTION, D3DTS_WORLD };
+   IDirect3DDevice9 * real = device();
+   DWORD value, s, t;
+   D3DMATRIX matrix;
+   int i;
+
+   for (s = 1; s < RENDER_STATES; s++)
+      if (SUCCEEDED(real->GetRenderState((D3DRENDERSTATETYPE) s, &value)) &&
+          (!m_renderWritten[s] || m_renderStates[s] != value))
+      {
+         UINT args[2] = { s, value };
+         put(CAP_RENDER_STATE, args);
+         m_renderStates[s] = value;
+         m_renderWritten[s] = true;
+      }
+   for (s = 0; s < STAGES; s++)
+   {
+      for (t = 1; t < STAGE_STATES; t++)
+         if (SUCCEEDED(real->GetTextureStageState(s, (D3DTEXTURESTAGESTATETYPE) t, &value)) &&
+             (!m_stageWritten[s][t] || m_stageStates[s][t] != value))
+         {
+            UINT args[3] = { s, t, value };
+            put(CAP_STAGE_STATE, args);
+            m_stageStates[s][t] = value;
+            m_stageWritten[s][t] = true;
+         }
+      for (t = 1; t < SAMPLER_STATES; t++)
+         if (SUCCEEDED(real->GetSamplerState(s, (D3DSAMPLERSTATETYPE) t, &value)) &&
+             (!m_samplerWritten[s][t] || m_samplerStates[s][t] != value))
+         {
+            UINT args[3] = { s, t, value };
+            put(CAP_SAMPLER_STATE, args);
+            m_samplerStates[s][t] = value;
+            m_samplerWritten[s][t] = true;
+         }
+   }
+   for (i = 0; i < 3; i++)
+      if (SUCCEEDED(real->GetTransform(transforms[i], &matrix)) &&
+          (!m_transformWritten[i] || memcmp(&m_transforms[i], &matrix, sizeof(matrix)) != 0))
+      {
+         UINT args[17] = { (UINT) transforms[i] };
+         memcpy(args + 1, &matrix, sizeof(matrix));
+         put(CAP_TRANSFORM, args);
+         m_transforms[i] = matrix;
+         m_transformWritten[i] = true;
+      }
+}
+
+
+// the texture's number in the recording.. its pixels are read back the
+// first time it is set in a frame, and go in again if they have changed
+unsigned int CaptureDevice::textureId(IDirect3DBaseTexture9 * base)
+{
+   D3DSURFACE_DESC desc;
+   D3DLOCKED_RECT rect;
+   UINT levels, level, w, h, row, rows, y;
+   Hash64 hash;
+
+   if (base == NULL)
+      return 0;
+   TextureSeen & seen = m_textures[base];   // id 0 if it is new
+   if (seen.id && seen.frame == frameNumber())
+      return seen.id;
+
+#ifdef _WIN32
+   if (base->GetType() != D3DRTYPE_TEXTURE)   // cube and volume textures aren't recorded
+      return 0;
+#endif
+   IDirect3DTexture9 * texture = static_cast<IDirect3DTexture9 *>(base);
+   levels = texture->GetLevelCount();
+   if (FAILED(texture->GetLevelDesc(0, &desc)))
+      return 0;
+
+   // every level's rows, packed.. none if it can't be read (D3DPOOL_DEFAULT)
+   m_pixels.clear();
+   for (level = 0, w = desc.Width, h = desc.Height; level < levels; level++)
+   {
+      row = captureRowBytes(desc.Format, w);
+      rows = captureRows(desc.Format, h);
+      if (row == 0 || FAILED(texture->LockRect(level, &rect, NULL, D3DLOCK_READONLY)))
+      {
+         m_pixels.clear();
+         break;
+      }
+      for (y = 0; y < rows; y++)
+      {
+         const unsigned char * src = (const unsigned char *) rect.pBits + (size_t) y * rect.Pitch;
+         m_pixels.insert(m_pixels.end(), src, src + row);
+      }
+      texture->UnlockRect(level);
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+   }
+
+   UINT args[6] = { 0, desc.Width, desc.Height, levels, (UINT) desc.Format, (UINT) m_pixels.size() };
+   hash = xxHash64(args + 1, 5 * sizeof(UINT));
+   if (!m_pixels.empty())
+      hash = xxHash64(&m_pixels[0], m_pixels.size(), hash);
+   seen.frame = frameNumber();
+   if (seen.id && seen.hash == hash)
+      return seen.id;
+   seen.id = m_nextTexture++;
+   seen.hash = hash;
+   args[0] = seen.id;
+   put(CAP_TEXTURE, args, m_pixels.empty() ? NULL : &m_pixels[0], args[5]);
+   return seen.id;
+}
+
+
+void CaptureDevice::endFrame()
+{
+   if (m_live)
+   {
+      put(CAP_FRAME, NULL);
+      m_framesRecorded++;
+   }
+   CountingDevice::endFrame();
+   if (m_file && !m_live)
+      beginRecording();
+   else if (m_live)
+      readBackStates();
+}
+
+
+void CaptureDevice::unlocked(unsigned int id, UINT offset, UINT bytes, const void * data)
+{
+   if (id >= m_buffers.size())
+      return;
+   std::vector<unsigned char> & copy = m_buffers[id].data;
+   if (offset > copy.size())
+      return;
+   if (bytes > copy.size() - offset)
+      bytes = (UINT) (copy.size() - offset);
+   memcpy(&copy[0] + offset, data, bytes);
+   if (m_live)
+   {
+      UINT args[3] = { id, offset, bytes };
+      put(CAP_BUFFER_DATA, args, data, bytes);
+   }
+}
+
+
+void CaptureDevice::released(unsigned int id)
+{
+   if (id >= m_buffers.size())
+      return;
+   m_buffers[id].live = false;
+   std::vector<unsigned char>().swap(m_buffers[id].data);
+   if (m_live)
+   {
+      UINT args[1] = { id };
+      put(CAP_RELEASE, args);
+   }
+}
+
+
+STDMETHODIMP CaptureDevice::CreateVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                               IDirect3DVertexBuffer9 ** buffer, HANDLE * shared)
+{
+   HRESULT hr = CountingDevice::CreateVertexBuffer(bytes, usage, fvf, pool, buffer, shared);
+   unsigned int id;
+
+   if (FAILED(hr))
+      return hr;
+   id = static_cast<CountingVertexBuffer *>(*buffer)->id();
+   if (id >= m_buffers.size())
+      m_buffers.resize(id + 1);
+   BufferCopy & b = m_buffers[id];
+   b.live = true;
+   b.index = false;
+   b.usage = usage;
+   b.format = fvf;
+   b.pool = pool;
+   b.data.assign(bytes, 0);
+   if (m_live)
+   {
+      UINT args[5] = { id, bytes, usage, fvf, (UINT) pool };
+      put(CAP_CREATE_VB, args);
+   }
+   return hr;
+}
+
+
+STDMETHODIMP CaptureDevice::CreateIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                              IDirect3DIndexBuffer9 ** buffer, HANDLE * shared)
+{
+   HRESULT hr = CountingDevice::CreateIndexBuffer(bytes, usage, format, pool, buffer, shared);
+   unsigned int id;
+
+   if (FAILED(hr))
+      return hr;
+   id = static_cast<CountingIndexBuffer *>(*buffer)->id();
+   if (id >= m_buffers.size())
+      m_buffers.resize(id + 1);
+   BufferCopy & b = m_buffers[id];
+   b.live = true;
+   b.index = true;
+   b.usage = usage;
+   b.format = (DWORD) format;
+   b.pool = pool;
+   b.data.assign(bytes, 0);
+   if (m_live)
+   {
+      UINT args[5] = { id, bytes, usage, (UINT) format, (UINT) pool };
+      put(CAP_CREATE_IB, args);
+   }
+   return hr;
+}
+
+
+STDMETHODIMP CaptureDevice::BeginScene()
+{
+   if (m_live)
+      put(CAP_BEGIN_SCENE, NULL);
+   return CountingDevice::BeginScene();
+}
+
+
+STDMETHODIMP CaptureDevice::EndScene()
+{
+   if (m_live)
+      put(CAP_END_SCENE, NULL);
+   return CountingDevice::EndScene();
+}
+
+
+STDMETHODIMP CaptureDevice::Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z,
+                                  DWORD stencil)
+{
+   if (m_live)
+   {
+      UINT bytes = rects ? count * (UINT) sizeof(D3DRECT) : 0;
+      UINT args[6] = { rects ? count : 0, flags, color, 0, stencil, bytes };
+      memcpy(&args[3], &z, 4);
+      put(CAP_CLEAR, args, rects, bytes);
+   }
+   return CountingDevice::Clear(count, rects, flags, color, z, stencil);
+}
+
+
+STDMETHODIMP CaptureDevice::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix)
+{
+   int slot = transformSlot(state);
+
+   if (m_live && matrix)
+   {
+      UINT args[17] = { (UINT) state };
+      memcpy(args + 1, matrix, sizeof(D3DMATRIX));
+      put(CAP_TRANSFORM, args);
+      if (slot >= 0)
+      {
+         m_transforms[slot] = *matrix;
+         m_transformWritten[slot] = true;
+      }
+   }
+   return CountingDevice::SetTransform(state, matrix);
+}
+
+
+STDMETHODIMP CaptureDevice::SetMaterial(const D3DMATERIAL9 * material)
+{
+   if (material)
+   {
+      m_material = *material;
+      if (m_live)
+      {
+         UINT args[17];
+         memcpy(args, material, sizeof(args));
+         put(CAP_MATERIAL, args);
+      }
+   }
+   return CountingDevice::SetMaterial(material);
+}
+
+
+STDMETHODIMP CaptureDevice::SetLight(DWORD index, const D3DLIGHT9 * light)
+{
+   if (light && index < LIGHTS)
+   {
+      m_lights[index] = *light;
+      m_lightSet[index] = true;
+   }
+   if (light && m_live)
+   {
+      UINT args[27] = { index };
+      memcpy(args + 1, light, sizeof(D3DLIGHT9));
+      put(CAP_LIGHT, args);
+   }
+   return CountingDevice::SetLight(index, light);
+}
+
+
+STDMETHODIMP CaptureDevice::LightEnable(DWORD index, BOOL enable)
+{
+   if (index < LIGHTS)
+      m_lightOn[index] = enable != 0;
+   if (m_live)
+   {
+      UINT args[2] = { index, (UINT) enable };
+      put(CAP_LIGHT_ENABLE, args);
+   }
+   return CountingDevice::LightEnable(index, enable);
+}
+
+
+STDMETHODIMP CaptureDevice::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+   unsigned int s = (unsigned int) state;
+
+   if (m_live)
+   {
+      UINT args[2] = { s, value };
+      put(CAP_RENDER_STATE, args);
+      if (s < RENDER_STATES)
+      {
+         m_renderStates[s] = value;
+         m_renderWritten[s] = true;
+      }
+   }
+   return CountingDevice::SetRenderState(state, value);
+}
+
+
+STDMETHODIMP CaptureDevice::SetTexture(DWORD stage, IDirect3DBaseTexture9 * texture)
+{
+   if (stage < STAGES)
+      m_stageTextures[stage] = texture;
+   if (m_live)
+   {
+      UINT args[2] = { stage, textureId(texture) };
+      put(CAP_SET_TEXTURE, args);
+   }
+   return CountingDevice::SetTexture(stage, texture);
+}
+
+
+STDMETHODIMP CaptureDevice::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+   unsigned int t = (unsigned int) type;
+
+   if (m_live)
+   {
+      UINT args[3] = { stage, t, value };
+      put(CAP_STAGE_STATE, args);
+      if (stage < STAGES && t < STAGE_STATES)
+      {
+         m_stageStates[stage][t] = value;
+         m_stageWritten[stage][t] = true;
+      }
+   }
+   return CountingDevice::SetTextureStageState(stage, type, value);
+}
+
+
+STDMETHODIMP CaptureDevice::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+   unsigned int t = (unsigned int) type;
+
+   if (m_live)
+   {
+      UINT args[3] = { sampler, t, value };
+      put(CAP_SAMPLER_STATE, args);
+      if (sampler < STAGES && t < SAMPLER_STATES)
+      {
+         m_samplerStates[sampler][t] = value;
+         m_samplerWritten[sampler][t] = true;
+      }
+   }
+   return CountingDevice::SetSamplerState(sampler, type, value);
+}
+
+
+STDMETHODIMP CaptureDevice::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count)
+{
+   if (m_live)
+   {
+      UINT args[3] = { (UINT) type, startVertex, count };
+      put(CAP_DRAW, args);
+   }
+   return CountingDevice::DrawPrimitive(type, startVertex, count);
+}
+
+
+STDMETHODIMP CaptureDevice::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                                 UINT numVertices, UINT startIndex, UINT count)
+{
+   if (m_live)
+   {
+      UINT args[6] = { (UINT) type, (UINT) baseVertex, minIndex, numVertices, startIndex, count };
+      put(CAP_DRAW_INDEXED, args);
+   }
+   return CountingDevice::DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, count);
+}
+
+
+STDMETHODIMP CaptureDevice::SetFVF(DWORD fvf)
+{
+   m_fvf = fvf;
+   if (m_live)
+   {
+      UINT args[1] = { fvf };
+      put(CAP_FVF, args);
+   }
+   return CountingDevice::SetFVF(fvf);
+}
+
+
+STDMETHODIMP CaptureDevice::SetStreamSource(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset, UINT stride)
+{
+   unsigned int id = buffer ? static_cast<CountingVertexBuffer *>(buffer)->id() : 0;
+
+   if (stream < STREAMS)
+   {
+      m_streams[stream].id = id;
+      m_streams[stream].offset = offset;
+      m_streams[stream].stride = stride;
+   }
+   if (m_live)
+   {
+      UINT args[4] = { stream, id, offset, stride };
+      put(CAP_STREAM, args);
+   }
+   return CountingDevice::SetStreamSource(stream, buffer, offset, stride);
+}
+
+
+STDMETHODIMP CaptureDevice::SetIndices(IDirect3DIndexBuffer9 * buffer)
+{
+   m_indices = buffer ? static_cast<CountingIndexBuffer *>(buffer)->id() : 0;
+   if (m_live)
+   {
+      UINT args[1] = { m_indices };
+      put(CAP_INDICES, args);
+   }
+   return CountingDevice::SetIndices(buffer);
+}
+
+
+//*******
+// playing back
+
+CaptureReplay::CaptureReplay()
+   : m_frame(0), m_failed(0)
+{
+}
+
+
+CaptureReplay::~CaptureReplay()
+{
+   close();
+}
+
+
+bool CaptureReplay::open(const char * filename)
+{
+   close();
+   return m_reader.open(filename);
+}
+
+
+void CaptureReplay::close()
+{
+   releaseAll();
+   m_reader.close();
+   m_frame = 0;
+   m_failed = 0;
+}
+
+
+void CaptureReplay::rewind()
+{
+   releaseAll();
+   m_reader.rewind();
+   m_frame = 0;
+}
+
+
+void CaptureReplay::releaseAll()
+{
+   size_t i;
+
+   for (i = 0; i < m_vertexBuffers.size(); i++)
+      if (m_vertexBuffers[i])
+         m_vertexBuffers[i]->Release();
+   for (i = 0; i < m_indexBuffers.size(); i++)
+      if (m_indexBuffers[i])
+         m_indexBuffers[i]->Release();
+   for (i = 0; i < m_textures.size(); i++)
+      if (m_textures[i])
+         m_textures[i]->Release();
+   m_vertexBuffers.clear();
+   m_indexBuffers.clear();
+   m_textures.clear();
+}
+
+
+bool CaptureReplay::playFrame(IDirect3DDevice9 * device)
+{
+   CaptureRecord r;
+
+   while (m_reader.next(r))
+   {
+      play(device, r);
+      if (r.op == CAP_FRAME)
+      {
+         m_frame++;
+         return true;
+      }
+   }
+   return false;
+}
+
+
+// slot id of a list of objects made on the device, let go of if it is taken
+template <class T> static T *& slot(std::vector<T *> & list, UINT id)
+{
+   if (id >= list.size())
+      list.resize(id + 1, NULL);
+   if (list[id])
+   {
+      list[id]->Release();
+      list[id] = NULL;
+   }
+   return list[id];
+}
+
+template <class T> static T * find(const std::vector<T *> & list, UINT id)
+{
+   return id < list.size() ? list[id] : NULL;
+}
+
+
+void CaptureReplay::play(IDirect3DDevice9 * device, const CaptureRecord & r)
+{
+   const UINT * a = r.args;
+   HRESULT hr = D3D_OK;
+   float f;
+   void * p;
+
+   switch (r.op)
+   {
+   case CAP_FRAME:
+      device->Present(NULL, NULL, NULL, NULL);   // a lost device is the caller's to deal with
+      break;
+   case CAP_BEGIN_SCENE:
+      hr = device->BeginScene();
+      break;
+   case CAP_END_SCENE:
+      hr = device->EndScene();
+      break;
+   case CAP_CLEAR:
+      {
+         std::vector<D3DRECT> rects(a[0] ? a[0] : 1);
+         if (r.dataBytes != a[0] * sizeof(D3DRECT))
+            break;
+         if (a[0])
+            memcpy(&rects[0], r.data, r.dataBytes);
+         memcpy(&f, &a[3], 4);
+         hr = device->Clear(a[0], a[0] ? &rects[0] : NULL, a[1], a[2], f, a[4]);
+      }
+      break;
+   case CAP_CREATE_VB:
+      hr = device->CreateVertexBuffer(a[1], a[2], a[3], (D3DPOOL) a[4], &slot(m_vertexBuffers, a[0]), NULL);
+      break;
+   case CAP_CREATE_IB:
+      hr = device->CreateIndexBuffer(a[1], a[2], (D3DFORMAT) a[3], (D3DPOOL) a[4], &slot(m_indexBuffers, a[0]),
+                                     NULL);
+      break;
+   case CAP_RELEASE:
+      if (find(m_vertexBuffers, a[0]))
+         slot(m_vertexBuffers, a[0]);
+      if (find(m_indexBuffers, a[0]))
+         slot(m_indexBuffers, a[0]);
+      break;
+   case CAP_BUFFER_DATA:
+      if (IDirect3DVertexBuffer9 * vb = find(m_vertexBuffers, a[0]))
+      {
+         if (SUCCEEDED(hr = vb->Lock(a[1], a[2], &p, 0)))
+         {
+            memcpy(p, r.data, a[2]);
+            vb->Unlock();
+         }
+      }
+      else if (IDirect3DIndexBuffer9 * ib = find(m_indexBuffers, a[0]))
+      {
+         if (SUCCEEDED(hr = ib->Lock(a[1], a[2], &p, 0)))
+         {
+            memcpy(p, r.data, a[2]);
+            ib->Unlock();
+         }
+      }
+      else
+         hr = D3DERR_INVALIDCALL;
+      break;
+   case CAP_TEXTURE:
+      {
+         IDirect3DTexture9 *& texture = slot(m_textures, a[0]);
+         D3DFORMAT format = (D3DFORMAT) a[4];
+         D3DLOCKED_RECT rect;
+         UINT level, w = a[1], h = a[2], row, rows, y;
+         const unsigned char * src = r.data;
+         size_t left = r.dataBytes;
+
+         hr = device->CreateTexture(a[1], a[2], a[3], 0, format, D3DPOOL_MANAGED, &texture, NULL);
+         for (level = 0; SUCCEEDED(hr) && left && level < a[3]; level++)
+         {
+            row = captureRowBytes(format, w);
+            rows = captureRows(format, h);
+            if ((size_t) row * rows > left)
+               break;
+            if (SUCCEEDED(hr = texture->LockRect(level, &rect, NULL, 0)))
+            {
+               for (y = 0; y < rows; y++, src += row)
+                  memcpy((unsigned char *) rect.pBits + (size_t) y * rect.Pitch, src, row);
+               texture->UnlockRect(level);
+               left -= (size_t) row * rows;
+            }
+            w = w > 1 ? w / 2 : 1;
+            h = h > 1 ? h / 2 : 1;
+         }
+      }
+      break;
+   case CAP_SET_TEXTURE:
+      hr = device->SetTexture(a[0], find(m_textures, a[1]));
+      break;
+   case CAP_RENDER_STATE:
+      hr = device->SetRenderState((D3DRENDERSTATETYPE) a[0], a[1]);
+      break;
+   case CAP_STAGE_STATE:
+      hr = device->SetTextureStageState(a[0], (D3DTEXTURESTAGESTATETYPE) a[1], a[2]);
+      break;
+   case CAP_SAMPLER_STATE:
+      hr = device->SetSamplerState(a[0], (D3DSAMPLERSTATETYPE) a[1], a[2]);
+      break;
+   case CAP_TRANSFORM:
+      {
+         D3DMATRIX matrix;
+         memcpy(&matrix, a + 1, sizeof(matrix));
+         hr = device->SetTransform((D3DTRANSFORMSTATETYPE) a[0], &matrix);
+      }
+      break;
+   case CAP_MATERIAL:
+      {
+         D3DMATERIAL9 material;
+         memcpy(&material, a, sizeof(material));
+         hr = device->SetMaterial(&material);
+      }
+      break;
+   case CAP_LIGHT:
+      {
+         D3DLIGHT9 light;
+         memcpy(&light, a + 1, sizeof(light));
+         hr = device->SetLight(a[0], &light);
+      }
+      break;
+   case CAP_LIGHT_ENABLE:
+      hr = device->LightEnable(a[0], (BOOL) a[1]);
+      break;
+   case CAP_FVF:
+      hr = device->SetFVF(a[0]);
+      break;
+   case CAP_STREAM:
+      hr = device->SetStreamSource(a[0], find(m_vertexBuffers, a[1]), a[2], a[3]);
+      break;
+   case CAP_INDICES:
+      hr = device->SetIndices(find(m_indexBuffers, a[0]));
+      break;
+   case CAP_DRAW:
+      hr = device->DrawPrimitive((D3DPRIMITIVETYPE) a[0], a[1], a[2]);
+      break;
+   case CAP_DRAW_INDEXED:
+      hr = device->DrawIndexedPrimitive((D3DPRIMITIVETYPE) a[0], (INT) a[1], a[2], a[3], a[4], a[5]);
+      break;
+   default:
+      break;
+   }
+   if (FAILED(hr))
+      m_failed++;
+}
@@ -0,0 +1,248 @@
+/* Filename:  DeviceCapture.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Records what a scene asks of the device, frame by frame, into a small
+   binary file, and plays it back onto any device: the real one, the
+   NullDevice from ../headless, or anything else that is an
+   IDirect3DDevice9.  A slow frame in an example can be caught once on a
+   PC and then timed over and over on a machine with no GPU and none of
+   the example's own code (bench/replaybench), and tools/capstat says
+   what is in a capture.
+
+   CaptureDevice is a CountingDevice that also writes every call it
+   passes on once start() is called.  Recording begins at the next frame,
+   and that frame starts with everything needed to draw it: the buffers
+   there are (it keeps a copy of what was written into each), the lights,
+   the streams, the textures bound and every render, stage and sampler
+   state.  States are read back from the device at the start of every
+   frame, too, since a state block (ID3DXSprite, behind DrawText, uses
+   one) can change them without coming through here.  A texture goes in
+   the first time it is set, as its pixels, and again only if they change.
+
+   The file is "D3DCAP01", then records: a byte saying what it is, the
+   fixed 32 bit words that go with it (floats as their bits), then for
+   some a block of bytes whose length is the last of those words.  All
+   little endian, as x86 is.  A frame ends with CAP_FRAME, where Present
+   was.  Calls that can't be played back (the UP draws, shaders) aren't
+   recorded.
+*/
+
+#ifndef DEVICECAPTURE_H
+#define DEVICECAPTURE_H
+
+#include "CountingDevice.h"
+#include "MappedFile.h"
+#include "Hash.h"
+#include <stdio.h>
+#include <map>
+#include <vector>
+
+#define CAPTURE_MAGIC "D3DCAP01"   // 8 bytes, no terminator in the file
+
+
+enum CaptureOp
+{
+   CAP_FRAME = 1,       // Present.. the end of a frame
+   CAP_BEGIN_SCENE,
+   CAP_END_SCENE,
+   CAP_CLEAR,           // count flags color z stencil bytes, + the rects
+   CAP_CREATE_VB,       // id bytes usage fvf pool
+   CAP_CREATE_IB,       // id bytes usage format pool
+   CAP_RELEASE,         // id.. a buffer
+   CAP_BUFFER_DATA,     // id offset bytes, + the bytes
+   CAP_TEXTURE,         // id width height levels format bytes, + each level's rows, packed
+   CAP_SET_TEXTURE,     // stage id.. 0 for none
+   CAP_RENDER_STATE,    // state value
+   CAP_STAGE_STATE,     // stage type value
+   CAP_SAMPLER_STATE,   // sampler type value
+   CAP_TRANSFORM,       // state, 16 floats
+   CAP_MATERIAL,        // D3DMATERIAL9, 17 floats
+   CAP_LIGHT,           // index, D3DLIGHT9 as 26 words
+   CAP_LIGHT_ENABLE,    // index enable
+   CAP_FVF,             // fvf
+   CAP_STREAM,          // stream id offset stride
+   CAP_INDICES,         // id
+   CAP_DRAW,            // type startVertex count
+   CAP_DRAW_INDEXED,    // type baseVertex minIndex numVertices startIndex count
+   CAPTURE_OPS
+};
+
+struct CaptureRecord
+{
+   CaptureOp op;
+   UINT args[27];                // the fixed words
+   const unsigned char * data;   // the block after them, NULL if there isn't one
+   UINT dataBytes;
+   UINT bytes;                   // all of it, as it is in the file
+};
+
+
+// reads a capture record by record, straight out of the mapped file
+class CaptureReader
+{
+public:
+   CaptureReader();
+
+   bool open(const char * filename);   // false if it can't be read or isn't a capture
+   void close();
+   void rewind();                       // back to the first record
+
+   // the next record.. false at the end, or where the file stops making sense
+   bool next(CaptureRecord & record);
+   bool damaged() const { return m_damaged; }   // stopped short of the end
+
+   static int argCount(CaptureOp op);   // -1 for an op there isn't
+   static const char * opName(CaptureOp op);
+
+private:
+   MappedFile m_file;
+   size_t m_pos;
+   bool m_damaged;
+};
+
+
+class CaptureDevice : public CountingDevice
+{
+public:
+   explicit CaptureDevice(IDirect3DDevice9 * device, unsigned int window = 1024);
+
+   // starts recording to filename with the next frame.. false if it can't be made
+   bool start(const char * filename);
+   // stops now and closes the file.. false if not all of it could be
+   // written.  A frame begun since the last Present is left unfinished, and
+   // replay leaves it out
+   bool stop();
+   bool recording() const { return m_file != NULL; }
+   unsigned int framesRecorded() const { return m_framesRecorded; }
+
+   void endFrame();
+
+   STDMETHOD(CreateVertexBuffer)(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                 IDirect3DVertexBuffer9 ** buffer, HANDLE * shared);
+   STDMETHOD(CreateIndexBuffer)(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                IDirect3DIndexBuffer9 ** buffer, HANDLE * shared);
+   STDMETHOD(BeginScene)();
+   STDMETHOD(EndScene)();
+   STDMETHOD(Clear)(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+   STDMETHOD(SetTransform)(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix);
+   STDMETHOD(SetMaterial)(const D3DMATERIAL9 * material);
+   STDMETHOD(SetLight)(DWORD index, const D3DLIGHT9 * light);
+   STDMETHOD(LightEnable)(DWORD index, BOOL enable);
+   STDMETHOD(SetRenderState)(D3DRENDERSTATETYPE state, DWORD value);
+   STDMETHOD(SetTexture)(DWORD stage, IDirect3DBaseTexture9 * texture);
+   STDMETHOD(SetTextureStageState)(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+   STDMETHOD(SetSamplerState)(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+   STDMETHOD(DrawPrimitive)(D3DPRIMITIVETYPE type, UINT startVertex, UINT count);
+   STDMETHOD(DrawIndexedPrimitive)(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                   UINT numVertices, UINT startIndex, UINT count);
+   STDMETHOD(SetFVF)(DWORD fvf);
+   STDMETHOD(SetStreamSource)(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset, UINT stride);
+   STDMETHOD(SetIndices)(IDirect3DIndexBuffer9 * buffer);
+
+protected:
+   ~CaptureDevice();
+
+   void unlocked(unsigned int id, UINT offset, UINT bytes, const void * data);
+   void released(unsigned int id);
+
+private:
+   // a copy of every buffer made, so a recording can start with them
+   struct BufferCopy
+   {
+      bool live, index;
+      DWORD usage, format;   // the FVF for a vertex buffer
+      D3DPOOL pool;
+      std::vector<unsigned char> data;
+   };
+
+   struct TextureSeen
+   {
+      unsigned int id;
+      Hash64 hash;          // of its size, format and pixels
+      unsigned int frame;   // when it was last checked
+   };
+
+   struct Stream
+   {
+      unsigned int id;
+      UINT offset, stride;
+   };
+
+   enum { STAGES = 8, STAGE_STATES = 33, SAMPLER_STATES = 14, RENDER_STATES = 256, STREAMS = 16, LIGHTS = 8 };
+
+   void put(CaptureOp op, const UINT * args, const void * data = NULL, UINT bytes = 0);
+   void putBuffer(unsigned int id);
+   void beginRecording();
+   void readBackStates();
+   unsigned int textureId(IDirect3DBaseTexture9 * texture);
+   static int transformSlot(D3DTRANSFORMSTATETYPE state);   // -1 for the ones not read back
+
+   FILE * m_file;
+   bool m_live;                // recording this frame, not waiting for the next one to start
+   bool m_writeFailed;
+   unsigned int m_framesRecorded;
+
+   // what is set now, kept all the time so a recording can start with it
+   std::vector<BufferCopy> m_buffers;   // by id
+   Stream m_streams[STREAMS];
+   unsigned int m_indices;
+   DWORD m_fvf;
+   IDirect3DBaseTexture9 * m_stageTextures[STAGES];   // not references, the device holds those
+   D3DMATERIAL9 m_material;
+   D3DLIGHT9 m_lights[LIGHTS];
+   bool m_lightSet[LIGHTS], m_lightOn[LIGHTS];
+
+   // what the recording says is set, so only changes go in.. cleared when one starts
+   DWORD m_renderStates[RENDER_STATES];
+   DWORD m_stageStates[STAGES][STAGE_STATES];
+   DWORD m_samplerStates[STAGES][SAMPLER_STATES];
+   bool m_renderWritten[RENDER_STATES];
+   bool m_stageWritten[STAGES][STAGE_STATES];
+   bool m_samplerWritten[STAGES][SAMPLER_STATES];
+   D3DMATRIX m_transforms[3];   // view, projection and world
+   bool m_transformWritten[3];
+   std::map<IDirect3DBaseTexture9 *, TextureSeen> m_textures;
+   unsigned int m_nextTexture;
+   std::vector<unsigned char> m_pixels;   // scratch for reading textures back
+};
+
+
+// plays a capture back onto a device, a frame at a time
+class CaptureReplay
+{
+public:
+   CaptureReplay();
+   ~CaptureReplay();
+
+   bool open(const char * filename);
+   void close();
+
+   // everything up to and including the next frame's Present.. false at
+   // the end.  The same device every frame, until rewind()
+   bool playFrame(IDirect3DDevice9 * device);
+
+   // back to the first frame, after letting go of all it made on the device
+   void rewind();
+
+   unsigned int frame() const { return m_frame; }     // frames played since the start
+   unsigned int failed() const { return m_failed; }   // calls the device said no to, since open()
+   bool damaged() const { return m_reader.damaged(); }
+
+private:
+   void play(IDirect3DDevice9 * device, const CaptureRecord & r);
+   void releaseAll();
+
+   CaptureReader m_reader;
+   std::vector<IDirect3DVertexBuffer9 *> m_vertexBuffers;   // by id
+   std::vector<IDirect3DIndexBuffer9 *> m_indexBuffers;
+   std::vector<IDirect3DTexture9 *> m_textures;
+   unsigned int m_frame, m_failed;
+};
+
+// bytes in a row of width pixels, and rows in height, for a texture format..
+// the DXT formats go in rows of 4x4 blocks.  0 for a format it doesn't know
+UINT captureRowBytes(D3DFORMAT format, UINT width);
+UINT captureRows(D3DFORMAT format, UINT height);
+
+#endif
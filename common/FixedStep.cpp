@@ -0,0 +1,52 @@
+/* Filename:  FixedStep.cpp
+
+   This file accompanies FixedStep.h.
+*/
+
+#include "FixedStep.h"
+#include <math.h>
+
+
+FixedStep::FixedStep(float step, unsigned int maxSteps)
+{
+   m_step = step > 0.0f ? step : 1.0f / 60.0f;
+   m_maxSteps = maxSteps ? maxSteps : 1;
+   reset();
+}
+
+
+void FixedStep::reset()
+{
+   m_left = 0.0;
+   m_count = 0;
+   m_dropped = 0;
+}
+
+
+unsigned int FixedStep::advance(float seconds)
+{
+   double steps;
+   unsigned int n;
+
+   if (seconds > 0.0f)   // the clock can't go backwards.. and NaN goes nowhere
+      m_left += seconds;
+   steps = m_left / m_step;
+   if (steps < 1.0)
+      return 0;
+
+   if (steps >= m_maxSteps + 1.0)
+   {  // too far behind to catch up.. run what is allowed and forget the rest
+      m_dropped += steps < 1e9 ? (unsigned int) steps - m_maxSteps : 1000000000;
+      m_left = fmod(m_left, (double) m_step);
+      n = m_maxSteps;
+   }
+   else
+   {
+      n = (unsigned int) steps;
+      m_left -= (double) n * m_step;
+   }
+   if (m_left < 0.0)   // rounding
+      m_left = 0.0;
+   m_count += n;
+   return n;
+}
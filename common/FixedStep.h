@@ -0,0 +1,48 @@
+/* Filename:  FixedStep.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Runs a simulation in steps of a fixed length however long the frames
+   take.  Every frame the real time that went by is added up, and as many
+   whole steps as fit are taken out: none on a fast frame, several on a
+   slow one.  The picture is then drawn part way between the last two
+   steps, alpha of the way, so the motion looks smooth even when the frame
+   rate and the step rate don't line up.
+
+   Since every step is the same length, the same steps give the same
+   result on any machine and at any frame rate, which is what replaying
+   and benchmarking need.  A very slow frame (a hitch, or the debugger)
+   runs at most maxSteps steps; the rest of the time is dropped, so one bad
+   frame can't make the next one slow too.
+*/
+
+#ifndef FIXEDSTEP_H
+#define FIXEDSTEP_H
+
+
+class FixedStep
+{
+public:
+   explicit FixedStep(float step = 1.0f / 60.0f, unsigned int maxSteps = 8);
+
+   // adds the seconds since the last frame.. returns how many steps to run now
+   unsigned int advance(float seconds);
+   void reset();   // back to time 0, nothing left over
+
+   float step() const { return m_step; }
+   float alpha() const { return (float) (m_left / m_step); }   // 0 = the step before the last, 1 = the last
+   unsigned int count() const { return m_count; }              // steps run, ever
+   unsigned int dropped() const { return m_dropped; }          // steps skipped on slow frames
+
+   double time() const { return m_count * (double) m_step; }   // simulation seconds after the last step
+   double renderTime() const { return m_count ? time() - m_step + m_left : 0.0; }   // where the picture is, alpha along
+
+private:
+   float m_step;
+   unsigned int m_maxSteps;
+   double m_left;   // seconds not yet run, less than one step
+   unsigned int m_count;
+   unsigned int m_dropped;
+};
+
+#endif
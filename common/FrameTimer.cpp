@@ -0,0 +1,198 @@
+/* Filename:  FrameTimer.cpp
+
+   This file accompanies FrameTimer.h.
+*/
+
+#include "FrameTimer.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(_MSC_VER) && _MSC_VER < 1900
+#define snprintf _snprintf   // doesn't always end the string.. done by hand below
+#endif
+
+
+FrameTimer::FrameTimer(unsigned int window)
+{
+   m_samples.resize(window ? window : 1);
+   m_next = 0;
+   m_count = 0;
+   m_frame = 0;
+   m_firstStart = 0.0;
+   m_frameStart = 0.0;
+   m_lastFrame = 0.0f;
+   for (int i = 0; i < FRAME_SERIES; i++)
+   {
+      m_partStart[i] = 0.0;
+      m_partMs[i] = 0.0f;
+   }
+}
+
+
+#ifdef _WIN32
+
+double FrameTimer::now()
+{
+   static double period = 0.0;
+   LARGE_INTEGER count;
+
+   if (period == 0.0)
+   {
+      LARGE_INTEGER freq;
+      QueryPerformanceFrequency(&freq);
+      period = 1.0 / (double) freq.QuadPart;
+   }
+   QueryPerformanceCounter(&count);
+   return (double) count.QuadPart * period;
+}
+
+#else
+
+double FrameTimer::now()
+{
+   timespec ts;
+   clock_gettime(CLOCK_MONOTONIC, &ts);
+   return (double) ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+#endif
+
+
+void FrameTimer::beginFrame()
+{
+   double t = now();
+
+   if (m_frameStart == 0.0)   // the very first frame.. nothing to finish
+      m_firstStart = t;
+   else
+   {
+      Sample & s = m_samples[m_next];
+      m_lastFrame = (float) (t - m_frameStart);
+      s.start = m_frameStart - m_firstStart;
+      s.ms[FRAME_TIME] = m_lastFrame * 1000.0f;
+      s.ms[FRAME_UPDATE] = m_partMs[FRAME_UPDATE];
+      s.ms[FRAME_SUBMIT] = m_partMs[FRAME_SUBMIT];
+
+      m_next = (m_next + 1) % m_samples.size();
+      if (m_count < m_samples.size())
+         m_count++;
+      m_frame++;
+   }
+   m_frameStart = t;
+   m_partMs[FRAME_UPDATE] = 0.0f;
+   m_partMs[FRAME_SUBMIT] = 0.0f;
+}
+
+
+void FrameTimer::begin(FrameSeries part)
+{
+   m_partStart[part] = now();
+}
+
+
+void FrameTimer::end(FrameSeries part)
+{
+   m_partMs[part] += (float) ((now() - m_partStart[part]) * 1000.0);
+}
+
+
+FrameStats FrameTimer::stats(FrameSeries series) const
+{
+   FrameStats st = { 0.0f, 0.0f, 0.0f, 0.0f, 0, 0 };
+   unsigned int i, n = m_count;
+
+   if (n == 0)
+      return st;
+   m_sorted.resize(n);
+   for (i = 0; i < n; i++)
+      m_sorted[i] = m_samples[i].ms[series];
+
+   // nearest rank.. each nth_element only has to look past the last one
+   std::vector<float>::iterator p50 = m_sorted.begin() + (n - 1) / 2;
+   std::vector<float>::iterator p95 = m_sorted.begin() + (n * 95 + 99) / 100 - 1;
+   std::vector<float>::iterator p99 = m_sorted.begin() + (n * 99 + 99) / 100 - 1;
+   std::nth_element(m_sorted.begin(), p50, m_sorted.end());
+   std::nth_element(p50, p95, m_sorted.end());
+   std::nth_element(p95, p99, m_sorted.end());
+   st.p50 = *p50;
+   st.p95 = *p95;
+   st.p99 = *p99;
+   st.max = *std::max_element(p99, m_sorted.end());
+   st.count = n;
+   for (std::vector<float>::iterator it = p50; it != m_sorted.end(); ++it)
+      st.hitches += *it > 2.0f * st.p50;
+   return st;
+}
+
+
+// adds line to the end of str, as much of it as fits
+static void append(char * str, size_t size, const char * line)
+{
+   size_t used = strlen(str), len = strlen(line);
+
+   if (used + len >= size)
+      len = size - used - 1;
+   memcpy(str + used, line, len);
+   str[used + len] = '\0';
+}
+
+
+void FrameTimer::summary(char * str, size_t size, bool detail) const
+{
+   static const char * names[FRAME_SERIES] = { "frame", "update", "submit" };
+   FrameStats frame = stats(FRAME_TIME);
+   char line[96];
+
+   if (size == 0)
+      return;
+   str[0] = '\0';
+   if (frame.count == 0)
+      append(str, size, "fps --");
+   else if (!detail)
+   {
+      snprintf(line, sizeof(line), "fps %.1f  p99 %.1f ms", 1000.0f / frame.p50, frame.p99);
+      line[sizeof(line) - 1] = '\0';
+      append(str, size, line);
+   }
+   else
+   {
+      append(str, size, "ms  p50 p95 p99 max\n");
+      for (int i = 0; i < FRAME_SERIES; i++)
+      {
+         FrameStats st = i == FRAME_TIME ? frame : stats((FrameSeries) i);
+         snprintf(line, sizeof(line), "%s %.1f %.1f %.1f %.1f\n", names[i], st.p50, st.p95, st.p99, st.max);
+         line[sizeof(line) - 1] = '\0';
+         append(str, size, line);
+      }
+      snprintf(line, sizeof(line), "%u hitches in %u", frame.hitches, frame.count);
+      line[sizeof(line) - 1] = '\0';
+      append(str, size, line);
+   }
+}
+
+
+bool FrameTimer::writeCsv(const char * filename) const
+{
+   FILE * f = fopen(filename, "w");
+   unsigned int i, oldest = m_count < m_samples.size() ? 0 : m_next;
+   bool ok;
+
+   if (f == NULL)
+      return false;
+   fprintf(f, "frame,start_ms,frame_ms,update_ms,submit_ms\n");
+   for (i = 0; i < m_count; i++)
+   {
+      const Sample & s = m_samples[(oldest + i) % m_samples.size()];
+      fprintf(f, "%u,%.3f,%.3f,%.3f,%.3f\n", m_frame - m_count + i, s.start * 1000.0,
+              s.ms[FRAME_TIME], s.ms[FRAME_UPDATE], s.ms[FRAME_SUBMIT]);
+   }
+   ok = ferror(f) == 0;
+   return fclose(f) == 0 && ok;
+}
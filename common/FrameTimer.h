@@ -0,0 +1,81 @@
+/* Filename:  FrameTimer.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Times every frame, and the update and submit parts of it, with the
+   high resolution clock (QueryPerformanceCounter, or CLOCK_MONOTONIC
+   elsewhere) and keeps the last few seconds' worth.  From those it gives
+   the median, 95th and 99th percentile and the worst frame, which say a
+   lot more than an average does: one 100 ms hitch in a second of 16 ms
+   frames barely moves the average but is plain to see in the max and p99.
+
+   The samples can be written out as CSV to look at in a spreadsheet.
+*/
+
+#ifndef FRAMETIMER_H
+#define FRAMETIMER_H
+
+#include <stddef.h>
+#include <vector>
+
+
+enum FrameSeries
+{
+   FRAME_TIME,     // start of one frame to the start of the next, all of it
+   FRAME_UPDATE,   // the maths, moving things and working out what to draw
+   FRAME_SUBMIT,   // clearing, drawing and Present
+   FRAME_SERIES
+};
+
+struct FrameStats
+{
+   float p50, p95, p99, max;   // milliseconds
+   unsigned int count;         // frames they were worked out from
+   unsigned int hitches;       // of those, how many took more than twice the median
+};
+
+class FrameTimer
+{
+public:
+   explicit FrameTimer(unsigned int window = 1024);   // frames kept
+
+   // seconds from some fixed point.. only the difference between two means anything
+   static double now();
+
+   // call at the top of every frame.. finishes the last one's sample
+   void beginFrame();
+
+   // around the update and submit parts of the frame.. a part can be timed
+   // in more than one piece, they add up
+   void begin(FrameSeries part);
+   void end(FrameSeries part);
+
+   float lastFrame() const { return m_lastFrame; }   // seconds the last whole frame took
+   unsigned int count() const { return m_count; }     // samples in the window
+
+   FrameStats stats(FrameSeries series) const;
+
+   // one line, fps and p99, or with detail a small table of all three series
+   void summary(char * str, size_t size, bool detail) const;
+
+   // frame,start_ms,frame_ms,update_ms,submit_ms.. oldest frame first
+   bool writeCsv(const char * filename) const;
+
+private:
+   struct Sample
+   {
+      double start;              // seconds since the first frame
+      float ms[FRAME_SERIES];
+   };
+
+   std::vector<Sample> m_samples;   // a ring, m_next is the oldest once it is full
+   unsigned int m_next, m_count;
+   unsigned int m_frame;            // frames finished, ever
+   double m_firstStart, m_frameStart;
+   double m_partStart[FRAME_SERIES];
+   float m_partMs[FRAME_SERIES];
+   float m_lastFrame;
+   mutable std::vector<float> m_sorted;   // scratch for the percentiles
+};
+
+#endif
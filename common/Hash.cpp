@@ -0,0 +1,114 @@
+/* Filename:  Hash.cpp
+
+   This file accompanies Hash.h.
+*/
+
+#include "Hash.h"
+#include <string.h>
+
+static const Hash64 PRIME1 = 11400714785074694791ULL;
+static const Hash64 PRIME2 = 14029467366897019727ULL;
+static const Hash64 PRIME3 = 1609587929392839161ULL;
+static const Hash64 PRIME4 = 9650029242287828579ULL;
+static const Hash64 PRIME5 = 2870177450012600261ULL;
+
+
+static inline Hash64 rotl(Hash64 x, int r)
+{
+   return (x << r) | (x >> (64 - r));
+}
+
+
+// memcpy is how to read unaligned data without upsetting anything.. the
+// compiler turns it into a plain load.  Assumes a little endian machine
+static inline Hash64 read64(const unsigned char * p)
+{
+   Hash64 v;
+   memcpy(&v, p, 8);
+   return v;
+}
+
+
+static inline Hash64 read32(const unsigned char * p)
+{
+   unsigned int v;
+   memcpy(&v, p, 4);
+   return v;
+}
+
+
+static inline Hash64 lane(Hash64 acc, Hash64 input)
+{
+   acc += input * PRIME2;
+   acc = rotl(acc, 31);
+   return acc * PRIME1;
+}
+
+
+static inline Hash64 mergeRound(Hash64 acc, Hash64 val)
+{
+   acc ^= lane(0, val);
+   return acc * PRIME1 + PRIME4;
+}
+
+
+Hash64 xxHash64(const void * data, size_t bytes, Hash64 seed)
+{
+   const unsigned char * p = (const unsigned char *) data;
+   const unsigned char * end = p + bytes;
+   Hash64 h;
+
+   if (bytes >= 32)
+   {  // four lanes of 8 bytes each, 32 bytes a step
+      const unsigned char * limit = end - 32;
+      Hash64 v1 = seed + PRIME1 + PRIME2;
+      Hash64 v2 = seed + PRIME2;
+      Hash64 v3 = seed;
+      Hash64 v4 = seed - PRIME1;
+
+      do
+      {
+         v1 = lane(v1, read64(p));
+         v2 = lane(v2, read64(p + 8));
+         v3 = lane(v3, read64(p + 16));
+         v4 = lane(v4, read64(p + 24));
+         p += 32;
+      } while (p <= limit);
+
+      h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+      h = mergeRound(h, v1);
+      h = mergeRound(h, v2);
+      h = mergeRound(h, v3);
+      h = mergeRound(h, v4);
+   }
+   else
+      h = seed + PRIME5;
+
+   h += (Hash64) bytes;
+
+   // what is left over.. 8, then 4, then 1 byte at a time
+   for (; p + 8 <= end; p += 8)
+   {
+      h ^= lane(0, read64(p));
+      h = rotl(h, 27) * PRIME1 + PRIME4;
+   }
+   if (p + 4 <= end)
+   {
+      h ^= read32(p) * PRIME1;
+      h = rotl(h, 23) * PRIME2 + PRIME3;
+      p += 4;
+   }
+   for (; p < end; p++)
+   {
+      h ^= (*p) * PRIME5;
+      h = rotl(h, 11) * PRIME1;
+   }
+
+   // avalanche
+   h ^= h >> 33;
+   h *= PRIME2;
+   h ^= h >> 29;
+   h *= PRIME3;
+   h ^= h >> 32;
+   return h;
+}
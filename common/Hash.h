@@ -0,0 +1,20 @@
+/* Filename:  Hash.h
+
+   This file is shared by the numbered examples and the tools.
+
+   xxHash64 (XXH64) by Yann Collet, written out from the published
+   algorithm.  It gives the same values as the reference library, so hashes
+   made by the tools and by the examples can be compared.  It is fast
+   enough to hash a whole bitmap every time one is loaded.
+*/
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+
+typedef unsigned long long Hash64;
+
+Hash64 xxHash64(const void * data, size_t bytes, Hash64 seed = 0);
+
+#endif
@@ -0,0 +1,117 @@
+/* Filename:  MappedFile.cpp
+
+   This file accompanies MappedFile.h.
+*/
+
+#include "MappedFile.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+MappedFile::MappedFile()
+{
+   m_data = NULL;
+   m_size = 0;
+#ifdef _WIN32
+   m_file = INVALID_HANDLE_VALUE;
+   m_mapping = NULL;
+#endif
+}
+
+
+MappedFile::~MappedFile()
+{
+   close();
+}
+
+
+#ifdef _WIN32
+
+bool MappedFile::open(const char * filename)
+{
+   LARGE_INTEGER size;
+
+   close();
+   m_file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                        FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+   if (m_file == INVALID_HANDLE_VALUE)
+      return false;
+   if (!GetFileSizeEx(m_file, &size) || size.QuadPart == 0)
+   {
+      close();
+      return false;
+   }
+
+   m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+   if (m_mapping)
+      m_data = (const unsigned char *) MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0);
+   if (m_data == NULL)
+   {
+      close();
+      return false;
+   }
+   m_size = (size_t) size.QuadPart;
+   return true;
+}
+
+
+void MappedFile::close()
+{
+   if (m_data)
+      UnmapViewOfFile(m_data);
+   if (m_mapping)
+      CloseHandle(m_mapping);
+   if (m_file != INVALID_HANDLE_VALUE)
+      CloseHandle(m_file);
+   m_data = NULL;
+   m_size = 0;
+   m_mapping = NULL;
+   m_file = INVALID_HANDLE_VALUE;
+}
+
+#else
+
+bool MappedFile::open(const char * filename)
+{
+   struct stat st;
+   void * p;
+   int fd;
+
+   close();
+   fd = ::open(filename, O_RDONLY);
+   if (fd < 0)
+      return false;
+   if (fstat(fd, &st) != 0 || st.st_size == 0)
+   {
+      ::close(fd);
+      return false;
+   }
+
+   p = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+   ::close(fd);   // the mapping keeps the file open
+   if (p == MAP_FAILED)
+      return false;
+   madvise(p, (size_t) st.st_size, MADV_SEQUENTIAL);
+
+   m_data = (const unsigned char *) p;
+   m_size = (size_t) st.st_size;
+   return true;
+}
+
+
+void MappedFile::close()
+{
+   if (m_data)
+      munmap((void *) m_data, m_size);
+   m_data = NULL;
+   m_size = 0;
+}
+
+#endif
@@ -0,0 +1,41 @@
+/* Filename:  MappedFile.h
+
+   This file is shared by the numbered examples and the tools.
+
+   A file mapped read only into memory (mmap, or CreateFileMapping on
+   Windows).  Nothing is copied; pages are read from disk the first time
+   they are touched, and a file that was read recently comes straight out
+   of the OS file cache.
+*/
+
+#ifndef MAPPEDFILE_H
+#define MAPPEDFILE_H
+
+#include <stddef.h>
+
+
+class MappedFile
+{
+public:
+   MappedFile();
+   ~MappedFile();
+
+   bool open(const char * filename);   // false if it can't be opened or is empty
+   void close();
+
+   const unsigned char * data() const { return m_data; }
+   size_t size() const { return m_size; }
+
+private:
+   MappedFile(const MappedFile &);              // not copyable
+   MappedFile & operator=(const MappedFile &);
+
+   const unsigned char * m_data;
+   size_t m_size;
+#ifdef _WIN32
+   void * m_file;
+   void * m_mapping;
+#endif
+};
+
+#endif
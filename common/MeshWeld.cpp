@@ -0,0 +1,94 @@
+/* Filename:  MeshWeld.cpp
+
+   This file accompanies MeshWeld.h.
+*/
+
+#include "MeshWeld.h"
+#include <string.h>
+
+#define EMPTY_SLOT 0xFFFFFFFF
+
+
+// FNV-1a over the bytes of one vertex.. vertices are small so this is cheap
+static unsigned int hashVertex(const unsigned char * v, unsigned int stride)
+{
+   unsigned int h = 2166136261u;
+   for (unsigned int i = 0; i < stride; i++)
+   {
+      h ^= v[i];
+      h *= 16777619u;
+   }
+   return h;
+}
+
+
+WeldedMesh::WeldedMesh()
+{
+   m_vertexCount = 0;
+   m_stride = 0;
+}
+
+
+bool WeldedMesh::weld(const void * verts, unsigned int count, unsigned int stride)
+{
+   const unsigned char * src = (const unsigned char *) verts;
+   std::vector<unsigned int> table;
+   unsigned int tableSize = 1;
+   unsigned int mask;
+   unsigned int i;
+
+   m_vertices.clear();
+   m_indices.clear();
+   m_vertexCount = 0;
+   m_stride = stride;
+
+   if (verts == NULL || stride == 0)
+      return false;
+
+   // keep the table at most half full so probes stay short
+   while (tableSize < count * 2)
+      tableSize <<= 1;
+   mask = tableSize - 1;
+   table.assign(tableSize, EMPTY_SLOT);
+
+   m_indices.resize(count);
+   m_vertices.reserve((size_t) count * stride);
+
+   for (i = 0; i < count; i++)
+   {
+      const unsigned char * v = src + (size_t) i * stride;
+      unsigned int slot = hashVertex(v, stride) & mask;
+
+      // linear probe until we find the vertex or an empty slot
+      while (table[slot] != EMPTY_SLOT &&
+             memcmp(&m_vertices[(size_t) table[slot] * stride], v, stride) != 0)
+         slot = (slot + 1) & mask;
+
+      if (table[slot] == EMPTY_SLOT)
+      {  // first time we see this vertex.. append it
+         table[slot] = m_vertexCount++;
+         m_vertices.insert(m_vertices.end(), v, v + stride);
+      }
+      m_indices[i] = table[slot];
+   }
+
+   return true;
+}
+
+
+void WeldedMesh::copyIndices(void * dst) const
+{
+   unsigned int i;
+
+   if (indexSize() == 4)
+   {
+      if (!m_indices.empty())
+         memcpy(dst, &m_indices[0], m_indices.size() * sizeof(unsigned int));
+   }
+   else
+   {
+      unsigned short * out = (unsigned short *) dst;
+      for (i = 0; i < m_indices.size(); i++)
+         out[i] = (unsigned short) m_indices[i];
+   }
+}
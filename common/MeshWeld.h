@@ -0,0 +1,52 @@
+/* Filename:  MeshWeld.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Mesh welding turns a plain triangle list (like the 36 vertex cube in
+   Rect3D2.cpp) into a list of unique vertices plus an index list.  Two
+   vertices are the same if every byte of them is the same, so a corner
+   shared by two faces with different normals or texture coordinates is
+   kept twice, which is what we want.
+
+   The vertices are hashed into an open addressing table that is sized
+   once up front, so welding is linear in the number of vertices and
+   works just as well for a mesh with a few million of them.
+*/
+
+#ifndef MESHWELD_H
+#define MESHWELD_H
+
+#include <stddef.h>
+#include <vector>
+
+
+class WeldedMesh
+{
+public:
+   WeldedMesh();
+
+   // welds count vertices of stride bytes each.. returns false on bad input
+   bool weld(const void * verts, unsigned int count, unsigned int stride);
+
+   unsigned int vertexCount() const   { return m_vertexCount; }
+   unsigned int indexCount() const    { return (unsigned int) m_indices.size(); }
+   unsigned int stride() const        { return m_stride; }
+   unsigned int indexSize() const     { return m_vertexCount > 0xFFFF ? 4 : 2; }   // 16 or 32 bit
+
+   const void * vertices() const      { return m_vertices.empty() ? NULL : &m_vertices[0]; }
+   unsigned int vertexBytes() const   { return (unsigned int) m_vertices.size(); }
+   const unsigned int * indices() const { return m_indices.empty() ? NULL : &m_indices[0]; }
+   unsigned int indexBytes() const    { return indexCount() * indexSize(); }
+
+   // writes the indices as 16 bit if they fit, otherwise 32 bit..
+   // dst must hold indexBytes() bytes (a locked index buffer for example)
+   void copyIndices(void * dst) const;
+
+private:
+   std::vector<unsigned char> m_vertices;   // unique vertices, stride bytes each
+   std::vector<unsigned int> m_indices;     // one per input vertex
+   unsigned int m_vertexCount;
+   unsigned int m_stride;
+};
+
+#endif
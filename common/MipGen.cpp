@@ -0,0 +1,326 @@
+/* Filename:  MipGen.cpp
+
+   This file accompanies MipGen.h.
+*/
+
+#include "MipGen.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define MIP_SSE 1
+#endif
+
+#define KAISER_TAPS 8
+
+
+// one pixel, 4 channels in linear light
+#ifdef MIP_SSE
+
+typedef __m128 Vec4;
+static inline Vec4 load4(const float * p) { return _mm_loadu_ps(p); }
+static inline void store4(float * p, Vec4 v) { _mm_storeu_ps(p, v); }
+static inline Vec4 add4(Vec4 a, Vec4 b) { return _mm_add_ps(a, b); }
+static inline Vec4 mul4(Vec4 a, Vec4 b) { return _mm_mul_ps(a, b); }
+static inline Vec4 splat4(float f) { return _mm_set1_ps(f); }
+
+#else
+
+struct Vec4 { float v[4]; };
+static inline Vec4 load4(const float * p) { Vec4 r; memcpy(r.v, p, 16); return r; }
+static inline void store4(float * p, Vec4 a) { memcpy(p, a.v, 16); }
+static inline Vec4 add4(Vec4 a, Vec4 b)
+{
+   Vec4 r = { { a.v[0] + b.v[0], a.v[1] + b.v[1], a.v[2] + b.v[2], a.v[3] + b.v[3] } };
+   return r;
+}
+static inline Vec4 mul4(Vec4 a, Vec4 b)
+{
+   Vec4 r = { { a.v[0] * b.v[0], a.v[1] * b.v[1], a.v[2] * b.v[2], a.v[3] * b.v[3] } };
+   return r;
+}
+static inline Vec4 splat4(float f) { Vec4 r = { { f, f, f, f } }; return r; }
+
+#endif
+
+
+// sRGB <-> linear, by table.. 4096 steps back is fine enough that every
+// 8 bit value comes back as itself
+struct GammaTables
+{
+   float toLinear[256];
+   unsigned char toSrgb[4096];
+
+   GammaTables()
+   {
+      int i;
+      for (i = 0; i < 256; i++)
+      {
+         float c = i / 255.0f;
+         toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+      }
+      for (i = 0; i < 4096; i++)
+      {
+         float l = i / 4095.0f;
+         float c = l <= 0.0031308f ? l * 12.92f : 1.055f * powf(l, 1 / 2.4f) - 0.055f;
+         toSrgb[i] = (unsigned char) (c * 255 + 0.5f);
+      }
+   }
+};
+
+static const GammaTables & gamma()
+{
+   static const GammaTables tables;
+   return tables;
+}
+
+
+static inline unsigned int encode(const float * p)
+{
+   const GammaTables & g = gamma();
+   unsigned int c[4], i;
+
+   for (i = 0; i < 4; i++)
+   {
+      float v = p[i] < 0 ? 0 : (p[i] > 1 ? 1 : p[i]);   // the sinc can overshoot
+      c[i] = i < 3 ? g.toSrgb[(int) (v * 4095 + 0.5f)] : (unsigned int) (v * 255 + 0.5f);
+   }
+   return c[0] | (c[1] << 8) | (c[2] << 16) | (c[3] << 24);
+}
+
+
+static float besselI0(float x)
+{
+   float sum = 1, term = 1;
+   int k;
+   for (k = 1; k < 20; k++)
+   {
+      term *= (x / (2 * k)) * (x / (2 * k));
+      sum += term;
+   }
+   return sum;
+}
+
+
+// weights for the source pixels 2x-3 .. 2x+4 around a new pixel x, whose
+// center is half way between source pixels 2x and 2x+1
+static void kaiserWeights(float * w)
+{
+   const float alpha = 4.0f, radius = KAISER_TAPS / 2;
+   float sum = 0;
+   int i;
+
+   for (i = 0; i < KAISER_TAPS; i++)
+   {
+      float d = i - (KAISER_TAPS / 2 - 1) - 0.5f;          // -3.5 .. 3.5 source pixels
+      float s = d * 0.5f * 3.14159265f;                   // sinc cut off at the new pixel size
+      float t = d / radius;
+      w[i] = (s == 0 ? 1 : sinf(s) / s) * besselI0(alpha * sqrtf(1 - t * t)) / besselI0(alpha);
+      sum += w[i];
+   }
+   for (i = 0; i < KAISER_TAPS; i++)
+      w[i] /= sum;
+}
+
+
+static inline int wrap(int i, int n)
+{
+   i %= n;
+   return i < 0 ? i + n : i;
+}
+
+
+template <class Fn>
+static void parallelRows(int rows, int width, unsigned int numThreads, Fn fn)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads > (unsigned int) rows)
+      numThreads = rows;
+   if (numThreads <= 1 || rows * width < 128 * 128)   // not worth starting threads
+   {
+      fn(0, rows);
+      return;
+   }
+
+   std::vector<std::thread> threads;
+   int chunk = (rows + numThreads - 1) / numThreads;
+   unsigned int t;
+   for (t = 1; t < numThreads; t++)
+      threads.push_back(std::thread(fn, std::min((int) t * chunk, rows), std::min((int) (t + 1) * chunk, rows)));
+   fn(0, std::min(chunk, rows));
+   for (t = 0; t < threads.size(); t++)
+      threads[t].join();
+}
+
+
+static void boxRows(const float * src, int w, int h, float * dst, unsigned int * out,
+                    int nw, int first, int last)
+{
+   Vec4 quarter = splat4(0.25f);
+   int x, y;
+
+   for (y = first; y < last; y++)
+   {
+      const float * row0 = src + (size_t) std::min(2 * y, h - 1) * w * 4;
+      const float * row1 = src + (size_t) std::min(2 * y + 1, h - 1) * w * 4;
+      for (x = 0; x < nw; x++)
+      {
+         int x0 = std::min(2 * x, w - 1) * 4, x1 = std::min(2 * x + 1, w - 1) * 4;
+         Vec4 sum = add4(add4(load4(row0 + x0), load4(row0 + x1)),
+                         add4(load4(row1 + x0), load4(row1 + x1)));
+         float * p = dst + ((size_t) y * nw + x) * 4;
+         store4(p, mul4(sum, quarter));
+         out[(size_t) y * nw + x] = encode(p);
+      }
+   }
+}
+
+
+// halves the width of rows [first, last).. a width of 1 is copied
+static void kaiserRowsX(const float * src, int w, float * dst, int nw, const float * weights,
+                        int first, int last)
+{
+   int x, y, k;
+
+   for (y = first; y < last; y++)
+   {
+      const float * row = src + (size_t) y * w * 4;
+      float * to = dst + (size_t) y * nw * 4;
+      if (w == 1)
+      {
+         memcpy(to, row, 16);
+         continue;
+      }
+      for (x = 0; x < nw; x++)
+      {
+         Vec4 sum = splat4(0);
+         for (k = 0; k < KAISER_TAPS; k++)
+         {
+            int sx = wrap(2 * x + k - (KAISER_TAPS / 2 - 1), w);
+            sum = add4(sum, mul4(load4(row + sx * 4), splat4(weights[k])));
+         }
+         store4(to + x * 4, sum);
+      }
+   }
+}
+
+
+// halves the height, writing new rows [first, last)
+static void kaiserRowsY(const float * src, int h, float * dst, unsigned int * out, int nw,
+                        const float * weights, int first, int last)
+{
+   int x, y, k;
+
+   for (y = first; y < last; y++)
+   {
+      float * to = dst + (size_t) y * nw * 4;
+      if (h == 1)
+         memcpy(to, src, (size_t) nw * 16);
+      else
+      {
+         const float * rows[KAISER_TAPS];
+         for (k = 0; k < KAISER_TAPS; k++)
+            rows[k] = src + (size_t) wrap(2 * y + k - (KAISER_TAPS / 2 - 1), h) * nw * 4;
+         for (x = 0; x < nw; x++)
+         {
+            Vec4 sum = splat4(0);
+            for (k = 0; k < KAISER_TAPS; k++)
+               sum = add4(sum, mul4(load4(rows[k] + x * 4), splat4(weights[k])));
+            store4(to + x * 4, sum);
+         }
+      }
+      for (x = 0; x < nw; x++)
+         out[(size_t) y * nw + x] = encode(to + x * 4);
+   }
+}
+
+
+unsigned int mipLevelCount(int width, int height)
+{
+   unsigned int n = 1;
+   while (width > 1 || height > 1)
+   {
+      width = std::max(width / 2, 1);
+      height = std::max(height / 2, 1);
+      n++;
+   }
+   return n;
+}
+
+
+void buildMipChain(const void * src, int width, int height, int pitch, MipFilter filter,
+                   MipChain & chain, unsigned int numThreads)
+{
+   const GammaTables & g = gamma();
+   unsigned int levels = mipLevelCount(width, height), i;
+   std::vector<float> cur((size_t) width * height * 4), next, tmp;
+   size_t total = 0;
+   float weights[KAISER_TAPS];
+   int w = width, h = height, x, y;
+
+   chain.width.resize(levels);
+   chain.height.resize(levels);
+   chain.offset.resize(levels);
+   for (i = 0; i < levels; i++)
+   {
+      chain.width[i] = w;
+      chain.height[i] = h;
+      chain.offset[i] = total;
+      total += (size_t) w * h;
+      w = std::max(w / 2, 1);
+      h = std::max(h / 2, 1);
+   }
+   chain.pixels.resize(total);
+
+   // level 0 as it is, and into linear light for filtering
+   for (y = 0; y < height; y++)
+   {
+      const unsigned int * row = (const unsigned int *) ((const unsigned char *) src + (ptrdiff_t) pitch * y);
+      memcpy(chain.level(0) + (size_t) y * width, row, (size_t) width * 4);
+      for (x = 0; x < width; x++)
+      {
+         float * p = &cur[((size_t) y * width + x) * 4];
+         p[0] = g.toLinear[row[x] & 0xFF];
+         p[1] = g.toLinear[(row[x] >> 8) & 0xFF];
+         p[2] = g.toLinear[(row[x] >> 16) & 0xFF];
+         p[3] = (row[x] >> 24) / 255.0f;
+      }
+   }
+
+   kaiserWeights(weights);
+   w = width;
+   h = height;
+   for (i = 1; i < levels; i++)
+   {
+      int nw = chain.width[i], nh = chain.height[i];
+      unsigned int * out = chain.level(i);
+      float * to;
+
+      next.resize((size_t) nw * nh * 4);
+      to = &next[0];
+      if (filter == MIP_BOX)
+      {
+         const float * from = &cur[0];
+         parallelRows(nh, nw, numThreads, [=](int first, int last)
+                      { boxRows(from, w, h, to, out, nw, first, last); });
+      }
+      else
+      {
+         const float * from = &cur[0];
+         float * across;
+         tmp.resize((size_t) nw * h * 4);
+         across = &tmp[0];
+         parallelRows(h, nw, numThreads, [=](int first, int last)
+                      { kaiserRowsX(from, w, across, nw, weights, first, last); });
+         parallelRows(nh, nw, numThreads, [=](int first, int last)
+                      { kaiserRowsY(across, h, to, out, nw, weights, first, last); });
+      }
+      cur.swap(next);
+      w = nw;
+      h = nh;
+   }
+}
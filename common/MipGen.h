@@ -0,0 +1,53 @@
+/* Filename:  MipGen.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Builds the whole chain of mip levels for a 32 bit texture, down to 1x1.
+   The colours are taken as sRGB, like every bitmap the examples load, so
+   they are turned into linear light before being averaged and back again
+   after; averaging the stored values straight makes the small levels too
+   dark.  Alpha is averaged as it is.
+
+   MIP_BOX averages each 2x2 block.  MIP_KAISER uses an 8 tap windowed
+   sinc (a Kaiser window), which keeps the small levels sharper without
+   the blockiness; it wraps around the edges like D3DTADDRESS_WRAP.  Each
+   level is filtered from the one above it, kept in floats, 4 channels at
+   a time with SSE, and the rows are split between threads.
+
+   The chains are normally saved with Dds.h so the filtering is only done
+   once; see TextureCache.h and tools/mipgen.cpp.
+*/
+
+#ifndef MIPGEN_H
+#define MIPGEN_H
+
+#include <stddef.h>
+#include <vector>
+
+
+enum MipFilter
+{
+   MIP_BOX,
+   MIP_KAISER
+};
+
+struct MipChain
+{
+   std::vector<int> width, height;
+   std::vector<size_t> offset;           // of each level in pixels
+   std::vector<unsigned int> pixels;     // every level, rows packed, alpha in the top byte
+
+   unsigned int levels() const { return (unsigned int) width.size(); }
+   unsigned int * level(unsigned int i) { return &pixels[offset[i]]; }
+   const unsigned int * level(unsigned int i) const { return &pixels[offset[i]]; }
+};
+
+// levels from width x height down to 1x1
+unsigned int mipLevelCount(int width, int height);
+
+// level 0 is copied from src (pitch in bytes), the rest are filtered from it..
+// numThreads 0 = all cores
+void buildMipChain(const void * src, int width, int height, int pitch, MipFilter filter,
+                   MipChain & chain, unsigned int numThreads = 0);
+
+#endif
@@ -0,0 +1,482 @@
+/* Filename:  Occlusion.cpp
+
+   This file accompanies Occlusion.h.
+*/
+
+#include "Occlusion.h"
+#include "VecMath.h"
+#include <math.h>
+#include <float.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define OCC_WIDTH 8
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define OCC_WIDTH 4
+#else
+#define OCC_WIDTH 1
+#endif
+
+#define FULL_MASK 0xFFFFFFFFu
+#define GUARD_BAND 4096.0f   // pixels off the screen a corner can be before its triangle is left out
+#define MIN_W 1e-5f          // nearer to the camera than this is behind it
+
+
+static unsigned int threadCount(unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   return numThreads ? numThreads : 1;
+}
+
+
+OcclusionBuffer::OcclusionBuffer()
+{
+   static const float identity[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+
+   m_width = m_height = m_tilesX = m_tilesY = 0;
+   memcpy(m_viewProj, identity, sizeof(m_viewProj));
+   resize(320, 192);
+}
+
+
+void OcclusionBuffer::resize(unsigned int width, unsigned int height)
+{
+   m_tilesX = (std::max(width, 1u) + TILE_WIDTH - 1) / TILE_WIDTH;
+   m_tilesY = (std::max(height, 1u) + TILE_HEIGHT - 1) / TILE_HEIGHT;
+   m_width = m_tilesX * TILE_WIDTH;
+   m_height = m_tilesY * TILE_HEIGHT;
+   m_tiles.resize(m_tilesX * m_tilesY);
+   begin(m_viewProj);
+}
+
+
+void OcclusionBuffer::begin(const float * view, const float * proj)
+{
+   float vp[16];
+
+   mat4Multiply(vp, view, proj);
+   begin(vp);
+}
+
+
+void OcclusionBuffer::begin(const float * viewProj)
+{
+   Tile empty;
+   empty.zFar = FLT_MAX;   // beyond the far plane even
+   empty.zNear = 0.0f;
+   empty.mask = 0;
+
+   if (viewProj != m_viewProj)
+      memcpy(m_viewProj, viewProj, sizeof(m_viewProj));
+   std::fill(m_tiles.begin(), m_tiles.end(), empty);
+   m_occluders.clear();
+}
+
+
+//*******
+// occluders
+
+void OcclusionBuffer::addOccluder(const float * positions, const unsigned short * indices, unsigned int triangles,
+                                  const float * world)
+{
+   float m[16], sx[3], sy[3], sz[3];
+   unsigned int t;
+   int k;
+
+   if (world)
+      mat4Multiply(m, world, m_viewProj);
+   else
+      memcpy(m, m_viewProj, sizeof(m));
+
+   for (t = 0; t < triangles; t++)
+   {
+      bool keep = true;
+      for (k = 0; k < 3 && keep; k++)
+      {
+         const float * p = positions + (indices ? indices[t * 3 + k] : t * 3 + k) * 3;
+         Vec4 h = vec3Transform(Vec3(p[0], p[1], p[2]), m);
+         if (h.w < MIN_W || h.z < 0.0f)
+            keep = false;   // crosses the near plane
+         else
+         {
+            sx[k] = (h.x / h.w * 0.5f + 0.5f) * m_width;
+            sy[k] = (0.5f - h.y / h.w * 0.5f) * m_height;
+            sz[k] = h.z / h.w;
+            keep = fabsf(sx[k]) < GUARD_BAND && fabsf(sy[k]) < GUARD_BAND;
+         }
+      }
+      float area = (sx[1] - sx[0]) * (sy[2] - sy[0]) - (sx[2] - sx[0]) * (sy[1] - sy[0]);
+      if (!keep || fabsf(area) < 1e-6f)
+         continue;
+
+      // the pixels it could cover all of
+      float minX = std::min(std::min(sx[0], sx[1]), sx[2]), maxX = std::max(std::max(sx[0], sx[1]), sx[2]);
+      float minY = std::min(std::min(sy[0], sy[1]), sy[2]), maxY = std::max(std::max(sy[0], sy[1]), sy[2]);
+      int x0 = std::max((int) ceilf(minX), 0), x1 = std::min((int) floorf(maxX), (int) m_width) - 1;
+      int y0 = std::max((int) ceilf(minY), 0), y1 = std::min((int) floorf(maxY), (int) m_height) - 1;
+      if (x0 > x1 || y0 > y1)
+         continue;
+
+      Occluder o;
+      float sign = area > 0.0f ? 1.0f : -1.0f;   // either winding
+      for (k = 0; k < 3; k++)
+      {
+         int n = (k + 1) % 3;
+         float a = (sy[k] - sy[n]) * sign, b = (sx[n] - sx[k]) * sign;
+         // at pixel centres, and the whole pixel has to be inside.. half a
+         // pixel either way, and a little more for rounding, which the
+         // guard band keeps well under 1/256 of a pixel
+         o.edge[k][0] = a;
+         o.edge[k][1] = b;
+         o.edge[k][2] = (float) (((double) sx[k] * sy[n] - (double) sx[n] * sy[k]) * sign + (a + b) * 0.5 -
+                                 (fabs(a) + fabs(b)) * (0.5 + 1.0 / 256.0));
+      }
+      o.plane[0] = ((sz[1] - sz[0]) * (sy[2] - sy[0]) - (sz[2] - sz[0]) * (sy[1] - sy[0])) / area;
+      o.plane[1] = ((sx[1] - sx[0]) * (sz[2] - sz[0]) - (sx[2] - sx[0]) * (sz[1] - sz[0])) / area;
+      o.plane[2] = sz[0] - o.plane[0] * sx[0] - o.plane[1] * sy[0];
+      o.zMax = std::max(std::max(sz[0], sz[1]), sz[2]);
+      o.tileX0 = x0 / TILE_WIDTH;
+      o.tileY0 = y0 / TILE_HEIGHT;
+      o.tileX1 = x1 / TILE_WIDTH;
+      o.tileY1 = y1 / TILE_HEIGHT;
+      m_occluders.push_back(o);
+   }
+}
+
+
+void OcclusionBuffer::addOccluderBox(const BoundBox & b, const float * world)
+{
+   static const unsigned short faces[36] =
+   {
+      0, 1, 3,  0, 3, 2,   4, 6, 7,  4, 7, 5,     // -z, +z
+      0, 4, 5,  0, 5, 1,   2, 3, 7,  2, 7, 6,     // -y, +y
+      0, 2, 6,  0, 6, 4,   1, 5, 7,  1, 7, 3      // -x, +x
+   };
+   float corners[8][3];
+   int i;
+
+   for (i = 0; i < 8; i++)
+   {
+      corners[i][0] = i & 1 ? b.maxX : b.minX;
+      corners[i][1] = i & 2 ? b.maxY : b.minY;
+      corners[i][2] = i & 4 ? b.maxZ : b.minZ;
+   }
+   addOccluder(&corners[0][0], faces, 12, world);
+}
+
+
+// a bit for each pixel of the tile whose top left is x, y that o covers
+unsigned int OcclusionBuffer::coverage(const Occluder & o, int x, int y)
+{
+   unsigned int bits = 0;
+   int row, k;
+
+#if OCC_WIDTH == 8
+   __m256 lanes = _mm256_add_ps(_mm256_set1_ps((float) x), _mm256_set_ps(7, 6, 5, 4, 3, 2, 1, 0));
+   __m256 e[3], stepY[3];
+   for (k = 0; k < 3; k++)
+   {
+      e[k] = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(o.edge[k][0]), lanes),
+                           _mm256_set1_ps(o.edge[k][1] * y + o.edge[k][2]));
+      stepY[k] = _mm256_set1_ps(o.edge[k][1]);
+   }
+   for (row = 0; row < TILE_HEIGHT; row++)
+   {
+      // outside where any edge is negative
+      __m256 least = _mm256_min_ps(_mm256_min_ps(e[0], e[1]), e[2]);
+      bits |= (~(unsigned int) _mm256_movemask_ps(least) & 0xFF) << (row * TILE_WIDTH);
+      for (k = 0; k < 3; k++)
+         e[k] = _mm256_add_ps(e[k], stepY[k]);
+   }
+#elif OCC_WIDTH == 4
+   __m128 lanes[2], e[3][2], stepY[3];
+   lanes[0] = _mm_add_ps(_mm_set1_ps((float) x), _mm_set_ps(3, 2, 1, 0));
+   lanes[1] = _mm_add_ps(lanes[0], _mm_set1_ps(4.0f));
+   for (k = 0; k < 3; k++)
+   {
+      __m128 start = _mm_set1_ps(o.edge[k][1] * y + o.edge[k][2]), a = _mm_set1_ps(o.edge[k][0]);
+      e[k][0] = _mm_add_ps(_mm_mul_ps(a, lanes[0]), start);
+      e[k][1] = _mm_add_ps(_mm_mul_ps(a, lanes[1]), start);
+      stepY[k] = _mm_set1_ps(o.edge[k][1]);
+   }
+   for (row = 0; row < TILE_HEIGHT; row++)
+   {
+      __m128 lo = _mm_min_ps(_mm_min_ps(e[0][0], e[1][0]), e[2][0]);
+      __m128 hi = _mm_min_ps(_mm_min_ps(e[0][1], e[1][1]), e[2][1]);
+      unsigned int out = (unsigned int) (_mm_movemask_ps(lo) | _mm_movemask_ps(hi) << 4);
+      bits |= (~out & 0xFF) << (row * TILE_WIDTH);
+      for (k = 0; k < 3; k++)
+      {
+         e[k][0] = _mm_add_ps(e[k][0], stepY[k]);
+         e[k][1] = _mm_add_ps(e[k][1], stepY[k]);
+      }
+   }
+#else
+   int column;
+   for (row = 0; row < TILE_HEIGHT; row++)
+      for (column = 0; column < TILE_WIDTH; column++)
+      {
+         bool in = true;
+         for (k = 0; k < 3 && in; k++)
+            in = o.edge[k][0] * (x + column) + o.edge[k][1] * (y + row) + o.edge[k][2] >= 0.0f;
+         if (in)
+            bits |= 1u << (row * TILE_WIDTH + column);
+      }
+#endif
+   return bits;
+}
+
+
+void OcclusionBuffer::drawRows(unsigned int first, unsigned int step)
+{
+   size_t i;
+   int x, y;
+
+   for (i = 0; i < m_occluders.size(); i++)
+   {
+      const Occluder & o = m_occluders[i];
+      const float * p = o.plane;
+      // the first of this thread's rows it reaches
+      for (y = o.tileY0 + (int) ((first + step - o.tileY0 % step) % step); y <= o.tileY1; y += step)
+         for (x = o.tileX0; x <= o.tileX1; x++)
+         {
+            Tile & tile = m_tiles[y * m_tilesX + x];
+            int px = x * TILE_WIDTH, py = y * TILE_HEIGHT;
+
+            // the furthest it is in the tile.. nothing to do if that is behind all of it
+            float z = std::min(o.zMax, p[0] * (p[0] > 0.0f ? px + TILE_WIDTH : px) +
+                                       p[1] * (p[1] > 0.0f ? py + TILE_HEIGHT : py) + p[2]);
+            if (z >= tile.zFar)
+               continue;
+            unsigned int bits = coverage(o, px, py);
+            if (bits == 0)
+               continue;
+
+            if (bits == FULL_MASK)
+            {  // all of the tile is z or nearer, the mask's pixels may be nearer still
+               tile.zFar = z;
+               if (tile.zNear >= z)
+                  tile.mask = 0;
+               continue;
+            }
+            tile.zNear = tile.mask ? std::max(tile.zNear, z) : z;
+            tile.mask |= bits;
+            if (tile.mask == FULL_MASK)
+            {
+               tile.zFar = tile.zNear;
+               tile.mask = 0;
+            }
+         }
+   }
+}
+
+
+void OcclusionBuffer::drawOccluders(unsigned int numThreads)
+{
+   unsigned int n = std::min(threadCount(numThreads), m_tilesY), t;
+   std::vector<std::thread> threads;
+
+   if (n == 1 || m_occluders.size() < 256)   // not worth starting threads
+   {
+      drawRows(0, 1);
+      return;
+   }
+   // every n-th row each, so the busy middle of the screen is shared out
+   for (t = 1; t < n; t++)
+      threads.push_back(std::thread(&OcclusionBuffer::drawRows, this, t, n));
+   drawRows(0, n);
+   for (t = 0; t < threads.size(); t++)
+      threads[t].join();
+}
+
+
+//*******
+// tests
+
+// the screen rectangle (in pixels) at depth minZ or further
+bool OcclusionBuffer::testRect(float minX, float minY, float maxX, float maxY, float minZ) const
+{
+   int x0, y0, x1, y1, x, y;
+
+   if (maxX < 0.0f || maxY < 0.0f || minX >= m_width || minY >= m_height)
+      return false;   // off the screen
+   if (minZ != minZ)
+      return true;    // NaN, from a box that isn't one.. keep it
+   x0 = minX > 0.0f ? (int) minX : 0;
+   y0 = minY > 0.0f ? (int) minY : 0;
+   x1 = maxX < m_width - 1 ? (int) maxX : m_width - 1;
+   y1 = maxY < m_height - 1 ? (int) maxY : m_height - 1;
+
+   for (y = y0 / TILE_HEIGHT; y <= y1 / TILE_HEIGHT; y++)
+   {
+      // the rows of this tile the rectangle is in
+      int r0 = std::max(y0 - y * TILE_HEIGHT, 0), r1 = std::min(y1 - y * TILE_HEIGHT, TILE_HEIGHT - 1);
+      unsigned int rows = (FULL_MASK >> (32 - (r1 + 1) * TILE_WIDTH)) & (FULL_MASK << (r0 * TILE_WIDTH));
+      for (x = x0 / TILE_WIDTH; x <= x1 / TILE_WIDTH; x++)
+      {
+         const Tile & tile = m_tiles[y * m_tilesX + x];
+         if (minZ > tile.zFar)
+            continue;   // the usual case for a hidden box
+         int c0 = std::max(x0 - x * TILE_WIDTH, 0), c1 = std::min(x1 - x * TILE_WIDTH, TILE_WIDTH - 1);
+         unsigned int columns = ((0xFFu >> (7 - c1)) & (0xFFu << c0)) * 0x01010101u;
+         unsigned int rect = rows & columns;
+         if ((rect & ~tile.mask) || minZ <= tile.zNear)
+            return true;
+      }
+   }
+   return false;
+}
+
+
+// the screen rectangle and nearest depth of b's corners through m, or false
+// if any is behind the camera
+static bool projectBox(const float * m, const BoundBox & b, float width, float height, float * rect)
+{
+   int i;
+
+   rect[0] = rect[1] = rect[4] = FLT_MAX;
+   rect[2] = rect[3] = -FLT_MAX;
+   for (i = 0; i < 8; i++)
+   {
+      float px = i & 1 ? b.maxX : b.minX, py = i & 2 ? b.maxY : b.minY, pz = i & 4 ? b.maxZ : b.minZ;
+      float x = px * m[0] + py * m[4] + pz * m[8] + m[12];
+      float y = px * m[1] + py * m[5] + pz * m[9] + m[13];
+      float z = px * m[2] + py * m[6] + pz * m[10] + m[14];
+      float w = px * m[3] + py * m[7] + pz * m[11] + m[15];
+      if (!(w >= MIN_W))
+         return false;
+      x = (x / w * 0.5f + 0.5f) * width;
+      y = (0.5f - y / w * 0.5f) * height;
+      rect[0] = std::min(rect[0], x);   rect[2] = std::max(rect[2], x);
+      rect[1] = std::min(rect[1], y);   rect[3] = std::max(rect[3], y);
+      rect[4] = std::min(rect[4], z / w);
+   }
+   return true;
+}
+
+
+bool OcclusionBuffer::testBox(const BoundBox & b) const
+{
+   float rect[5];
+
+   if (!projectBox(m_viewProj, b, (float) m_width, (float) m_height, rect))
+      return true;
+   return testRect(rect[0], rect[1], rect[2], rect[3], rect[4]);
+}
+
+
+void OcclusionBuffer::testBoxes(const BoundBoxArray & boxes, unsigned int first, unsigned int last,
+                                std::vector<unsigned int> & visible, const unsigned int * remap) const
+{
+   unsigned int i = first;
+
+   if (last > boxes.count)
+      last = boxes.count;
+
+#if OCC_WIDTH == 8
+   const float * m = m_viewProj;
+   // 8 boxes at a time through the matrix, a corner at a time
+   __m256 half = _mm256_set1_ps(0.5f), width = _mm256_set1_ps((float) m_width), height = _mm256_set1_ps((float) m_height);
+   for (; i + 8 <= last; i += 8)
+   {
+      __m256 lo[3] = { _mm256_loadu_ps(&boxes.minX[i]), _mm256_loadu_ps(&boxes.minY[i]), _mm256_loadu_ps(&boxes.minZ[i]) };
+      __m256 hi[3] = { _mm256_loadu_ps(&boxes.maxX[i]), _mm256_loadu_ps(&boxes.maxY[i]), _mm256_loadu_ps(&boxes.maxZ[i]) };
+      __m256 minX = _mm256_set1_ps(FLT_MAX), minY = minX, minZ = minX, minW = minX;
+      __m256 maxX = _mm256_set1_ps(-FLT_MAX), maxY = maxX;
+      float rect[5][8], w[8];
+      int c, k;
+      for (c = 0; c < 8; c++)
+      {
+         __m256 px = c & 1 ? hi[0] : lo[0], py = c & 2 ? hi[1] : lo[1], pz = c & 4 ? hi[2] : lo[2];
+         __m256 clip[4];
+         for (k = 0; k < 4; k++)
+            clip[k] = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(px, _mm256_set1_ps(m[k])),
+                                                  _mm256_mul_ps(py, _mm256_set1_ps(m[4 + k]))),
+                                    _mm256_add_ps(_mm256_mul_ps(pz, _mm256_set1_ps(m[8 + k])),
+                                                  _mm256_set1_ps(m[12 + k])));
+         minW = _mm256_min_ps(minW, clip[3]);
+         __m256 sx = _mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_div_ps(clip[0], clip[3]), half), half), width);
+         __m256 sy = _mm256_mul_ps(_mm256_sub_ps(half, _mm256_mul_ps(_mm256_div_ps(clip[1], clip[3]), half)), height);
+         minX = _mm256_min_ps(minX, sx);   maxX = _mm256_max_ps(maxX, sx);
+         minY = _mm256_min_ps(minY, sy);   maxY = _mm256_max_ps(maxY, sy);
+         minZ = _mm256_min_ps(minZ, _mm256_div_ps(clip[2], clip[3]));
+      }
+      _mm256_storeu_ps(rect[0], minX);   _mm256_storeu_ps(rect[1], minY);
+      _mm256_storeu_ps(rect[2], maxX);   _mm256_storeu_ps(rect[3], maxY);
+      _mm256_storeu_ps(rect[4], minZ);   _mm256_storeu_ps(w, minW);
+      for (k = 0; k < 8; k++)
+         if (!(w[k] >= MIN_W) || testRect(rect[0][k], rect[1][k], rect[2][k], rect[3][k], rect[4][k]))
+            visible.push_back(remap ? remap[i + k] : i + k);
+   }
+#elif OCC_WIDTH == 4
+   const float * m = m_viewProj;
+   __m128 half = _mm_set1_ps(0.5f), width = _mm_set1_ps((float) m_width), height = _mm_set1_ps((float) m_height);
+   for (; i + 4 <= last; i += 4)
+   {
+      __m128 lo[3] = { _mm_loadu_ps(&boxes.minX[i]), _mm_loadu_ps(&boxes.minY[i]), _mm_loadu_ps(&boxes.minZ[i]) };
+      __m128 hi[3] = { _mm_loadu_ps(&boxes.maxX[i]), _mm_loadu_ps(&boxes.maxY[i]), _mm_loadu_ps(&boxes.maxZ[i]) };
+      __m128 minX = _mm_set1_ps(FLT_MAX), minY = minX, minZ = minX, minW = minX;
+      __m128 maxX = _mm_set1_ps(-FLT_MAX), maxY = maxX;
+      float rect[5][4], w[4];
+      int c, k;
+      for (c = 0; c < 8; c++)
+      {
+         __m128 px = c & 1 ? hi[0] : lo[0], py = c & 2 ? hi[1] : lo[1], pz = c & 4 ? hi[2] : lo[2];
+         __m128 clip[4];
+         for (k = 0; k < 4; k++)
+            clip[k] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(px, _mm_set1_ps(m[k])), _mm_mul_ps(py, _mm_set1_ps(m[4 + k]))),
+                                 _mm_add_ps(_mm_mul_ps(pz, _mm_set1_ps(m[8 + k])), _mm_set1_ps(m[12 + k])));
+         minW = _mm_min_ps(minW, clip[3]);
+         __m128 sx = _mm_mul_ps(_mm_add_ps(_mm_mul_ps(_mm_div_ps(clip[0], clip[3]), half), half), width);
+         __m128 sy = _mm_mul_ps(_mm_sub_ps(half, _mm_mul_ps(_mm_div_ps(clip[1], clip[3]), half)), height);
+         minX = _mm_min_ps(minX, sx);   maxX = _mm_max_ps(maxX, sx);
+         minY = _mm_min_ps(minY, sy);   maxY = _mm_max_ps(maxY, sy);
+         minZ = _mm_min_ps(minZ, _mm_div_ps(clip[2], clip[3]));
+      }
+      _mm_storeu_ps(rect[0], minX);   _mm_storeu_ps(rect[1], minY);
+      _mm_storeu_ps(rect[2], maxX);   _mm_storeu_ps(rect[3], maxY);
+      _mm_storeu_ps(rect[4], minZ);   _mm_storeu_ps(w, minW);
+      for (k = 0; k < 4; k++)
+         if (!(w[k] >= MIN_W) || testRect(rect[0][k], rect[1][k], rect[2][k], rect[3][k], rect[4][k]))
+            visible.push_back(remap ? remap[i + k] : i + k);
+   }
+#endif
+
+   for (; i < last; i++)   // whatever is left over
+      if (testBox(boxes.get(i)))
+         visible.push_back(remap ? remap[i] : i);
+}
+
+
+void OcclusionBuffer::testBoxesParallel(const BoundBoxArray & boxes, std::vector<unsigned int> & visible,
+                                        unsigned int numThreads, const unsigned int * remap) const
+{
+   unsigned int n = threadCount(numThreads);
+   unsigned int chunk = ((boxes.count + n - 1) / n + 7) & ~7u;   // rounded up, so the last lump takes the rest
+   std::vector<std::vector<unsigned int> > results(n);
+   std::vector<std::thread> threads;
+   unsigned int t;
+
+   if (n == 1 || boxes.count < 4096)   // not worth starting threads
+   {
+      testBoxes(boxes, 0, boxes.count, visible, remap);
+      return;
+   }
+
+   for (t = 1; t < n; t++)
+      threads.push_back(std::thread(&OcclusionBuffer::testBoxes, this, std::cref(boxes),
+                                    std::min(t * chunk, boxes.count), std::min((t + 1) * chunk, boxes.count),
+                                    std::ref(results[t]), remap));
+   testBoxes(boxes, 0, std::min(chunk, boxes.count), visible, remap);
+
+   for (t = 1; t < n; t++)   // join in order so the results stay sorted
+   {
+      threads[t - 1].join();
+      visible.insert(visible.end(), results[t].begin(), results[t].end());
+   }
+}
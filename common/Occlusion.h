@@ -0,0 +1,103 @@
+/* Filename:  Occlusion.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Occlusion culling on the CPU, for after the frustum test (Cull.h).  Big
+   things that hide others, the walls and the cubes nearest the camera,
+   are drawn as occluders into a small depth buffer with no colour, 320 x
+   192 say; then each object's bounding box is put on the screen and it is
+   thrown away if everything it covers there is behind what was drawn.
+
+   The depth buffer is a masked one.  It is kept in tiles of 8x4 pixels
+   and a tile has two depths and a mask rather than 32 depths: zFar is the
+   furthest anything in the tile can be, and the pixels in the mask are no
+   further than zNear as well, the furthest of the occluders drawn over
+   them since the tile last filled up.  When the mask is full zNear becomes
+   the depth of the whole tile, so an occluder made of many triangles, or
+   several side by side, fills a tile the way one big one would.
+
+   Everything errs towards visible.  A pixel only counts as covered if an
+   occluder covers all of it, not just its centre; the depth a triangle
+   gives a tile is the furthest it gets in it; a box is tested with its
+   nearest corner, over every tile its rectangle touches; and a box that
+   reaches behind the camera is visible.  Occluder triangles that cross
+   the near plane, or go far off the screen, are left out, not clipped.
+
+   Coverage is worked out a row of 8 pixels at a time with AVX, or 4 with
+   SSE, and boxes are put on the screen 8 or 4 at a time.  drawOccluders()
+   shares the rows of tiles out between threads and testBoxesParallel()
+   the boxes.  A tile's zFar is the coarse level of the hierarchy and is
+   all most tests and most occluder triangles look at; the masks are only
+   read where that isn't enough.
+*/
+
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <vector>
+#include "Cull.h"
+
+
+class OcclusionBuffer
+{
+public:
+   enum { TILE_WIDTH = 8, TILE_HEIGHT = 4 };
+
+   OcclusionBuffer();
+
+   // width x height pixels, rounded up to whole tiles, covering the viewport
+   void resize(unsigned int width, unsigned int height);
+   unsigned int width() const { return m_width; }
+   unsigned int height() const { return m_height; }
+
+   // starts a frame with nothing drawn.. D3D style (row vector, z from 0 to
+   // 1) matrices, as for Frustum::extract
+   void begin(const float * view, const float * proj);
+   void begin(const float * viewProj);
+
+   // a triangle list as an occluder, positions 3 floats each.. world is a
+   // 4x4 row vector matrix, or NULL if they are in world space already
+   void addOccluder(const float * positions, const unsigned short * indices, unsigned int triangles,
+                    const float * world);
+   // a solid box, local to world.. a flat one (one size 0) for a wall
+   void addOccluderBox(const BoundBox & local, const float * world);
+
+   // draws what was added since begin(), numThreads 0 = all cores
+   void drawOccluders(unsigned int numThreads = 1);
+   unsigned int occluders() const { return (unsigned int) m_occluders.size(); }   // triangles kept
+
+   bool testBox(const BoundBox & b) const;   // true if any part may be visible
+
+   // as Frustum::testBoxes, appends the ones that may be visible
+   void testBoxes(const BoundBoxArray & boxes, unsigned int first, unsigned int last,
+                  std::vector<unsigned int> & visible, const unsigned int * remap = 0) const;
+   void testBoxesParallel(const BoundBoxArray & boxes, std::vector<unsigned int> & visible,
+                          unsigned int numThreads = 0, const unsigned int * remap = 0) const;
+
+private:
+   struct Tile
+   {
+      float zFar, zNear;
+      unsigned int mask;   // bit row * 8 + column
+   };
+
+   // a triangle set up for drawing: edges already pulled in half a pixel
+   struct Occluder
+   {
+      float edge[3][3];      // a * x + b * y + c, at least 0 inside
+      float plane[3];        // z the same way
+      float zMax;            // of the corners
+      int tileX0, tileY0, tileX1, tileY1;
+   };
+
+   void drawRows(unsigned int first, unsigned int step);   // tile rows first, first + step, ..
+   static unsigned int coverage(const Occluder & o, int x, int y);   // of the tile at pixel x, y
+   bool testRect(float minX, float minY, float maxX, float maxY, float minZ) const;
+
+   unsigned int m_width, m_height, m_tilesX, m_tilesY;
+   std::vector<Tile> m_tiles;
+   std::vector<Occluder> m_occluders;
+   float m_viewProj[16];
+};
+
+#endif
@@ -0,0 +1,420 @@
+/* Filename:  ProcTex.cpp
+
+   This file accompanies ProcTex.h.
+*/
+
+#include "ProcTex.h"
+#include <stddef.h>
+#include <math.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define PROC_SSE2 1
+#endif
+
+// AVX2 is only used if the processor has it, like BmpLoader does
+#if defined(PROC_SSE2) && (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PROC_AVX2 1
+#define PROC_TARGET(x) __attribute__((target(x)))
+#elif defined(PROC_SSE2) && defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#define PROC_AVX2 1
+#define PROC_TARGET(x)
+#endif
+
+#define RADIAL_FALLOFF 10.0f   // 1 / (1 + k d^2), about what tex2.bmp has
+
+
+ProcParams procParams(ProcPattern pattern)
+{
+   ProcParams p;
+
+   p.pattern = pattern;
+   p.inner = 0xFFFFFFFF;
+   p.outer = 0xFF000000;
+   p.centerX = p.centerY = 0.5f;
+   p.radius = 0.5f;
+   p.softness = 0.25f;
+   p.cells = 8;
+   p.octaves = 4;
+   p.seed = 1;
+   return p;
+}
+
+
+// from one colour to another by t, 0 to 1, a channel at a time
+struct ColorRamp
+{
+   float base[4], delta[4];   // B, G, R, A
+
+   ColorRamp(unsigned int from, unsigned int to)
+   {
+      int i;
+      for (i = 0; i < 4; i++)
+      {
+         base[i] = (float) ((from >> (8 * i)) & 0xFF);
+         delta[i] = (float) ((to >> (8 * i)) & 0xFF) - base[i];
+      }
+   }
+
+   unsigned int color(float t) const
+   {
+      unsigned int c = 0;
+      int i;
+      for (i = 0; i < 4; i++)
+         c |= (unsigned int) (base[i] + delta[i] * t + 0.5f) << (8 * i);
+      return c;
+   }
+};
+
+
+#ifdef PROC_SSE2
+
+// the ramp's channels splatted once, so a row doesn't set them up again
+struct ColorRamp4
+{
+   __m128 base[4], delta[4];
+
+   explicit ColorRamp4(const ColorRamp & r)
+   {
+      int i;
+      for (i = 0; i < 4; i++)
+      {
+         base[i] = _mm_set1_ps(r.base[i]);
+         delta[i] = _mm_set1_ps(r.delta[i]);
+      }
+   }
+
+   // 4 pixels' colours, t already 0 to 1
+   void store(unsigned int * p, __m128 t) const
+   {
+      __m128i b = _mm_cvtps_epi32(_mm_add_ps(base[0], _mm_mul_ps(delta[0], t)));
+      __m128i g = _mm_cvtps_epi32(_mm_add_ps(base[1], _mm_mul_ps(delta[1], t)));
+      __m128i r = _mm_cvtps_epi32(_mm_add_ps(base[2], _mm_mul_ps(delta[2], t)));
+      __m128i a = _mm_cvtps_epi32(_mm_add_ps(base[3], _mm_mul_ps(delta[3], t)));
+      __m128i c = _mm_or_si128(_mm_or_si128(b, _mm_slli_epi32(g, 8)),
+                               _mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(a, 24)));
+      _mm_storeu_si128((__m128i *) p, c);
+   }
+};
+
+#endif
+
+
+#ifdef PROC_AVX2
+
+static bool detectAvx2()
+{
+#if defined(__GNUC__) || defined(__clang__)
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2") != 0;
+#else
+   int regs[4];
+   __cpuid(regs, 0);
+   int maxLeaf = regs[0];
+   __cpuid(regs, 1);
+   bool osAvx = (regs[2] & (1 << 27)) && (regs[2] & (1 << 28)) &&   // OSXSAVE, AVX..
+                (_xgetbv(0) & 6) == 6;                              // .. and the OS saves ymm
+   if (!osAvx || maxLeaf < 7)
+      return false;
+   __cpuidex(regs, 7, 0);
+   return (regs[1] & (1 << 5)) != 0;
+#endif
+}
+
+static bool hasAvx2()
+{
+   static const bool avx2 = detectAvx2();
+   return avx2;
+}
+
+
+// lightRows' inner loop 8 pixels at a time, as far as whole 8s go..
+// returns where it got to
+template <bool Spot>
+PROC_TARGET("avx2")
+static int lightRowAVX2(unsigned int * row, int width, float startX, float stepX, float dy2,
+                        float a, float b, const ColorRamp & ramp)
+{
+   __m256 base[4], delta[4];
+   __m256 one = _mm256_set1_ps(1), zero = _mm256_setzero_ps(), a8 = _mm256_set1_ps(a), b8 = _mm256_set1_ps(b);
+   __m256 dy28 = _mm256_set1_ps(dy2), step8 = _mm256_set1_ps(8 * stepX), t;
+   __m256 dx = _mm256_add_ps(_mm256_set1_ps(startX),
+                             _mm256_mul_ps(_mm256_setr_ps(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_ps(stepX)));
+   int x, i;
+
+   for (i = 0; i < 4; i++)
+   {
+      base[i] = _mm256_set1_ps(ramp.base[i]);
+      delta[i] = _mm256_set1_ps(ramp.delta[i]);
+   }
+   for (x = 0; x + 8 <= width; x += 8, dx = _mm256_add_ps(dx, step8))
+   {
+      __m256 d2 = _mm256_add_ps(_mm256_mul_ps(dx, dx), dy28);
+      if (Spot)
+      {
+         t = _mm256_sub_ps(a8, _mm256_mul_ps(_mm256_sqrt_ps(d2), b8));
+         t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+         t = _mm256_mul_ps(_mm256_mul_ps(t, t), _mm256_sub_ps(_mm256_set1_ps(3), _mm256_add_ps(t, t)));
+      }
+      else
+      {
+         t = _mm256_sub_ps(_mm256_mul_ps(_mm256_rcp_ps(_mm256_add_ps(one, d2)), a8), b8);
+         t = _mm256_min_ps(_mm256_max_ps(t, zero), one);
+      }
+      __m256i cb = _mm256_cvtps_epi32(_mm256_add_ps(base[0], _mm256_mul_ps(delta[0], t)));
+      __m256i cg = _mm256_cvtps_epi32(_mm256_add_ps(base[1], _mm256_mul_ps(delta[1], t)));
+      __m256i cr = _mm256_cvtps_epi32(_mm256_add_ps(base[2], _mm256_mul_ps(delta[2], t)));
+      __m256i ca = _mm256_cvtps_epi32(_mm256_add_ps(base[3], _mm256_mul_ps(delta[3], t)));
+      __m256i c = _mm256_or_si256(_mm256_or_si256(cb, _mm256_slli_epi32(cg, 8)),
+                                  _mm256_or_si256(_mm256_slli_epi32(cr, 16), _mm256_slli_epi32(ca, 24)));
+      _mm256_storeu_si256((__m256i *) (row + x), c);
+   }
+   _mm256_zeroupper();   // the SSE after this isn't VEX encoded
+   return x;
+}
+
+#endif
+
+
+static inline float saturate(float t)
+{
+   return t < 0 ? 0 : (t > 1 ? 1 : t);
+}
+
+
+static inline float smooth(float t)
+{
+   return t * t * (3 - 2 * t);
+}
+
+
+template <class Fn>
+static void parallelRows(int rows, int width, unsigned int numThreads, Fn fn)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads > (unsigned int) rows)
+      numThreads = rows;
+   if (numThreads <= 1 || rows * width < 128 * 128)   // not worth starting threads
+   {
+      fn(0, rows);
+      return;
+   }
+
+   std::vector<std::thread> threads;
+   int chunk = (rows + numThreads - 1) / numThreads;
+   unsigned int t;
+   for (t = 1; t < numThreads; t++)
+      threads.push_back(std::thread(fn, std::min((int) t * chunk, rows), std::min((int) (t + 1) * chunk, rows)));
+   fn(0, std::min(chunk, rows));
+   for (t = 0; t < threads.size(); t++)
+      threads[t].join();
+}
+
+
+// radial and spot both go by the distance from the center, in radii..
+// radial as 1 / (1 + k d^2) moved down to reach 0 at d = 1, spot as a
+// smoothed step from 1 - softness to 1.  Radial works in distances
+// already scaled by the square root of k, so it is one add and a
+// reciprocal from there
+template <bool Spot>
+static void lightRows(const ProcParams & p, unsigned char * dst, int width, int height, int pitch,
+                      int first, int last)
+{
+   ColorRamp ramp(p.outer, p.inner);
+   float k = Spot ? 1 : RADIAL_FALLOFF, floor0 = 1 / (1 + RADIAL_FALLOFF), scale = 1 / (1 - floor0);
+   float invSoft = 1 / std::max(p.softness, 0.001f);
+   float stepX = sqrtf(k) / (p.radius * width);
+   float startX = (0.5f / width - p.centerX) * sqrtf(k) / p.radius;
+   int x, y;
+
+#ifdef PROC_SSE2
+   ColorRamp4 ramp4(ramp);
+   __m128 one = _mm_set1_ps(1), zero = _mm_setzero_ps();
+   float a = Spot ? invSoft : scale, b = Spot ? invSoft : floor0 * scale;
+   __m128 a4 = _mm_set1_ps(a), b4 = _mm_set1_ps(b);
+   __m128 step4 = _mm_set1_ps(4 * stepX);
+#endif
+
+   for (y = first; y < last; y++)
+   {
+      unsigned int * row = (unsigned int *) (dst + (ptrdiff_t) pitch * y);
+      float dy = ((y + 0.5f) / height - p.centerY) * sqrtf(k) / p.radius, dy2 = dy * dy;
+      x = 0;
+
+#ifdef PROC_AVX2
+      if (hasAvx2())
+         x = lightRowAVX2<Spot>(row, width, startX, stepX, dy2, a, b, ramp);
+#endif
+#ifdef PROC_SSE2
+      __m128 dy24 = _mm_set1_ps(dy2), t;
+      __m128 dx = _mm_add_ps(_mm_set1_ps(startX),
+                             _mm_mul_ps(_mm_setr_ps(x, x + 1.0f, x + 2.0f, x + 3.0f), _mm_set1_ps(stepX)));
+      for (; x + 4 <= width; x += 4, dx = _mm_add_ps(dx, step4))
+      {
+         __m128 d2 = _mm_add_ps(_mm_mul_ps(dx, dx), dy24);
+         if (Spot)
+         {  // (1 - d) / softness, smoothed
+            t = _mm_sub_ps(a4, _mm_mul_ps(_mm_sqrt_ps(d2), b4));
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+            t = _mm_mul_ps(_mm_mul_ps(t, t), _mm_sub_ps(_mm_set1_ps(3), _mm_add_ps(t, t)));
+         }
+         else
+         {  // the reciprocal estimate is good to 12 bits, plenty for 8 bit colours
+            t = _mm_sub_ps(_mm_mul_ps(_mm_rcp_ps(_mm_add_ps(one, d2)), a4), b4);
+            t = _mm_min_ps(_mm_max_ps(t, zero), one);
+         }
+         ramp4.store(row + x, t);
+      }
+#endif
+
+      for (; x < width; x++)
+      {
+         float dx = startX + x * stepX, d2 = dx * dx + dy2;
+         float t = Spot ? smooth(saturate((1 - sqrtf(d2)) * invSoft))
+                        : saturate((1 / (1 + d2) - floor0) * scale);
+         row[x] = ramp.color(t);
+      }
+   }
+}
+
+
+// a value from 0 to 1 for each lattice point
+static inline float lattice(int i, int j, unsigned int seed)
+{
+   unsigned int h = (unsigned int) i * 0x8DA6B343u ^ (unsigned int) j * 0xD8163841u ^ seed * 0xCB1AB31Fu;
+   h ^= h >> 13;
+   h *= 0x85EBCA6Bu;
+   h ^= h >> 16;
+   return (h & 0xFFFF) / 65535.0f;
+}
+
+
+// each octave's lattice wraps around the texture, so it tiles
+static void noiseRows(const ProcParams & p, unsigned char * dst, int width, int height, int pitch,
+                      int first, int last)
+{
+   ColorRamp ramp(p.outer, p.inner);
+   std::vector<float> sum(width), cols, across(width);
+   float total = 0, amp = 1;
+   int octaves = std::max(p.octaves, 1), o, x, y, i;
+
+   for (o = 0; o < octaves; o++, amp *= 0.5f)
+      total += amp;
+
+#ifdef PROC_SSE2
+   ColorRamp4 ramp4(ramp);
+#endif
+
+   for (y = first; y < last; y++)
+   {
+      unsigned int * row = (unsigned int *) (dst + (ptrdiff_t) pitch * y);
+      std::fill(sum.begin(), sum.end(), 0.0f);
+
+      for (o = 0, amp = 1 / total; o < octaves; o++, amp *= 0.5f)
+      {
+         int cells = std::max(p.cells, 1) << o;
+         float v = (float) y * cells / height, sy = smooth(v - floorf(v));
+         int j0 = (int) v % cells, j1 = (j0 + 1) % cells;
+
+         // this row's values at each lattice column, then across between them
+         cols.resize(cells + 1);
+         for (i = 0; i < cells; i++)
+            cols[i] = amp * (lattice(i, j0, p.seed) + (lattice(i, j1, p.seed) - lattice(i, j0, p.seed)) * sy);
+         cols[cells] = cols[0];
+
+         if (width % cells == 0)
+         {  // whole cells of span pixels.. the same steps across each
+            int span = width / cells, k;
+            for (k = 0; k < span; k++)
+               across[k] = smooth((float) k / span);
+            for (i = 0; i < cells; i++)
+            {
+               float a = cols[i], b = cols[i + 1] - cols[i];
+               float * s = &sum[i * span];
+               k = 0;
+#ifdef PROC_SSE2
+               __m128 a4 = _mm_set1_ps(a), b4 = _mm_set1_ps(b);
+               for (; k + 4 <= span; k += 4)
+                  _mm_storeu_ps(s + k, _mm_add_ps(_mm_loadu_ps(s + k),
+                                                  _mm_add_ps(a4, _mm_mul_ps(b4, _mm_loadu_ps(&across[k])))));
+#endif
+               for (; k < span; k++)
+                  s[k] += a + b * across[k];
+            }
+         }
+         else
+            for (x = 0; x < width; x++)
+            {
+               float u = (float) x * cells / width;
+               i = (int) u;
+               sum[x] += cols[i] + (cols[i + 1] - cols[i]) * smooth(u - i);
+            }
+      }
+
+      x = 0;
+#ifdef PROC_SSE2
+      __m128 zero = _mm_setzero_ps(), one = _mm_set1_ps(1);
+      for (; x + 4 <= width; x += 4)
+         ramp4.store(row + x, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&sum[x]), zero), one));
+#endif
+      for (; x < width; x++)
+         row[x] = ramp.color(saturate(sum[x]));
+   }
+}
+
+
+// runs of one colour, filled straight in
+static void checkerRows(const ProcParams & p, unsigned char * dst, int width, int height, int pitch,
+                        int first, int last)
+{
+   int cells = std::max(p.cells, 1), x, y, i;
+
+   for (y = first; y < last; y++)
+   {
+      unsigned int * row = (unsigned int *) (dst + (ptrdiff_t) pitch * y);
+      int j = (int) ((long long) y * cells / height);
+      for (i = 0; i < cells; i++)
+      {
+         int x0 = (int) (((long long) i * width + cells - 1) / cells);
+         int x1 = (int) (((long long) (i + 1) * width + cells - 1) / cells);
+         unsigned int c = (i + j) & 1 ? p.outer : p.inner;
+         for (x = x0; x < x1; x++)
+            row[x] = c;
+      }
+   }
+}
+
+
+void generateTexture(const ProcParams & params, void * dst, int width, int height, int pitch,
+                     unsigned int numThreads)
+{
+   unsigned char * bits = (unsigned char *) dst;
+   const ProcParams * p = &params;
+
+   switch (params.pattern)
+   {
+   case PROC_NOISE:
+      parallelRows(height, width, numThreads, [=](int first, int last)
+                   { noiseRows(*p, bits, width, height, pitch, first, last); });
+      break;
+   case PROC_CHECKER:
+      parallelRows(height, width, numThreads, [=](int first, int last)
+                   { checkerRows(*p, bits, width, height, pitch, first, last); });
+      break;
+   case PROC_SPOT:
+      parallelRows(height, width, numThreads, [=](int first, int last)
+                   { lightRows<true>(*p, bits, width, height, pitch, first, last); });
+      break;
+   default:
+      parallelRows(height, width, numThreads, [=](int first, int last)
+                   { lightRows<false>(*p, bits, width, height, pitch, first, last); });
+      break;
+   }
+}
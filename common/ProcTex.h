@@ -0,0 +1,51 @@
+/* Filename:  ProcTex.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Makes simple textures out of nothing instead of loading them: the kind
+   of light blob tex2.bmp is, a spot light's cone, fractal noise and a
+   checker board, at whatever size is wanted.  A light map made this way
+   costs no disk reads, and every light can have its own.
+
+   Radial and spot maps are worked out 4 pixels at a time with SSE2,
+   noise a lattice cell at a time and the checker board a run of one
+   colour at a time.  The rows are split between threads.
+
+   The pixels are laid out like D3DFMT_A8R8G8B8: B, G, R, A in memory.
+*/
+
+#ifndef PROCTEX_H
+#define PROCTEX_H
+
+
+enum ProcPattern
+{
+   PROC_RADIAL,   // a point light, falling off with the square of the distance
+   PROC_SPOT,     // a spot light's cone: even inside, a soft edge, nothing outside
+   PROC_NOISE,    // value noise, octaves of it added up.. tiles
+   PROC_CHECKER   // squares of the two colours
+};
+
+struct ProcParams
+{
+   ProcPattern pattern;
+   unsigned int inner, outer;   // colours as 0xAARRGGBB: the light and around it, the
+                                // high and low of the noise, the two squares
+   float centerX, centerY;      // of the light, 0 to 1 across the texture
+   float radius;                // where the light reaches the outer colour, in the same units
+   float softness;              // spot: how much of the radius the edge takes to fade
+   int cells;                   // checker: squares across.. noise: cells across the coarsest octave
+   int octaves;                 // noise: each has twice the cells and half the strength
+   unsigned int seed;           // noise: a different one gives different noise
+};
+
+// a white light on black in the middle of the texture, filling it, and
+// 8 cells and 4 octaves for noise and checkers
+ProcParams procParams(ProcPattern pattern);
+
+// fills width x height pixels with pitch bytes from one row to the next..
+// numThreads 0 = all cores
+void generateTexture(const ProcParams & params, void * dst, int width, int height, int pitch,
+                     unsigned int numThreads = 0);
+
+#endif
@@ -0,0 +1,215 @@
+/* Filename:  Profiler.cpp
+
+   This file accompanies Profiler.h.
+*/
+
+#include "Profiler.h"
+#include <stdio.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+struct ProfileEvent
+{
+   const char * name;
+   Profiler::Ticks start, end;
+};
+
+// one thread's zones.. only that thread writes events and head, the
+// reader goes by head and leaves out anything that may have changed
+struct ProfileRing
+{
+   std::atomic<unsigned int> head;   // zones ever written, the next one goes in head % size
+   unsigned int from;                // where clear() was.. older ones aren't written out
+   unsigned int tid;                 // for the trace, kept by whichever thread has the ring next
+   std::string name;
+   ProfileEvent events[PROFILE_RING_SIZE];
+};
+
+// gives the ring back when its thread ends
+struct RingOwner
+{
+   ProfileRing * ring;
+   ~RingOwner();
+};
+
+// every ring made.. they last until the program ends
+struct RingList : public std::vector<ProfileRing *>
+{
+   ~RingList()
+   {
+      for (size_t i = 0; i < size(); i++)
+         delete (*this)[i];
+   }
+};
+
+static std::mutex ringLock;                 // for the lists, names and from.. never for writing zones
+static RingList rings;
+static std::vector<ProfileRing *> spare;    // rings whose threads have ended
+static Profiler::Ticks epochTicks;          // the time stamp counter and the clock..
+static Clock::time_point epochTime;         // .. when the first ring was made
+static thread_local ProfileRing * myRing = NULL;
+static thread_local RingOwner owner;
+
+
+RingOwner::~RingOwner()
+{
+   std::lock_guard<std::mutex> guard(ringLock);
+   if (ring)
+      spare.push_back(ring);
+   myRing = NULL;
+}
+
+
+// this thread's ring, a spare one or a new one
+static ProfileRing * newRing()
+{
+   std::lock_guard<std::mutex> guard(ringLock);
+   ProfileRing * ring;
+
+   if (rings.empty())
+   {
+      epochTicks = Profiler::ticks();
+      epochTime = Clock::now();
+   }
+   if (!spare.empty())
+   {
+      ring = spare.back();
+      spare.pop_back();
+   }
+   else
+   {
+      ring = new ProfileRing;
+      ring->head = 0;
+      ring->from = 0;
+      ring->tid = (unsigned int) rings.size() + 1;
+      rings.push_back(ring);
+   }
+   owner.ring = ring;
+   myRing = ring;
+   return ring;
+}
+
+
+Profiler::Ticks Profiler::steadyTicks()
+{
+   return (Ticks) std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+
+void Profiler::record(const char * name, Ticks start, Ticks end)
+{
+   ProfileRing * ring = myRing ? myRing : newRing();
+   unsigned int head = ring->head.load(std::memory_order_relaxed);
+   ProfileEvent & e = ring->events[head & (PROFILE_RING_SIZE - 1)];
+
+   e.name = name;
+   e.start = start;
+   e.end = end;
+   ring->head.store(head + 1, std::memory_order_release);
+}
+
+
+void Profiler::setThreadName(const char * name)
+{
+   ProfileRing * ring = myRing ? myRing : newRing();
+   std::lock_guard<std::mutex> guard(ringLock);
+   ring->name = name;
+}
+
+
+void Profiler::clear()
+{
+   std::lock_guard<std::mutex> guard(ringLock);
+   for (size_t i = 0; i < rings.size(); i++)
+      rings[i]->from = rings[i]->head.load(std::memory_order_acquire);
+}
+
+
+// a name as a JSON string
+static void writeString(FILE * f, const char * s)
+{
+   fputc('"', f);
+   for (; *s; s++)
+   {
+      if (*s == '"' || *s == '\\')
+         fprintf(f, "\\%c", *s);
+      else if ((unsigned char) *s < 0x20)
+         fprintf(f, "\\u%04x", (unsigned char) *s);
+      else
+         fputc(*s, f);
+   }
+   fputc('"', f);
+}
+
+
+bool Profiler::writeChromeTrace(const char * filename)
+{
+   std::lock_guard<std::mutex> guard(ringLock);
+   std::vector<ProfileEvent> events;
+   FILE * f;
+   bool first = true, ok;
+   double usPerTick = 0.0;
+
+   f = fopen(filename, "w");
+   if (f == NULL)
+      return false;
+
+   // how long a tick is, from how far the counter and the clock have both
+   // gone since the first ring.. rdtsc runs at a fixed rate, whatever the
+   // clock speed, on anything from the last ten years or so
+   if (!rings.empty())
+   {
+      double us = std::chrono::duration<double, std::micro>(Clock::now() - epochTime).count();
+      Ticks ticks = Profiler::ticks() - epochTicks;
+      usPerTick = ticks ? us / (double) ticks : 0.0;
+   }
+
+   fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+   for (size_t r = 0; r < rings.size(); r++)
+   {
+      ProfileRing * ring = rings[r];
+      unsigned int head = ring->head.load(std::memory_order_acquire);
+      unsigned int count = head - ring->from, written, skip, k;
+
+      if (count > PROFILE_RING_SIZE)
+         count = PROFILE_RING_SIZE;
+      events.resize(count);
+      for (k = 0; k < count; k++)
+         events[k] = ring->events[(head - count + k) & (PROFILE_RING_SIZE - 1)];
+
+      // each zone written since took the oldest slot, and the one being
+      // written now may have the next
+      written = ring->head.load(std::memory_order_acquire) - head + 1;
+      if (written >= PROFILE_RING_SIZE)
+         skip = count;
+      else
+         skip = count + written > PROFILE_RING_SIZE ? count + written - PROFILE_RING_SIZE : 0;
+
+      if (!ring->name.empty())
+      {
+         fprintf(f, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                 first ? "" : ",\n", ring->tid);
+         writeString(f, ring->name.c_str());
+         fprintf(f, "}}");
+         first = false;
+      }
+      for (k = skip; k < count; k++)
+      {
+         const ProfileEvent & e = events[k];
+         fprintf(f, "%s{\"name\":", first ? "" : ",\n");
+         writeString(f, e.name);
+         fprintf(f, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}", ring->tid,
+                 (double) (long long) (e.start - epochTicks) * usPerTick, (double) (e.end - e.start) * usPerTick);
+         first = false;
+      }
+   }
+   fprintf(f, "\n]}\n");
+
+   ok = ferror(f) == 0;
+   return fclose(f) == 0 && ok;
+}
@@ -0,0 +1,99 @@
+/* Filename:  Profiler.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Scoped timing zones, for seeing where a frame goes.  Put
+      PROFILE_ZONE("doMath");
+   at the top of a block and the time from there to the end of the block
+   is recorded, with the thread it ran on.  Zones nest however the code
+   does.  The names have to be string literals, or anything else that
+   lives as long as the program, since only the pointer is kept.
+
+   Each thread writes into its own ring of the last PROFILE_RING_SIZE
+   zones, so there is no lock and nothing shared on the way in: a zone is
+   two reads of the time stamp counter (rdtsc, or steady_clock where there
+   isn't one) and one write.  bench/profbench measured 38 to 43 ns a zone,
+   but on a virtual machine that traps rdtsc, so that is mostly the trap..
+   run it for the figure on real hardware.
+   A thread that ends hands its ring on to the next one to start, so the
+   worker threads that come and go don't add up.
+
+   writeChromeTrace() saves what the rings hold as trace event JSON, which
+   chrome://tracing and ui.perfetto.dev open.  Best done between frames..
+   zones being written while it reads are left out.
+
+   Built with NO_PROFILE defined the zones are compiled out altogether and
+   cost nothing.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#define PROFILE_RING_SIZE 65536   // zones kept per thread, a power of 2
+
+#if defined(_MSC_VER) && (defined(_M_IX86) || defined(_M_X64))
+#include <intrin.h>
+#define PROFILE_RDTSC 1
+#elif (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define PROFILE_RDTSC 1
+#endif
+
+
+class Profiler
+{
+public:
+   typedef unsigned long long Ticks;
+
+   static inline Ticks ticks()
+   {
+#ifdef PROFILE_RDTSC
+      return __rdtsc();
+#else
+      return steadyTicks();
+#endif
+   }
+
+   // adds a zone to this thread's ring
+   static void record(const char * name, Ticks start, Ticks end);
+
+   // what the calling thread is called in the trace.. "main", "texture loader"
+   static void setThreadName(const char * name);
+
+   // every ring, as trace event JSON.. false if the file can't be written
+   static bool writeChromeTrace(const char * filename);
+
+   static void clear();   // forgets every zone recorded so far
+
+private:
+   static Ticks steadyTicks();
+};
+
+
+class ProfileZone
+{
+public:
+   explicit ProfileZone(const char * name) : m_name(name), m_start(Profiler::ticks()) {}
+   ~ProfileZone() { Profiler::record(m_name, m_start, Profiler::ticks()); }
+
+private:
+   ProfileZone(const ProfileZone &);
+   ProfileZone & operator=(const ProfileZone &);
+
+   const char * m_name;
+   Profiler::Ticks m_start;
+};
+
+
+#define PROFILE_JOIN2(a, b) a##b
+#define PROFILE_JOIN(a, b) PROFILE_JOIN2(a, b)
+
+#ifdef NO_PROFILE
+#define PROFILE_ZONE(name)
+#define PROFILE_THREAD(name)
+#else
+#define PROFILE_ZONE(name) ProfileZone PROFILE_JOIN(profileZone, __LINE__)(name)
+#define PROFILE_THREAD(name) Profiler::setThreadName(name)
+#endif
+
+#endif
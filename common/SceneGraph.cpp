@@ -0,0 +1,431 @@
+/* Filename:  SceneGraph.cpp
+
+   This file accompanies SceneGraph.h.
+*/
+
+#include "SceneGraph.h"
+#include "VecMath.h"
+#include <math.h>
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+
+void transformMatrix(const Transform & t, float * m)
+{
+   float cy = cosf(t.yaw), sy = sinf(t.yaw);
+   float cp = cosf(t.pitch), sp = sinf(t.pitch);
+   float cr = cosf(t.roll), sr = sinf(t.roll);
+
+   // the rotation is roll, then pitch, then yaw like D3DX does it
+   m[0] = t.width * (cr * cy + sr * sp * sy);
+   m[1] = t.width * (sr * cp);
+   m[2] = t.width * (sr * sp * cy - cr * sy);
+   m[3] = 0.0f;
+   m[4] = t.height * (cr * sp * sy - sr * cy);
+   m[5] = t.height * (cr * cp);
+   m[6] = t.height * (sr * sy + cr * sp * cy);
+   m[7] = 0.0f;
+   m[8] = t.depth * (cp * sy);
+   m[9] = t.depth * (-sp);
+   m[10] = t.depth * (cp * cy);
+   m[11] = 0.0f;
+   m[12] = t.posX;
+   m[13] = t.posY;
+   m[14] = t.posZ;
+   m[15] = 1.0f;
+}
+
+
+static unsigned int threadCount(unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   return numThreads ? numThreads : 1;
+}
+
+
+SceneGraph::SceneGraph()
+{
+   m_firstRoot = m_lastRoot = NONE;
+   m_count = 0;
+   m_flat = true;
+   m_rescan = false;
+}
+
+
+void SceneGraph::reserve(unsigned int n)
+{
+   m_slot.reserve(n);
+   m_parent.reserve(n);
+   m_firstChild.reserve(n);
+   m_lastChild.reserve(n);
+   m_nextSibling.reserve(n);
+   m_prevSibling.reserve(n);
+   m_node.reserve(n);
+   m_parentSlot.reserve(n);
+   m_end.reserve(n);
+   m_local.reserve(n);
+   m_world.reserve((size_t) n * 16);
+   m_dirty.reserve(n);
+   m_pending.reserve(n);
+   m_changed.reserve(n);
+}
+
+
+unsigned int SceneGraph::create(const Transform & local, unsigned int parent)
+{
+   unsigned int node, slot = (unsigned int) m_node.size();
+
+   if (!m_freeNodes.empty())
+   {
+      node = m_freeNodes.back();
+      m_freeNodes.pop_back();
+   }
+   else
+   {
+      node = (unsigned int) m_slot.size();
+      m_slot.push_back(NONE);
+      m_parent.push_back(NONE);
+      m_firstChild.push_back(NONE);
+      m_lastChild.push_back(NONE);
+      m_nextSibling.push_back(NONE);
+      m_prevSibling.push_back(NONE);
+   }
+   m_firstChild[node] = m_lastChild[node] = NONE;
+   linkChild(node, parent);
+
+   // it goes on the end of the arrays.. that is still depth first order if it
+   // is a root, or if its parent's subtree is the last thing in the arrays
+   unsigned int parentSlot = parent == NONE ? NONE : m_slot[parent];
+   if (m_flat && parentSlot != NONE)
+   {
+      if (m_end[parentSlot] == slot)
+         for (unsigned int p = parentSlot; p != NONE; p = m_parentSlot[p])
+            m_end[p] = slot + 1;
+      else
+         m_flat = false;   // update() sorts it into place
+   }
+
+   m_slot[node] = slot;
+   m_node.push_back(node);
+   m_parentSlot.push_back(parentSlot);
+   m_end.push_back(slot + 1);
+   m_local.push_back(local);
+   m_world.resize(m_world.size() + 16, 0.0f);
+   m_dirty.push_back(0);
+   m_pending.push_back(0);
+   m_changed.push_back(0);
+   m_count++;
+
+   markDirty(slot);
+   return node;
+}
+
+
+void SceneGraph::destroy(unsigned int node)
+{
+   if (node >= m_slot.size() || m_slot[node] == NONE)
+      return;
+
+   while (m_firstChild[node] != NONE)
+   {
+      unsigned int child = m_firstChild[node];
+      unlinkChild(child);
+      linkChild(child, m_parent[node]);
+   }
+   unlinkChild(node);
+
+   m_node[m_slot[node]] = NONE;   // a hole until the arrays are sorted again
+   m_slot[node] = NONE;
+   m_freeNodes.push_back(node);
+   m_count--;
+   m_flat = false;
+}
+
+
+void SceneGraph::setParent(unsigned int node, unsigned int parent)
+{
+   unsigned int p;
+
+   if (m_parent[node] == parent)
+      return;
+   for (p = parent; p != NONE; p = m_parent[p])
+      if (p == node)
+         return;   // it would end up under itself
+
+   unlinkChild(node);
+   linkChild(node, parent);
+   m_flat = false;
+}
+
+
+void SceneGraph::linkChild(unsigned int node, unsigned int parent)
+{
+   unsigned int & first = parent == NONE ? m_firstRoot : m_firstChild[parent];
+   unsigned int & last = parent == NONE ? m_lastRoot : m_lastChild[parent];
+
+   m_parent[node] = parent;
+   m_prevSibling[node] = last;
+   m_nextSibling[node] = NONE;
+   if (last != NONE)
+      m_nextSibling[last] = node;
+   else
+      first = node;
+   last = node;
+}
+
+
+void SceneGraph::unlinkChild(unsigned int node)
+{
+   unsigned int parent = m_parent[node];
+   unsigned int & first = parent == NONE ? m_firstRoot : m_firstChild[parent];
+   unsigned int & last = parent == NONE ? m_lastRoot : m_lastChild[parent];
+
+   if (m_prevSibling[node] != NONE)
+      m_nextSibling[m_prevSibling[node]] = m_nextSibling[node];
+   else
+      first = m_nextSibling[node];
+   if (m_nextSibling[node] != NONE)
+      m_prevSibling[m_nextSibling[node]] = m_prevSibling[node];
+   else
+      last = m_prevSibling[node];
+   m_parent[node] = m_nextSibling[node] = m_prevSibling[node] = NONE;
+}
+
+
+void SceneGraph::setLocal(unsigned int node, const Transform & t)
+{
+   m_local[m_slot[node]] = t;
+   markDirty(m_slot[node]);
+}
+
+
+Transform & SceneGraph::editLocal(unsigned int node)
+{
+   markDirty(m_slot[node]);
+   return m_local[m_slot[node]];
+}
+
+
+void SceneGraph::touch(unsigned int node)
+{
+   m_dirty[m_slot[node]] = 1;
+   if (!m_rescan.load(std::memory_order_relaxed))
+      m_rescan.store(true, std::memory_order_relaxed);
+}
+
+
+void SceneGraph::markDirty(unsigned int slot)
+{
+   m_dirty[slot] = 1;
+
+   // flag the way up, stopping at the first ancestor that already knows
+   while (!m_pending[slot])
+   {
+      m_pending[slot] = 1;
+      if (m_parentSlot[slot] == NONE)
+      {
+         m_dirtyRoots.push_back(m_node[slot]);
+         break;
+      }
+      slot = m_parentSlot[slot];
+   }
+}
+
+
+void SceneGraph::flatten()
+{
+   std::vector<unsigned int> order;
+   unsigned int i, n;
+
+   // walk the child lists depth first
+   order.reserve(m_count);
+   for (unsigned int root = m_firstRoot; root != NONE; root = m_nextSibling[root])
+   {
+      n = root;
+      for (;;)
+      {
+         order.push_back(n);
+         if (m_firstChild[n] != NONE)
+         {
+            n = m_firstChild[n];
+            continue;
+         }
+         while (n != root && m_nextSibling[n] == NONE)
+            n = m_parent[n];
+         if (n == root)
+            break;
+         n = m_nextSibling[n];
+      }
+   }
+
+   std::vector<Transform> local(order.size());
+   std::vector<float> world(order.size() * 16);
+   for (i = 0; i < order.size(); i++)
+   {
+      local[i] = m_local[m_slot[order[i]]];
+      memcpy(&world[(size_t) i * 16], &m_world[(size_t) m_slot[order[i]] * 16], 16 * sizeof(float));
+   }
+   m_local.swap(local);
+   m_world.swap(world);
+
+   n = (unsigned int) order.size();
+   m_node = order;
+   for (i = 0; i < n; i++)
+      m_slot[order[i]] = i;
+   m_parentSlot.resize(n);
+   m_end.resize(n);
+   for (i = 0; i < n; i++)
+   {
+      m_parentSlot[i] = m_parent[order[i]] == NONE ? NONE : m_slot[m_parent[order[i]]];
+      m_end[i] = i + 1;
+   }
+   for (i = n; i-- > 0; )   // children come after parents, so go backwards
+      if (m_parentSlot[i] != NONE)
+         m_end[m_parentSlot[i]] = std::max(m_end[m_parentSlot[i]], m_end[i]);
+
+   // things moved to different parents.. simplest to do everything once
+   m_dirty.assign(n, 1);
+   m_pending.assign(n, 0);
+   m_changed.assign(n, 0);
+   m_dirtyRoots.clear();
+   m_rescan = true;
+   m_flat = true;
+}
+
+
+void SceneGraph::updateNode(unsigned int slot)
+{
+   float l[16];
+   float * w = &m_world[(size_t) slot * 16];
+
+   transformMatrix(m_local[slot], l);
+   if (m_parentSlot[slot] == NONE)
+   {
+      memcpy(w, l, sizeof(l));
+      return;
+   }
+
+   // local * parent world
+   mat4Multiply(w, l, &m_world[(size_t) m_parentSlot[slot] * 16]);
+}
+
+
+unsigned int SceneGraph::updateSubtree(unsigned int root)
+{
+   unsigned int slot = root, end = m_end[root], done = 0;
+
+   while (slot < end)
+   {
+      unsigned int p = m_parentSlot[slot];
+      bool recompute = m_dirty[slot] || (p != NONE && m_changed[p]);
+
+      if (!recompute && !m_pending[slot])
+      {  // nothing changed in here
+         slot = m_end[slot];
+         continue;
+      }
+      if (recompute)
+      {
+         updateNode(slot);
+         done++;
+      }
+      m_changed[slot] = recompute;
+      m_dirty[slot] = m_pending[slot] = 0;
+      slot++;
+   }
+   return done;
+}
+
+
+unsigned int SceneGraph::update(unsigned int numThreads)
+{
+   std::vector<unsigned int> tasks;
+   unsigned int slot, i, n, done = 0;
+
+   if (!m_flat)
+      flatten();
+   n = (unsigned int) m_node.size();
+
+   if (m_rescan)
+   {  // touch() doesn't flag the way up.. do it for everything from the bottom
+      for (slot = n; slot-- > 0; )
+      {
+         m_pending[slot] |= m_dirty[slot];
+         if (m_pending[slot] && m_parentSlot[slot] != NONE)
+            m_pending[m_parentSlot[slot]] = 1;
+      }
+   }
+
+   if (m_rescan || m_dirtyRoots.size() > n / 16)
+   {  // lots of it changed.. cheaper to look at every root than to sort the list
+      for (slot = 0; slot < n; slot = m_end[slot])
+         if (m_pending[slot])
+            tasks.push_back(slot);
+      m_rescan = false;
+   }
+   else
+   {
+      for (i = 0; i < m_dirtyRoots.size(); i++)
+         if (m_slot[m_dirtyRoots[i]] != NONE)
+            tasks.push_back(m_slot[m_dirtyRoots[i]]);
+      std::sort(tasks.begin(), tasks.end());   // so the arrays are walked forwards
+   }
+   m_dirtyRoots.clear();
+
+   unsigned int threads = threadCount(numThreads);
+   if (threads == 1 || n < 16384 || tasks.empty())
+   {
+      for (i = 0; i < tasks.size(); i++)
+         done += updateSubtree(tasks[i]);
+      return done;
+   }
+
+   // big subtrees are split: the top node is done here, then its children
+   // are separate tasks, since nothing under one child depends on another
+   unsigned int big = n / (threads * 4);
+   std::vector<unsigned int> split;
+   for (i = 0; i < tasks.size(); i++)
+   {
+      slot = tasks[i];
+      if (m_end[slot] - slot <= big || m_end[slot] == slot + 1)
+      {
+         split.push_back(slot);
+         continue;
+      }
+
+      unsigned int p = m_parentSlot[slot];
+      bool recompute = m_dirty[slot] || (p != NONE && m_changed[p]);
+      if (recompute)
+      {
+         updateNode(slot);
+         done++;
+      }
+      m_changed[slot] = recompute;
+      m_dirty[slot] = m_pending[slot] = 0;
+      for (unsigned int c = slot + 1; c < m_end[slot]; c = m_end[c])
+         if (recompute || m_pending[c])
+            tasks.push_back(c);   // looked at again further down this loop
+   }
+
+   std::sort(split.begin(), split.end());
+
+   std::vector<unsigned int> counts(threads, 0);
+   std::vector<std::thread> workers;
+   unsigned int t;
+   for (t = 0; t < threads; t++)
+      workers.push_back(std::thread([&, t]()
+      {  // every thread takes its own run of tasks, so it walks memory forwards
+         unsigned int first = (unsigned int) ((size_t) split.size() * t / threads);
+         unsigned int last = (unsigned int) ((size_t) split.size() * (t + 1) / threads);
+         for (unsigned int k = first; k < last; k++)
+            counts[t] += updateSubtree(split[k]);
+      }));
+   for (t = 0; t < threads; t++)
+   {
+      workers[t].join();
+      done += counts[t];
+   }
+   return done;
+}
@@ -0,0 +1,103 @@
+/* Filename:  SceneGraph.h
+
+   This file is shared by the numbered examples and the tools.
+
+   A tree of transforms.  Every node has a local Transform (relative to its
+   parent) and a world matrix, which is the local matrix times the parent's
+   world matrix, so a cube can orbit another cube or a light can ride along
+   with the flag.
+
+   The nodes are kept in flat arrays in depth first order: a node is
+   followed by all of its descendants, and end() of a node is one past the
+   last of them.  Changing a local transform marks the node dirty and flags
+   its ancestors, so update() only walks down into subtrees where something
+   changed and only recomputes the matrices below a change.  Parts of the
+   scene that don't move cost nothing per frame.
+
+   Node numbers stay the same for as long as the node lives; the position
+   in the arrays does not, since adding a child in the middle of the tree or
+   destroying a node makes update() sort the arrays again.
+*/
+
+#ifndef SCENEGRAPH_H
+#define SCENEGRAPH_H
+
+#include <stddef.h>
+#include <vector>
+#include <atomic>
+
+
+struct Transform
+{
+   float posX, posY, posZ;
+   float width, height, depth;
+   float yaw, pitch, roll;
+};
+
+// scale * D3DXMatrixRotationYawPitchRoll * translation, as a 4x4 row vector matrix
+void transformMatrix(const Transform & t, float * m);
+
+
+class SceneGraph
+{
+public:
+   enum { NONE = 0xFFFFFFFF };
+
+   SceneGraph();
+
+   unsigned int create(const Transform & local, unsigned int parent = NONE);
+   void destroy(unsigned int node);   // its children move up to its parent
+   void setParent(unsigned int node, unsigned int parent);   // NONE for a root
+   unsigned int parent(unsigned int node) const { return m_parent[node]; }
+   unsigned int count() const { return m_count; }
+   void reserve(unsigned int n);
+
+   const Transform & local(unsigned int node) const { return m_local[m_slot[node]]; }
+   void setLocal(unsigned int node, const Transform & t);
+   Transform & editLocal(unsigned int node);   // marks it dirty, change it right away
+
+   // for changing many nodes from several threads at once (each thread its own
+   // nodes).. change local(), then touch().  The next update() looks the whole
+   // tree over instead of following the marks
+   Transform & lockFreeLocal(unsigned int node) { return m_local[m_slot[node]]; }
+   void touch(unsigned int node);
+
+   // recomputes the world matrices of everything that changed.. returns how many
+   unsigned int update(unsigned int numThreads = 1);
+
+   // 4x4 row vector matrix from the last update()
+   const float * world(unsigned int node) const { return &m_world[(size_t) m_slot[node] * 16]; }
+
+private:
+   void flatten();
+   void markDirty(unsigned int slot);
+   void linkChild(unsigned int node, unsigned int parent);
+   void unlinkChild(unsigned int node);
+   unsigned int updateSubtree(unsigned int slot);
+   void updateNode(unsigned int slot);
+
+   // by node number
+   std::vector<unsigned int> m_slot;          // where it is in the arrays below, NONE if free
+   std::vector<unsigned int> m_parent;
+   std::vector<unsigned int> m_firstChild, m_lastChild;
+   std::vector<unsigned int> m_nextSibling, m_prevSibling;
+   std::vector<unsigned int> m_freeNodes;
+   unsigned int m_firstRoot, m_lastRoot;      // roots are siblings of each other
+   unsigned int m_count;
+
+   // by slot, depth first
+   std::vector<unsigned int> m_node;          // slot -> node number, NONE for a hole
+   std::vector<unsigned int> m_parentSlot;
+   std::vector<unsigned int> m_end;           // one past the last descendant
+   std::vector<Transform> m_local;
+   std::vector<float> m_world;                // 16 floats each
+   std::vector<unsigned char> m_dirty;        // local changed since the last update
+   std::vector<unsigned char> m_pending;      // it or something under it is dirty
+   std::vector<unsigned char> m_changed;      // matrix recomputed in this update
+
+   std::vector<unsigned int> m_dirtyRoots;    // node numbers of roots with m_pending set
+   bool m_flat;                               // false until the arrays are sorted again
+   std::atomic<bool> m_rescan;                // touch() was used
+};
+
+#endif
@@ -0,0 +1,367 @@
+/* Filename:  SceneStore.cpp
+
+   This file accompanies SceneStore.h.
+*/
+
+#include "SceneStore.h"
+#include <math.h>
+#include <float.h>
+#include <algorithm>
+#include <thread>
+
+
+SceneStore::SceneStore()
+{
+   m_alive = 0;
+}
+
+
+Entity SceneStore::create()
+{
+   Entity e;
+
+   if (!m_free.empty())
+   {  // reuse a slot.. its generation was bumped when it was destroyed
+      e.index = m_free.back();
+      m_free.pop_back();
+   }
+   else
+   {
+      e.index = (unsigned int) m_generation.size();
+      m_generation.push_back(0);
+   }
+   e.generation = m_generation[e.index];
+   m_alive++;
+   return e;
+}
+
+
+void SceneStore::destroy(Entity e)
+{
+   if (!alive(e))
+      return;
+
+   if (m_nodes.has(e.index))
+   {  // its children stay where they are in the tree, but one level up
+      m_graph.destroy(*m_nodes.get(e.index));
+      m_nodes.remove(e.index);
+   }
+   m_motions.remove(e.index);
+   m_steps.remove(e.index);
+   m_renderables.remove(e.index);
+   m_lights.remove(e.index);
+
+   m_generation[e.index]++;   // old handles stop working
+   m_free.push_back(e.index);
+   m_alive--;
+}
+
+
+bool SceneStore::alive(Entity e) const
+{
+   return e.index < m_generation.size() && m_generation[e.index] == e.generation;
+}
+
+
+void SceneStore::reserve(unsigned int n)
+{
+   m_generation.reserve(n);
+   m_nodes.reserve(n);
+   m_graph.reserve(n);
+   m_motions.reserve(n);
+   m_steps.reserve(n);
+   m_renderables.reserve(n);
+}
+
+
+void SceneStore::addTransform(Entity e, const Transform & t)
+{
+   if (!alive(e))
+      return;
+   if (m_nodes.has(e.index))
+      m_graph.setLocal(*m_nodes.get(e.index), t);
+   else
+      m_nodes.add(e.index, m_graph.create(t));
+   if (m_steps.has(e.index))
+   {  // put there, not moved there.. nothing to interpolate from
+      MotionStep * step = m_steps.get(e.index);
+      step->from = t;
+      step->to = t;
+   }
+}
+
+
+void SceneStore::setParent(Entity child, Entity parent)
+{
+   if (!alive(child) || !m_nodes.has(child.index))
+      return;
+   if (alive(parent) && m_nodes.has(parent.index))
+      m_graph.setParent(*m_nodes.get(child.index), *m_nodes.get(parent.index));
+   else
+      m_graph.setParent(*m_nodes.get(child.index), SceneGraph::NONE);
+}
+
+
+void SceneStore::addMotion(Entity e, const Motion & m)
+{
+   MotionStep step;
+
+   if (!alive(e))
+      return;
+   if (m_nodes.has(e.index))
+      step.from = m_graph.local(*m_nodes.get(e.index));
+   else
+   {  // addTransform fills it in
+      Transform none = { 0.0f, 0.0f, 0.0f,   1.0f, 1.0f, 1.0f,   0.0f, 0.0f, 0.0f };
+      step.from = none;
+   }
+   step.to = step.from;
+   m_motions.add(e.index, m);
+   m_steps.add(e.index, step);
+}
+
+
+void SceneStore::addRenderable(Entity e, const Renderable & r)
+{
+   if (alive(e))
+      m_renderables.add(e.index, r);
+}
+
+
+void SceneStore::addLight(Entity e, const Light & l)
+{
+   if (alive(e))
+      m_lights.add(e.index, l);
+}
+
+
+const Transform * SceneStore::transform(Entity e)
+{
+   if (!alive(e) || !m_nodes.has(e.index))
+      return NULL;
+   if (m_steps.has(e.index))   // the graph's may be part way back to the step before
+      return &m_steps.get(e.index)->to;
+   return &m_graph.local(*m_nodes.get(e.index));
+}
+
+
+void SceneStore::setTransform(Entity e, const Transform & t)
+{
+   if (alive(e) && m_nodes.has(e.index))
+      addTransform(e, t);
+}
+
+
+Motion * SceneStore::motion(Entity e)
+{
+   return alive(e) ? m_motions.get(e.index) : NULL;
+}
+
+
+Renderable * SceneStore::renderable(Entity e)
+{
+   return alive(e) ? m_renderables.get(e.index) : NULL;
+}
+
+
+Light * SceneStore::light(Entity e)
+{
+   return alive(e) ? m_lights.get(e.index) : NULL;
+}
+
+
+const float * SceneStore::world(Entity e)
+{
+   if (!alive(e) || !m_nodes.has(e.index))
+      return NULL;
+   return m_graph.world(*m_nodes.get(e.index));
+}
+
+
+// splits [0, count) between threads and runs fn on each piece
+template <class Fn>
+static void parallelFor(unsigned int count, unsigned int numThreads, Fn fn)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads <= 1 || count < 16384)
+   {
+      fn(0, count);
+      return;
+   }
+
+   std::vector<std::thread> threads;
+   unsigned int chunk = (count + numThreads - 1) / numThreads;
+   unsigned int t;
+   for (t = 1; t < numThreads; t++)
+      threads.push_back(std::thread(fn, std::min(t * chunk, count), std::min((t + 1) * chunk, count)));
+   fn(0, std::min(chunk, count));
+   for (t = 0; t < threads.size(); t++)
+      threads[t].join();
+}
+
+
+void SceneStore::motionRange(float t, unsigned int first, unsigned int last, bool threaded)
+{
+   Motion * motions = m_motions.data();
+   MotionStep * steps = m_steps.data();
+   const unsigned int * owners = m_motions.owners();
+   float halfTSqrd = 0.5f * t * t;
+   unsigned int i;
+
+   for (i = first; i < last; i++)
+   {
+      Motion & m = motions[i];
+      unsigned int * node = m_nodes.get(owners[i]);
+      if (node == NULL)
+         continue;
+
+      // editLocal flags the way up to the root, which can't be done from
+      // several threads.. touch only marks the node and the graph finds it later
+      Transform & local = threaded ? m_graph.lockFreeLocal(*node) : m_graph.editLocal(*node);
+      if (threaded)
+         m_graph.touch(*node);
+
+      Transform & x = steps[i].to;
+      steps[i].from = x;
+
+      // d = d + v * t + (1/2)at^2
+      // v = v + at;
+      x.yaw += m.dYaw * t + halfTSqrd * m.ddYaw;
+      m.dYaw += m.ddYaw * t;
+      x.pitch += m.dPitch * t + halfTSqrd * m.ddPitch;
+      m.dPitch += m.ddPitch * t;
+      x.roll += m.dRoll * t + halfTSqrd * m.ddRoll;
+      m.dRoll += m.ddRoll * t;
+
+      x.posX += m.velX * t;
+      x.posY += m.velY * t;
+      x.posZ += m.velZ * t;
+      local = x;
+   }
+}
+
+
+void SceneStore::interpolateRange(float alpha, unsigned int first, unsigned int last, bool threaded)
+{
+   const MotionStep * steps = m_steps.data();
+   const unsigned int * owners = m_motions.owners();
+   float beta = 1.0f - alpha;
+   unsigned int i;
+
+   for (i = first; i < last; i++)
+   {
+      unsigned int * node = m_nodes.get(owners[i]);
+      if (node == NULL)
+         continue;
+
+      Transform & x = threaded ? m_graph.lockFreeLocal(*node) : m_graph.editLocal(*node);
+      if (threaded)
+         m_graph.touch(*node);
+
+      // the angles are never wrapped, so a straight line between them is
+      // the way the entity turned
+      const Transform & a = steps[i].from;
+      const Transform & b = steps[i].to;
+      x.posX = a.posX * beta + b.posX * alpha;
+      x.posY = a.posY * beta + b.posY * alpha;
+      x.posZ = a.posZ * beta + b.posZ * alpha;
+      x.width = a.width * beta + b.width * alpha;
+      x.height = a.height * beta + b.height * alpha;
+      x.depth = a.depth * beta + b.depth * alpha;
+      x.yaw = a.yaw * beta + b.yaw * alpha;
+      x.pitch = a.pitch * beta + b.pitch * alpha;
+      x.roll = a.roll * beta + b.roll * alpha;
+   }
+}
+
+
+void SceneStore::updateMotion(float seconds, unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads <= 1 || m_motions.size() < 16384)
+   {
+      motionRange(seconds, 0, m_motions.size(), false);
+      return;
+   }
+   parallelFor(m_motions.size(), numThreads,
+               [this, seconds](unsigned int first, unsigned int last) { motionRange(seconds, first, last, true); });
+}
+
+
+void SceneStore::interpolate(float alpha, unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   if (numThreads <= 1 || m_motions.size() < 16384)
+   {
+      interpolateRange(alpha, 0, m_motions.size(), false);
+      return;
+   }
+   parallelFor(m_motions.size(), numThreads,
+               [this, alpha](unsigned int first, unsigned int last) { interpolateRange(alpha, first, last, true); });
+}
+
+
+unsigned int SceneStore::updateWorld(unsigned int numThreads)
+{
+   return m_graph.update(numThreads);
+}
+
+
+void SceneStore::collectDraws(const Frustum & frustum, std::vector<DrawItem> & draws,
+                              unsigned int numThreads, const OcclusionBuffer * occlusion)
+{
+   Renderable * renderables = m_renderables.data();
+   const unsigned int * owners = m_renderables.owners();
+   unsigned int i, count = m_renderables.size();
+
+   // a box around each sphere, so rotation never matters.. laid out for
+   // the SIMD frustum test, which does 4 or 8 of them at a time
+   if (m_bounds.count != count)
+      m_bounds.resize(count);
+   for (i = 0; i < count; i++)
+   {
+      const unsigned int * node = m_nodes.get(owners[i]);
+      if (node == NULL)
+      {  // nowhere to draw it.. an inside out box never shows
+         m_bounds.set(i, makeBoundBox(0.0f, 0.0f, 0.0f, -FLT_MAX, -FLT_MAX, -FLT_MAX));
+         continue;
+      }
+
+      // the longest axis of the world matrix is how much the parents and the
+      // entity's own size have scaled it
+      const float * w = m_graph.world(*node);
+      float sx = w[0] * w[0] + w[1] * w[1] + w[2] * w[2];
+      float sy = w[4] * w[4] + w[5] * w[5] + w[6] * w[6];
+      float sz = w[8] * w[8] + w[9] * w[9] + w[10] * w[10];
+      float r = renderables[i].radius * sqrtf(std::max(sx, std::max(sy, sz)));
+      m_bounds.set(i, makeBoundBox(w[12], w[13], w[14], r, r, r));
+   }
+
+   m_visible.clear();
+   frustum.testBoxesParallel(m_bounds, m_visible, numThreads);
+
+   // what got through, against the occluders
+   if (occlusion && !m_visible.empty())
+   {
+      m_inFrustum.resize((unsigned int) m_visible.size());
+      for (i = 0; i < m_visible.size(); i++)
+         m_inFrustum.set(i, m_bounds.get(m_visible[i]));
+      m_unoccluded.clear();
+      occlusion->testBoxesParallel(m_inFrustum, m_unoccluded, numThreads, &m_visible[0]);
+      m_visible.swap(m_unoccluded);
+   }
+
+   for (i = 0; i < m_visible.size(); i++)
+   {
+      unsigned int entity = owners[m_visible[i]];
+      DrawItem item;
+      item.object = renderables[m_visible[i]].object;
+      item.world = m_graph.world(*m_nodes.get(entity));
+      item.entity.index = entity;
+      item.entity.generation = m_generation[entity];
+      draws.push_back(item);
+   }
+}
@@ -0,0 +1,193 @@
+/* Filename:  SceneStore.h
+
+   This file is shared by the numbered examples and the tools.
+
+   A scene is a bag of entities.  An entity is only a handle; what it is
+   made of lives in component arrays, one per kind of component:
+
+      Transform    position, size and yaw/pitch/roll (what Rect3D2 had)
+      Motion       angular speed and acceleration, plus a linear speed
+      Renderable   what to draw (for example a Rect3D2) and how big it is
+      Light        a light and the point it is aimed at
+
+   Each array is packed with no holes, so the systems (updateMotion,
+   updateWorld, collectDraws) walk straight through memory instead of
+   chasing one object pointer after another.  Removing an entity moves the
+   last element of each array into its place.
+
+   Handles carry a generation number, so a handle to an entity that has
+   been destroyed (and whose slot was reused) is simply no longer valid.
+
+   Transforms live in a SceneGraph, so an entity can be given a parent and
+   then moves along with it; the transform is relative to the parent.  Only
+   entities that moved (or whose parents did) get a new world matrix in
+   updateWorld.
+
+   updateMotion is one step of the simulation, and keeps where each moving
+   entity was before the step as well as after it.  interpolate then puts
+   the transforms the graph draws with part way between the two, so the
+   simulation can run in fixed steps (see FixedStep.h) and the picture
+   still moves smoothly at any frame rate.
+
+   collectDraws can take an OcclusionBuffer (Occlusion.h) the caller has
+   drawn this frame's occluders into, and then leaves out what is hidden
+   behind them as well as what is outside the frustum.
+*/
+
+#ifndef SCENESTORE_H
+#define SCENESTORE_H
+
+#include <vector>
+#include "Cull.h"
+#include "Occlusion.h"
+#include "SceneGraph.h"
+
+
+struct Entity
+{
+   unsigned int index;
+   unsigned int generation;
+};
+
+struct Motion
+{
+   float dYaw, dPitch, dRoll;      // radians per second..
+   float ddYaw, ddPitch, ddRoll;   // .. and per second squared
+   float velX, velY, velZ;         // units per second
+};
+
+struct Renderable
+{
+   void * object;   // what draws it.. the scene never looks inside
+   float radius;    // of a sphere around the object at size 1
+};
+
+struct Light
+{
+   void * object;                     // the Light3D (or whatever) it belongs to
+   float targetX, targetY, targetZ;   // where it is aimed
+   bool enabled;
+};
+
+// what collectDraws hands back.. one per visible renderable
+struct DrawItem
+{
+   void * object;
+   const float * world;   // 4x4 row vector matrix, valid until the next updateWorld
+   Entity entity;
+};
+
+
+// one packed array of components plus the maps from entity to element and back
+template <class T>
+class ComponentArray
+{
+public:
+   bool has(unsigned int entity) const
+   {
+      return entity < m_sparse.size() && m_sparse[entity] != NONE;
+   }
+   T * get(unsigned int entity)
+   {
+      return has(entity) ? &m_dense[m_sparse[entity]] : 0;
+   }
+   unsigned int indexOf(unsigned int entity) const { return m_sparse[entity]; }
+   void add(unsigned int entity, const T & value)
+   {
+      if (entity >= m_sparse.size())
+         m_sparse.resize(entity + 1, NONE);
+      if (m_sparse[entity] != NONE)
+      {
+         m_dense[m_sparse[entity]] = value;
+         return;
+      }
+      m_sparse[entity] = (unsigned int) m_dense.size();
+      m_dense.push_back(value);
+      m_owner.push_back(entity);
+   }
+   void remove(unsigned int entity)
+   {
+      if (!has(entity))
+         return;
+      unsigned int i = m_sparse[entity], last = (unsigned int) m_dense.size() - 1;
+      m_dense[i] = m_dense[last];       // move the last one into the hole
+      m_owner[i] = m_owner[last];
+      m_sparse[m_owner[i]] = i;
+      m_dense.pop_back();
+      m_owner.pop_back();
+      m_sparse[entity] = NONE;
+   }
+   void reserve(unsigned int n)     { m_dense.reserve(n); m_owner.reserve(n); }
+   unsigned int size() const        { return (unsigned int) m_dense.size(); }
+   T * data()                       { return m_dense.empty() ? 0 : &m_dense[0]; }
+   const unsigned int * owners() const { return m_owner.empty() ? 0 : &m_owner[0]; }
+
+private:
+   enum { NONE = 0xFFFFFFFF };
+   std::vector<T> m_dense;              // the components, no holes
+   std::vector<unsigned int> m_owner;   // entity index of each component
+   std::vector<unsigned int> m_sparse;  // entity index -> element, or NONE
+};
+
+
+class SceneStore
+{
+public:
+   SceneStore();
+
+   Entity create();
+   void destroy(Entity e);
+   bool alive(Entity e) const;
+   unsigned int count() const { return m_alive; }
+   void reserve(unsigned int n);
+
+   void addTransform(Entity e, const Transform & t);
+   void setParent(Entity child, Entity parent);   // both need a transform.. an invalid parent detaches
+   void addMotion(Entity e, const Motion & m);
+   void addRenderable(Entity e, const Renderable & r);
+   void addLight(Entity e, const Light & l);
+
+   const Transform * transform(Entity e);    // NULL if the entity doesn't have one.. as of the last step
+   void setTransform(Entity e, const Transform & t);
+   Motion * motion(Entity e);
+   Renderable * renderable(Entity e);
+   Light * light(Entity e);
+   const float * world(Entity e);            // world matrix from the last updateWorld
+
+   ComponentArray<Light> & lights() { return m_lights; }
+
+   // systems.. numThreads 0 uses every core
+   void updateMotion(float seconds, unsigned int numThreads = 1);   // one step
+   void interpolate(float alpha, unsigned int numThreads = 1);     // 0 = before the last step, 1 = after
+   unsigned int updateWorld(unsigned int numThreads = 1);   // returns matrices recomputed
+   void collectDraws(const Frustum & frustum, std::vector<DrawItem> & draws,
+                     unsigned int numThreads = 1, const OcclusionBuffer * occlusion = 0);
+
+private:
+   // where a moving entity was before the last step and where it is now
+   struct MotionStep
+   {
+      Transform from, to;
+   };
+
+   void motionRange(float seconds, unsigned int first, unsigned int last, bool threaded);
+   void interpolateRange(float alpha, unsigned int first, unsigned int last, bool threaded);
+
+   std::vector<unsigned int> m_generation;   // per entity slot
+   std::vector<unsigned int> m_free;         // slots of destroyed entities
+   unsigned int m_alive;
+
+   ComponentArray<unsigned int> m_nodes;     // the entity's node in m_graph
+   SceneGraph m_graph;
+   ComponentArray<Motion> m_motions;
+   ComponentArray<MotionStep> m_steps;       // added and removed with m_motions, so in the same order
+   ComponentArray<Renderable> m_renderables;
+   ComponentArray<Light> m_lights;
+
+   BoundBoxArray m_bounds;                   // scratch for collectDraws..
+   std::vector<unsigned int> m_visible;      // .. kept so it isn't allocated every frame
+   BoundBoxArray m_inFrustum;                // and for the occlusion test
+   std::vector<unsigned int> m_unoccluded;
+};
+
+#endif
@@ -0,0 +1,819 @@
+/* Filename:  TextureCache.cpp
+
+   This file accompanies TextureCache.h.
+*/
+
+#include "TextureCache.h"
+#include "BmpLoader.h"
+#include "MappedFile.h"
+#include "MipGen.h"
+#include "Dds.h"
+#include "BlockCompress.h"
+#include "AssetPack.h"
+#include "Profiler.h"
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define PLACEHOLDER_COLOR 0xFF808080   // grey until the texture is in
+
+// levels ready to be copied into a texture, made on whichever thread
+// loaded the file
+struct StagedTexture
+{
+   std::pair<Hash64, UINT> key;
+   DdsFormat format;
+   int width, height;
+   UINT levels;
+   std::vector<unsigned char> bits;   // every level packed, or the whole file for D3DX
+   bool d3dx;                         // not a bitmap.. D3DX makes it from bits
+   bool failed;                       // couldn't be read
+};
+
+struct TextureEntry
+{
+   std::pair<Hash64, UINT> key;
+   bool hasKey;                                  // in m_entries under key
+   std::string name;                             // in m_byName if streamed
+   std::atomic<long> refs;
+   LPDIRECT3DTEXTURE9 texture;                   // NULL while it is streaming
+   UINT bytes;
+   std::list<TextureEntry *>::iterator unused;   // where it is in m_unused..
+   bool isUnused;                                // .. if it is there at all
+   DdsFormat format;                             // wanted, for a streamed bitmap
+   StagedTexture * staged;                       // loaded, waiting for uploadPending
+};
+
+
+// bytes of one mip level
+static UINT levelBytes(const D3DSURFACE_DESC & desc)
+{
+   UINT blocks = ((desc.Width + 3) / 4) * ((desc.Height + 3) / 4);
+
+   switch (desc.Format)
+   {
+   case D3DFMT_DXT1:
+      return blocks * 8;
+   case D3DFMT_DXT2:
+   case D3DFMT_DXT3:
+   case D3DFMT_DXT4:
+   case D3DFMT_DXT5:
+      return blocks * 16;
+   case D3DFMT_R5G6B5:
+   case D3DFMT_X1R5G5B5:
+   case D3DFMT_A1R5G5B5:
+   case D3DFMT_A4R4G4B4:
+      return desc.Width * desc.Height * 2;
+   case D3DFMT_R8G8B8:
+      return desc.Width * desc.Height * 3;
+   case D3DFMT_L8:
+   case D3DFMT_A8:
+   case D3DFMT_P8:
+      return desc.Width * desc.Height;
+   default:   // the 32 bit formats, and a guess for anything else
+      return desc.Width * desc.Height * 4;
+   }
+}
+
+
+static UINT textureBytes(LPDIRECT3DTEXTURE9 texture)
+{
+   D3DSURFACE_DESC desc;
+   UINT level, total = 0;
+
+   for (level = 0; level < texture->GetLevelCount(); level++)
+      if (SUCCEEDED(texture->GetLevelDesc(level, &desc)))
+         total += levelBytes(desc);
+   return total;
+}
+
+
+TextureRef::TextureRef()
+{
+   m_entry = NULL;
+}
+
+
+TextureRef::TextureRef(TextureEntry * entry)
+{
+   m_entry = entry;
+}
+
+
+TextureRef::TextureRef(const TextureRef & other)
+{
+   m_entry = other.m_entry;
+   if (m_entry)
+      m_entry->refs++;
+}
+
+
+TextureRef::~TextureRef()
+{
+   reset();
+}
+
+
+TextureRef & TextureRef::operator=(const TextureRef & other)
+{
+   if (other.m_entry)   // add first in case it is the same texture
+      other.m_entry->refs++;
+   reset();
+   m_entry = other.m_entry;
+   return *this;
+}
+
+
+void TextureRef::reset()
+{
+   if (m_entry)
+      TextureCache::instance().release(m_entry);
+   m_entry = NULL;
+}
+
+
+LPDIRECT3DTEXTURE9 TextureRef::texture() const
+{
+   if (m_entry == NULL)
+      return NULL;
+   return m_entry->texture ? m_entry->texture : TextureCache::instance().m_placeholder;
+}
+
+
+bool TextureRef::ready() const
+{
+   return m_entry && m_entry->texture;
+}
+
+
+UINT TextureRef::bytes() const
+{
+   return m_entry ? m_entry->bytes : 0;
+}
+
+
+TextureCache & TextureCache::instance()
+{
+   static TextureCache cache;
+   return cache;
+}
+
+
+TextureCache::TextureCache()
+{
+   m_budget = 32 * 1024 * 1024;
+   m_compress = true;
+   m_placeholder = NULL;
+   m_quit = false;
+   m_loading = 0;
+   m_pack = NULL;
+   m_unusedBytes = 0;
+   m_residentBytes = 0;
+   m_hits = m_misses = 0;
+}
+
+
+TextureCache::~TextureCache()
+{
+   size_t i;
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+      m_quit = true;
+   }
+   m_wake.notify_all();
+   for (i = 0; i < m_workers.size(); i++)
+      m_workers[i].join();
+   for (i = 0; i < m_ready.size(); i++)   // loaded after the device was gone
+      delete m_ready[i]->staged;
+}
+
+
+// a named file's bytes and its saved mip levels, from the pack if it has
+// them and from disk if not.. either way used where they lie, not copied
+struct TextureSource
+{
+   MappedFile file;
+   std::vector<unsigned char> scratch;   // compressed pack entries, unpacked
+   std::vector<unsigned char> mipScratch;
+   const unsigned char * data;
+   UINT bytes;
+   Hash64 hash;
+   DdsFile mips;
+   bool hasMips;
+   std::string saveAs;                   // where new levels go.. empty for a pack
+
+   bool open(const AssetPack * pack, const char * filename)
+   {
+      std::string mipFile = std::string(filename) + ".dds";
+      const unsigned char * levels;
+      PackItem item;
+
+      if (pack && pack->find(filename, item))
+      {  // the pack knows the hash already
+         data = pack->contents(item, scratch);
+         bytes = (UINT) item.rawBytes;
+         hash = item.hash;
+         hasMips = pack->find(mipFile.c_str(), item) &&
+                   (levels = pack->contents(item, mipScratch)) != NULL && mips.open(levels, item.rawBytes);
+         return data != NULL;
+      }
+
+      if (!file.open(filename))   // hashed and loaded straight from the mapping
+         return false;
+      data = file.data();
+      bytes = (UINT) file.size();
+      hash = xxHash64(data, bytes);
+      hasMips = mips.open(mipFile.c_str());
+      saveAs = mipFile;
+      return true;
+   }
+};
+
+
+TextureRef TextureCache::acquireFromFile(LPDIRECT3DDEVICE9 dev, const char * filename)
+{
+   TextureSource source;
+   const AssetPack * pack;
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+      pack = m_pack;
+   }
+   if (!source.open(pack, filename))
+      return TextureRef();
+   return acquire(dev, source.data, source.bytes, source.hash, source.hasMips ? &source.mips : NULL,
+                  source.saveAs.empty() ? NULL : source.saveAs.c_str());
+}
+
+
+TextureRef TextureCache::acquireFromMemory(LPDIRECT3DDEVICE9 dev, const void * data, UINT bytes)
+{
+   return acquire(dev, data, bytes, xxHash64(data, bytes), NULL, NULL);
+}
+
+
+static bool isPowerOf2(int n)
+{
+   return (n & (n - 1)) == 0;
+}
+
+
+static D3DFORMAT d3dFormat(DdsFormat format)
+{
+   switch (format)
+   {
+   case DDS_BGRA8:
+      return D3DFMT_A8R8G8B8;
+   case DDS_DXT1:
+      return D3DFMT_DXT1;
+   case DDS_DXT5:
+      return D3DFMT_DXT5;
+   default:
+      return D3DFMT_X8R8G8B8;
+   }
+}
+
+
+// a managed texture with every level filled in from data, where the levels
+// are packed one after the other the way a .dds file has them
+static LPDIRECT3DTEXTURE9 createFromLevels(LPDIRECT3DDEVICE9 dev, DdsFormat format, int width, int height,
+                                           UINT levels, const unsigned char * data)
+{
+   LPDIRECT3DTEXTURE9 texture = NULL;
+   D3DLOCKED_RECT rect;
+   UINT level;
+   int y;
+
+   if (FAILED(dev->CreateTexture(width, height, levels, 0, d3dFormat(format),
+                                 D3DPOOL_MANAGED, &texture, NULL)))
+      return NULL;
+   for (level = 0; level < levels; level++)
+   {
+      int pitch = ddsPitch(format, width), rows = ddsRows(format, height);
+      if (FAILED(texture->LockRect(level, &rect, NULL, 0)))
+      {
+         texture->Release();
+         return NULL;
+      }
+      for (y = 0; y < rows; y++, data += pitch)
+         memcpy((unsigned char *) rect.pBits + rect.Pitch * y, data, pitch);
+      texture->UnlockRect(level);
+      width = width > 1 ? width / 2 : 1;
+      height = height > 1 ? height / 2 : 1;
+   }
+   return texture;
+}
+
+
+// a 24 bit bitmap with power of 2 sides gets its mip levels from MipGen,
+// compressed to DXT1 unless that is turned off, or from the .dds they were
+// saved to the last time (mips) if it still matches.. in whatever format
+// that is, so tools/mipgen can pick.  New levels are saved to saveAs.
+// Anything else is left to D3DX
+static void stageTexture(const void * data, UINT bytes, Hash64 hash, const DdsFile * mips,
+                         const char * saveAs, DdsFormat format, StagedTexture & staged)
+{
+   std::vector<unsigned int> pixels;
+   std::vector<unsigned char> blocks;
+   const unsigned char * bits;
+   MipChain chain;
+   BmpInfo info;
+
+   staged.key = std::make_pair(hash, bytes);
+   staged.failed = false;
+   staged.d3dx = !readBmpInfo(data, bytes, info) || !isPowerOf2(info.width) || !isPowerOf2(info.height);
+   if (staged.d3dx)
+   {
+      staged.bits.assign((const unsigned char *) data, (const unsigned char *) data + bytes);
+      return;
+   }
+
+   staged.width = info.width;
+   staged.height = info.height;
+   staged.levels = mipLevelCount(info.width, info.height);
+
+   if (mips && mips->sourceHash() == hash &&
+       mips->width() == info.width && mips->height() == info.height && mips->levels() == staged.levels)
+   {
+      DdsLevel last = mips->level(staged.levels - 1);
+      bits = (const unsigned char *) mips->level(0).data;
+      staged.format = mips->format();
+      staged.bits.assign(bits, (const unsigned char *) last.data + last.bytes);
+      return;
+   }
+
+   pixels.resize((size_t) info.width * info.height);
+   convertBmp(info, data, &pixels[0], info.width * 4);
+   buildMipChain(&pixels[0], info.width, info.height, info.width * 4, MIP_KAISER, chain);
+   staged.format = format;
+   if (format == DDS_DXT1)
+      compressMipChain(BLOCK_BC1, chain, staged.bits);
+   else
+   {
+      bits = (const unsigned char *) &chain.pixels[0];
+      staged.bits.assign(bits, bits + chain.pixels.size() * 4);
+   }
+   if (saveAs)   // if it can't be saved it will just be made again next time
+      writeDds(saveAs, format, info.width, info.height, staged.levels, &staged.bits[0], hash);
+}
+
+
+static LPDIRECT3DTEXTURE9 createFromStaged(LPDIRECT3DDEVICE9 dev, const StagedTexture & staged)
+{
+   LPDIRECT3DTEXTURE9 texture = NULL;
+
+   if (staged.failed)
+      return NULL;
+   if (!staged.d3dx)
+      return createFromLevels(dev, staged.format, staged.width, staged.height, staged.levels,
+                              &staged.bits[0]);
+   if (FAILED(D3DXCreateTextureFromFileInMemory(dev, &staged.bits[0], (UINT) staged.bits.size(), &texture)))
+      return NULL;
+   return texture;
+}
+
+
+TextureRef TextureCache::acquire(LPDIRECT3DDEVICE9 dev, const void * data, UINT bytes, Hash64 hash,
+                                 const DdsFile * mips, const char * saveAs)
+{
+   Key key(hash, bytes);
+   TextureEntry * entry;
+   DdsFormat format;
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+      if ((entry = share(key)) != NULL)   // seen these bytes before
+         return TextureRef(entry);
+      format = m_compress ? DDS_DXT1 : DDS_BGRX8;
+   }
+
+   // made without the lock, so the loaders aren't held up meanwhile
+   StagedTexture staged;
+   stageTexture(data, bytes, hash, mips, saveAs, format, staged);
+   LPDIRECT3DTEXTURE9 texture = createFromStaged(dev, staged);
+   if (texture == NULL)
+      return TextureRef();
+   return keep(key, texture);
+}
+
+
+TextureRef TextureCache::acquireFromPixels(LPDIRECT3DDEVICE9 dev, const void * pixels, int width, int height,
+                                           int pitch, bool alpha)
+{
+   std::vector<unsigned char> packed;
+   const unsigned char * data = (const unsigned char *) pixels;
+   UINT bytes = (UINT) width * height * 4;
+   MipChain chain;
+   int y;
+
+   if (pitch != width * 4)
+   {  // hashed with the rows together
+      packed.resize(bytes);
+      for (y = 0; y < height; y++)
+         memcpy(&packed[(size_t) y * width * 4], data + (ptrdiff_t) pitch * y, (size_t) width * 4);
+      data = &packed[0];
+   }
+
+   Key key(xxHash64(data, bytes), bytes);
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+      TextureEntry * entry = share(key);
+      if (entry != NULL)
+         return TextureRef(entry);
+   }
+
+   buildMipChain(data, width, height, width * 4, MIP_KAISER, chain);
+   LPDIRECT3DTEXTURE9 texture = createFromLevels(dev, alpha ? DDS_BGRA8 : DDS_BGRX8, width, height,
+                                                 chain.levels(), (const unsigned char *) &chain.pixels[0]);
+   if (texture == NULL)
+      return TextureRef();
+   return keep(key, texture);
+}
+
+
+TextureEntry * TextureCache::newEntry()
+{
+   TextureEntry * entry = new TextureEntry;
+   entry->hasKey = false;
+   entry->refs = 1;
+   entry->texture = NULL;
+   entry->bytes = 0;
+   entry->isUnused = false;
+   entry->format = DDS_BGRX8;
+   entry->staged = NULL;
+   return entry;
+}
+
+
+// m_lock must be held.. a new texture, one reference
+TextureEntry * TextureCache::addEntry(const Key & key, LPDIRECT3DTEXTURE9 texture)
+{
+   TextureEntry * entry = newEntry();
+   entry->key = key;
+   entry->hasKey = true;
+   entry->texture = texture;
+   entry->bytes = textureBytes(texture);
+
+   m_entries[key] = entry;
+   m_residentBytes += entry->bytes;
+   m_misses++;
+   return entry;
+}
+
+
+// a texture made without the lock.. if another thread made the same one
+// meanwhile, theirs is shared and this one let go of
+TextureRef TextureCache::keep(const Key & key, LPDIRECT3DTEXTURE9 texture)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   TextureEntry * entry = share(key);
+
+   if (entry != NULL)
+   {
+      texture->Release();
+      return TextureRef(entry);
+   }
+   return TextureRef(addEntry(key, texture));
+}
+
+
+// m_lock must be held.. the entry for key with another reference, or NULL
+TextureEntry * TextureCache::share(const Key & key)
+{
+   std::map<Key, TextureEntry *>::iterator it = m_entries.find(key);
+
+   if (it == m_entries.end())
+      return NULL;
+   reuse(it->second);
+   return it->second;
+}
+
+
+// m_lock must be held
+void TextureCache::reuse(TextureEntry * entry)
+{
+   if (entry->isUnused)
+   {
+      m_unused.erase(entry->unused);
+      m_unusedBytes -= entry->bytes;
+      entry->isUnused = false;
+   }
+   entry->refs++;
+   m_hits++;
+}
+
+
+TextureRef TextureCache::stream(LPDIRECT3DDEVICE9 dev, const char * filename)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   std::map<std::string, TextureEntry *>::iterator it = m_byName.find(filename);
+   D3DLOCKED_RECT rect;
+   unsigned int n;
+
+   if (m_placeholder == NULL &&
+       SUCCEEDED(dev->CreateTexture(1, 1, 1, 0, D3DFMT_X8R8G8B8, D3DPOOL_MANAGED, &m_placeholder, NULL)) &&
+       SUCCEEDED(m_placeholder->LockRect(0, &rect, NULL, 0)))
+   {
+      *(DWORD *) rect.pBits = PLACEHOLDER_COLOR;
+      m_placeholder->UnlockRect(0);
+   }
+
+   if (it != m_byName.end())
+   {  // asked for before, loaded or not
+      reuse(it->second);
+      return TextureRef(it->second);
+   }
+
+   if (m_workers.empty())
+   {  // leave a core for the render thread
+      n = std::thread::hardware_concurrency();
+      n = n > 2 ? n - 1 : 1;
+      while (m_workers.size() < n)
+         m_workers.push_back(std::thread(&TextureCache::workerLoop, this));
+   }
+
+   TextureEntry * entry = newEntry();
+   entry->name = filename;
+   entry->refs = 2;   // one for the caller, one for the loader until it is uploaded
+   entry->format = m_compress ? DDS_DXT1 : DDS_BGRX8;
+   m_byName[entry->name] = entry;
+   m_jobs.push_back(entry);
+   m_misses++;
+   m_wake.notify_one();
+   return TextureRef(entry);
+}
+
+
+void TextureCache::workerLoop()
+{
+   PROFILE_THREAD("texture loader");
+   for (;;)
+   {
+      std::unique_lock<std::mutex> lock(m_lock);
+      while (!m_quit && m_jobs.empty())
+         m_wake.wait(lock);
+      if (m_quit)
+         return;
+
+      TextureEntry * entry = m_jobs.front();
+      m_jobs.pop_front();
+      std::string filename = entry->name;
+      DdsFormat format = entry->format;
+      const AssetPack * pack = m_pack;
+      m_loading++;
+      lock.unlock();
+
+      // everything but making the D3D texture, off the render thread
+      StagedTexture * staged = new StagedTexture;
+      {
+         PROFILE_ZONE("load texture");
+         TextureSource source;
+         if (source.open(pack, filename.c_str()))
+            stageTexture(source.data, source.bytes, source.hash, source.hasMips ? &source.mips : NULL,
+                         source.saveAs.empty() ? NULL : source.saveAs.c_str(), format, *staged);
+         else
+            staged->failed = true;
+      }
+
+      lock.lock();
+      entry->staged = staged;
+      m_ready.push_back(entry);
+      if (--m_loading == 0)
+         m_idle.notify_all();
+   }
+}
+
+
+UINT TextureCache::uploadPending(LPDIRECT3DDEVICE9 dev, UINT budget)
+{
+   PROFILE_ZONE("uploadPending");
+   std::vector<TextureEntry *> taken;
+   std::vector<LPDIRECT3DTEXTURE9> textures;
+   UINT uploaded = 0, count = 0;
+   size_t i;
+
+   {
+      std::lock_guard<std::mutex> guard(m_lock);
+
+      // always at least one, so a texture bigger than the budget still gets in
+      while (!m_ready.empty() && (count == 0 || uploaded < budget))
+      {
+         TextureEntry * entry = m_ready.front();
+         StagedTexture * staged = entry->staged;
+         m_ready.pop_front();
+         count++;
+
+         if (!staged->failed)
+         {
+            std::map<Key, TextureEntry *>::iterator it = m_entries.find(staged->key);
+            if (it != m_entries.end() && it->second->texture)
+            {  // the same bytes are already loaded under another name, nothing to make
+               entry->staged = NULL;
+               publish(entry, staged->key, NULL);
+               delete staged;
+               releaseLocked(entry);   // the loader's reference
+               continue;
+            }
+            uploaded += (UINT) staged->bits.size();
+         }
+         taken.push_back(entry);
+      }
+   }
+
+   // made without the lock, so acquire and the loaders aren't held up meanwhile..
+   // nothing else touches a popped entry's staged copy
+   textures.assign(taken.size(), NULL);
+   for (i = 0; i < taken.size(); i++)
+      if (!taken[i]->staged->failed)
+         textures[i] = createFromStaged(dev, *taken[i]->staged);
+
+   std::lock_guard<std::mutex> guard(m_lock);
+   for (i = 0; i < taken.size(); i++)
+   {
+      TextureEntry * entry = taken[i];
+      StagedTexture * staged = entry->staged;
+      entry->staged = NULL;
+      if (textures[i])
+         publish(entry, staged->key, textures[i]);
+      delete staged;
+      releaseLocked(entry);   // the loader's reference
+   }
+   return count;
+}
+
+
+// m_lock must be held.. gives a streamed entry its texture.  If the same
+// bytes are loaded already (under another name, or by acquire while this
+// one was being made) it shares theirs, counted once, and lets go of
+// texture; otherwise it takes texture, NULL or not
+void TextureCache::publish(TextureEntry * entry, const Key & key, LPDIRECT3DTEXTURE9 texture)
+{
+   std::map<Key, TextureEntry *>::iterator it = m_entries.find(key);
+
+   entry->key = key;
+   if (it != m_entries.end() && it->second->texture)
+   {
+      entry->texture = it->second->texture;
+      entry->texture->AddRef();
+      if (texture)
+         texture->Release();
+   }
+   else if ((entry->texture = texture) != NULL)
+   {
+      entry->bytes = textureBytes(texture);
+      m_residentBytes += entry->bytes;
+      if (it == m_entries.end())
+      {
+         m_entries[key] = entry;
+         entry->hasKey = true;
+      }
+   }
+}
+
+
+UINT TextureCache::pendingCount()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   return (UINT) (m_jobs.size() + m_loading + m_ready.size());   // the ones being read too
+}
+
+
+void TextureCache::release(TextureEntry * entry)
+{
+   long n = entry->refs;
+
+   // while other references are left just count down without locking..
+   while (n > 1)
+      if (entry->refs.compare_exchange_weak(n, n - 1))
+         return;
+
+   // .. the last one is let go of under the lock, since that is when
+   // acquire hands out new references
+   std::lock_guard<std::mutex> guard(m_lock);
+   releaseLocked(entry);
+}
+
+
+void TextureCache::releaseLocked(TextureEntry * entry)
+{
+   if (--entry->refs > 0)
+      return;
+
+   // keep it around in case somebody loads it again
+   m_unused.push_front(entry);
+   entry->unused = m_unused.begin();
+   entry->isUnused = true;
+   m_unusedBytes += entry->bytes;
+   trim(m_budget);
+}
+
+
+void TextureCache::trim(UINT budget)
+{
+   while (m_unusedBytes > budget && !m_unused.empty())
+      evict(m_unused.back());   // the one used longest ago goes first
+}
+
+
+void TextureCache::evict(TextureEntry * entry)
+{
+   std::map<std::string, TextureEntry *>::iterator it;
+
+   m_unused.erase(entry->unused);
+   m_unusedBytes -= entry->bytes;
+   m_residentBytes -= entry->bytes;
+   if (entry->hasKey)
+      m_entries.erase(entry->key);
+   if (!entry->name.empty() && (it = m_byName.find(entry->name)) != m_byName.end() && it->second == entry)
+      m_byName.erase(it);
+   if (entry->texture)
+      entry->texture->Release();
+   delete entry;
+}
+
+
+void TextureCache::setPack(const AssetPack * pack)
+{
+   std::unique_lock<std::mutex> lock(m_lock);
+
+   // the queued ones pick up the new pack, the ones being read finish with the old
+   while (m_loading > 0)
+      m_idle.wait(lock);
+   m_pack = pack;
+}
+
+
+void TextureCache::setBudget(UINT bytes)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   m_budget = bytes;
+   trim(m_budget);
+}
+
+
+void TextureCache::setCompression(bool compress)
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   m_compress = compress;
+}
+
+
+void TextureCache::evictUnused()
+{
+   std::unique_lock<std::mutex> lock(m_lock);
+   size_t i;
+
+   // the streams not uploaded yet are dropped.. the queued ones aren't
+   // started, the ones being read are waited for, and the loaders'
+   // references let go of, so the entries nobody else holds go below
+   for (i = 0; i < m_jobs.size(); i++)
+      releaseLocked(m_jobs[i]);
+   m_jobs.clear();
+   while (m_loading > 0)
+      m_idle.wait(lock);
+   for (i = 0; i < m_ready.size(); i++)
+   {
+      delete m_ready[i]->staged;
+      m_ready[i]->staged = NULL;
+      releaseLocked(m_ready[i]);
+   }
+   m_ready.clear();
+
+   while (!m_unused.empty())
+      evict(m_unused.back());
+   if (m_placeholder)   // whatever is still held draws with no texture from here on
+   {
+      m_placeholder->Release();
+      m_placeholder = NULL;
+   }
+}
+
+
+UINT TextureCache::residentBytes()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   return m_residentBytes;
+}
+
+
+UINT TextureCache::hits()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   return m_hits;
+}
+
+
+UINT TextureCache::misses()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   return m_misses;
+}
+
+
+float TextureCache::hitRate()
+{
+   std::lock_guard<std::mutex> guard(m_lock);
+   UINT loads = m_hits + m_misses;
+   return loads ? (float) m_hits / loads : 0.0f;
+}
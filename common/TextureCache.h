@@ -0,0 +1,169 @@
+/* Filename:  TextureCache.h
+
+   This file is shared by the numbered examples.
+
+   Keeps the textures the examples load, keyed by a hash of the file's
+   contents rather than its name.  Loading tex1.bmp twice, or loading two
+   copies of the same bitmap from different folders, gives back the same
+   texture.  Objects get a TextureRef, which counts references like
+   BufferRef does.
+
+   A texture nobody holds a reference to isn't let go of straight away; it
+   stays in the cache in case it is loaded again, until the unused textures
+   add up to more than the budget.  Then the ones used longest ago go
+   first.  The textures are D3DPOOL_MANAGED, so a lost device doesn't
+   affect them.
+
+   Files are mapped rather than read.  24 bit bitmaps, which is what all
+   the examples use, are converted by BmpLoader, get their mip levels from
+   MipGen (gamma correct Kaiser filtering) and are compressed to DXT1 by
+   BlockCompress, an eighth of the memory.  The levels are saved next to
+   the bitmap, tex1.bmp in tex1.bmp.dds, and later loads copy them from
+   there without filtering or compressing anything, as long as the bitmap
+   hasn't changed.
+   tools/mipgen makes the same files ahead of time.  Anything else still
+   goes through D3DX.
+
+   stream() doesn't wait for any of that.  The file is read, filtered and
+   compressed on loader threads, and until it is done the TextureRef hands
+   out a grey 1x1 placeholder.  Once a frame the render thread calls
+   uploadPending(), which makes the D3D textures for whatever is ready, up
+   to a budget of bytes so a burst of loads doesn't stall one frame.  So
+   initData returns straight away however many textures there are.
+
+   Given an AssetPack with setPack(), files are looked for in the pack
+   first, saved mip levels (tex1.bmp.dds) included, and used where they
+   lie in its mapping.  Nothing is saved back into a pack.
+*/
+
+#ifndef TEXTURECACHE_H
+#define TEXTURECACHE_H
+
+#include <d3dx9.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <map>
+#include <list>
+#include <deque>
+#include <vector>
+#include <string>
+#include <utility>
+#include "Hash.h"
+
+struct TextureEntry;
+class AssetPack;
+class DdsFile;
+
+
+class TextureRef
+{
+public:
+   TextureRef();
+   TextureRef(const TextureRef & other);
+   ~TextureRef();
+   TextureRef & operator=(const TextureRef & other);
+
+   bool valid() const { return m_entry != NULL; }
+   void reset();   // drops this reference
+
+   // NULL if not valid(), the placeholder until ready().. so fetch it each
+   // frame rather than keeping it
+   LPDIRECT3DTEXTURE9 texture() const;
+   bool ready() const;                   // loaded, not the placeholder
+   UINT bytes() const;                   // memory the texture takes, all mip levels
+
+private:
+   friend class TextureCache;
+   explicit TextureRef(TextureEntry * entry);   // takes over one reference
+   TextureEntry * m_entry;
+};
+
+
+class TextureCache
+{
+public:
+   static TextureCache & instance();
+
+   // like D3DXCreateTextureFromFile, unless a texture with the same contents
+   // is already in the cache.. not valid() if the file can't be loaded
+   TextureRef acquireFromFile(LPDIRECT3DDEVICE9 dev, const char * filename);
+   TextureRef acquireFromMemory(LPDIRECT3DDEVICE9 dev, const void * data, UINT bytes);
+
+   // from 32 bit pixels (B, G, R, A) such as ProcTex makes, mip levels and
+   // all.. kept X8R8G8B8 (A8R8G8B8 with alpha), as DXT1 would band smooth
+   // light maps.  The same pixels give back the same texture
+   TextureRef acquireFromPixels(LPDIRECT3DDEVICE9 dev, const void * pixels, int width, int height,
+                                int pitch, bool alpha = false);
+
+   // like acquireFromFile but returns at once and loads the file in the
+   // background.. the same name streamed twice shares one texture
+   TextureRef stream(LPDIRECT3DDEVICE9 dev, const char * filename);
+
+   // once a frame, on the device's thread: makes the textures that have
+   // finished loading, until budget bytes have been copied.. returns how many
+   UINT uploadPending(LPDIRECT3DDEVICE9 dev, UINT budget = 1024 * 1024);
+   UINT pendingCount();          // streamed textures not uploaded yet
+
+   // files in the pack are loaded from it, anything else from disk.. NULL
+   // to go back to disk.  Waits for the loads already started, so the old
+   // pack can be closed once this returns
+   void setPack(const AssetPack * pack);
+
+   void setBudget(UINT bytes);   // for textures nobody uses.. 32 MB to start with
+   // bitmaps as DXT1 (the default) or X8R8G8B8.. a saved .dds is used
+   // whichever it holds
+   void setCompression(bool compress);
+   // lets go of all of those, and drops the streams that haven't been
+   // uploaded.. do it before releasing the device, once nothing is drawn
+   void evictUnused();
+
+   UINT residentBytes();         // every texture in the cache, used or not
+   UINT hits();                  // loads that found the texture already here..
+   UINT misses();                // .. and ones that had to make it
+   float hitRate();              // hits / loads, 0 before anything is loaded
+
+private:
+   typedef std::pair<Hash64, UINT> Key;   // hash and size of the file
+
+   friend class TextureRef;
+   TextureCache();
+   ~TextureCache();
+   TextureRef acquire(LPDIRECT3DDEVICE9 dev, const void * data, UINT bytes, Hash64 hash,
+                      const DdsFile * mips, const char * saveAs);
+   TextureEntry * newEntry();
+   TextureEntry * addEntry(const Key & key, LPDIRECT3DTEXTURE9 texture);
+   TextureRef keep(const Key & key, LPDIRECT3DTEXTURE9 texture);
+   void release(TextureEntry * entry);
+   void workerLoop();
+
+   // m_lock must be held for these
+   void reuse(TextureEntry * entry);
+   TextureEntry * share(const Key & key);
+   void publish(TextureEntry * entry, const Key & key, LPDIRECT3DTEXTURE9 texture);
+   void releaseLocked(TextureEntry * entry);
+   void trim(UINT budget);
+   void evict(TextureEntry * entry);
+
+   std::mutex m_lock;
+   std::map<Key, TextureEntry *> m_entries;
+   std::map<std::string, TextureEntry *> m_byName;   // streamed ones, by file name
+   std::list<TextureEntry *> m_unused;   // nobody holds these, last used at the front
+   std::deque<TextureEntry *> m_jobs;    // waiting for a loader thread..
+   std::deque<TextureEntry *> m_ready;   // .. and loaded, waiting for uploadPending
+   std::vector<std::thread> m_workers;
+   std::condition_variable m_wake;
+   std::condition_variable m_idle;       // m_loading dropped to 0
+   UINT m_loading;                       // files the loader threads have open
+   bool m_quit;
+   const AssetPack * m_pack;
+   LPDIRECT3DTEXTURE9 m_placeholder;
+   UINT m_budget;
+   bool m_compress;
+   UINT m_unusedBytes;
+   UINT m_residentBytes;
+   UINT m_hits, m_misses;
+};
+
+#endif
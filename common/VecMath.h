@@ -0,0 +1,549 @@
+/* Filename:  VecMath.h
+
+   This file is shared by the numbered examples and the tools.
+
+   Vectors, quaternions and 4x4 matrices done the D3DX way, for the code
+   that can't count on d3dx9 being there: left handed, row vectors (a point
+   is multiplied on the left, p * M), matrices stored row by row with the
+   translation in m[12], m[13] and m[14], so a Mat4 can be handed straight
+   to SetTransform or to anything here that takes a const float *.  The
+   builders give what the D3DX function of the same name gives, to within
+   a float rounding or two.
+
+   Everything is in this header.  The small things (adding, dot and cross
+   products, the constructors) are constexpr so constant tables can be
+   built from them.  Matrix products and the transforms of whole arrays of
+   points go through SSE (a row of the result at a time), AVX (two rows,
+   or two points, at a time) or NEON, whichever the compiler was told it
+   may use, and one float at a time with none of them.  The sums are
+   bracketed the same way on every path, so they all give the same bits;
+   the ...Scalar versions are always there to check that against and to
+   time against.  As with Cull.cpp, every file of one program should be
+   built for the same instruction set.
+*/
+
+#ifndef VECMATH_H
+#define VECMATH_H
+
+#include <math.h>
+#include <string.h>
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define VECMATH_AVX 1
+#define VECMATH_SSE 1
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#include <xmmintrin.h>
+#define VECMATH_SSE 1
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define VECMATH_NEON 1
+#endif
+
+
+struct Vec3
+{
+   float x, y, z;
+
+   Vec3() = default;
+   constexpr Vec3(float x_, float y_, float z_) : x(x_), y(y_), z(z_) {}
+};
+
+struct Vec4
+{
+   float x, y, z, w;
+
+   Vec4() = default;
+   constexpr Vec4(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+   constexpr Vec4(const Vec3 & v, float w_) : x(v.x), y(v.y), z(v.z), w(w_) {}
+};
+
+// x, y, z, w like D3DXQUATERNION, w the real part
+struct Quat
+{
+   float x, y, z, w;
+
+   Quat() = default;
+   constexpr Quat(float x_, float y_, float z_, float w_) : x(x_), y(y_), z(z_), w(w_) {}
+};
+
+// the same 16 floats as a D3DMATRIX.. m[row * 4 + column]
+struct Mat4
+{
+   float m[16];
+
+   Mat4() = default;
+   constexpr Mat4(float m11, float m12, float m13, float m14,
+                  float m21, float m22, float m23, float m24,
+                  float m31, float m32, float m33, float m34,
+                  float m41, float m42, float m43, float m44)
+      : m{m11, m12, m13, m14, m21, m22, m23, m24, m31, m32, m33, m34, m41, m42, m43, m44} {}
+
+   operator float * () { return m; }
+   operator const float * () const { return m; }
+};
+
+
+//*******************************************************************
+// vectors
+
+constexpr Vec3 operator + (const Vec3 & a, const Vec3 & b) { return Vec3(a.x + b.x, a.y + b.y, a.z + b.z); }
+constexpr Vec3 operator - (const Vec3 & a, const Vec3 & b) { return Vec3(a.x - b.x, a.y - b.y, a.z - b.z); }
+constexpr Vec3 operator - (const Vec3 & a) { return Vec3(-a.x, -a.y, -a.z); }
+constexpr Vec3 operator * (const Vec3 & a, float s) { return Vec3(a.x * s, a.y * s, a.z * s); }
+constexpr Vec3 operator * (float s, const Vec3 & a) { return Vec3(a.x * s, a.y * s, a.z * s); }
+
+constexpr Vec4 operator + (const Vec4 & a, const Vec4 & b) { return Vec4(a.x + b.x, a.y + b.y, a.z + b.z, a.w + b.w); }
+constexpr Vec4 operator - (const Vec4 & a, const Vec4 & b) { return Vec4(a.x - b.x, a.y - b.y, a.z - b.z, a.w - b.w); }
+constexpr Vec4 operator * (const Vec4 & a, float s) { return Vec4(a.x * s, a.y * s, a.z * s, a.w * s); }
+
+constexpr float vec3Dot(const Vec3 & a, const Vec3 & b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+constexpr float vec4Dot(const Vec4 & a, const Vec4 & b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+constexpr Vec3 vec3Cross(const Vec3 & a, const Vec3 & b)
+{
+   return Vec3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+constexpr Vec3 vec3Lerp(const Vec3 & a, const Vec3 & b, float t) { return a + (b - a) * t; }
+
+inline float vec3Length(const Vec3 & v) { return sqrtf(vec3Dot(v, v)); }
+
+// as D3DXVec3Normalize, so a zero vector stays zero rather than going NaN
+inline Vec3 vec3Normalize(const Vec3 & v)
+{
+   float len = vec3Length(v);
+   return len > 0.0f ? Vec3(v.x / len, v.y / len, v.z / len) : Vec3(0.0f, 0.0f, 0.0f);
+}
+
+
+//*******************************************************************
+// building matrices, each like the D3DXMatrix function with the same name
+
+constexpr Mat4 mat4Identity()
+{
+   return Mat4(1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1);
+}
+
+constexpr Mat4 mat4Translation(float x, float y, float z)
+{
+   return Mat4(1, 0, 0, 0,  0, 1, 0, 0,  0, 0, 1, 0,  x, y, z, 1);
+}
+
+constexpr Mat4 mat4Scaling(float sx, float sy, float sz)
+{
+   return Mat4(sx, 0, 0, 0,  0, sy, 0, 0,  0, 0, sz, 0,  0, 0, 0, 1);
+}
+
+inline Mat4 mat4RotationX(float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+   return Mat4(1, 0, 0, 0,  0, c, s, 0,  0, -s, c, 0,  0, 0, 0, 1);
+}
+
+inline Mat4 mat4RotationY(float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+   return Mat4(c, 0, -s, 0,  0, 1, 0, 0,  s, 0, c, 0,  0, 0, 0, 1);
+}
+
+inline Mat4 mat4RotationZ(float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+   return Mat4(c, s, 0, 0,  -s, c, 0, 0,  0, 0, 1, 0,  0, 0, 0, 1);
+}
+
+// scaling * rotation yaw pitch roll * translation, written out in full..
+// the rotation is roll (about z), then pitch (x), then yaw (y)
+inline Mat4 mat4ScaleRotateTranslate(float scaleX, float scaleY, float scaleZ, float yaw, float pitch, float roll,
+                                     float x, float y, float z)
+{
+   float cy = cosf(yaw), sy = sinf(yaw);
+   float cp = cosf(pitch), sp = sinf(pitch);
+   float cr = cosf(roll), sr = sinf(roll);
+
+   return Mat4(scaleX * (cr * cy + sr * sp * sy), scaleX * (sr * cp), scaleX * (sr * sp * cy - cr * sy), 0.0f,
+               scaleY * (cr * sp * sy - sr * cy), scaleY * (cr * cp), scaleY * (sr * sy + cr * sp * cy), 0.0f,
+               scaleZ * (cp * sy), scaleZ * (-sp), scaleZ * (cp * cy), 0.0f,
+               x, y, z, 1.0f);
+}
+
+inline Mat4 mat4RotationYawPitchRoll(float yaw, float pitch, float roll)
+{
+   return mat4ScaleRotateTranslate(1.0f, 1.0f, 1.0f, yaw, pitch, roll, 0.0f, 0.0f, 0.0f);
+}
+
+// about an axis through the origin, which needn't be unit length
+inline Mat4 mat4RotationAxis(const Vec3 & axis, float angle)
+{
+   Vec3 a = vec3Normalize(axis);
+   float c = cosf(angle), s = sinf(angle), t = 1.0f - c;
+
+   return Mat4(t * a.x * a.x + c, t * a.x * a.y + s * a.z, t * a.x * a.z - s * a.y, 0.0f,
+               t * a.x * a.y - s * a.z, t * a.y * a.y + c, t * a.y * a.z + s * a.x, 0.0f,
+               t * a.x * a.z + s * a.y, t * a.y * a.z - s * a.x, t * a.z * a.z + c, 0.0f,
+               0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+inline Mat4 mat4LookAtLH(const Vec3 & eye, const Vec3 & at, const Vec3 & up)
+{
+   Vec3 z = vec3Normalize(at - eye);
+   Vec3 x = vec3Normalize(vec3Cross(up, z));
+   Vec3 y = vec3Cross(z, x);
+
+   return Mat4(x.x, y.x, z.x, 0.0f,
+               x.y, y.y, z.y, 0.0f,
+               x.z, y.z, z.z, 0.0f,
+               -vec3Dot(x, eye), -vec3Dot(y, eye), -vec3Dot(z, eye), 1.0f);
+}
+
+// fovy in radians, aspect width / height, z from 0 at zn to 1 at zf
+inline Mat4 mat4PerspectiveFovLH(float fovy, float aspect, float zn, float zf)
+{
+   float ys = 1.0f / tanf(fovy / 2);
+
+   return Mat4(ys / aspect, 0, 0, 0,  0, ys, 0, 0,  0, 0, zf / (zf - zn), 1,  0, 0, -zn * zf / (zf - zn), 0);
+}
+
+inline Mat4 mat4Transpose(const Mat4 & a)
+{
+   return Mat4(a.m[0], a.m[4], a.m[8], a.m[12],  a.m[1], a.m[5], a.m[9], a.m[13],
+               a.m[2], a.m[6], a.m[10], a.m[14],  a.m[3], a.m[7], a.m[11], a.m[15]);
+}
+
+
+//*******************************************************************
+// quaternions, each like the D3DXQuaternion function with the same name
+
+constexpr Quat quatIdentity() { return Quat(0.0f, 0.0f, 0.0f, 1.0f); }
+constexpr Quat quatConjugate(const Quat & q) { return Quat(-q.x, -q.y, -q.z, q.w); }
+constexpr float quatDot(const Quat & a, const Quat & b) { return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w; }
+
+// the rotation a then the rotation b, the D3DX order (so b * a written the
+// usual way), the same as multiplying their matrices a * b
+constexpr Quat quatMultiply(const Quat & a, const Quat & b)
+{
+   return Quat(b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+               b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+               b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+               b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z);
+}
+
+inline Quat quatNormalize(const Quat & q)
+{
+   float len = sqrtf(quatDot(q, q));
+   if (len <= 0.0f)
+      return Quat(0.0f, 0.0f, 0.0f, 0.0f);
+   len = 1.0f / len;
+   return Quat(q.x * len, q.y * len, q.z * len, q.w * len);
+}
+
+inline Quat quatRotationAxis(const Vec3 & axis, float angle)
+{
+   Vec3 a = vec3Normalize(axis) * sinf(angle / 2);
+   return Quat(a.x, a.y, a.z, cosf(angle / 2));
+}
+
+inline Quat quatRotationYawPitchRoll(float yaw, float pitch, float roll)
+{
+   float cy = cosf(yaw / 2), sy = sinf(yaw / 2);
+   float cp = cosf(pitch / 2), sp = sinf(pitch / 2);
+   float cr = cosf(roll / 2), sr = sinf(roll / 2);
+
+   return Quat(cy * sp * cr + sy * cp * sr,
+               sy * cp * cr - cy * sp * sr,
+               cy * cp * sr - sy * sp * cr,
+               cy * cp * cr + sy * sp * sr);
+}
+
+// the shorter way round from a (t = 0) to b (t = 1)
+inline Quat quatSlerp(const Quat & a, const Quat & b, float t)
+{
+   float d = quatDot(a, b), sign = 1.0f, wa = 1.0f - t, wb = t;
+
+   if (d < 0.0f)
+   {
+      d = -d;
+      sign = -1.0f;
+   }
+   if (d < 0.9999f)   // else they are so close that a straight line will do
+   {
+      float angle = acosf(d), s = 1.0f / sinf(angle);
+      wa = sinf(wa * angle) * s;
+      wb = sinf(wb * angle) * s;
+   }
+   wb *= sign;
+   return Quat(a.x * wa + b.x * wb, a.y * wa + b.y * wb, a.z * wa + b.z * wb, a.w * wa + b.w * wb);
+}
+
+// as D3DXMatrixRotationQuaternion, q a unit quaternion
+inline Mat4 mat4RotationQuat(const Quat & q)
+{
+   float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+   float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+   float xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+
+   return Mat4(1.0f - 2.0f * (yy + zz), 2.0f * (xy + zw), 2.0f * (xz - yw), 0.0f,
+               2.0f * (xy - zw), 1.0f - 2.0f * (xx + zz), 2.0f * (yz + xw), 0.0f,
+               2.0f * (xz + yw), 2.0f * (yz - xw), 1.0f - 2.0f * (xx + yy), 0.0f,
+               0.0f, 0.0f, 0.0f, 1.0f);
+}
+
+
+//*******************************************************************
+// products and transforms, one float at a time.. the SIMD versions below
+// add up in the same order
+
+// out = a * b.. out may be a or b
+inline void mat4MultiplyScalar(float * out, const float * a, const float * b)
+{
+   float r[16];
+   int i, j;
+
+   for (i = 0; i < 4; i++)
+      for (j = 0; j < 4; j++)
+         r[i * 4 + j] = (a[i * 4 + 0] * b[0 * 4 + j] + a[i * 4 + 1] * b[1 * 4 + j]) +
+                        (a[i * 4 + 2] * b[2 * 4 + j] + a[i * 4 + 3] * b[3 * 4 + j]);
+   memcpy(out, r, sizeof(r));
+}
+
+// (x, y, z, 1) * m
+inline Vec4 vec3TransformScalar(const Vec3 & v, const float * m)
+{
+   return Vec4((v.x * m[0] + v.y * m[4]) + (v.z * m[8] + m[12]),
+               (v.x * m[1] + v.y * m[5]) + (v.z * m[9] + m[13]),
+               (v.x * m[2] + v.y * m[6]) + (v.z * m[10] + m[14]),
+               (v.x * m[3] + v.y * m[7]) + (v.z * m[11] + m[15]));
+}
+
+inline void vec3TransformArrayScalar(Vec4 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   unsigned int i;
+   for (i = 0; i < count; i++)
+      out[i] = vec3TransformScalar(in[i], m);
+}
+
+// as above, divided by w like D3DXVec3TransformCoord
+inline void vec3TransformCoordArrayScalar(Vec3 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   unsigned int i;
+   for (i = 0; i < count; i++)
+   {
+      Vec4 r = vec3TransformScalar(in[i], m);
+      float w = 1.0f / r.w;
+      out[i] = Vec3(r.x * w, r.y * w, r.z * w);
+   }
+}
+
+// out[i] = a[i] * b, count matrices
+inline void mat4MultiplyArrayScalar(Mat4 * out, const Mat4 * a, unsigned int count, const float * b)
+{
+   unsigned int i;
+   for (i = 0; i < count; i++)
+      mat4MultiplyScalar(out[i].m, a[i].m, b);
+}
+
+
+//*******************************************************************
+// the same with whatever SIMD there is
+
+#if defined(VECMATH_AVX)
+
+// rows 0 and 1 of b (or 2 and 3) in the two halves.. each half a row of
+// a, splatted a float at a time
+inline __m256 vecMathRows2(__m256 a, __m256 b0, __m256 b1, __m256 b2, __m256 b3)
+{
+   return _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x00), b0),
+                                      _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0x55), b1)),
+                        _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xAA), b2),
+                                      _mm256_mul_ps(_mm256_shuffle_ps(a, a, 0xFF), b3)));
+}
+
+inline void mat4Multiply(float * out, const float * a, const float * b)
+{
+   __m256 b0 = _mm256_broadcast_ps((const __m128 *) (b + 0)), b1 = _mm256_broadcast_ps((const __m128 *) (b + 4));
+   __m256 b2 = _mm256_broadcast_ps((const __m128 *) (b + 8)), b3 = _mm256_broadcast_ps((const __m128 *) (b + 12));
+   __m256 r01 = vecMathRows2(_mm256_loadu_ps(a), b0, b1, b2, b3);
+   __m256 r23 = vecMathRows2(_mm256_loadu_ps(a + 8), b0, b1, b2, b3);
+   _mm256_storeu_ps(out, r01);
+   _mm256_storeu_ps(out + 8, r23);
+}
+
+#elif defined(VECMATH_SSE)
+
+inline __m128 vecMathRow(const float * a, __m128 b0, __m128 b1, __m128 b2, __m128 b3)
+{
+   return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[0]), b0), _mm_mul_ps(_mm_set1_ps(a[1]), b1)),
+                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a[2]), b2), _mm_mul_ps(_mm_set1_ps(a[3]), b3)));
+}
+
+inline void mat4Multiply(float * out, const float * a, const float * b)
+{
+   __m128 b0 = _mm_loadu_ps(b), b1 = _mm_loadu_ps(b + 4), b2 = _mm_loadu_ps(b + 8), b3 = _mm_loadu_ps(b + 12);
+   __m128 r0 = vecMathRow(a, b0, b1, b2, b3), r1 = vecMathRow(a + 4, b0, b1, b2, b3);
+   __m128 r2 = vecMathRow(a + 8, b0, b1, b2, b3), r3 = vecMathRow(a + 12, b0, b1, b2, b3);
+   _mm_storeu_ps(out, r0);
+   _mm_storeu_ps(out + 4, r1);
+   _mm_storeu_ps(out + 8, r2);
+   _mm_storeu_ps(out + 12, r3);
+}
+
+#elif defined(VECMATH_NEON)
+
+inline float32x4_t vecMathRow(const float * a, float32x4_t b0, float32x4_t b1, float32x4_t b2, float32x4_t b3)
+{
+   return vaddq_f32(vaddq_f32(vmulq_n_f32(b0, a[0]), vmulq_n_f32(b1, a[1])),
+                    vaddq_f32(vmulq_n_f32(b2, a[2]), vmulq_n_f32(b3, a[3])));
+}
+
+inline void mat4Multiply(float * out, const float * a, const float * b)
+{
+   float32x4_t b0 = vld1q_f32(b), b1 = vld1q_f32(b + 4), b2 = vld1q_f32(b + 8), b3 = vld1q_f32(b + 12);
+   float32x4_t r0 = vecMathRow(a, b0, b1, b2, b3), r1 = vecMathRow(a + 4, b0, b1, b2, b3);
+   float32x4_t r2 = vecMathRow(a + 8, b0, b1, b2, b3), r3 = vecMathRow(a + 12, b0, b1, b2, b3);
+   vst1q_f32(out, r0);
+   vst1q_f32(out + 4, r1);
+   vst1q_f32(out + 8, r2);
+   vst1q_f32(out + 12, r3);
+}
+
+#else
+
+inline void mat4Multiply(float * out, const float * a, const float * b)
+{
+   mat4MultiplyScalar(out, a, b);
+}
+
+#endif
+
+
+#if defined(VECMATH_SSE) || defined(VECMATH_NEON)
+
+#if defined(VECMATH_SSE)
+typedef __m128 VecMathReg;
+inline VecMathReg vecMathLoad(const float * p) { return _mm_loadu_ps(p); }
+inline void vecMathStore(float * p, VecMathReg v) { _mm_storeu_ps(p, v); }
+inline VecMathReg vecMathPoint(const Vec3 & v, VecMathReg r0, VecMathReg r1, VecMathReg r2, VecMathReg r3)
+{
+   return _mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.x), r0), _mm_mul_ps(_mm_set1_ps(v.y), r1)),
+                     _mm_add_ps(_mm_mul_ps(_mm_set1_ps(v.z), r2), r3));
+}
+#else
+typedef float32x4_t VecMathReg;
+inline VecMathReg vecMathLoad(const float * p) { return vld1q_f32(p); }
+inline void vecMathStore(float * p, VecMathReg v) { vst1q_f32(p, v); }
+inline VecMathReg vecMathPoint(const Vec3 & v, VecMathReg r0, VecMathReg r1, VecMathReg r2, VecMathReg r3)
+{
+   return vaddq_f32(vaddq_f32(vmulq_n_f32(r0, v.x), vmulq_n_f32(r1, v.y)), vaddq_f32(vmulq_n_f32(r2, v.z), r3));
+}
+#endif
+
+inline Vec4 vec3Transform(const Vec3 & v, const float * m)
+{
+   Vec4 r;
+   vecMathStore(&r.x, vecMathPoint(v, vecMathLoad(m), vecMathLoad(m + 4), vecMathLoad(m + 8), vecMathLoad(m + 12)));
+   return r;
+}
+
+inline void vec3TransformArray(Vec4 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   VecMathReg r0 = vecMathLoad(m), r1 = vecMathLoad(m + 4), r2 = vecMathLoad(m + 8), r3 = vecMathLoad(m + 12);
+   unsigned int i = 0;
+
+#if defined(VECMATH_AVX)
+   // two points at a time, one in each half.. the loads take 4 floats from
+   // each point, so the last one or two are left for the loop below
+   __m256 w0 = _mm256_broadcast_ps((const __m128 *) (m + 0)), w1 = _mm256_broadcast_ps((const __m128 *) (m + 4));
+   __m256 w2 = _mm256_broadcast_ps((const __m128 *) (m + 8)), w3 = _mm256_broadcast_ps((const __m128 *) (m + 12));
+   for (; i + 3 <= count; i += 2)
+   {
+      __m256 p = _mm256_insertf128_ps(_mm256_castps128_ps256(_mm_loadu_ps(&in[i].x)), _mm_loadu_ps(&in[i + 1].x), 1);
+      __m256 r = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(p, p, 0x00), w0),
+                                             _mm256_mul_ps(_mm256_shuffle_ps(p, p, 0x55), w1)),
+                               _mm256_add_ps(_mm256_mul_ps(_mm256_shuffle_ps(p, p, 0xAA), w2), w3));
+      _mm256_storeu_ps(&out[i].x, r);
+   }
+#endif
+   for (; i < count; i++)
+      vecMathStore(&out[i].x, vecMathPoint(in[i], r0, r1, r2, r3));
+}
+
+inline void vec3TransformCoordArray(Vec3 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   VecMathReg r0 = vecMathLoad(m), r1 = vecMathLoad(m + 4), r2 = vecMathLoad(m + 8), r3 = vecMathLoad(m + 12);
+   unsigned int i;
+
+   for (i = 0; i < count; i++)
+   {
+      Vec4 r;
+      vecMathStore(&r.x, vecMathPoint(in[i], r0, r1, r2, r3));
+      float w = 1.0f / r.w;
+      out[i] = Vec3(r.x * w, r.y * w, r.z * w);
+   }
+}
+
+#else
+
+inline Vec4 vec3Transform(const Vec3 & v, const float * m)
+{
+   return vec3TransformScalar(v, m);
+}
+
+inline void vec3TransformArray(Vec4 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   vec3TransformArrayScalar(out, in, count, m);
+}
+
+inline void vec3TransformCoordArray(Vec3 * out, const Vec3 * in, unsigned int count, const float * m)
+{
+   vec3TransformCoordArrayScalar(out, in, count, m);
+}
+
+#endif
+
+
+inline void mat4MultiplyArray(Mat4 * out, const Mat4 * a, unsigned int count, const float * b)
+{
+   unsigned int i;
+   for (i = 0; i < count; i++)
+      mat4Multiply(out[i].m, a[i].m, b);
+}
+
+inline Mat4 operator * (const Mat4 & a, const Mat4 & b)
+{
+   Mat4 r;
+   mat4Multiply(r.m, a.m, b.m);
+   return r;
+}
+
+// as D3DXVec3TransformCoord
+inline Vec3 vec3TransformCoord(const Vec3 & v, const float * m)
+{
+   Vec4 r = vec3Transform(v, m);
+   float w = 1.0f / r.w;
+   return Vec3(r.x * w, r.y * w, r.z * w);
+}
+
+// as D3DXVec3TransformNormal, the translation left out
+inline Vec3 vec3TransformNormal(const Vec3 & v, const float * m)
+{
+   return Vec3((v.x * m[0] + v.y * m[4]) + v.z * m[8],
+               (v.x * m[1] + v.y * m[5]) + v.z * m[9],
+               (v.x * m[2] + v.y * m[6]) + v.z * m[10]);
+}
+
+// "avx", "sse", "neon" or "scalar"
+inline const char * vecMathPath()
+{
+#if defined(VECMATH_AVX)
+   return "avx";
+#elif defined(VECMATH_SSE)
+   return "sse";
+#elif defined(VECMATH_NEON)
+   return "neon";
+#else
+   return "scalar";
+#endif
+}
+
+#endif
@@ -0,0 +1,173 @@
+/* Filename:  D3DXMath.cpp
+
+   This file accompanies d3dx9.h.
+*/
+
+#include "d3dx9.h"
+#include <math.h>
+
+
+D3DXMATRIX D3DXMATRIX::operator * (const D3DXMATRIX & mat) const
+{
+   D3DXMATRIX out;
+   D3DXMatrixMultiply(&out, this, &mat);
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixIdentity(D3DXMATRIX * out)
+{
+   memset(static_cast<D3DMATRIX *>(out), 0, sizeof(D3DMATRIX));
+   out->_11 = out->_22 = out->_33 = out->_44 = 1.0f;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixMultiply(D3DXMATRIX * out, const D3DXMATRIX * m1, const D3DXMATRIX * m2)
+{
+   D3DXMATRIX t;   // out may be m1 or m2
+   int r, c;
+
+   for (r = 0; r < 4; r++)
+      for (c = 0; c < 4; c++)
+         t.m[r][c] = m1->m[r][0] * m2->m[0][c] + m1->m[r][1] * m2->m[1][c] +
+                     m1->m[r][2] * m2->m[2][c] + m1->m[r][3] * m2->m[3][c];
+   *out = t;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixTranslation(D3DXMATRIX * out, float x, float y, float z)
+{
+   D3DXMatrixIdentity(out);
+   out->_41 = x;
+   out->_42 = y;
+   out->_43 = z;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixScaling(D3DXMATRIX * out, float sx, float sy, float sz)
+{
+   D3DXMatrixIdentity(out);
+   out->_11 = sx;
+   out->_22 = sy;
+   out->_33 = sz;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixRotationX(D3DXMATRIX * out, float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+
+   D3DXMatrixIdentity(out);
+   out->_22 = c;   out->_23 = s;
+   out->_32 = -s;  out->_33 = c;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixRotationY(D3DXMATRIX * out, float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+
+   D3DXMatrixIdentity(out);
+   out->_11 = c;   out->_13 = -s;
+   out->_31 = s;   out->_33 = c;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixRotationZ(D3DXMATRIX * out, float angle)
+{
+   float c = cosf(angle), s = sinf(angle);
+
+   D3DXMatrixIdentity(out);
+   out->_11 = c;   out->_12 = s;
+   out->_21 = -s;  out->_22 = c;
+   return out;
+}
+
+
+// roll around z first, then pitch around x, then yaw around y
+D3DXMATRIX * D3DXMatrixRotationYawPitchRoll(D3DXMATRIX * out, float yaw, float pitch, float roll)
+{
+   D3DXMATRIX rx, ry;
+
+   D3DXMatrixRotationZ(out, roll);
+   D3DXMatrixRotationX(&rx, pitch);
+   D3DXMatrixRotationY(&ry, yaw);
+   D3DXMatrixMultiply(out, out, &rx);
+   return D3DXMatrixMultiply(out, out, &ry);
+}
+
+
+static D3DXVECTOR3 cross(const D3DXVECTOR3 & a, const D3DXVECTOR3 & b)
+{
+   return D3DXVECTOR3(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+
+
+static float dot(const D3DXVECTOR3 & a, const D3DXVECTOR3 & b)
+{
+   return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+
+D3DXMATRIX * D3DXMatrixLookAtLH(D3DXMATRIX * out, const D3DXVECTOR3 * eye, const D3DXVECTOR3 * at,
+                                const D3DXVECTOR3 * up)
+{
+   D3DXVECTOR3 x, y, z;
+
+   z = D3DXVECTOR3(at->x - eye->x, at->y - eye->y, at->z - eye->z);
+   D3DXVec3Normalize(&z, &z);
+   x = cross(*up, z);
+   D3DXVec3Normalize(&x, &x);
+   y = cross(z, x);
+
+   out->_11 = x.x;  out->_12 = y.x;  out->_13 = z.x;  out->_14 = 0.0f;
+   out->_21 = x.y;  out->_22 = y.y;  out->_23 = z.y;  out->_24 = 0.0f;
+   out->_31 = x.z;  out->_32 = y.z;  out->_33 = z.z;  out->_34 = 0.0f;
+   out->_41 = -dot(x, *eye);
+   out->_42 = -dot(y, *eye);
+   out->_43 = -dot(z, *eye);
+   out->_44 = 1.0f;
+   return out;
+}
+
+
+D3DXMATRIX * D3DXMatrixPerspectiveFovLH(D3DXMATRIX * out, float fovy, float aspect, float zn, float zf)
+{
+   float ys = 1.0f / tanf(fovy * 0.5f);
+
+   memset(static_cast<D3DMATRIX *>(out), 0, sizeof(D3DMATRIX));
+   out->_11 = ys / aspect;
+   out->_22 = ys;
+   out->_33 = zf / (zf - zn);
+   out->_34 = 1.0f;
+   out->_43 = -zn * zf / (zf - zn);
+   return out;
+}
+
+
+// a zero length vector stays zero, as it does in D3DX
+D3DXVECTOR3 * D3DXVec3Normalize(D3DXVECTOR3 * out, const D3DXVECTOR3 * v)
+{
+   float len = sqrtf(dot(*v, *v));
+
+   if (len == 0.0f)
+      *out = D3DXVECTOR3(0.0f, 0.0f, 0.0f);
+   else
+      *out = D3DXVECTOR3(v->x / len, v->y / len, v->z / len);
+   return out;
+}
+
+
+HRESULT D3DXCreateTextureFromFileInMemory(LPDIRECT3DDEVICE9, const void *, UINT,
+                                          LPDIRECT3DTEXTURE9 * texture)
+{
+   if (texture)
+      *texture = NULL;
+   return D3DERR_INVALIDCALL;
+}
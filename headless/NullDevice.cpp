@@ -0,0 +1,650 @@
+/* Filename:  NullDevice.cpp
+
+   This file accompanies NullDevice.h.
+*/
+
+#include "NullDevice.h"
+
+
+// locks the part of data asked for.. 0 bytes is all of it after offset
+static HRESULT lockRange(std::vector<unsigned char> & data, bool & locked, UINT offset, UINT bytes,
+                         void ** ptr)
+{
+   if (ptr == NULL || locked || offset > data.size() || bytes > data.size() - offset)
+      return D3DERR_INVALIDCALL;
+   *ptr = &data[0] + offset;
+   locked = true;
+   return D3D_OK;
+}
+
+
+NullVertexBuffer::NullVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool)
+   : m_data(bytes), m_usage(usage), m_fvf(fvf), m_pool(pool), m_refs(1), m_locked(false)
+{
+}
+
+
+ULONG NullVertexBuffer::AddRef()
+{
+   return ++m_refs;
+}
+
+
+ULONG NullVertexBuffer::Release()
+{
+   ULONG refs = --m_refs;
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+HRESULT NullVertexBuffer::Lock(UINT offset, UINT bytes, void ** data, DWORD)
+{
+   return lockRange(m_data, m_locked, offset, bytes, data);
+}
+
+
+HRESULT NullVertexBuffer::Unlock()
+{
+   if (!m_locked)
+      return D3DERR_INVALIDCALL;
+   m_locked = false;
+   return D3D_OK;
+}
+
+
+NullIndexBuffer::NullIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool)
+   : m_data(bytes), m_usage(usage), m_format(format), m_pool(pool), m_refs(1), m_locked(false)
+{
+}
+
+
+ULONG NullIndexBuffer::AddRef()
+{
+   return ++m_refs;
+}
+
+
+ULONG NullIndexBuffer::Release()
+{
+   ULONG refs = --m_refs;
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+HRESULT NullIndexBuffer::Lock(UINT offset, UINT bytes, void ** data, DWORD)
+{
+   return lockRange(m_data, m_locked, offset, bytes, data);
+}
+
+
+HRESULT NullIndexBuffer::Unlock()
+{
+   if (!m_locked)
+      return D3DERR_INVALIDCALL;
+   m_locked = false;
+   return D3D_OK;
+}
+
+
+UINT NullTexture::rowBytes(D3DFORMAT format, UINT width)
+{
+   switch (format)
+   {
+   case D3DFMT_DXT1:
+      return (width + 3) / 4 * 8;
+   case D3DFMT_DXT2:
+   case D3DFMT_DXT3:
+   case D3DFMT_DXT4:
+   case D3DFMT_DXT5:
+      return (width + 3) / 4 * 16;
+   case D3DFMT_A8R8G8B8:
+   case D3DFMT_X8R8G8B8:
+      return width * 4;
+   case D3DFMT_R8G8B8:
+      return width * 3;
+   case D3DFMT_R5G6B5:
+   case D3DFMT_X1R5G5B5:
+   case D3DFMT_A1R5G5B5:
+   case D3DFMT_A4R4G4B4:
+      return width * 2;
+   case D3DFMT_A8:
+   case D3DFMT_P8:
+   case D3DFMT_L8:
+      return width;
+   default:
+      return 0;
+   }
+}
+
+
+UINT NullTexture::rows(D3DFORMAT format, UINT height)
+{
+   if (format >= D3DFMT_DXT1 && format <= D3DFMT_DXT5)   // the DXT codes are FOURCCs, all up there
+      return (height + 3) / 4;
+   return height;
+}
+
+
+NullTexture::NullTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format, D3DPOOL pool)
+{
+   UINT w = width, h = height, i;
+
+   m_refs = 1;
+   m_changes = 0;
+   if (levels == 0)
+      for (levels = 1; (width >> levels) || (height >> levels); levels++)
+         ;
+   m_levels.resize(levels);
+   for (i = 0; i < levels; i++)
+   {
+      Level & l = m_levels[i];
+      ZeroMemory(&l.desc, sizeof(l.desc));
+      l.desc.Format = format;
+      l.desc.Type = D3DRTYPE_SURFACE;
+      l.desc.Usage = usage;
+      l.desc.Pool = pool;
+      l.desc.Width = w;
+      l.desc.Height = h;
+      l.pitch = rowBytes(format, w);
+      l.bits.resize((size_t) l.pitch * rows(format, h) + 1);   // + 1 so &bits[0] is there for 0 bytes
+      l.locked = false;
+      w = w > 1 ? w / 2 : 1;
+      h = h > 1 ? h / 2 : 1;
+   }
+}
+
+
+ULONG NullTexture::AddRef()
+{
+   return ++m_refs;
+}
+
+
+ULONG NullTexture::Release()
+{
+   ULONG refs = --m_refs;
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+DWORD NullTexture::GetLevelCount()
+{
+   return (DWORD) m_levels.size();
+}
+
+
+HRESULT NullTexture::GetLevelDesc(UINT level, D3DSURFACE_DESC * desc)
+{
+   if (level >= m_levels.size() || desc == NULL)
+      return D3DERR_INVALIDCALL;
+   *desc = m_levels[level].desc;
+   return D3D_OK;
+}
+
+
+HRESULT NullTexture::LockRect(UINT level, D3DLOCKED_RECT * rect, const RECT * area, DWORD)
+{
+   if (level >= m_levels.size() || rect == NULL || m_levels[level].locked)
+      return D3DERR_INVALIDCALL;
+
+   Level & l = m_levels[level];
+   size_t offset = 0;
+   if (area)
+   {
+      if (area->left < 0 || area->top < 0 || area->right > (LONG) l.desc.Width ||
+          area->bottom > (LONG) l.desc.Height || area->left >= area->right || area->top >= area->bottom)
+         return D3DERR_INVALIDCALL;
+      offset = (size_t) rows(l.desc.Format, area->top) * l.pitch + rowBytes(l.desc.Format, area->left);
+   }
+   rect->Pitch = l.pitch;
+   rect->pBits = &l.bits[0] + offset;
+   l.locked = true;
+   return D3D_OK;
+}
+
+
+HRESULT NullTexture::UnlockRect(UINT level)
+{
+   if (level >= m_levels.size() || !m_levels[level].locked)
+      return D3DERR_INVALIDCALL;
+   m_levels[level].locked = false;
+   m_changes++;
+   return D3D_OK;
+}
+
+
+UINT NullTexture::bytes() const
+{
+   size_t total = 0;
+   for (size_t i = 0; i < m_levels.size(); i++)
+      total += m_levels[i].bits.size() - 1;
+   return (UINT) total;
+}
+
+
+NullDevice::NullDevice()
+{
+   int i;
+
+   m_refs = 1;
+   m_lost = false;
+   m_inScene = false;
+   for (i = 0; i < STAGES; i++)
+      m_textures[i] = NULL;
+   m_stream = NULL;
+   m_indices = NULL;
+   setDefaults();
+}
+
+
+NullDevice::~NullDevice()
+{
+   int i;
+
+   for (i = 0; i < STAGES; i++)
+      hold(m_textures[i], (NullTexture *) NULL);
+   hold(m_stream, (NullVertexBuffer *) NULL);
+   hold(m_indices, (NullIndexBuffer *) NULL);
+}
+
+
+// the states a new device has, from the D3D9 docs
+void NullDevice::setDefaults()
+{
+   int i, j;
+
+   ZeroMemory(m_renderStates, sizeof(m_renderStates));
+   m_renderStates[D3DRS_ZENABLE] = TRUE;
+   m_renderStates[D3DRS_FILLMODE] = 3;    // solid
+   m_renderStates[D3DRS_SHADEMODE] = 2;   // gouraud
+   m_renderStates[D3DRS_ZWRITEENABLE] = TRUE;
+   m_renderStates[D3DRS_SRCBLEND] = D3DBLEND_ONE;
+   m_renderStates[D3DRS_DESTBLEND] = D3DBLEND_ZERO;
+   m_renderStates[D3DRS_CULLMODE] = D3DCULL_CCW;
+   m_renderStates[D3DRS_ZFUNC] = D3DCMP_LESSEQUAL;
+   m_renderStates[D3DRS_ALPHAFUNC] = D3DCMP_ALWAYS;
+   m_renderStates[D3DRS_TEXTUREFACTOR] = 0xFFFFFFFF;
+   m_renderStates[D3DRS_LIGHTING] = TRUE;
+   m_renderStates[D3DRS_BLENDOP] = D3DBLENDOP_ADD;
+   m_renderStates[D3DRS_BLENDFACTOR] = 0xFFFFFFFF;
+
+   for (i = 0; i < STAGES; i++)
+   {
+      for (j = 0; j < STAGE_STATES; j++)
+         m_stageStates[i][j] = 0;
+      m_stageStates[i][D3DTSS_COLOROP] = i == 0 ? D3DTOP_MODULATE : D3DTOP_DISABLE;
+      m_stageStates[i][D3DTSS_COLORARG1] = D3DTA_TEXTURE;
+      m_stageStates[i][D3DTSS_COLORARG2] = D3DTA_CURRENT;
+      m_stageStates[i][D3DTSS_ALPHAOP] = i == 0 ? D3DTOP_SELECTARG1 : D3DTOP_DISABLE;
+      m_stageStates[i][D3DTSS_ALPHAARG1] = D3DTA_TEXTURE;
+      m_stageStates[i][D3DTSS_ALPHAARG2] = D3DTA_CURRENT;
+      m_stageStates[i][D3DTSS_TEXCOORDINDEX] = i;
+
+      for (j = 0; j < SAMPLER_STATES; j++)
+         m_samplerStates[i][j] = 0;
+      m_samplerStates[i][D3DSAMP_ADDRESSU] = D3DTADDRESS_WRAP;
+      m_samplerStates[i][D3DSAMP_ADDRESSV] = D3DTADDRESS_WRAP;
+      m_samplerStates[i][D3DSAMP_ADDRESSW] = D3DTADDRESS_WRAP;
+      m_samplerStates[i][D3DSAMP_MAGFILTER] = D3DTEXF_POINT;
+      m_samplerStates[i][D3DSAMP_MINFILTER] = D3DTEXF_POINT;
+      m_samplerStates[i][D3DSAMP_MIPFILTER] = D3DTEXF_NONE;
+      m_samplerStates[i][D3DSAMP_MAXANISOTROPY] = 1;
+   }
+
+   ZeroMemory(&m_view, sizeof(D3DMATRIX));
+   m_view._11 = m_view._22 = m_view._33 = m_view._44 = 1.0f;
+   m_projection = m_world = m_view;
+
+   ZeroMemory(&m_material, sizeof(m_material));
+   m_material.Diffuse.r = m_material.Diffuse.g = m_material.Diffuse.b = m_material.Diffuse.a = 1.0f;
+   m_lights.clear();
+   m_lightOn.clear();
+
+   for (i = 0; i < STAGES; i++)
+      hold(m_textures[i], (NullTexture *) NULL);
+   hold(m_stream, (NullVertexBuffer *) NULL);
+   hold(m_indices, (NullIndexBuffer *) NULL);
+   m_streamOffset = m_streamStride = 0;
+   m_fvf = 0;
+}
+
+
+// slot gets a reference to object and lets go of what it had
+template <class T> void NullDevice::hold(T *& slot, T * object)
+{
+   if (object)
+      object->AddRef();
+   if (slot)
+      slot->Release();
+   slot = object;
+}
+
+
+ULONG NullDevice::AddRef()
+{
+   return ++m_refs;
+}
+
+
+ULONG NullDevice::Release()
+{
+   ULONG refs = --m_refs;
+   if (refs == 0)
+      delete this;
+   return refs;
+}
+
+
+HRESULT NullDevice::TestCooperativeLevel()
+{
+   return m_lost ? D3DERR_DEVICENOTRESET : D3D_OK;
+}
+
+
+// like a real Reset, everything goes back to how it was when the device was new
+HRESULT NullDevice::Reset(D3DPRESENT_PARAMETERS * params)
+{
+   if (params == NULL)
+      return D3DERR_INVALIDCALL;
+   m_lost = false;
+   m_inScene = false;
+   setDefaults();
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::Present(const RECT *, const RECT *, HWND, const RGNDATA *)
+{
+   if (m_inScene)
+      return D3DERR_INVALIDCALL;
+   return m_lost ? D3DERR_DEVICELOST : D3D_OK;
+}
+
+
+HRESULT NullDevice::CreateTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format,
+                                  D3DPOOL pool, IDirect3DTexture9 ** texture, HANDLE *)
+{
+   if (texture == NULL || width == 0 || height == 0 || NullTexture::rowBytes(format, 1) == 0)
+      return D3DERR_INVALIDCALL;
+   *texture = new NullTexture(width, height, levels, usage, format, pool);
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::CreateVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                       IDirect3DVertexBuffer9 ** buffer, HANDLE *)
+{
+   if (buffer == NULL || bytes == 0)
+      return D3DERR_INVALIDCALL;
+   *buffer = new NullVertexBuffer(bytes, usage, fvf, pool);
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::CreateIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                      IDirect3DIndexBuffer9 ** buffer, HANDLE *)
+{
+   if (buffer == NULL || bytes == 0 || (format != D3DFMT_INDEX16 && format != D3DFMT_INDEX32))
+      return D3DERR_INVALIDCALL;
+   *buffer = new NullIndexBuffer(bytes, usage, format, pool);
+   return D3D_OK;
+}
+
+
+// the examples begin and end a scene around every object, D3D doesn't
+// mind that as long as they pair up
+HRESULT NullDevice::BeginScene()
+{
+   if (m_inScene)
+      return D3DERR_INVALIDCALL;
+   m_inScene = true;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::EndScene()
+{
+   if (!m_inScene)
+      return D3DERR_INVALIDCALL;
+   m_inScene = false;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::Clear(DWORD count, const D3DRECT * rects, DWORD, D3DCOLOR, float z, DWORD)
+{
+   if ((count != 0) != (rects != NULL) || z < 0.0f || z > 1.0f)
+      return D3DERR_INVALIDCALL;
+   return D3D_OK;
+}
+
+
+D3DMATRIX * NullDevice::transformSlot(D3DTRANSFORMSTATETYPE state)
+{
+   switch (state)
+   {
+   case D3DTS_VIEW:
+      return &m_view;
+   case D3DTS_PROJECTION:
+      return &m_projection;
+   default:
+      return state == D3DTS_WORLD ? &m_world : NULL;
+   }
+}
+
+
+HRESULT NullDevice::SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix)
+{
+   D3DMATRIX * slot = transformSlot(state);
+
+   if (matrix == NULL)
+      return D3DERR_INVALIDCALL;
+   if (slot)   // texture and extra world matrices are taken and forgotten
+      *slot = *matrix;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::GetTransform(D3DTRANSFORMSTATETYPE state, D3DMATRIX * matrix)
+{
+   D3DMATRIX * slot = transformSlot(state);
+
+   if (matrix == NULL || slot == NULL)
+      return D3DERR_INVALIDCALL;
+   *matrix = *slot;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetMaterial(const D3DMATERIAL9 * material)
+{
+   if (material == NULL)
+      return D3DERR_INVALIDCALL;
+   m_material = *material;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetLight(DWORD index, const D3DLIGHT9 * light)
+{
+   if (light == NULL || light->Type < D3DLIGHT_POINT || light->Type > D3DLIGHT_DIRECTIONAL)
+      return D3DERR_INVALIDCALL;
+   if (index >= m_lights.size())
+   {
+      m_lights.resize(index + 1);
+      m_lightOn.resize(index + 1, false);
+   }
+   m_lights[index] = *light;
+   return D3D_OK;
+}
+
+
+// a light that was never set gets the default one, white and pointing down z
+HRESULT NullDevice::LightEnable(DWORD index, BOOL enable)
+{
+   if (index >= m_lights.size())
+   {
+      D3DLIGHT9 light;
+      ZeroMemory(&light, sizeof(light));
+      light.Type = D3DLIGHT_DIRECTIONAL;
+      light.Diffuse.r = light.Diffuse.g = light.Diffuse.b = 1.0f;
+      light.Direction.z = 1.0f;
+      m_lights.resize(index + 1, light);
+      m_lightOn.resize(index + 1, false);
+   }
+   m_lightOn[index] = enable != FALSE;
+   return D3D_OK;
+}
+
+
+const D3DLIGHT9 * NullDevice::light(DWORD index) const
+{
+   return index < m_lights.size() && m_lightOn[index] ? &m_lights[index] : NULL;
+}
+
+
+HRESULT NullDevice::SetRenderState(D3DRENDERSTATETYPE state, DWORD value)
+{
+   if ((unsigned int) state >= RENDER_STATES)
+      return D3DERR_INVALIDCALL;
+   m_renderStates[state] = value;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::GetRenderState(D3DRENDERSTATETYPE state, DWORD * value)
+{
+   if ((unsigned int) state >= RENDER_STATES || value == NULL)
+      return D3DERR_INVALIDCALL;
+   *value = m_renderStates[state];
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetTexture(DWORD stage, IDirect3DBaseTexture9 * texture)
+{
+   if (stage >= STAGES)
+      return D3DERR_INVALIDCALL;
+   // only this device makes them, and they are all 2D
+   hold(m_textures[stage], static_cast<NullTexture *>(static_cast<IDirect3DTexture9 *>(texture)));
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value)
+{
+   if (stage >= STAGES || (unsigned int) type >= STAGE_STATES)
+      return D3DERR_INVALIDCALL;
+   m_stageStates[stage][type] = value;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::GetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD * value)
+{
+   if (stage >= STAGES || (unsigned int) type >= STAGE_STATES || value == NULL)
+      return D3DERR_INVALIDCALL;
+   *value = m_stageStates[stage][type];
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value)
+{
+   if (sampler >= STAGES || (unsigned int) type >= SAMPLER_STATES)
+      return D3DERR_INVALIDCALL;
+   m_samplerStates[sampler][type] = value;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::GetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD * value)
+{
+   if (sampler >= STAGES || (unsigned int) type >= SAMPLER_STATES || value == NULL)
+      return D3DERR_INVALIDCALL;
+   *value = m_samplerStates[sampler][type];
+   return D3D_OK;
+}
+
+
+// vertices a primitive count of type takes
+static UINT vertexCount(D3DPRIMITIVETYPE type, UINT count)
+{
+   switch (type)
+   {
+   case D3DPT_POINTLIST:
+      return count;
+   case D3DPT_LINELIST:
+      return count * 2;
+   case D3DPT_LINESTRIP:
+      return count + 1;
+   case D3DPT_TRIANGLELIST:
+      return count * 3;
+   case D3DPT_TRIANGLESTRIP:
+   case D3DPT_TRIANGLEFAN:
+      return count + 2;
+   default:
+      return 0;
+   }
+}
+
+
+HRESULT NullDevice::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count)
+{
+   UINT vertices = vertexCount(type, count);
+
+   if (!m_inScene || m_stream == NULL || m_streamStride == 0 || vertices == 0)
+      return D3DERR_INVALIDCALL;
+   if (m_streamOffset + (startVertex + (size_t) vertices) * m_streamStride > m_stream->size())
+      return D3DERR_INVALIDCALL;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                         UINT numVertices, UINT startIndex, UINT count)
+{
+   UINT indices = vertexCount(type, count);
+   UINT indexSize;
+
+   if (!m_inScene || m_stream == NULL || m_indices == NULL || m_streamStride == 0 || indices == 0)
+      return D3DERR_INVALIDCALL;
+   indexSize = m_indices->format() == D3DFMT_INDEX16 ? 2 : 4;
+   if ((startIndex + (size_t) indices) * indexSize > m_indices->size())
+      return D3DERR_INVALIDCALL;
+   if (baseVertex < 0 ||
+       m_streamOffset + (baseVertex + (size_t) minIndex + numVertices) * m_streamStride > m_stream->size())
+      return D3DERR_INVALIDCALL;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetFVF(DWORD fvf)
+{
+   m_fvf = fvf;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetStreamSource(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset, UINT stride)
+{
+   if (stream != 0)   // one stream is all the fixed function examples use
+      return D3DERR_INVALIDCALL;
+   hold(m_stream, static_cast<NullVertexBuffer *>(buffer));
+   m_streamOffset = offset;
+   m_streamStride = stride;
+   return D3D_OK;
+}
+
+
+HRESULT NullDevice::SetIndices(IDirect3DIndexBuffer9 * buffer)
+{
+   hold(m_indices, static_cast<NullIndexBuffer *>(buffer));
+   return D3D_OK;
+}
@@ -0,0 +1,204 @@
+/* Filename:  NullDevice.h
+
+   This file is used by the headless builds.  See d3d9.h.
+
+   A Direct3D 9 device that draws nothing.  Buffers and textures are real
+   memory that can be locked, filled and read back, render, stage and
+   sampler states, transforms and lights are kept and can be asked for,
+   and the draw calls check their arguments and return.  So everything in
+   front of the device, the examples' classes, BufferManager and
+   TextureCache, runs exactly as it does on Windows, and whatever time is
+   measured is theirs.
+
+   Objects count references like COM ones.  The device starts with one and
+   goes away with the last Release(); buffers and textures it has been
+   given with SetTexture, SetStreamSource and SetIndices are held until
+   something else is set or the device goes.
+
+   loseDevice() makes it act like an alt-tab: TestCooperativeLevel says
+   D3DERR_DEVICENOTRESET until Reset() is called.
+*/
+
+#ifndef NULLDEVICE_H
+#define NULLDEVICE_H
+
+#include "d3d9.h"
+#include <vector>
+
+
+class NullVertexBuffer : public IDirect3DVertexBuffer9
+{
+public:
+   NullVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool);
+
+   ULONG AddRef();
+   ULONG Release();
+   HRESULT Lock(UINT offset, UINT bytes, void ** data, DWORD flags);
+   HRESULT Unlock();
+
+   const unsigned char * data() const { return &m_data[0]; }
+   UINT size() const { return (UINT) m_data.size(); }
+   DWORD fvf() const { return m_fvf; }
+   D3DPOOL pool() const { return m_pool; }
+
+private:
+   std::vector<unsigned char> m_data;
+   DWORD m_usage, m_fvf;
+   D3DPOOL m_pool;
+   ULONG m_refs;
+   bool m_locked;
+};
+
+
+class NullIndexBuffer : public IDirect3DIndexBuffer9
+{
+public:
+   NullIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool);
+
+   ULONG AddRef();
+   ULONG Release();
+   HRESULT Lock(UINT offset, UINT bytes, void ** data, DWORD flags);
+   HRESULT Unlock();
+
+   const unsigned char * data() const { return &m_data[0]; }
+   UINT size() const { return (UINT) m_data.size(); }
+   D3DFORMAT format() const { return m_format; }
+   D3DPOOL pool() const { return m_pool; }
+
+private:
+   std::vector<unsigned char> m_data;
+   DWORD m_usage;
+   D3DFORMAT m_format;
+   D3DPOOL m_pool;
+   ULONG m_refs;
+   bool m_locked;
+};
+
+
+class NullTexture : public IDirect3DTexture9
+{
+public:
+   // levels 0 is the whole chain down to 1x1
+   NullTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format, D3DPOOL pool);
+
+   ULONG AddRef();
+   ULONG Release();
+   DWORD GetLevelCount();
+   HRESULT GetLevelDesc(UINT level, D3DSURFACE_DESC * desc);
+   HRESULT LockRect(UINT level, D3DLOCKED_RECT * rect, const RECT * area, DWORD flags);
+   HRESULT UnlockRect(UINT level);
+
+   const unsigned char * data(UINT level) const { return &m_levels[level].bits[0]; }
+   UINT pitch(UINT level) const { return m_levels[level].pitch; }
+   UINT bytes() const;   // all the levels
+   unsigned int changes() const { return m_changes; }   // unlocks so far, so a copy can tell it is stale
+
+   // a row of 4x4 blocks for DXT formats, a row of pixels for the rest..
+   // 0 for a format nothing here knows the size of
+   static UINT rowBytes(D3DFORMAT format, UINT width);
+   static UINT rows(D3DFORMAT format, UINT height);
+
+private:
+   struct Level
+   {
+      D3DSURFACE_DESC desc;
+      UINT pitch;
+      std::vector<unsigned char> bits;
+      bool locked;
+   };
+
+   std::vector<Level> m_levels;
+   ULONG m_refs;
+   unsigned int m_changes;
+};
+
+
+class NullDevice : public IDirect3DDevice9
+{
+public:
+   NullDevice();   // one reference, Release() it when done
+
+   ULONG AddRef();
+   ULONG Release();
+
+   HRESULT TestCooperativeLevel();
+   HRESULT Reset(D3DPRESENT_PARAMETERS * params);
+   HRESULT Present(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty);
+
+   HRESULT CreateTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format,
+                         D3DPOOL pool, IDirect3DTexture9 ** texture, HANDLE * shared);
+   HRESULT CreateVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                              IDirect3DVertexBuffer9 ** buffer, HANDLE * shared);
+   HRESULT CreateIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                             IDirect3DIndexBuffer9 ** buffer, HANDLE * shared);
+
+   HRESULT BeginScene();
+   HRESULT EndScene();
+   HRESULT Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+
+   HRESULT SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix);
+   HRESULT GetTransform(D3DTRANSFORMSTATETYPE state, D3DMATRIX * matrix);
+   HRESULT SetMaterial(const D3DMATERIAL9 * material);
+   HRESULT SetLight(DWORD index, const D3DLIGHT9 * light);
+   HRESULT LightEnable(DWORD index, BOOL enable);
+   HRESULT SetRenderState(D3DRENDERSTATETYPE state, DWORD value);
+   HRESULT GetRenderState(D3DRENDERSTATETYPE state, DWORD * value);
+   HRESULT SetTexture(DWORD stage, IDirect3DBaseTexture9 * texture);
+   HRESULT SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value);
+   HRESULT GetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD * value);
+   HRESULT SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value);
+   HRESULT GetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD * value);
+
+   HRESULT DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count);
+   HRESULT DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                UINT numVertices, UINT startIndex, UINT count);
+   HRESULT SetFVF(DWORD fvf);
+   HRESULT SetStreamSource(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset, UINT stride);
+   HRESULT SetIndices(IDirect3DIndexBuffer9 * buffer);
+
+   void loseDevice() { m_lost = true; }
+
+   // what is set now.. what a draw would use
+   DWORD renderState(D3DRENDERSTATETYPE state) const { return m_renderStates[state]; }
+   DWORD stageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type) const { return m_stageStates[stage][type]; }
+   DWORD samplerState(DWORD sampler, D3DSAMPLERSTATETYPE type) const { return m_samplerStates[sampler][type]; }
+   const D3DMATRIX & view() const { return m_view; }
+   const D3DMATRIX & projection() const { return m_projection; }
+   const D3DMATRIX & world() const { return m_world; }
+   const D3DMATERIAL9 & material() const { return m_material; }
+   const D3DLIGHT9 * light(DWORD index) const;   // NULL if it is not on
+   NullTexture * texture(DWORD stage) const { return stage < STAGES ? m_textures[stage] : NULL; }
+   NullVertexBuffer * streamSource() const { return m_stream; }
+   UINT streamStride() const { return m_streamStride; }
+   UINT streamOffset() const { return m_streamOffset; }
+   NullIndexBuffer * indices() const { return m_indices; }
+   DWORD fvf() const { return m_fvf; }
+   bool inScene() const { return m_inScene; }
+
+   enum { STAGES = 8, STAGE_STATES = 33, SAMPLER_STATES = 14, RENDER_STATES = 256 };
+
+protected:
+   ~NullDevice();
+
+private:
+   D3DMATRIX * transformSlot(D3DTRANSFORMSTATETYPE state);
+   void setDefaults();
+   template <class T> static void hold(T *& slot, T * object);
+
+   ULONG m_refs;
+   bool m_lost, m_inScene;
+   DWORD m_renderStates[RENDER_STATES];
+   DWORD m_stageStates[STAGES][STAGE_STATES];
+   DWORD m_samplerStates[STAGES][SAMPLER_STATES];
+   D3DMATRIX m_view, m_projection, m_world;
+   D3DMATERIAL9 m_material;
+   std::vector<D3DLIGHT9> m_lights;
+   std::vector<bool> m_lightOn;
+   NullTexture * m_textures[STAGES];
+   NullVertexBuffer * m_stream;
+   UINT m_streamOffset, m_streamStride;
+   NullIndexBuffer * m_indices;
+   DWORD m_fvf;
+};
+
+#endif
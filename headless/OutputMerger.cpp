@@ -0,0 +1,406 @@
+/* Filename:  OutputMerger.cpp
+
+   This file accompanies OutputMerger.h.
+*/
+
+#include "OutputMerger.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define MERGE_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MERGE_SSE 1
+#endif
+
+
+unsigned int depthBits(D3DFORMAT format)
+{
+   return format == D3DFMT_D24X8 || format == D3DFMT_D24S8 ? 24 : 16;
+}
+
+
+const char * outputMergerPath()
+{
+#if defined(MERGE_AVX2)
+   return "avx2";
+#elif defined(MERGE_SSE)
+   return "sse2";
+#else
+   return "scalar";
+#endif
+}
+
+
+// a BOTH factor for the source decides the destination's as well
+static void blendFactors(const MergeState & s, DWORD & src, DWORD & dest)
+{
+   src = s.srcBlend;
+   dest = s.destBlend;
+   if (src == D3DBLEND_BOTHSRCALPHA)
+   {
+      src = D3DBLEND_SRCALPHA;
+      dest = D3DBLEND_INVSRCALPHA;
+   }
+   else if (src == D3DBLEND_BOTHINVSRCALPHA)
+   {
+      src = D3DBLEND_INVSRCALPHA;
+      dest = D3DBLEND_SRCALPHA;
+   }
+}
+
+
+#if defined(MERGE_AVX2)
+
+// value func ref in each lane, all ones where it holds.. both under 2^31, so signed compares do
+static inline __m256i compare8(DWORD func, __m256i value, __m256i ref)
+{
+   __m256i ones = _mm256_set1_epi32(-1);
+   switch (func)
+   {
+   case D3DCMP_NEVER:        return _mm256_setzero_si256();
+   case D3DCMP_LESS:         return _mm256_cmpgt_epi32(ref, value);
+   case D3DCMP_EQUAL:        return _mm256_cmpeq_epi32(value, ref);
+   case D3DCMP_LESSEQUAL:    return _mm256_xor_si256(_mm256_cmpgt_epi32(value, ref), ones);
+   case D3DCMP_GREATER:      return _mm256_cmpgt_epi32(value, ref);
+   case D3DCMP_NOTEQUAL:     return _mm256_xor_si256(_mm256_cmpeq_epi32(value, ref), ones);
+   case D3DCMP_GREATEREQUAL: return _mm256_xor_si256(_mm256_cmpgt_epi32(ref, value), ones);
+   default:                  return ones;
+   }
+}
+
+
+static inline __m256i laneMask(unsigned int mask)
+{
+   __m256i bits = _mm256_set_epi32(128, 64, 32, 16, 8, 4, 2, 1);
+   return _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(mask), bits), bits);
+}
+
+
+// a blend factor for channel c
+static inline __m256 factor8(DWORD f, const __m256 * src, const __m256 * dst, const __m256 * constant, int c)
+{
+   __m256 one = _mm256_set1_ps(1.0f);
+   switch (f)
+   {
+   case D3DBLEND_ZERO:            return _mm256_setzero_ps();
+   case D3DBLEND_SRCCOLOR:        return src[c];
+   case D3DBLEND_INVSRCCOLOR:     return _mm256_sub_ps(one, src[c]);
+   case D3DBLEND_SRCALPHA:        return src[3];
+   case D3DBLEND_INVSRCALPHA:     return _mm256_sub_ps(one, src[3]);
+   case D3DBLEND_DESTALPHA:       return one;
+   case D3DBLEND_INVDESTALPHA:    return _mm256_setzero_ps();
+   case D3DBLEND_DESTCOLOR:       return dst[c];
+   case D3DBLEND_INVDESTCOLOR:    return _mm256_sub_ps(one, dst[c]);
+   case D3DBLEND_SRCALPHASAT:     return _mm256_setzero_ps();   // min(As, 1 - Ad), and Ad is 1
+   case D3DBLEND_BLENDFACTOR:     return constant[c];
+   case D3DBLEND_INVBLENDFACTOR:  return _mm256_sub_ps(one, constant[c]);
+   default:                       return one;   // D3DBLEND_ONE
+   }
+}
+
+
+unsigned int depthTest(const MergeState & s, const unsigned int * z, const unsigned int * depth, unsigned int mask)
+{
+   if (!s.zEnable)
+      return mask;
+   __m256i pass = compare8(s.zFunc, _mm256_loadu_si256((const __m256i *) z),
+                           _mm256_loadu_si256((const __m256i *) depth));
+   return mask & (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+}
+
+
+void mergeSpan(const MergeState & s, const float color[4][MERGE_WIDTH], const unsigned int * z,
+               unsigned int * dst, unsigned int * depth, unsigned int mask)
+{
+   __m256 src[4], one = _mm256_set1_ps(1.0f), zero = _mm256_setzero_ps();
+   __m256i byte = _mm256_set1_epi32(0xFF);
+   int c;
+
+   for (c = 0; c < 4; c++)
+      src[c] = _mm256_min_ps(_mm256_max_ps(_mm256_loadu_ps(color[c]), zero), one);
+   if (s.alphaTest)
+   {
+      __m256i alpha = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(src[3], _mm256_set1_ps(255.0f)),
+                                                        _mm256_set1_ps(0.5f)));
+      __m256i pass = compare8(s.alphaFunc, alpha, _mm256_set1_epi32(s.alphaRef));
+      mask &= (unsigned int) _mm256_movemask_ps(_mm256_castsi256_ps(pass));
+   }
+   if (mask == 0)
+      return;
+   __m256i lanes = laneMask(mask);
+
+   __m256i old = _mm256_loadu_si256((const __m256i *) dst);
+   if (s.blend)
+   {
+      __m256 d[4], k[4], scale = _mm256_set1_ps(1.0f / 255.0f);
+      DWORD fs, fd;
+      d[0] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(old, 16), byte)), scale);
+      d[1] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(old, 8), byte)), scale);
+      d[2] = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_and_si256(old, byte)), scale);
+      d[3] = one;
+      k[0] = _mm256_set1_ps(((s.blendFactor >> 16) & 0xFF) / 255.0f);
+      k[1] = _mm256_set1_ps(((s.blendFactor >> 8) & 0xFF) / 255.0f);
+      k[2] = _mm256_set1_ps((s.blendFactor & 0xFF) / 255.0f);
+      k[3] = _mm256_set1_ps((s.blendFactor >> 24) / 255.0f);
+      blendFactors(s, fs, fd);
+      for (c = 0; c < 3; c++)
+      {
+         __m256 a = _mm256_mul_ps(src[c], factor8(fs, src, d, k, c));
+         __m256 b = _mm256_mul_ps(d[c], factor8(fd, src, d, k, c));
+         switch (s.blendOp)
+         {
+         case D3DBLENDOP_SUBTRACT:    a = _mm256_sub_ps(a, b);           break;
+         case D3DBLENDOP_REVSUBTRACT: a = _mm256_sub_ps(b, a);           break;
+         case D3DBLENDOP_MIN:         a = _mm256_min_ps(src[c], d[c]);   break;
+         case D3DBLENDOP_MAX:         a = _mm256_max_ps(src[c], d[c]);   break;
+         default:                     a = _mm256_add_ps(a, b);           break;
+         }
+         src[c] = _mm256_min_ps(_mm256_max_ps(a, zero), one);
+      }
+   }
+
+   __m256 most = _mm256_set1_ps(255.0f), half = _mm256_set1_ps(0.5f);
+   __m256i r = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(src[0], most), half));
+   __m256i g = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(src[1], most), half));
+   __m256i b = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(src[2], most), half));
+   __m256i packed = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(r, 16), _mm256_slli_epi32(g, 8)), b);
+   _mm256_storeu_si256((__m256i *) dst, _mm256_blendv_epi8(old, packed, lanes));
+   if (s.zEnable && s.zWrite)
+   {
+      __m256i was = _mm256_loadu_si256((const __m256i *) depth);
+      _mm256_storeu_si256((__m256i *) depth, _mm256_blendv_epi8(was, _mm256_loadu_si256((const __m256i *) z), lanes));
+   }
+}
+
+#elif defined(MERGE_SSE)
+
+// as compare8, a half span at a time.. SSE2 has no unsigned or not-greater compares either
+static inline __m128i compare4(DWORD func, __m128i value, __m128i ref)
+{
+   __m128i ones = _mm_set1_epi32(-1);
+   switch (func)
+   {
+   case D3DCMP_NEVER:        return _mm_setzero_si128();
+   case D3DCMP_LESS:         return _mm_cmpgt_epi32(ref, value);
+   case D3DCMP_EQUAL:        return _mm_cmpeq_epi32(value, ref);
+   case D3DCMP_LESSEQUAL:    return _mm_xor_si128(_mm_cmpgt_epi32(value, ref), ones);
+   case D3DCMP_GREATER:      return _mm_cmpgt_epi32(value, ref);
+   case D3DCMP_NOTEQUAL:     return _mm_xor_si128(_mm_cmpeq_epi32(value, ref), ones);
+   case D3DCMP_GREATEREQUAL: return _mm_xor_si128(_mm_cmpgt_epi32(ref, value), ones);
+   default:                  return ones;
+   }
+}
+
+
+static inline __m128i laneMask(unsigned int mask)
+{
+   __m128i bits = _mm_set_epi32(8, 4, 2, 1);
+   return _mm_cmpeq_epi32(_mm_and_si128(_mm_set1_epi32(mask), bits), bits);
+}
+
+
+static inline __m128i select(__m128i mask, __m128i a, __m128i b)   // b where mask is set
+{
+   return _mm_or_si128(_mm_andnot_si128(mask, a), _mm_and_si128(mask, b));
+}
+
+
+static inline __m128 factor4(DWORD f, const __m128 * src, const __m128 * dst, const __m128 * constant, int c)
+{
+   __m128 one = _mm_set1_ps(1.0f);
+   switch (f)
+   {
+   case D3DBLEND_ZERO:            return _mm_setzero_ps();
+   case D3DBLEND_SRCCOLOR:        return src[c];
+   case D3DBLEND_INVSRCCOLOR:     return _mm_sub_ps(one, src[c]);
+   case D3DBLEND_SRCALPHA:        return src[3];
+   case D3DBLEND_INVSRCALPHA:     return _mm_sub_ps(one, src[3]);
+   case D3DBLEND_DESTALPHA:       return one;
+   case D3DBLEND_INVDESTALPHA:    return _mm_setzero_ps();
+   case D3DBLEND_DESTCOLOR:       return dst[c];
+   case D3DBLEND_INVDESTCOLOR:    return _mm_sub_ps(one, dst[c]);
+   case D3DBLEND_SRCALPHASAT:     return _mm_setzero_ps();
+   case D3DBLEND_BLENDFACTOR:     return constant[c];
+   case D3DBLEND_INVBLENDFACTOR:  return _mm_sub_ps(one, constant[c]);
+   default:                       return one;
+   }
+}
+
+
+unsigned int depthTest(const MergeState & s, const unsigned int * z, const unsigned int * depth, unsigned int mask)
+{
+   if (!s.zEnable)
+      return mask;
+   __m128i lo = compare4(s.zFunc, _mm_loadu_si128((const __m128i *) z), _mm_loadu_si128((const __m128i *) depth));
+   __m128i hi = compare4(s.zFunc, _mm_loadu_si128((const __m128i *) (z + 4)),
+                         _mm_loadu_si128((const __m128i *) (depth + 4)));
+   return mask & (unsigned int) (_mm_movemask_ps(_mm_castsi128_ps(lo)) | _mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+}
+
+
+void mergeSpan(const MergeState & s, const float color[4][MERGE_WIDTH], const unsigned int * z,
+               unsigned int * dst, unsigned int * depth, unsigned int mask)
+{
+   __m128 one = _mm_set1_ps(1.0f), zero = _mm_setzero_ps(), most = _mm_set1_ps(255.0f), half = _mm_set1_ps(0.5f);
+   __m128i byte = _mm_set1_epi32(0xFF);
+   DWORD fs, fd;
+   int h, c;
+
+   blendFactors(s, fs, fd);
+   for (h = 0; h < MERGE_WIDTH; h += 4)
+   {
+      __m128 src[4];
+      for (c = 0; c < 4; c++)
+         src[c] = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(color[c] + h), zero), one);
+      unsigned int quad = (mask >> h) & 0xF;
+      if (s.alphaTest)
+      {
+         __m128i alpha = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(src[3], most), half));
+         quad &= (unsigned int) _mm_movemask_ps(_mm_castsi128_ps(compare4(s.alphaFunc, alpha,
+                                                                          _mm_set1_epi32(s.alphaRef))));
+      }
+      if (quad == 0)
+         continue;
+      __m128i lanes = laneMask(quad);
+
+      __m128i old = _mm_loadu_si128((const __m128i *) (dst + h));
+      if (s.blend)
+      {
+         __m128 d[4], k[4], scale = _mm_set1_ps(1.0f / 255.0f);
+         d[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(old, 16), byte)), scale);
+         d[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(old, 8), byte)), scale);
+         d[2] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_and_si128(old, byte)), scale);
+         d[3] = one;
+         k[0] = _mm_set1_ps(((s.blendFactor >> 16) & 0xFF) / 255.0f);
+         k[1] = _mm_set1_ps(((s.blendFactor >> 8) & 0xFF) / 255.0f);
+         k[2] = _mm_set1_ps((s.blendFactor & 0xFF) / 255.0f);
+         k[3] = _mm_set1_ps((s.blendFactor >> 24) / 255.0f);
+         for (c = 0; c < 3; c++)
+         {
+            __m128 a = _mm_mul_ps(src[c], factor4(fs, src, d, k, c));
+            __m128 b = _mm_mul_ps(d[c], factor4(fd, src, d, k, c));
+            switch (s.blendOp)
+            {
+            case D3DBLENDOP_SUBTRACT:    a = _mm_sub_ps(a, b);           break;
+            case D3DBLENDOP_REVSUBTRACT: a = _mm_sub_ps(b, a);           break;
+            case D3DBLENDOP_MIN:         a = _mm_min_ps(src[c], d[c]);   break;
+            case D3DBLENDOP_MAX:         a = _mm_max_ps(src[c], d[c]);   break;
+            default:                     a = _mm_add_ps(a, b);           break;
+            }
+            src[c] = _mm_min_ps(_mm_max_ps(a, zero), one);
+         }
+      }
+
+      __m128i r = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(src[0], most), half));
+      __m128i g = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(src[1], most), half));
+      __m128i b = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(src[2], most), half));
+      __m128i packed = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(r, 16), _mm_slli_epi32(g, 8)), b);
+      _mm_storeu_si128((__m128i *) (dst + h), select(lanes, old, packed));
+      if (s.zEnable && s.zWrite)
+      {
+         __m128i was = _mm_loadu_si128((const __m128i *) (depth + h));
+         _mm_storeu_si128((__m128i *) (depth + h), select(lanes, was, _mm_loadu_si128((const __m128i *) (z + h))));
+      }
+   }
+}
+
+#else
+
+static bool compare(DWORD func, unsigned int value, unsigned int ref)
+{
+   switch (func)
+   {
+   case D3DCMP_NEVER:        return false;
+   case D3DCMP_LESS:         return value < ref;
+   case D3DCMP_EQUAL:        return value == ref;
+   case D3DCMP_LESSEQUAL:    return value <= ref;
+   case D3DCMP_GREATER:      return value > ref;
+   case D3DCMP_NOTEQUAL:     return value != ref;
+   case D3DCMP_GREATEREQUAL: return value >= ref;
+   default:                  return true;
+   }
+}
+
+
+static float factor(DWORD f, const float * src, const float * dst, const float * constant, int c)
+{
+   switch (f)
+   {
+   case D3DBLEND_ZERO:            return 0.0f;
+   case D3DBLEND_SRCCOLOR:        return src[c];
+   case D3DBLEND_INVSRCCOLOR:     return 1.0f - src[c];
+   case D3DBLEND_SRCALPHA:        return src[3];
+   case D3DBLEND_INVSRCALPHA:     return 1.0f - src[3];
+   case D3DBLEND_DESTALPHA:       return 1.0f;
+   case D3DBLEND_INVDESTALPHA:    return 0.0f;
+   case D3DBLEND_DESTCOLOR:       return dst[c];
+   case D3DBLEND_INVDESTCOLOR:    return 1.0f - dst[c];
+   case D3DBLEND_SRCALPHASAT:     return 0.0f;
+   case D3DBLEND_BLENDFACTOR:     return constant[c];
+   case D3DBLEND_INVBLENDFACTOR:  return 1.0f - constant[c];
+   default:                       return 1.0f;
+   }
+}
+
+
+unsigned int depthTest(const MergeState & s, const unsigned int * z, const unsigned int * depth, unsigned int mask)
+{
+   int i;
+
+   if (!s.zEnable)
+      return mask;
+   for (i = 0; i < MERGE_WIDTH; i++)
+      if (!compare(s.zFunc, z[i], depth[i]))
+         mask &= ~(1u << i);
+   return mask;
+}
+
+
+void mergeSpan(const MergeState & s, const float color[4][MERGE_WIDTH], const unsigned int * z,
+               unsigned int * dst, unsigned int * depth, unsigned int mask)
+{
+   float k[4] = { ((s.blendFactor >> 16) & 0xFF) / 255.0f, ((s.blendFactor >> 8) & 0xFF) / 255.0f,
+                  (s.blendFactor & 0xFF) / 255.0f, (s.blendFactor >> 24) / 255.0f };
+   DWORD fs, fd;
+   int i, c;
+
+   blendFactors(s, fs, fd);
+   for (i = 0; i < MERGE_WIDTH; i++)
+   {
+      float src[4], d[4];
+      if ((mask & (1u << i)) == 0)
+         continue;
+      for (c = 0; c < 4; c++)
+         src[c] = std::min(std::max(color[c][i], 0.0f), 1.0f);
+      if (s.alphaTest && !compare(s.alphaFunc, (unsigned int) (src[3] * 255.0f + 0.5f), s.alphaRef))
+         continue;
+      if (s.blend)
+      {
+         d[0] = ((dst[i] >> 16) & 0xFF) / 255.0f;
+         d[1] = ((dst[i] >> 8) & 0xFF) / 255.0f;
+         d[2] = (dst[i] & 0xFF) / 255.0f;
+         d[3] = 1.0f;
+         for (c = 0; c < 3; c++)
+         {
+            float a = src[c] * factor(fs, src, d, k, c), b = d[c] * factor(fd, src, d, k, c);
+            switch (s.blendOp)
+            {
+            case D3DBLENDOP_SUBTRACT:    a = a - b;                      break;
+            case D3DBLENDOP_REVSUBTRACT: a = b - a;                      break;
+            case D3DBLENDOP_MIN:         a = std::min(src[c], d[c]);     break;
+            case D3DBLENDOP_MAX:         a = std::max(src[c], d[c]);     break;
+            default:                     a = a + b;                      break;
+            }
+            src[c] = std::min(std::max(a, 0.0f), 1.0f);
+         }
+      }
+      dst[i] = (unsigned int) (src[0] * 255.0f + 0.5f) << 16 | (unsigned int) (src[1] * 255.0f + 0.5f) << 8 |
+               (unsigned int) (src[2] * 255.0f + 0.5f);
+      if (s.zEnable && s.zWrite)
+         depth[i] = z[i];
+   }
+}
+
+#endif
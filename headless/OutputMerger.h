@@ -0,0 +1,61 @@
+/* Filename:  OutputMerger.h
+
+   This file is used by the headless builds.  See d3d9.h.
+
+   The last part of SoftDevice's pipeline, a span of 8 pixels at a time:
+   the depth test, the alpha test, and blending into an X8R8G8B8 back
+   buffer with D3DRS_SRCBLEND, DESTBLEND and BLENDOP.  All the D3DBLEND
+   factors are done (the back buffer has no alpha, so the destination's
+   is taken as 1, as D3D does) and all five blend ops.
+
+   Depths are kept in 32 bit words whatever the depth buffer's format, a
+   16 bit one (D3DFMT_D16) holding 0 to 65535 and a 24 bit one (D24X8,
+   D24S8) 0 to 2^24 - 1, so they compare as a card's would, with the same
+   rounding, either way.
+
+   The spans are 8 pixels of one row of a tile, so the back buffer each
+   reads and writes is the tile's own, the one thread rendering it the
+   only one touching it.  With AVX2 a span is done in one go, with SSE2
+   in two halves, and with neither one pixel at a time.
+*/
+
+#ifndef OUTPUTMERGER_H
+#define OUTPUTMERGER_H
+
+#include <d3d9.h>
+
+
+enum { MERGE_WIDTH = 8 };
+
+// the render states the merger reads
+struct MergeState
+{
+   DWORD zEnable, zWrite, zFunc;            // zFunc a D3DCMP
+   DWORD alphaTest, alphaRef, alphaFunc;    // alphaRef 0 to 255
+   DWORD blend, srcBlend, destBlend, blendOp;
+   D3DCOLOR blendFactor;                    // for D3DBLEND_BLENDFACTOR
+};
+
+// bits in a depth, for a depth buffer format.. 16 unless it is a 24 bit one
+unsigned int depthBits(D3DFORMAT format);
+
+// z, 0 to 1, as a depth bits deep
+inline unsigned int depthValue(float z, unsigned int bits)
+{
+   float most = (float) ((1u << bits) - 1);
+   return (unsigned int) ((z < 0.0f ? 0.0f : z > 1.0f ? 1.0f : z) * most + 0.5f);
+}
+
+// which of the pixels of mask have a z that passes the depth test against
+// depth.. all of them if it is off.  Nothing is written
+unsigned int depthTest(const MergeState & s, const unsigned int * z, const unsigned int * depth, unsigned int mask);
+
+// the pixels of mask whose alpha passes the alpha test: color (r, g, b
+// and a, 0 to 1, 8 of each) blended into dst, and their z written into
+// depth if z writes are on
+void mergeSpan(const MergeState & s, const float color[4][MERGE_WIDTH], const unsigned int * z,
+               unsigned int * dst, unsigned int * depth, unsigned int mask);
+
+const char * outputMergerPath();   // "avx2", "sse2" or "scalar"
+
+#endif
@@ -0,0 +1,1361 @@
+/* Filename:  SoftDevice.cpp
+
+   This file accompanies SoftDevice.h.
+*/
+
+#include "SoftDevice.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SOFT_SSE 1
+#endif
+
+#define GUARD_BAND 4096.0f   // pixels either way a vertex can be before it is clipped.. keeps the edge maths in 32 bits
+#define LIGHTS 8
+
+
+static unsigned int outCode(const SoftDevice::Vertex & v, float gx, float gy);
+
+
+static void multiply(D3DMATRIX & out, const D3DMATRIX & a, const D3DMATRIX & b)
+{
+   int i, j;
+
+   for (i = 0; i < 4; i++)
+      for (j = 0; j < 4; j++)
+         out.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+}
+
+
+static void unpackColor(D3DCOLOR c, float * out)
+{
+   out[0] = ((c >> 16) & 0xFF) / 255.0f;
+   out[1] = ((c >> 8) & 0xFF) / 255.0f;
+   out[2] = (c & 0xFF) / 255.0f;
+   out[3] = (c >> 24) / 255.0f;
+}
+
+
+static float clamp01(float f)
+{
+   return f < 0.0f ? 0.0f : f > 1.0f ? 1.0f : f;
+}
+
+
+SoftDevice::SoftDevice(UINT width, UINT height, D3DFORMAT depthFormat, unsigned int numThreads)
+   : m_width(0), m_height(0), m_tilesX(0), m_tilesY(0), m_depthBits(::depthBits(depthFormat)),
+     m_trianglesDrawn(0), m_frameTriangles(0),
+     m_state(0), m_generation(0), m_nextTile(0), m_busy(0), m_quit(false)
+{
+   unsigned int i;
+
+   resize(width, height);
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   for (i = 1; i < numThreads; i++)
+      m_workers.push_back(std::thread(&SoftDevice::workerLoop, this));
+}
+
+
+SoftDevice::~SoftDevice()
+{
+   size_t i;
+
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_quit = true;
+   }
+   m_wake.notify_all();
+   for (i = 0; i < m_workers.size(); i++)
+      m_workers[i].join();
+   std::map<NullTexture *, TextureCopy>::iterator it;
+   for (it = m_copies.begin(); it != m_copies.end(); ++it)
+      it->first->Release();
+}
+
+
+void SoftDevice::resize(UINT width, UINT height)
+{
+   if (width == 0 || height == 0)
+      return;
+   m_width = width;
+   m_height = height;
+   m_tilesX = (width + TILE - 1) / TILE;
+   m_tilesY = (height + TILE - 1) / TILE;
+   m_color.assign((size_t) m_tilesX * m_tilesY * TILE * TILE, 0);
+   m_depth.assign(m_color.size(), depthValue(1.0f, m_depthBits));
+   m_front.assign((size_t) width * height, 0);
+   m_bins.clear();
+   m_bins.resize(m_tilesX * m_tilesY);
+}
+
+
+HRESULT SoftDevice::Reset(D3DPRESENT_PARAMETERS * params)
+{
+   HRESULT hr = NullDevice::Reset(params);
+
+   if (FAILED(hr))
+      return hr;
+   flush(false);   // what was drawn before the reset is lost, as it is on a card
+   if (params->EnableAutoDepthStencil)
+      m_depthBits = ::depthBits(params->AutoDepthStencilFormat);
+   resize(params->BackBufferWidth, params->BackBufferHeight);
+   return hr;
+}
+
+
+HRESULT SoftDevice::Present(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty)
+{
+   HRESULT hr = NullDevice::Present(src, dst, window, dirty);
+
+   if (FAILED(hr))
+      return hr;
+   flush(false);
+   resolve();
+   m_trianglesDrawn = m_frameTriangles;
+   m_frameTriangles = 0;
+
+   // copies of textures this frame didn't use go
+   std::map<NullTexture *, TextureCopy>::iterator it = m_copies.begin();
+   while (it != m_copies.end())
+   {
+      if (it->second.used)
+      {
+         it->second.used = false;
+         ++it;
+         continue;
+      }
+      it->first->Release();
+      m_copies.erase(it++);
+   }
+   return hr;
+}
+
+
+void SoftDevice::resolve()
+{
+   UINT tile, y;
+
+   for (tile = 0; tile < m_tilesX * m_tilesY; tile++)
+   {
+      UINT tx = (tile % m_tilesX) * TILE, ty = (tile / m_tilesX) * TILE;
+      UINT w = std::min((UINT) TILE, m_width - tx), h = std::min((UINT) TILE, m_height - ty);
+      const unsigned int * src = &m_color[(size_t) tile * TILE * TILE];
+      for (y = 0; y < h; y++)
+         memcpy(&m_front[(size_t) (ty + y) * m_width + tx], src + y * TILE, w * sizeof(unsigned int));
+   }
+}
+
+
+//*******
+// the commands of a frame, binned by tile
+
+HRESULT SoftDevice::Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil)
+{
+   HRESULT hr = NullDevice::Clear(count, rects, flags, color, z, stencil);
+   DWORD i;
+
+   if (FAILED(hr) || (flags & (D3DCLEAR_TARGET | D3DCLEAR_ZBUFFER)) == 0)
+      return hr;
+   for (i = 0; i < (count ? count : 1); i++)
+   {
+      ClearCommand c;
+      c.x1 = count ? std::max((int) rects[i].x1, 0) : 0;
+      c.y1 = count ? std::max((int) rects[i].y1, 0) : 0;
+      c.x2 = count ? std::min((int) rects[i].x2, (int) m_width) : (int) m_width;
+      c.y2 = count ? std::min((int) rects[i].y2, (int) m_height) : (int) m_height;
+      c.flags = flags;
+      c.color = color & 0x00FFFFFF;
+      c.z = depthValue(z, m_depthBits);
+      if (c.x1 >= c.x2 || c.y1 >= c.y2)
+         continue;
+      m_clears.push_back(c);
+      bin(CLEAR_BIT | (unsigned int) (m_clears.size() - 1), c.x1, c.y1, c.x2 - 1, c.y2 - 1);
+   }
+   return hr;
+}
+
+
+// a texel of any format here as A8R8G8B8
+static unsigned int decodeTexel(const unsigned char * bits, UINT pitch, D3DFORMAT format, UINT x, UINT y)
+{
+   const unsigned char * row = bits + (size_t) (format >= D3DFMT_DXT1 && format <= D3DFMT_DXT5 ? y / 4 : y) * pitch;
+   unsigned int c;
+
+   switch (format)
+   {
+   case D3DFMT_A8R8G8B8:
+   case D3DFMT_X8R8G8B8:
+      c = ((const unsigned int *) row)[x];
+      if (format == D3DFMT_X8R8G8B8)
+         c |= 0xFF000000;
+      break;
+   case D3DFMT_R8G8B8:
+      c = 0xFF000000 | (row[x * 3 + 2] << 16) | (row[x * 3 + 1] << 8) | row[x * 3];
+      break;
+   case D3DFMT_R5G6B5:
+      c = ((const unsigned short *) row)[x];
+      c = 0xFF000000 | ((c >> 11) * 255 / 31) << 16 | ((c >> 5 & 63) * 255 / 63) << 8 | (c & 31) * 255 / 31;
+      break;
+   case D3DFMT_X1R5G5B5:
+   case D3DFMT_A1R5G5B5:
+      c = ((const unsigned short *) row)[x];
+      c = (format == D3DFMT_X1R5G5B5 || (c & 0x8000) ? 0xFF000000 : 0) | ((c >> 10 & 31) * 255 / 31) << 16 |
+          ((c >> 5 & 31) * 255 / 31) << 8 | (c & 31) * 255 / 31;
+      break;
+   case D3DFMT_A4R4G4B4:
+      c = ((const unsigned short *) row)[x];
+      c = (c >> 12) * 0x11000000 | (c >> 8 & 15) * 0x110000 | (c >> 4 & 15) * 0x1100 | (c & 15) * 0x11;
+      break;
+   case D3DFMT_L8:
+      c = 0xFF000000 | row[x] * 0x010101;
+      break;
+   case D3DFMT_A8:
+      c = row[x] << 24;
+      break;
+   case D3DFMT_DXT1:
+   case D3DFMT_DXT2:
+   case D3DFMT_DXT3:
+   case D3DFMT_DXT4:
+   case D3DFMT_DXT5:
+      {
+         // the one texel out of its 4x4 block
+         bool bc1 = format == D3DFMT_DXT1;
+         const unsigned char * block = row + (x / 4) * (bc1 ? 8 : 16);
+         const unsigned char * colors = bc1 ? block : block + 8;
+         unsigned int i = (y & 3) * 4 + (x & 3), c0 = colors[0] | colors[1] << 8, c1 = colors[2] | colors[3] << 8;
+         unsigned int sel = colors[4 + i / 4] >> ((i & 3) * 2) & 3, alpha = 255, ch, a0, a1;
+         unsigned int rgb0[3] = { (c0 >> 11) * 255 / 31, (c0 >> 5 & 63) * 255 / 63, (c0 & 31) * 255 / 31 };
+         unsigned int rgb1[3] = { (c1 >> 11) * 255 / 31, (c1 >> 5 & 63) * 255 / 63, (c1 & 31) * 255 / 31 };
+         unsigned int rgb[3];
+         for (ch = 0; ch < 3; ch++)
+         {
+            if (sel == 0)
+               rgb[ch] = rgb0[ch];
+            else if (sel == 1)
+               rgb[ch] = rgb1[ch];
+            else if (c0 > c1 || !bc1)
+               rgb[ch] = sel == 2 ? (2 * rgb0[ch] + rgb1[ch]) / 3 : (rgb0[ch] + 2 * rgb1[ch]) / 3;
+            else
+               rgb[ch] = sel == 2 ? (rgb0[ch] + rgb1[ch]) / 2 : 0;
+         }
+         if (bc1 && c0 <= c1 && sel == 3)
+            alpha = 0;
+         if (format == D3DFMT_DXT2 || format == D3DFMT_DXT3)
+            alpha = (block[i / 2] >> ((i & 1) * 4) & 15) * 17;
+         else if (!bc1)
+         {
+            unsigned long long bits48 = 0;
+            for (ch = 0; ch < 6; ch++)
+               bits48 |= (unsigned long long) block[2 + ch] << (ch * 8);
+            a0 = block[0];
+            a1 = block[1];
+            sel = (unsigned int) (bits48 >> (i * 3)) & 7;
+            if (sel == 0)
+               alpha = a0;
+            else if (sel == 1)
+               alpha = a1;
+            else if (a0 > a1)
+               alpha = ((8 - sel) * a0 + (sel - 1) * a1) / 7;
+            else
+               alpha = sel == 6 ? 0 : sel == 7 ? 255 : ((6 - sel) * a0 + (sel - 1) * a1) / 5;
+         }
+         c = alpha << 24 | rgb[0] << 16 | rgb[1] << 8 | rgb[2];
+      }
+      break;
+   default:
+      c = 0xFFFFFFFF;
+      break;
+   }
+   return c;
+}
+
+
+// the state every triangle of a draw refers to.. the last one again if nothing has changed
+unsigned int SoftDevice::captureState()
+{
+   DrawState s;
+   int i;
+
+   memset(&s, 0, sizeof(s));   // padding and all, for the memcmp
+   for (i = 0; i < STAGES_USED; i++)
+   {
+      s.textures[i] = copyTexture(texture(i));
+      s.colorOp[i] = stageState(i, D3DTSS_COLOROP);
+      s.colorArg1[i] = stageState(i, D3DTSS_COLORARG1);
+      s.colorArg2[i] = stageState(i, D3DTSS_COLORARG2);
+      s.alphaOp[i] = stageState(i, D3DTSS_ALPHAOP);
+      s.alphaArg1[i] = stageState(i, D3DTSS_ALPHAARG1);
+      s.alphaArg2[i] = stageState(i, D3DTSS_ALPHAARG2);
+      s.texCoords[i] = stageState(i, D3DTSS_TEXCOORDINDEX) & 0xFFFF;
+      SamplerSettings & sampler = s.samplers[i];
+      sampler.minFilter = samplerState(i, D3DSAMP_MINFILTER);
+      sampler.magFilter = samplerState(i, D3DSAMP_MAGFILTER);
+      sampler.mipFilter = samplerState(i, D3DSAMP_MIPFILTER);
+      sampler.addressU = samplerState(i, D3DSAMP_ADDRESSU);
+      sampler.addressV = samplerState(i, D3DSAMP_ADDRESSV);
+      sampler.maxAnisotropy = samplerState(i, D3DSAMP_MAXANISOTROPY);
+      DWORD bias = samplerState(i, D3DSAMP_MIPMAPLODBIAS);
+      memcpy(&sampler.lodBias, &bias, sizeof(float));
+   }
+   s.textureFactor = renderState(D3DRS_TEXTUREFACTOR);
+   s.specular = renderState(D3DRS_SPECULARENABLE);
+   MergeState & merge = s.merge;
+   merge.zEnable = renderState(D3DRS_ZENABLE);
+   merge.zWrite = renderState(D3DRS_ZWRITEENABLE);
+   merge.zFunc = renderState(D3DRS_ZFUNC);
+   merge.alphaTest = renderState(D3DRS_ALPHATESTENABLE);
+   merge.alphaRef = renderState(D3DRS_ALPHAREF) & 0xFF;
+   merge.alphaFunc = renderState(D3DRS_ALPHAFUNC);
+   merge.blend = renderState(D3DRS_ALPHABLENDENABLE);
+   merge.srcBlend = renderState(D3DRS_SRCBLEND);
+   merge.destBlend = renderState(D3DRS_DESTBLEND);
+   merge.blendOp = renderState(D3DRS_BLENDOP);
+   merge.blendFactor = renderState(D3DRS_BLENDFACTOR);
+
+   if (!m_states.empty() && memcmp(&m_states.back(), &s, sizeof(s)) == 0)
+      return (unsigned int) m_states.size() - 1;
+   m_states.push_back(s);
+   return (unsigned int) m_states.size() - 1;
+}
+
+
+// the sampler's copy of a texture, made again if it has changed since
+const SampledTexture * SoftDevice::copyTexture(NullTexture * texture)
+{
+   D3DSURFACE_DESC desc;
+   UINT level, x, y;
+
+   if (texture == NULL)
+      return NULL;
+   std::map<NullTexture *, TextureCopy>::iterator it = m_copies.find(texture);
+   if (it == m_copies.end())
+   {
+      texture->AddRef();
+      it = m_copies.insert(std::make_pair(texture, TextureCopy())).first;
+      it->second.changes = texture->changes() - 1;   // so it is copied
+      it->second.used = false;
+   }
+   TextureCopy & copy = it->second;
+   if (copy.changes != texture->changes())
+   {
+      if (copy.used)
+         flush(true);   // draws already made this frame see it as it was
+      texture->GetLevelDesc(0, &desc);
+      copy.sampled.resize(desc.Width, desc.Height, texture->GetLevelCount());
+      for (level = 0; level < texture->GetLevelCount(); level++)
+      {
+         texture->GetLevelDesc(level, &desc);
+         m_decoded.resize((size_t) desc.Width * desc.Height);
+         for (y = 0; y < desc.Height; y++)
+            for (x = 0; x < desc.Width; x++)
+               m_decoded[(size_t) y * desc.Width + x] = decodeTexel(texture->data(level), texture->pitch(level),
+                                                                    desc.Format, x, y);
+         copy.sampled.setLevel(level, &m_decoded[0], desc.Width * 4);
+      }
+      copy.changes = texture->changes();
+   }
+   copy.used = true;
+   return &copy.sampled;
+}
+
+
+void SoftDevice::bin(unsigned int command, int minX, int minY, int maxX, int maxY)
+{
+   unsigned int tx, ty;
+
+   for (ty = minY / TILE; ty <= (unsigned int) maxY / TILE; ty++)
+      for (tx = minX / TILE; tx <= (unsigned int) maxX / TILE; tx++)
+         m_bins[ty * m_tilesX + tx].push_back(command);
+}
+
+
+//*******
+// vertices
+
+// the vertices of the stream from start, transformed and lit into m_vertices,
+// with their clip codes and screen positions.. false, and nothing lit, if
+// they are all outside one plane so nothing of the draw can be seen
+bool SoftDevice::transformVertices(UINT start, UINT count)
+{
+   DWORD format = fvf();
+   const unsigned char * src = streamSource()->data() + streamOffset() + (size_t) start * streamStride();
+   UINT stride = streamStride(), texSets = (format & D3DFVF_TEXCOUNT_MASK) >> D3DFVF_TEXCOUNT_SHIFT;
+   UINT normalAt = 0, diffuseAt = 0, specularAt = 0, texAt, i, j;
+   bool rhw = (format & D3DFVF_XYZRHW) != 0;
+   bool lit = renderState(D3DRS_LIGHTING) && !rhw;
+   bool specular = lit && renderState(D3DRS_SPECULARENABLE);
+   D3DMATRIX viewProj, wvp;
+   const D3DMATRIX & w = world();
+   const D3DLIGHT9 * lights[LIGHTS];
+   float ambient[4] = { 0.0f, 0.0f, 0.0f, 0.0f }, camera[3] = { 0.0f, 0.0f, 0.0f };
+   int lightCount = 0, stage;
+
+   // where each part is in a vertex
+   texAt = rhw ? 16 : 12;
+   if (format & D3DFVF_NORMAL)
+   {
+      normalAt = texAt;
+      texAt += 12;
+   }
+   if (format & D3DFVF_PSIZE)
+      texAt += 4;
+   if (format & D3DFVF_DIFFUSE)
+   {
+      diffuseAt = texAt;
+      texAt += 4;
+   }
+   if (format & D3DFVF_SPECULAR)
+   {
+      specularAt = texAt;
+      texAt += 4;
+   }
+
+   multiply(viewProj, view(), projection());
+   multiply(wvp, w, viewProj);
+   if (lit)
+   {
+      for (i = 0; i < LIGHTS; i++)
+         if ((lights[lightCount] = light(i)) != NULL)
+            lightCount++;
+      unpackColor(renderState(D3DRS_AMBIENT), ambient);
+      // the camera is where the view matrix takes to 0,0,0
+      const D3DMATRIX & v = view();
+      for (i = 0; i < 3; i++)
+         camera[i] = -(v._41 * v.m[i][0] + v._42 * v.m[i][1] + v._43 * v.m[i][2]);
+   }
+
+   m_vertices.resize(count);
+   m_clipCodes.resize(count);
+   m_screen.resize((size_t) count * 2);
+   float * screenX = &m_screen[0], * screenY = screenX + count;
+   float gx = 2.0f * GUARD_BAND / m_width - 1.0f, gy = 2.0f * GUARD_BAND / m_height - 1.0f;
+
+   // the positions pulled out into streams and done 8 at a time
+   if (!rhw)
+   {
+      VertexTransform t;
+      VertexStreams s;
+      memcpy(t.matrix, &wvp, sizeof(t.matrix));
+      t.width = (float) m_width;
+      t.height = (float) m_height;
+      t.guardX = gx;
+      t.guardY = gy;
+
+      m_streams.resize((size_t) count * 7);
+      float * x = &m_streams[0];
+      const unsigned char * from = src;
+      for (i = 0; i < count; i++, from += stride)
+      {
+         const float * p = (const float *) from;
+         x[i] = p[0];
+         x[count + i] = p[1];
+         x[count * 2 + i] = p[2];
+      }
+      s.x = x;
+      s.y = x + count;
+      s.z = x + count * 2;
+      s.clipX = x + count * 3;
+      s.clipY = x + count * 4;
+      s.clipZ = x + count * 5;
+      s.clipW = x + count * 6;
+      s.screenX = screenX;
+      s.screenY = screenY;
+      s.screenZ = s.rhw = NULL;
+      s.clip = &m_clipCodes[0];
+      if (transformVerticesParallel(t, s, count).all)
+         return false;
+   }
+
+   for (i = 0; i < count; i++, src += stride)
+   {
+      Vertex & out = m_vertices[i];
+      const float * p = (const float *) src;
+
+      if (rhw)   // already on the screen
+      {
+         out.w = p[3] != 0.0f ? 1.0f / p[3] : 1.0f;
+         out.x = (p[0] / (m_width * 0.5f) - 1.0f) * out.w;
+         out.y = (1.0f - p[1] / (m_height * 0.5f)) * out.w;
+         out.z = p[2] * out.w;
+         m_clipCodes[i] = (unsigned char) outCode(out, gx, gy);
+         screenX[i] = (out.x / out.w + 1.0f) * 0.5f * m_width;
+         screenY[i] = (1.0f - out.y / out.w) * 0.5f * m_height;
+      }
+      else
+      {
+         const float * c = &m_streams[(size_t) count * 3 + i];
+         out.x = c[0];
+         out.y = c[count];
+         out.z = c[count * 2];
+         out.w = c[count * 3];
+      }
+
+      if (diffuseAt)
+         unpackColor(*(const DWORD *) (src + diffuseAt), out.diffuse);
+      else
+         out.diffuse[0] = out.diffuse[1] = out.diffuse[2] = out.diffuse[3] = 1.0f;
+      out.specular[0] = out.specular[1] = out.specular[2] = 0.0f;
+      if (specularAt && !lit)
+      {
+         float s[4];
+         unpackColor(*(const DWORD *) (src + specularAt), s);
+         out.specular[0] = s[0];
+         out.specular[1] = s[1];
+         out.specular[2] = s[2];
+      }
+
+      if (lit)
+      {
+         // in world space.. the same as D3D's camera space for anything that isn't squashed
+         const D3DMATERIAL9 & m = material();
+         float pos[3], n[3] = { 0.0f, 0.0f, 0.0f }, d[3] = { 0.0f, 0.0f, 0.0f }, a[3], s[3] = { 0.0f, 0.0f, 0.0f };
+         const float * dm = diffuseAt ? out.diffuse : &m.Diffuse.r;   // the vertex colour if it has one
+         float alpha = dm[3];
+
+         for (j = 0; j < 3; j++)
+            pos[j] = p[0] * w.m[0][j] + p[1] * w.m[1][j] + p[2] * w.m[2][j] + w.m[3][j];
+         if (normalAt)
+         {
+            const float * q = (const float *) (src + normalAt);
+            for (j = 0; j < 3; j++)
+               n[j] = q[0] * w.m[0][j] + q[1] * w.m[1][j] + q[2] * w.m[2][j];
+            float len = sqrtf(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+            if (len > 0.0f)
+               for (j = 0; j < 3; j++)
+                  n[j] /= len;
+         }
+         a[0] = ambient[0];
+         a[1] = ambient[1];
+         a[2] = ambient[2];
+
+         for (int l = 0; l < lightCount; l++)
+         {
+            const D3DLIGHT9 & L = *lights[l];
+            float dir[3], atten = 1.0f, dist;
+
+            if (L.Type == D3DLIGHT_DIRECTIONAL)
+            {
+               dir[0] = -L.Direction.x;
+               dir[1] = -L.Direction.y;
+               dir[2] = -L.Direction.z;
+               dist = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+            }
+            else
+            {
+               dir[0] = L.Position.x - pos[0];
+               dir[1] = L.Position.y - pos[1];
+               dir[2] = L.Position.z - pos[2];
+               dist = sqrtf(dir[0] * dir[0] + dir[1] * dir[1] + dir[2] * dir[2]);
+               if (dist > L.Range)
+                  continue;
+               atten = L.Attenuation0 + L.Attenuation1 * dist + L.Attenuation2 * dist * dist;
+               atten = atten > 0.0f ? 1.0f / atten : 1.0f;
+            }
+            if (dist > 0.0f)
+               for (j = 0; j < 3; j++)
+                  dir[j] /= dist;
+
+            if (L.Type == D3DLIGHT_SPOT)
+            {
+               float len = sqrtf(L.Direction.x * L.Direction.x + L.Direction.y * L.Direction.y +
+                                 L.Direction.z * L.Direction.z);
+               float rho = len > 0.0f ? -(dir[0] * L.Direction.x + dir[1] * L.Direction.y +
+                                          dir[2] * L.Direction.z) / len : 1.0f;
+               float inner = cosf(L.Theta * 0.5f), outer = cosf(L.Phi * 0.5f);
+               if (rho <= outer)
+                  continue;
+               if (rho < inner)
+                  atten *= powf((rho - outer) / (inner - outer), L.Falloff);
+            }
+
+            for (j = 0; j < 3; j++)
+               a[j] += (&L.Ambient.r)[j] * atten;
+            float nDotL = n[0] * dir[0] + n[1] * dir[1] + n[2] * dir[2];
+            if (nDotL <= 0.0f)
+               continue;
+            for (j = 0; j < 3; j++)
+               d[j] += (&L.Diffuse.r)[j] * nDotL * atten;
+            if (specular && m.Power > 0.0f)
+            {
+               float h[3], len;
+               for (j = 0; j < 3; j++)
+                  h[j] = camera[j] - pos[j];
+               len = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+               for (j = 0; j < 3; j++)
+                  h[j] = dir[j] + (len > 0.0f ? h[j] / len : 0.0f);
+               len = sqrtf(h[0] * h[0] + h[1] * h[1] + h[2] * h[2]);
+               float nDotH = len > 0.0f ? (n[0] * h[0] + n[1] * h[1] + n[2] * h[2]) / len : 0.0f;
+               if (nDotH > 0.0f)
+                  for (j = 0; j < 3; j++)
+                     s[j] += (&L.Specular.r)[j] * powf(nDotH, m.Power) * atten;
+            }
+         }
+
+         for (j = 0; j < 3; j++)
+         {
+            out.diffuse[j] = clamp01((&m.Emissive.r)[j] + (&m.Ambient.r)[j] * a[j] + dm[j] * d[j]);
+            out.specular[j] = clamp01((&m.Specular.r)[j] * s[j]);
+         }
+         out.diffuse[3] = clamp01(alpha);
+      }
+
+      for (stage = 0; stage < STAGES_USED; stage++)
+      {
+         UINT set = stageState(stage, D3DTSS_TEXCOORDINDEX) & 0xFFFF;
+         if (set < texSets)
+         {
+            const float * uv = (const float *) (src + texAt + set * 8);
+            out.uv[stage][0] = uv[0];
+            out.uv[stage][1] = uv[1];
+         }
+         else
+            out.uv[stage][0] = out.uv[stage][1] = 0.0f;
+      }
+   }
+   return true;
+}
+
+
+HRESULT SoftDevice::DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count)
+{
+   HRESULT hr = NullDevice::DrawPrimitive(type, startVertex, count);
+   UINT vertices, i;
+
+   if (FAILED(hr) || (fvf() & (D3DFVF_XYZ | D3DFVF_XYZRHW)) == 0)
+      return hr;
+   vertices = type == D3DPT_POINTLIST ? count : type == D3DPT_LINELIST ? count * 2 : type == D3DPT_LINESTRIP ?
+              count + 1 : type == D3DPT_TRIANGLELIST ? count * 3 : count + 2;
+   if (!transformVertices(startVertex, vertices))
+      return hr;
+   m_indices.resize(vertices);
+   for (i = 0; i < vertices; i++)
+      m_indices[i] = i;
+   m_state = captureState();
+   drawPrimitives(type, &m_indices[0], count);
+   return hr;
+}
+
+
+HRESULT SoftDevice::DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                         UINT numVertices, UINT startIndex, UINT count)
+{
+   HRESULT hr = NullDevice::DrawIndexedPrimitive(type, baseVertex, minIndex, numVertices, startIndex, count);
+   UINT n, i, index;
+
+   if (FAILED(hr) || (fvf() & (D3DFVF_XYZ | D3DFVF_XYZRHW)) == 0)
+      return hr;
+   n = type == D3DPT_POINTLIST ? count : type == D3DPT_LINELIST ? count * 2 : type == D3DPT_LINESTRIP ?
+       count + 1 : type == D3DPT_TRIANGLELIST ? count * 3 : count + 2;
+   if (!transformVertices(baseVertex + minIndex, numVertices))
+      return hr;
+
+   // into m_vertices.. one outside the range the draw gave is left out, with what it is part of
+   const unsigned char * src = indices()->data();
+   bool wide = indices()->format() == D3DFMT_INDEX32;
+   m_indices.resize(n);
+   for (i = 0; i < n; i++)
+   {
+      index = wide ? ((const unsigned int *) src)[startIndex + i] : ((const unsigned short *) src)[startIndex + i];
+      m_indices[i] = index >= minIndex && index - minIndex < numVertices ? index - minIndex : 0xFFFFFFFF;
+   }
+   m_state = captureState();
+   drawPrimitives(type, &m_indices[0], count);
+   return hr;
+}
+
+
+void SoftDevice::drawPrimitives(D3DPRIMITIVETYPE type, const unsigned int * index, UINT count)
+{
+   const Vertex * v = &m_vertices[0];
+   DWORD cullMode = renderState(D3DRS_CULLMODE);
+   UINT i;
+
+   for (i = 0; i < count; i++)
+   {
+      unsigned int a, b, c;
+      switch (type)
+      {
+      case D3DPT_POINTLIST:
+         if ((a = index[i]) != 0xFFFFFFFF)
+            drawPoint(a);
+         continue;
+      case D3DPT_LINELIST:
+         a = index[i * 2];
+         b = index[i * 2 + 1];
+         if (a != 0xFFFFFFFF && b != 0xFFFFFFFF)
+            drawLine(v[a], v[b]);
+         continue;
+      case D3DPT_LINESTRIP:
+         a = index[i];
+         b = index[i + 1];
+         if (a != 0xFFFFFFFF && b != 0xFFFFFFFF)
+            drawLine(v[a], v[b]);
+         continue;
+      case D3DPT_TRIANGLELIST:
+         a = index[i * 3];
+         b = index[i * 3 + 1];
+         c = index[i * 3 + 2];
+         break;
+      case D3DPT_TRIANGLESTRIP:   // every other one is wound the other way
+         a = index[i];
+         b = index[i + 1 + (i & 1)];
+         c = index[i + 2 - (i & 1)];
+         break;
+      default:   // D3DPT_TRIANGLEFAN
+         a = index[0];
+         b = index[i + 1];
+         c = index[i + 2];
+         break;
+      }
+      if (a == 0xFFFFFFFF || b == 0xFFFFFFFF || c == 0xFFFFFFFF)
+         continue;
+      // CW culling means the clockwise ones go, so they are drawn the other way round
+      if (cullMode == D3DCULL_CW)
+         drawTriangle(a, c, b, true);
+      else
+         drawTriangle(a, b, c, cullMode == D3DCULL_CCW);
+   }
+}
+
+
+//*******
+// clipping
+
+static const int CLIP_PLANES = 6;
+
+// how far inside each plane a vertex is, negative if outside: near, far,
+// and the guard band left, right, bottom, top
+static float planeDistance(const SoftDevice::Vertex & v, int plane, float gx, float gy)
+{
+   switch (plane)
+   {
+   case 0:  return v.z;
+   case 1:  return v.w - v.z;
+   case 2:  return v.x + gx * v.w;
+   case 3:  return gx * v.w - v.x;
+   case 4:  return v.y + gy * v.w;
+   default: return gy * v.w - v.y;
+   }
+}
+
+
+static unsigned int outCode(const SoftDevice::Vertex & v, float gx, float gy)
+{
+   unsigned int code = 0;
+   for (int p = 0; p < CLIP_PLANES; p++)
+      if (planeDistance(v, p, gx, gy) < 0.0f)
+         code |= 1 << p;
+   return code;
+}
+
+
+static SoftDevice::Vertex lerp(const SoftDevice::Vertex & a, const SoftDevice::Vertex & b, float t)
+{
+   SoftDevice::Vertex v;
+   int i;
+
+   v.x = a.x + (b.x - a.x) * t;
+   v.y = a.y + (b.y - a.y) * t;
+   v.z = a.z + (b.z - a.z) * t;
+   v.w = a.w + (b.w - a.w) * t;
+   for (i = 0; i < 4; i++)
+      v.diffuse[i] = a.diffuse[i] + (b.diffuse[i] - a.diffuse[i]) * t;
+   for (i = 0; i < 3; i++)
+      v.specular[i] = a.specular[i] + (b.specular[i] - a.specular[i]) * t;
+   for (i = 0; i < SoftDevice::STAGES_USED; i++)
+   {
+      v.uv[i][0] = a.uv[i][0] + (b.uv[i][0] - a.uv[i][0]) * t;
+      v.uv[i][1] = a.uv[i][1] + (b.uv[i][1] - a.uv[i][1]) * t;
+   }
+   return v;
+}
+
+
+// m_vertices ia, ib and ic
+void SoftDevice::drawTriangle(unsigned int ia, unsigned int ib, unsigned int ic, bool cull)
+{
+   float gx = 2.0f * GUARD_BAND / m_width - 1.0f, gy = 2.0f * GUARD_BAND / m_height - 1.0f;
+   unsigned int ca = m_clipCodes[ia], cb = m_clipCodes[ib], cc = m_clipCodes[ic];
+   const Vertex & a = m_vertices[ia], & b = m_vertices[ib], & c = m_vertices[ic];
+   Vertex poly[2][3 + CLIP_PLANES];
+   const Vertex * v[3];
+   float sx[3], sy[3];
+   int n = 3, in = 0, p, i;
+
+   if (ca & cb & cc)   // all outside one plane
+      return;
+
+   // inside all of them, as most are: nothing to clip, and the screen positions are made
+   if ((ca | cb | cc) == 0)
+   {
+      const float * screenY = &m_screen[m_vertices.size()];
+      if (a.w <= 0.0f || b.w <= 0.0f || c.w <= 0.0f)
+         return;
+      v[0] = &a;
+      v[1] = &b;
+      v[2] = &c;
+      sx[0] = m_screen[ia];
+      sx[1] = m_screen[ib];
+      sx[2] = m_screen[ic];
+      sy[0] = screenY[ia];
+      sy[1] = screenY[ib];
+      sy[2] = screenY[ic];
+      setupTriangle(v, sx, sy, cull);
+      return;
+   }
+
+   poly[0][0] = a;
+   poly[0][1] = b;
+   poly[0][2] = c;
+   for (p = 0; p < CLIP_PLANES && ((ca | cb | cc) >> p); p++)
+   {
+      if (((ca | cb | cc) & (1 << p)) == 0)
+         continue;
+      // Sutherland-Hodgman, one plane at a time
+      const Vertex * src = poly[in];
+      Vertex * dst = poly[in ^ 1];
+      int out = 0;
+      for (i = 0; i < n; i++)
+      {
+         const Vertex & s = src[i], & e = src[(i + 1) % n];
+         float ds = planeDistance(s, p, gx, gy), de = planeDistance(e, p, gx, gy);
+         if (ds >= 0.0f)
+            dst[out++] = s;
+         if ((ds >= 0.0f) != (de >= 0.0f))
+            dst[out++] = lerp(s, e, ds / (ds - de));
+      }
+      n = out;
+      in ^= 1;
+      if (n < 3)
+         return;
+   }
+
+   // fan out from the first vertex
+   for (i = 0; i < n; i++)
+      if (poly[in][i].w <= 0.0f)
+         return;
+   v[0] = &poly[in][0];
+   sx[0] = (v[0]->x / v[0]->w + 1.0f) * 0.5f * m_width;
+   sy[0] = (1.0f - v[0]->y / v[0]->w) * 0.5f * m_height;
+   for (i = 1; i + 1 < n; i++)
+   {
+      for (p = 1; p < 3; p++)
+      {
+         v[p] = &poly[in][i + p - 1];
+         sx[p] = (v[p]->x / v[p]->w + 1.0f) * 0.5f * m_width;
+         sy[p] = (1.0f - v[p]->y / v[p]->w) * 0.5f * m_height;
+      }
+      setupTriangle(v, sx, sy, cull);
+   }
+}
+
+
+// a quad a pixel wide, across whichever way the line is steeper
+void SoftDevice::drawLine(const Vertex & a, const Vertex & b)
+{
+   float gx = 2.0f * GUARD_BAND / m_width - 1.0f, gy = 2.0f * GUARD_BAND / m_height - 1.0f;
+   float t0 = 0.0f, t1 = 1.0f, sx[2], sy[2], dx, dy;
+   Vertex e[2];
+   int p, i;
+
+   for (p = 0; p < CLIP_PLANES; p++)
+   {
+      float da = planeDistance(a, p, gx, gy), db = planeDistance(b, p, gx, gy);
+      if (da < 0.0f && db < 0.0f)
+         return;
+      if (da < 0.0f)
+         t0 = std::max(t0, da / (da - db));
+      else if (db < 0.0f)
+         t1 = std::min(t1, da / (da - db));
+   }
+   if (t0 >= t1)
+      return;
+   e[0] = t0 > 0.0f ? lerp(a, b, t0) : a;
+   e[1] = t1 < 1.0f ? lerp(a, b, t1) : b;
+   for (i = 0; i < 2; i++)
+   {
+      if (e[i].w <= 0.0f)
+         return;
+      sx[i] = (e[i].x / e[i].w + 1.0f) * 0.5f * m_width;
+      sy[i] = (1.0f - e[i].y / e[i].w) * 0.5f * m_height;
+   }
+   dx = fabsf(sx[1] - sx[0]) >= fabsf(sy[1] - sy[0]) ? 0.0f : 0.5f;
+   dy = 0.5f - dx;
+
+   const Vertex * v1[3] = { &e[0], &e[0], &e[1] }, * v2[3] = { &e[1], &e[1], &e[0] };
+   float x1[3] = { sx[0] - dx, sx[0] + dx, sx[1] + dx }, y1[3] = { sy[0] - dy, sy[0] + dy, sy[1] + dy };
+   float x2[3] = { sx[1] + dx, sx[1] - dx, sx[0] - dx }, y2[3] = { sy[1] + dy, sy[1] - dy, sy[0] - dy };
+   setupTriangle(v1, x1, y1, false);
+   setupTriangle(v2, x2, y2, false);
+}
+
+
+void SoftDevice::drawPoint(unsigned int index)
+{
+   const Vertex & a = m_vertices[index];
+
+   if (m_clipCodes[index] || a.w <= 0.0f)
+      return;
+   float x = m_screen[index], y = m_screen[m_vertices.size() + index];
+   const Vertex * v[3] = { &a, &a, &a };
+   float x1[3] = { x - 0.5f, x + 0.5f, x + 0.5f }, y1[3] = { y - 0.5f, y - 0.5f, y + 0.5f };
+   float x2[3] = { x - 0.5f, x + 0.5f, x - 0.5f }, y2[3] = { y - 0.5f, y + 0.5f, y + 0.5f };
+   setupTriangle(v, x1, y1, false);
+   setupTriangle(v, x2, y2, false);
+}
+
+
+//*******
+// setup
+
+void SoftDevice::setupTriangle(const Vertex * v[3], const float sx[3], const float sy[3], bool cull)
+{
+   Triangle t;
+   float f[ATTRIBUTES][3], px[3], py[3], det, dx1, dy1, dx2, dy2;
+   long long area;
+   int i, k;
+
+   for (i = 0; i < 3; i++)
+   {
+      t.x[i] = (int) lrintf(sx[i] * 16.0f);
+      t.y[i] = (int) lrintf(sy[i] * 16.0f);
+   }
+   area = (long long) (t.x[1] - t.x[0]) * (t.y[2] - t.y[0]) - (long long) (t.x[2] - t.x[0]) * (t.y[1] - t.y[0]);
+   if (area == 0 || (cull && area < 0))   // y is down, so clockwise on the screen is positive
+      return;
+   if (area < 0)
+   {
+      std::swap(t.x[1], t.x[2]);
+      std::swap(t.y[1], t.y[2]);
+      std::swap(v[1], v[2]);
+   }
+
+   // the pixels whose centres can be inside
+   t.minX = std::max((std::min(std::min(t.x[0], t.x[1]), t.x[2]) + 15) >> 4, 0);
+   t.minY = std::max((std::min(std::min(t.y[0], t.y[1]), t.y[2]) + 15) >> 4, 0);
+   t.maxX = std::min(std::max(std::max(t.x[0], t.x[1]), t.x[2]) >> 4, (int) m_width - 1);
+   t.maxY = std::min(std::max(std::max(t.y[0], t.y[1]), t.y[2]) >> 4, (int) m_height - 1);
+   if (t.minX > t.maxX || t.minY > t.maxY)
+      return;
+
+   // the attributes as planes over the screen.. all but z over w, so they
+   // come out right in perspective
+   for (i = 0; i < 3; i++)
+   {
+      float rw = 1.0f / v[i]->w;
+      px[i] = t.x[i] / 16.0f;
+      py[i] = t.y[i] / 16.0f;
+      f[0][i] = v[i]->z * rw;
+      f[1][i] = rw;
+      for (k = 0; k < 4; k++)
+         f[2 + k][i] = v[i]->diffuse[k] * rw;
+      for (k = 0; k < 3; k++)
+         f[6 + k][i] = v[i]->specular[k] * rw;
+      for (k = 0; k < STAGES_USED; k++)
+      {
+         f[9 + k * 2][i] = v[i]->uv[k][0] * rw;
+         f[10 + k * 2][i] = v[i]->uv[k][1] * rw;
+      }
+   }
+   dx1 = px[1] - px[0];
+   dy1 = py[1] - py[0];
+   dx2 = px[2] - px[0];
+   dy2 = py[2] - py[0];
+   det = dx1 * dy2 - dx2 * dy1;
+   for (k = 0; k < ATTRIBUTES; k++)
+   {
+      float d1 = f[k][1] - f[k][0], d2 = f[k][2] - f[k][0];
+      t.plane[k][0] = (d1 * dy2 - d2 * dy1) / det;
+      t.plane[k][1] = (d2 * dx1 - d1 * dx2) / det;
+      t.plane[k][2] = f[k][0] - t.plane[k][0] * px[0] - t.plane[k][1] * py[0];
+   }
+
+   t.state = m_state;
+   m_triangles.push_back(t);
+   bin((unsigned int) m_triangles.size() - 1, t.minX, t.minY, t.maxX, t.maxY);
+   m_frameTriangles++;
+   if (m_triangles.size() >= MAX_TRIANGLES)
+      flush(true);
+}
+
+
+//*******
+// rendering the bins
+
+void SoftDevice::flush(bool midDraw)
+{
+   size_t i;
+
+   if (!m_triangles.empty() || !m_clears.empty())
+      renderTiles();
+   for (i = 0; i < m_bins.size(); i++)
+      m_bins[i].clear();
+   m_triangles.clear();
+   m_clears.clear();
+
+   // the draw being made keeps its state, the rest are done with
+   if (midDraw && !m_states.empty())
+   {
+      DrawState keep = m_states[m_state];
+      m_states.clear();
+      m_states.push_back(keep);
+   }
+   else
+      m_states.clear();
+   m_state = 0;
+}
+
+
+void SoftDevice::renderTiles()
+{
+   unsigned int tile;
+
+   {
+      std::lock_guard<std::mutex> lock(m_lock);
+      m_nextTile = 0;
+      m_busy = (unsigned int) m_workers.size();
+      m_generation++;
+   }
+   m_wake.notify_all();
+   for (;;)
+   {
+      {
+         std::lock_guard<std::mutex> lock(m_lock);
+         tile = m_nextTile++;
+      }
+      if (tile >= m_bins.size())
+         break;
+      renderTile(tile);
+   }
+   std::unique_lock<std::mutex> lock(m_lock);
+   while (m_busy)
+      m_done.wait(lock);
+}
+
+
+void SoftDevice::workerLoop()
+{
+   unsigned int seen = 0, tile;
+
+   for (;;)
+   {
+      {
+         std::unique_lock<std::mutex> lock(m_lock);
+         while (!m_quit && m_generation == seen)
+            m_wake.wait(lock);
+         if (m_quit)
+            return;
+         seen = m_generation;
+      }
+      for (;;)
+      {
+         {
+            std::lock_guard<std::mutex> lock(m_lock);
+            tile = m_nextTile++;
+         }
+         if (tile >= m_bins.size())
+            break;
+         renderTile(tile);
+      }
+      {
+         std::lock_guard<std::mutex> lock(m_lock);
+         m_busy--;
+      }
+      m_done.notify_one();
+   }
+}
+
+
+void SoftDevice::renderTile(unsigned int tile)
+{
+   const std::vector<unsigned int> & commands = m_bins[tile];
+   int tx = (tile % m_tilesX) * TILE, ty = (tile / m_tilesX) * TILE;
+   int tx2 = std::min(tx + TILE, (int) m_width) - 1, ty2 = std::min(ty + TILE, (int) m_height) - 1;
+   unsigned int * color = &m_color[(size_t) tile * TILE * TILE], * depth = &m_depth[(size_t) tile * TILE * TILE];
+   size_t i;
+   int x, y;
+
+   for (i = 0; i < commands.size(); i++)
+   {
+      if (commands[i] & CLEAR_BIT)
+      {
+         const ClearCommand & c = m_clears[commands[i] & ~CLEAR_BIT];
+         int x1 = std::max(c.x1, tx), y1 = std::max(c.y1, ty);
+         int x2 = std::min(c.x2 - 1, tx2), y2 = std::min(c.y2 - 1, ty2);
+         for (y = y1 - ty; y <= y2 - ty; y++)
+         {
+            if (c.flags & D3DCLEAR_TARGET)
+               std::fill(color + y * TILE + x1 - tx, color + y * TILE + x2 - tx + 1, c.color);
+            if (c.flags & D3DCLEAR_ZBUFFER)
+               std::fill(depth + y * TILE + x1 - tx, depth + y * TILE + x2 - tx + 1, c.z);
+         }
+         continue;
+      }
+      const Triangle & t = m_triangles[commands[i]];
+      x = std::max(t.minX, tx);
+      y = std::max(t.minY, ty);
+      if (x <= std::min(t.maxX, tx2) && y <= std::min(t.maxY, ty2))
+         rasterize(t, tx, ty, x, y, std::min(t.maxX, tx2), std::min(t.maxY, ty2));
+   }
+}
+
+
+// the pixels of x0,y0 to x1,y1 (all in tile tx,ty) whose centres are inside
+// t.. the spans start a multiple of 8 pixels into the tile, lined up for the merger
+void SoftDevice::rasterize(const Triangle & t, int tx, int ty, int x0, int y0, int x1, int y1)
+{
+   const DrawState & s = m_states[t.state];
+   unsigned int * color = &m_color[(size_t) (ty / TILE * m_tilesX + tx / TILE) * TILE * TILE];
+   unsigned int * depth = &m_depth[(size_t) (ty / TILE * m_tilesX + tx / TILE) * TILE * TILE];
+   int rowStart[3], stepX[3], stepY[3], edges = 0, k, x, y, xs = tx + ((x0 - tx) & ~(SPAN - 1));
+
+   for (k = 0; k < 3; k++)
+   {
+      int n = (k + 1) % 3;
+      long long a = t.y[k] - t.y[n], b = t.x[n] - t.x[k];
+      long long c = -(a * t.x[k] + b * t.y[k]);
+      if (!(a > 0 || (a == 0 && b > 0)))   // top-left rule: a pixel right on any other edge isn't drawn
+         c--;
+      long long e = a * 16 * x0 + b * 16 * y0 + c;
+      long long lo = e + std::min(0LL, a * 16 * (x1 - x0)) + std::min(0LL, b * 16 * (y1 - y0));
+      long long hi = e + std::max(0LL, a * 16 * (x1 - x0)) + std::max(0LL, b * 16 * (y1 - y0));
+      if (hi < 0)
+         return;   // all of it is outside this edge
+      if (lo >= 0)
+         continue;   // all inside, no need to test
+      // it crosses the block, so e and its steps are small.. rows start at xs
+      rowStart[edges] = (int) (e - a * 16 * (x0 - xs));
+      stepX[edges] = (int) (a * 16);
+      stepY[edges] = (int) (b * 16);
+      edges++;
+   }
+
+#ifdef SOFT_SSE
+   // each edge at a span of pixels side by side, as two sets of 4, and
+   // the step to the next span
+   __m128i lanes[3][2], stepSpan[3], e[3][2];
+   for (k = 0; k < edges; k++)
+   {
+      lanes[k][0] = _mm_set_epi32(stepX[k] * 3, stepX[k] * 2, stepX[k], 0);
+      lanes[k][1] = _mm_add_epi32(lanes[k][0], _mm_set1_epi32(stepX[k] * 4));
+      stepSpan[k] = _mm_set1_epi32(stepX[k] * SPAN);
+   }
+#endif
+
+   for (y = y0; y <= y1; y++)
+   {
+#ifdef SOFT_SSE
+      for (k = 0; k < edges; k++)
+      {
+         e[k][0] = _mm_add_epi32(_mm_set1_epi32(rowStart[k]), lanes[k][0]);
+         e[k][1] = _mm_add_epi32(_mm_set1_epi32(rowStart[k]), lanes[k][1]);
+      }
+#endif
+      for (x = xs; x <= x1; x += SPAN)
+      {
+         unsigned int mask = x1 - x >= SPAN - 1 ? (1u << SPAN) - 1 : (1u << (x1 - x + 1)) - 1;
+         if (x < x0)
+            mask &= ~((1u << (x0 - x)) - 1);
+#ifdef SOFT_SSE
+         // a pixel is out if any edge is negative there.. the sign bits, or-ed
+         __m128i outside[2] = { _mm_setzero_si128(), _mm_setzero_si128() };
+         for (k = 0; k < edges; k++)
+         {
+            outside[0] = _mm_or_si128(outside[0], e[k][0]);
+            outside[1] = _mm_or_si128(outside[1], e[k][1]);
+            e[k][0] = _mm_add_epi32(e[k][0], stepSpan[k]);
+            e[k][1] = _mm_add_epi32(e[k][1], stepSpan[k]);
+         }
+         mask &= ~(unsigned int) (_mm_movemask_ps(_mm_castsi128_ps(outside[0])) |
+                                  _mm_movemask_ps(_mm_castsi128_ps(outside[1])) << 4);
+#else
+         for (int i = 0; i < SPAN; i++)
+            for (k = 0; k < edges; k++)
+               if (rowStart[k] + stepX[k] * (x - xs + i) < 0)
+                  mask &= ~(1u << i);
+#endif
+         if (mask)
+            shadeSpan(t, s, x, y, color + (y - ty) * TILE + x - tx, depth + (y - ty) * TILE + x - tx, mask);
+      }
+      for (k = 0; k < edges; k++)
+         rowStart[k] += stepY[k];
+   }
+}
+
+
+//*******
+// shading
+
+static void stageArg(DWORD arg, const float * diffuse, const float * current, const float * texel,
+                     const float * factor, const float * specular, float * out)
+{
+   const float * src;
+   int i;
+
+   switch (arg & D3DTA_SELECTMASK)
+   {
+   case D3DTA_DIFFUSE:   src = diffuse;  break;
+   case D3DTA_TEXTURE:   src = texel;    break;
+   case D3DTA_TFACTOR:   src = factor;   break;
+   case D3DTA_SPECULAR:  src = specular; break;
+   default:              src = current;  break;
+   }
+   for (i = 0; i < 4; i++)
+      out[i] = arg & D3DTA_ALPHAREPLICATE ? src[3] : src[i];
+   if (arg & D3DTA_COMPLEMENT)
+      for (i = 0; i < 4; i++)
+         out[i] = 1.0f - out[i];
+}
+
+
+// one D3DTOP on channels from to to of a and b
+static void stageOp(DWORD op, const float * a, const float * b, float diffuseAlpha, float textureAlpha,
+                    int from, int to, float * out)
+{
+   for (int i = from; i < to; i++)
+   {
+      float r;
+      switch (op)
+      {
+      case D3DTOP_SELECTARG1:        r = a[i];                      break;
+      case D3DTOP_SELECTARG2:        r = b[i];                      break;
+      case D3DTOP_MODULATE2X:        r = a[i] * b[i] * 2.0f;        break;
+      case D3DTOP_MODULATE4X:        r = a[i] * b[i] * 4.0f;        break;
+      case D3DTOP_ADD:               r = a[i] + b[i];               break;
+      case D3DTOP_ADDSIGNED:         r = a[i] + b[i] - 0.5f;        break;
+      case D3DTOP_ADDSIGNED2X:       r = (a[i] + b[i] - 0.5f) * 2.0f;   break;
+      case D3DTOP_SUBTRACT:          r = a[i] - b[i];               break;
+      case D3DTOP_ADDSMOOTH:         r = a[i] + b[i] - a[i] * b[i]; break;
+      case D3DTOP_BLENDDIFFUSEALPHA: r = a[i] * diffuseAlpha + b[i] * (1.0f - diffuseAlpha);   break;
+      case D3DTOP_BLENDTEXTUREALPHA: r = a[i] * textureAlpha + b[i] * (1.0f - textureAlpha);   break;
+      default:                       r = a[i] * b[i];               break;   // D3DTOP_MODULATE
+      }
+      out[i] = clamp01(r);
+   }
+}
+
+
+// the pixels of mask from x along row y
+void SoftDevice::shadeSpan(const Triangle & t, const DrawState & s, int x, int y, unsigned int * color,
+                           unsigned int * depth, unsigned int mask)
+{
+   float a[ATTRIBUTES][SPAN], texels[STAGES_USED][4][SPAN], factor[4], out[4][SPAN];
+   unsigned int z[SPAN];
+   int i, k, stage, stages;
+
+   // depth first, so a span that is all hidden goes no further
+   for (i = 0; i < SPAN; i++)
+      z[i] = depthValue(t.plane[0][0] * (x + i) + t.plane[0][1] * y + t.plane[0][2], m_depthBits);
+   mask = depthTest(s.merge, z, depth, mask);
+   if (mask == 0)
+      return;
+
+   // the rest over 1/w for all of the span, even the pixels left out, for the sampler
+   for (i = 0; i < SPAN; i++)
+   {
+      float w = 1.0f / (t.plane[1][0] * (x + i) + t.plane[1][1] * y + t.plane[1][2]);
+      for (k = 2; k < ATTRIBUTES; k++)
+         a[k][i] = (t.plane[k][0] * (x + i) + t.plane[k][1] * y + t.plane[k][2]) * w;
+   }
+
+   // the textures, the whole span at once, with the gradients at its middle
+   for (stages = 0; stages < STAGES_USED && s.colorOp[stages] != D3DTOP_DISABLE; stages++)
+   {
+      if (s.textures[stages] == NULL)
+         continue;
+      const float * pu = t.plane[9 + stages * 2], * pv = t.plane[10 + stages * 2], * pw = t.plane[1];
+      float cx = x + (SPAN - 1) * 0.5f, w = 1.0f / (pw[0] * cx + pw[1] * y + pw[2]);
+      float u = (pu[0] * cx + pu[1] * y + pu[2]) * w, v = (pv[0] * cx + pv[1] * y + pv[2]) * w;
+      SampleGradients g;
+      g.dudx = (pu[0] - u * pw[0]) * w;
+      g.dvdx = (pv[0] - v * pw[0]) * w;
+      g.dudy = (pu[1] - u * pw[1]) * w;
+      g.dvdy = (pv[1] - v * pw[1]) * w;
+      sampleTexture(*s.textures[stages], s.samplers[stages], a[9 + stages * 2], a[10 + stages * 2], g,
+                    texels[stages]);
+   }
+
+   unpackColor(s.textureFactor, factor);
+   for (i = 0; i < SPAN; i++)
+   {
+      if ((mask & (1 << i)) == 0)
+      {
+         for (k = 0; k < 4; k++)
+            out[k][i] = 0.0f;
+         continue;
+      }
+
+      // the texture stages.. a stage with no texture reads white, as cards do
+      float diffuse[4], specular[4], current[4], texel[4], arg1[4], arg2[4];
+      for (k = 0; k < 4; k++)
+         diffuse[k] = current[k] = clamp01(a[2 + k][i]);
+      for (k = 0; k < 3; k++)
+         specular[k] = clamp01(a[6 + k][i]);
+      specular[3] = 1.0f;
+      for (stage = 0; stage < stages; stage++)
+      {
+         float result[4];
+         for (k = 0; k < 4; k++)
+            texel[k] = s.textures[stage] ? texels[stage][k][i] : 1.0f;
+         stageArg(s.colorArg1[stage], diffuse, current, texel, factor, specular, arg1);
+         stageArg(s.colorArg2[stage], diffuse, current, texel, factor, specular, arg2);
+         stageOp(s.colorOp[stage], arg1, arg2, diffuse[3], texel[3], 0, 3, result);
+         if (s.alphaOp[stage] == D3DTOP_DISABLE)
+            result[3] = current[3];
+         else
+         {
+            stageArg(s.alphaArg1[stage], diffuse, current, texel, factor, specular, arg1);
+            stageArg(s.alphaArg2[stage], diffuse, current, texel, factor, specular, arg2);
+            stageOp(s.alphaOp[stage], arg1, arg2, diffuse[3], texel[3], 3, 4, result);
+         }
+         for (k = 0; k < 4; k++)
+            current[k] = result[k];
+      }
+      if (s.specular)
+         for (k = 0; k < 3; k++)
+            current[k] = clamp01(current[k] + specular[k]);
+
+      for (k = 0; k < 4; k++)
+         out[k][i] = current[k];
+   }
+   mergeSpan(s.merge, out, z, color, depth, mask);
+}
+
+
+bool SoftDevice::writeBmp(const char * filename) const
+{
+   FILE * f = fopen(filename, "wb");
+   UINT rowBytes = (m_width * 3 + 3) & ~3u, size = 54 + rowBytes * m_height, x, y;
+   unsigned char header[54] = { 'B', 'M' };
+   std::vector<unsigned char> row(rowBytes, 0);
+   bool ok;
+
+   if (f == NULL)
+      return false;
+   // little endian words into the header
+   UINT fields[][2] = { { 2, size }, { 10, 54 }, { 14, 40 }, { 18, m_width }, { 22, m_height }, { 34, rowBytes * m_height } };
+   for (x = 0; x < sizeof(fields) / sizeof(fields[0]); x++)
+      for (y = 0; y < 4; y++)
+         header[fields[x][0] + y] = (unsigned char) (fields[x][1] >> (y * 8));
+   header[26] = 1;    // planes
+   header[28] = 24;   // bits a pixel
+   fwrite(header, 1, sizeof(header), f);
+   for (y = m_height; y-- > 0;)   // bottom row first
+   {
+      const unsigned int * src = &m_front[(size_t) y * m_width];
+      for (x = 0; x < m_width; x++)
+      {
+         row[x * 3] = (unsigned char) src[x];
+         row[x * 3 + 1] = (unsigned char) (src[x] >> 8);
+         row[x * 3 + 2] = (unsigned char) (src[x] >> 16);
+      }
+      fwrite(&row[0], 1, rowBytes, f);
+   }
+   ok = ferror(f) == 0;
+   return fclose(f) == 0 && ok;
+}
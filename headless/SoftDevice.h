@@ -0,0 +1,196 @@
+/* Filename:  SoftDevice.h
+
+   This file is used by the headless builds.  See d3d9.h.
+
+   A NullDevice that draws.  The part of the fixed function pipeline the
+   examples use, on the CPU: vertices with a position, a normal, a diffuse
+   colour and one or two sets of texture coordinates, through the world,
+   view and projection matrices and up to 8 lights; point, line and
+   triangle lists, strips and fans; a 16 or 24 bit depth buffer; two
+   texture stages with the D3DTOP ops in d3d9.h; alpha test and blending.
+   What it
+   draws goes into a 32 bit back buffer that can be read or saved as a
+   bitmap, so a capture (DeviceCapture.h) can be played back and looked at
+   on a machine with no Direct3D at all.
+
+   The positions of a draw's vertices go through the world, view and
+   projection together, 8 at a time with VertexTransform.h, which gives
+   each one a clip code and its place on the screen; a draw whose
+   vertices are all outside one plane is dropped there, and a triangle
+   with all three inside, as most are, goes straight on to setup.
+
+   Draws don't render when they are made.  Each triangle is clipped (to
+   the near and far planes, and to a guard band well outside the screen
+   for the rest), set up and put in a bin for every 64x64 tile of the
+   screen it touches.  Present() renders the bins, the tiles shared out
+   between threads, each tile drawing its triangles in the order they were
+   made.  A tile is rasterized with edge functions in fixed point, 1/16 of
+   a pixel, 4 pixels at a time with SSE2: an edge that misses the tile
+   throws the triangle out of it, one the tile is wholly inside of isn't
+   tested at all.  Pixel centres are at whole numbers and the fill rule is
+   top-left, as D3D9's are.
+
+   Lines are drawn as quads a pixel wide and points as a pixel, through
+   the same setup.  Pixels are shaded 8 at a time, along a row, and
+   textures sampled with TexSampler.h, so with the filters and address
+   modes the sampler states ask for.  The depth test, alpha test and
+   blending are OutputMerger.h's, the same 8 at a time.  Not done: fog,
+   texture transforms, stencil, shaders.
+
+   The back buffer and depth buffer are kept a tile at a time, a tile's
+   pixels all together, so a thread rendering one works in 32K of its own
+   and the spans never straddle a row end.  Present() copies the tiles
+   out into the rows pixels() and writeBmp() read.
+
+   A texture is copied, decoded and tiled for the sampler, the first time
+   a draw uses it and again when it has been changed since.  The copies
+   hold the texture, and are let go of at a Present() when the frame
+   didn't use them.
+*/
+
+#ifndef SOFTDEVICE_H
+#define SOFTDEVICE_H
+
+#include "NullDevice.h"
+#include "TexSampler.h"
+#include "OutputMerger.h"
+#include "VertexTransform.h"
+#include <vector>
+#include <map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+
+class SoftDevice : public NullDevice
+{
+public:
+   // a width x height back buffer, and a depth buffer of depthFormat
+   // (D16, D24X8 or D24S8).. numThreads 0 = all cores
+   SoftDevice(UINT width, UINT height, D3DFORMAT depthFormat = D3DFMT_D16, unsigned int numThreads = 0);
+
+   HRESULT Reset(D3DPRESENT_PARAMETERS * params);   // a new size and depth format if it has them
+   HRESULT Present(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty);
+   HRESULT Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z, DWORD stencil);
+   HRESULT DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count);
+   HRESULT DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                UINT numVertices, UINT startIndex, UINT count);
+
+   // the back buffer, X8R8G8B8, width() pixels a row.. as of the last Present()
+   const unsigned int * pixels() const { return &m_front[0]; }
+   UINT width() const { return m_width; }
+   UINT height() const { return m_height; }
+   bool writeBmp(const char * filename) const;   // 24 bit
+   unsigned int depthBits() const { return m_depthBits; }
+
+   unsigned int trianglesDrawn() const { return m_trianglesDrawn; }   // since the last Present(), after clipping
+
+   enum { TILE = 64, STAGES_USED = 2, ATTRIBUTES = 13 };
+
+   // a vertex after transform and lighting, in clip space
+   struct Vertex
+   {
+      float x, y, z, w;
+      float diffuse[4];    // r g b a, 0 to 1
+      float specular[3];
+      float uv[STAGES_USED][2];
+   };
+
+protected:
+   ~SoftDevice();
+
+private:
+   // all a draw needs from the device's state, kept with its triangles
+   struct DrawState
+   {
+      const SampledTexture * textures[STAGES_USED];   // in m_copies
+      DWORD colorOp[STAGES_USED], colorArg1[STAGES_USED], colorArg2[STAGES_USED];
+      DWORD alphaOp[STAGES_USED], alphaArg1[STAGES_USED], alphaArg2[STAGES_USED];
+      DWORD texCoords[STAGES_USED];
+      SamplerSettings samplers[STAGES_USED];
+      DWORD textureFactor;
+      DWORD specular;
+      MergeState merge;
+   };
+
+   // a triangle ready to rasterize, wound so its area is positive
+   struct Triangle
+   {
+      int x[3], y[3];                      // 1/16 pixel
+      int minX, minY, maxX, maxY;          // pixels it can touch, on the screen
+      float plane[ATTRIBUTES][3];          // a*x + b*y + c at a pixel: z, 1/w, then the rest over w
+      unsigned int state;
+   };
+
+   struct ClearCommand
+   {
+      int x1, y1, x2, y2;
+      DWORD flags;
+      unsigned int color;
+      unsigned int z;          // depthBits() deep
+   };
+
+   // a texture as the sampler reads it
+   struct TextureCopy
+   {
+      SampledTexture sampled;
+      unsigned int changes;   // the texture's, when it was copied
+      bool used;              // this frame
+   };
+
+   enum { CLEAR_BIT = 0x80000000u, MAX_TRIANGLES = 1 << 18 };
+   enum { SPAN = SAMPLE_WIDTH };   // pixels shaded together
+
+   void resize(UINT width, UINT height);
+   void resolve();   // the tiles into m_front
+   unsigned int captureState();
+   const SampledTexture * copyTexture(NullTexture * texture);
+   bool transformVertices(UINT start, UINT count);
+   void drawPrimitives(D3DPRIMITIVETYPE type, const unsigned int * indices, UINT count);
+   void drawTriangle(unsigned int a, unsigned int b, unsigned int c, bool cull);   // indices into m_vertices
+   void drawLine(const Vertex & a, const Vertex & b);
+   void drawPoint(unsigned int a);
+   void setupTriangle(const Vertex * v[3], const float sx[3], const float sy[3], bool cull);
+   void bin(unsigned int command, int minX, int minY, int maxX, int maxY);
+   void flush(bool midDraw);   // midDraw keeps the state of the draw being made
+   void renderTiles();
+   void renderTile(unsigned int tile);
+   void rasterize(const Triangle & t, int tx, int ty, int x0, int y0, int x1, int y1);
+   void shadeSpan(const Triangle & t, const DrawState & s, int x, int y, unsigned int * color,
+                  unsigned int * depth, unsigned int mask);   // SPAN pixels, color and depth the tile's at x, y
+   void workerLoop();
+
+   UINT m_width, m_height, m_tilesX, m_tilesY;
+   unsigned int m_depthBits;
+   std::vector<unsigned int> m_color, m_depth;   // by tile, TILE * TILE pixels each, rows of TILE
+   std::vector<unsigned int> m_front;            // the back buffer by rows, as of the last Present()
+   unsigned int m_trianglesDrawn, m_frameTriangles;
+
+   // the frame so far, waiting for Present()
+   std::vector<DrawState> m_states;
+   std::vector<Triangle> m_triangles;
+   std::vector<ClearCommand> m_clears;
+   std::vector<std::vector<unsigned int> > m_bins;   // by tile, triangle or CLEAR_BIT | clear
+
+   std::map<NullTexture *, TextureCopy> m_copies;   // each holding its texture
+   std::vector<unsigned int> m_decoded;             // scratch for copying a level
+
+   // scratch for a draw
+   std::vector<Vertex> m_vertices;
+   std::vector<unsigned char> m_clipCodes;   // each vertex's CLIP_ bits
+   std::vector<float> m_screen;              // their screen x's, then y's
+   std::vector<float> m_streams;             // positions in and clip space out, for VertexTransform
+   std::vector<unsigned int> m_indices;
+   unsigned int m_state;
+
+   // the threads that render tiles.. the caller of Present() renders too
+   std::vector<std::thread> m_workers;
+   std::mutex m_lock;
+   std::condition_variable m_wake, m_done;
+   unsigned int m_generation;   // counts the flushes, a worker wakes when it changes
+   unsigned int m_nextTile;     // the next one to take, under m_lock
+   unsigned int m_busy;         // workers still rendering this flush
+   bool m_quit;
+};
+
+#endif
@@ -0,0 +1,340 @@
+/* Filename:  TexSampler.cpp
+
+   This file accompanies TexSampler.h.
+*/
+
+#include "TexSampler.h"
+#include <math.h>
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SAMPLER_AVX2 1
+#endif
+
+#define MAX_ANISOTROPY 16
+
+
+SampledTexture::SampledTexture()
+{
+}
+
+
+void SampledTexture::resize(UINT width, UINT height, UINT levels)
+{
+   size_t texels = 0;
+   UINT i;
+
+   if (levels == 0)
+      for (levels = 1; (width >> levels) || (height >> levels); levels++)
+         ;
+   m_levels.resize(levels);
+   for (i = 0; i < levels; i++)
+   {
+      Level & l = m_levels[i];
+      l.width = std::max(width >> i, 1u);
+      l.height = std::max(height >> i, 1u);
+      l.tilesX = (l.width + 3) / 4;
+      l.offset = texels;
+      texels += (size_t) l.tilesX * ((l.height + 3) / 4) * 16;
+   }
+   m_texels.assign(texels + 1, 0);   // + 1 so texels() is there for an empty one
+}
+
+
+void SampledTexture::setLevel(UINT level, const unsigned int * argb, UINT pitch)
+{
+   const Level & l = m_levels[level];
+   unsigned int * tiles = &m_texels[l.offset];
+   UINT x, y;
+
+   for (y = 0; y < l.height; y++)
+   {
+      const unsigned int * row = (const unsigned int *) ((const unsigned char *) argb + (size_t) y * pitch);
+      unsigned int * tileRow = tiles + (size_t) (y >> 2) * l.tilesX * 16 + (y & 3) * 4;
+      for (x = 0; x < l.width; x++)
+         tileRow[(x >> 2) * 16 + (x & 3)] = row[x];
+   }
+}
+
+
+const char * texSamplerPath()
+{
+#ifdef SAMPLER_AVX2
+   return "avx2";
+#else
+   return "scalar";
+#endif
+}
+
+
+// a level as a sample of it needs it
+struct LevelView
+{
+   const unsigned int * texels;
+   int width, height, tilesX;
+   bool linear;   // bilinear, or point
+};
+
+
+#ifdef SAMPLER_AVX2
+
+// whole texel coordinates, as floats, brought onto a texture size texels across
+static inline __m256 address(__m256 x, float size, DWORD mode)
+{
+   switch (mode)
+   {
+   case D3DTADDRESS_MIRROR:
+      {
+         __m256 period = _mm256_set1_ps(size * 2.0f);
+         __m256 m = _mm256_sub_ps(x, _mm256_mul_ps(period, _mm256_floor_ps(_mm256_mul_ps(x, _mm256_set1_ps(0.5f / size)))));
+         __m256 back = _mm256_sub_ps(_mm256_sub_ps(period, _mm256_set1_ps(1.0f)), m);
+         m = _mm256_blendv_ps(m, back, _mm256_cmp_ps(m, _mm256_set1_ps(size), _CMP_GE_OQ));
+         return _mm256_min_ps(_mm256_max_ps(m, _mm256_setzero_ps()), _mm256_set1_ps(size - 1.0f));
+      }
+   case D3DTADDRESS_MIRRORONCE:
+      {
+         // -1 - x to the left of 0, so -1 is 0 again
+         __m256 m = _mm256_max_ps(x, _mm256_sub_ps(_mm256_set1_ps(-1.0f), x));
+         return _mm256_min_ps(m, _mm256_set1_ps(size - 1.0f));
+      }
+   case D3DTADDRESS_CLAMP:
+   case D3DTADDRESS_BORDER:
+      return _mm256_min_ps(_mm256_max_ps(x, _mm256_setzero_ps()), _mm256_set1_ps(size - 1.0f));
+   default:   // D3DTADDRESS_WRAP
+      {
+         __m256 s = _mm256_set1_ps(size);
+         __m256 m = _mm256_sub_ps(x, _mm256_mul_ps(s, _mm256_floor_ps(_mm256_mul_ps(x, _mm256_set1_ps(1.0f / size)))));
+         // in case the floor rounded the wrong way
+         return _mm256_min_ps(_mm256_max_ps(m, _mm256_setzero_ps()), _mm256_set1_ps(size - 1.0f));
+      }
+   }
+}
+
+
+static inline __m256i tileIndex(__m256i x, __m256i y, __m256i tilesX)
+{
+   __m256i tile = _mm256_add_epi32(_mm256_mullo_epi32(_mm256_srli_epi32(y, 2), tilesX), _mm256_srli_epi32(x, 2));
+   __m256i three = _mm256_set1_epi32(3);
+   return _mm256_add_epi32(_mm256_slli_epi32(tile, 4),
+                           _mm256_add_epi32(_mm256_slli_epi32(_mm256_and_si256(y, three), 2), _mm256_and_si256(x, three)));
+}
+
+
+// the 4 channels of 8 texels, 0 to 255
+static inline void unpack(__m256i c, __m256 * out)
+{
+   __m256i byte = _mm256_set1_epi32(0xFF);
+   out[0] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 16), byte));
+   out[1] = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(c, 8), byte));
+   out[2] = _mm256_cvtepi32_ps(_mm256_and_si256(c, byte));
+   out[3] = _mm256_cvtepi32_ps(_mm256_srli_epi32(c, 24));
+}
+
+
+// weight times the level sampled at u, v, added to sum
+static void sampleLevel(const LevelView & l, DWORD addressU, DWORD addressV, __m256 u, __m256 v, float weight,
+                        __m256 * sum)
+{
+   const int * base = (const int *) l.texels;
+   __m256i tilesX = _mm256_set1_epi32(l.tilesX);
+   __m256 w = _mm256_set1_ps(weight), t[4];
+   float fw = (float) l.width, fh = (float) l.height;
+   int c;
+
+   u = _mm256_mul_ps(u, _mm256_set1_ps(fw));
+   v = _mm256_mul_ps(v, _mm256_set1_ps(fh));
+   if (!l.linear)
+   {
+      __m256i x = _mm256_cvttps_epi32(address(_mm256_floor_ps(u), fw, addressU));
+      __m256i y = _mm256_cvttps_epi32(address(_mm256_floor_ps(v), fh, addressV));
+      unpack(_mm256_i32gather_epi32(base, tileIndex(x, y, tilesX), 4), t);
+      for (c = 0; c < 4; c++)
+         sum[c] = _mm256_add_ps(sum[c], _mm256_mul_ps(t[c], w));
+      return;
+   }
+
+   __m256 half = _mm256_set1_ps(0.5f), one = _mm256_set1_ps(1.0f), t00[4], t10[4], t01[4], t11[4];
+   u = _mm256_sub_ps(u, half);
+   v = _mm256_sub_ps(v, half);
+   __m256 fu = _mm256_floor_ps(u), fv = _mm256_floor_ps(v);
+   __m256 ax = _mm256_sub_ps(u, fu), ay = _mm256_sub_ps(v, fv);
+   __m256i x0 = _mm256_cvttps_epi32(address(fu, fw, addressU));
+   __m256i x1 = _mm256_cvttps_epi32(address(_mm256_add_ps(fu, one), fw, addressU));
+   __m256i y0 = _mm256_cvttps_epi32(address(fv, fh, addressV));
+   __m256i y1 = _mm256_cvttps_epi32(address(_mm256_add_ps(fv, one), fh, addressV));
+   unpack(_mm256_i32gather_epi32(base, tileIndex(x0, y0, tilesX), 4), t00);
+   unpack(_mm256_i32gather_epi32(base, tileIndex(x1, y0, tilesX), 4), t10);
+   unpack(_mm256_i32gather_epi32(base, tileIndex(x0, y1, tilesX), 4), t01);
+   unpack(_mm256_i32gather_epi32(base, tileIndex(x1, y1, tilesX), 4), t11);
+   for (c = 0; c < 4; c++)
+   {
+      __m256 top = _mm256_add_ps(t00[c], _mm256_mul_ps(_mm256_sub_ps(t10[c], t00[c]), ax));
+      __m256 bottom = _mm256_add_ps(t01[c], _mm256_mul_ps(_mm256_sub_ps(t11[c], t01[c]), ax));
+      sum[c] = _mm256_add_ps(sum[c], _mm256_mul_ps(_mm256_add_ps(top, _mm256_mul_ps(_mm256_sub_ps(bottom, top), ay)), w));
+   }
+}
+
+#else
+
+static inline int address(int x, int size, DWORD mode)
+{
+   switch (mode)
+   {
+   case D3DTADDRESS_MIRROR:
+   case D3DTADDRESS_MIRRORONCE:
+      x = x < 0 ? -x - 1 : x;
+      if (mode == D3DTADDRESS_MIRRORONCE)
+         return x < size ? x : size - 1;
+      x %= 2 * size;
+      return x < size ? x : 2 * size - 1 - x;
+   case D3DTADDRESS_CLAMP:
+   case D3DTADDRESS_BORDER:
+      return x < 0 ? 0 : x >= size ? size - 1 : x;
+   default:   // D3DTADDRESS_WRAP
+      x %= size;
+      return x < 0 ? x + size : x;
+   }
+}
+
+
+static inline unsigned int fetch(const LevelView & l, int x, int y)
+{
+   return l.texels[((y >> 2) * l.tilesX + (x >> 2)) * 16 + (y & 3) * 4 + (x & 3)];
+}
+
+
+static void sampleLevel(const LevelView & l, DWORD addressU, DWORD addressV, const float * u, const float * v,
+                        float weight, float sum[4][SAMPLE_WIDTH])
+{
+   int i, c;
+
+   for (i = 0; i < SAMPLE_WIDTH; i++)
+   {
+      float fu = u[i] * l.width, fv = v[i] * l.height;
+      if (!l.linear)
+      {
+         unsigned int t = fetch(l, address((int) floorf(fu), l.width, addressU), address((int) floorf(fv), l.height, addressV));
+         for (c = 0; c < 4; c++)
+            sum[c][i] += (float) (t >> (c == 3 ? 24 : 16 - c * 8) & 0xFF) * weight;
+         continue;
+      }
+      fu -= 0.5f;
+      fv -= 0.5f;
+      int x = (int) floorf(fu), y = (int) floorf(fv);
+      float ax = fu - x, ay = fv - y;
+      int x0 = address(x, l.width, addressU), x1 = address(x + 1, l.width, addressU);
+      int y0 = address(y, l.height, addressV), y1 = address(y + 1, l.height, addressV);
+      unsigned int t00 = fetch(l, x0, y0), t10 = fetch(l, x1, y0), t01 = fetch(l, x0, y1), t11 = fetch(l, x1, y1);
+      for (c = 0; c < 4; c++)
+      {
+         int shift = c == 3 ? 24 : 16 - c * 8;
+         float a = (float) (t00 >> shift & 0xFF), b = (float) (t10 >> shift & 0xFF);
+         float d = (float) (t01 >> shift & 0xFF), e = (float) (t11 >> shift & 0xFF);
+         float top = a + (b - a) * ax, bottom = d + (e - d) * ax;
+         sum[c][i] += (top + (bottom - top) * ay) * weight;
+      }
+   }
+}
+
+#endif
+
+
+void sampleTexture(const SampledTexture & texture, const SamplerSettings & s, const float * u, const float * v,
+                   const SampleGradients & g, float out[4][SAMPLE_WIDTH])
+{
+   float w0 = (float) texture.width(), h0 = (float) texture.height();
+   float xLen = sqrtf(g.dudx * g.dudx * w0 * w0 + g.dvdx * g.dvdx * h0 * h0);
+   float yLen = sqrtf(g.dudy * g.dudy * w0 * w0 + g.dvdy * g.dvdy * h0 * h0);
+   float major = std::max(xLen, yLen), minor = std::min(xLen, yLen), lod, du, dv;
+   int taps = 1, levels = (int) texture.levels(), level, tap, i, c;
+   float weights[2];
+   LevelView views[2];
+   DWORD filter;
+
+   // texels a pixel covers, along its longer side, as a power of 2.. above 0 is minification
+   lod = major > 0.0f ? log2f(major) + s.lodBias : -1.0f;
+   filter = lod > 0.0f ? s.minFilter : s.magFilter;
+   if (lod > 0.0f && s.minFilter == D3DTEXF_ANISOTROPIC && s.maxAnisotropy > 1)
+   {
+      // more samples along the long side, each one a footprint as wide as the short side
+      float ratio = minor > 0.0f ? major / minor : (float) MAX_ANISOTROPY;
+      taps = std::min((int) ceilf(ratio), (int) std::min(s.maxAnisotropy, (DWORD) MAX_ANISOTROPY));
+      lod = std::max(lod - log2f((float) taps), 0.0f);
+   }
+   du = xLen >= yLen ? g.dudx : g.dudy;
+   dv = xLen >= yLen ? g.dvdx : g.dvdy;
+   if (!(fabsf(du) < 1.0e6f && fabsf(dv) < 1.0e6f))   // and not NaN
+      du = dv = 0.0f;
+
+   // which levels, and how much of each
+   int count = 1;
+   level = 0;
+   weights[0] = 1.0f;
+   if (s.mipFilter != D3DTEXF_NONE && lod > 0.0f && levels > 1)
+   {
+      if (s.mipFilter == D3DTEXF_LINEAR && lod < levels - 1)
+      {
+         level = (int) lod;
+         weights[1] = lod - level;
+         weights[0] = 1.0f - weights[1];
+         count = weights[1] > 0.0f ? 2 : 1;
+      }
+      else
+         level = std::min((int) (lod + 0.5f), levels - 1);
+   }
+   for (i = 0; i < count; i++)
+   {
+      const SampledTexture::Level & l = texture.level(level + i);
+      views[i].texels = texture.texels() + l.offset;
+      views[i].width = (int) l.width;
+      views[i].height = (int) l.height;
+      views[i].tilesX = (int) l.tilesX;
+      views[i].linear = filter == D3DTEXF_LINEAR || filter == D3DTEXF_ANISOTROPIC;
+      weights[i] /= taps * 255.0f;
+   }
+
+   // wrapped early, so big coordinates keep their fraction.. one that is
+   // no use (a pixel left out of a span can have anything) is taken as 0
+   float wu[SAMPLE_WIDTH], wv[SAMPLE_WIDTH];
+   for (i = 0; i < SAMPLE_WIDTH; i++)
+   {
+      if (!(fabsf(u[i]) < 1.0e6f && fabsf(v[i]) < 1.0e6f))
+      {
+         wu[i] = wv[i] = 0.0f;
+         continue;
+      }
+      wu[i] = s.addressU == D3DTADDRESS_WRAP ? u[i] - floorf(u[i]) : u[i];
+      wv[i] = s.addressV == D3DTADDRESS_WRAP ? v[i] - floorf(v[i]) : v[i];
+   }
+
+#ifdef SAMPLER_AVX2
+   __m256 sum[4] = { _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps(), _mm256_setzero_ps() };
+   __m256 bu = _mm256_loadu_ps(wu), bv = _mm256_loadu_ps(wv);
+   for (tap = 0; tap < taps; tap++)
+   {
+      float t = (tap + 0.5f) / taps - 0.5f;   // spread along the long side, about the pixel's centre
+      __m256 tu = _mm256_add_ps(bu, _mm256_set1_ps(du * t)), tv = _mm256_add_ps(bv, _mm256_set1_ps(dv * t));
+      for (i = 0; i < count; i++)
+         sampleLevel(views[i], s.addressU, s.addressV, tu, tv, weights[i], sum);
+   }
+   for (c = 0; c < 4; c++)
+      _mm256_storeu_ps(out[c], sum[c]);
+#else
+   float tu[SAMPLE_WIDTH], tv[SAMPLE_WIDTH];
+   for (c = 0; c < 4; c++)
+      for (i = 0; i < SAMPLE_WIDTH; i++)
+         out[c][i] = 0.0f;
+   for (tap = 0; tap < taps; tap++)
+   {
+      float t = (tap + 0.5f) / taps - 0.5f;
+      for (i = 0; i < SAMPLE_WIDTH; i++)
+      {
+         tu[i] = wu[i] + du * t;
+         tv[i] = wv[i] + dv * t;
+      }
+      for (i = 0; i < count; i++)
+         sampleLevel(views[i], s.addressU, s.addressV, tu, tv, weights[i], out);
+   }
+#endif
+}
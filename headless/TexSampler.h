@@ -0,0 +1,96 @@
+/* Filename:  TexSampler.h
+
+   This file is used by the headless builds.  See d3d9.h.
+
+   Texture sampling on the CPU, for SoftDevice.  It does the filters and
+   address modes the examples ask for: POINT, LINEAR and ANISOTROPIC for
+   D3DSAMP_MINFILTER and MAGFILTER (example 7 switches between them with
+   1-3), NONE, POINT and LINEAR (trilinear) for MIPFILTER, and WRAP,
+   MIRROR and CLAMP addressing (Flag3D mirrors, Wall clamps).  BORDER is
+   taken as CLAMP and MIRRORONCE as a clamped MIRROR.
+
+   A SampledTexture is a copy of a texture's levels, decoded to A8R8G8B8
+   and stored in 4x4 tiles of 64 bytes.  A bilinear fetch is then nearly
+   always one cache line rather than two rows, and a span of pixels
+   walking across the texture at any angle stays in few of them.
+
+   sampleTexture() takes 8 pixels at a time.  Built with AVX2 the 8 go
+   through together, the texels fetched with gathers; without, the same
+   sums are done one pixel at a time.  The mip level and the anisotropy
+   are worked out once for the 8, from their gradients, as a card does
+   once for a 2x2 quad.  Anisotropic filtering takes up to
+   D3DSAMP_MAXANISOTROPY trilinear samples along the longer axis of the
+   pixel's footprint.
+*/
+
+#ifndef TEXSAMPLER_H
+#define TEXSAMPLER_H
+
+#include <d3d9.h>
+#include <vector>
+
+
+class SampledTexture
+{
+public:
+   SampledTexture();
+
+   // room for levels (0 for the whole chain) of a width x height texture,
+   // each half the size of the one before, as D3D makes them
+   void resize(UINT width, UINT height, UINT levels);
+
+   // a level's texels from rows of A8R8G8B8, pitch bytes apart
+   void setLevel(UINT level, const unsigned int * argb, UINT pitch);
+
+   UINT levels() const { return (UINT) m_levels.size(); }
+   UINT width(UINT level = 0) const { return m_levels[level].width; }
+   UINT height(UINT level = 0) const { return m_levels[level].height; }
+
+   // one texel, x and y on the level
+   unsigned int texel(UINT level, UINT x, UINT y) const
+   {
+      const Level & l = m_levels[level];
+      return m_texels[l.offset + ((y >> 2) * l.tilesX + (x >> 2)) * 16 + (y & 3) * 4 + (x & 3)];
+   }
+
+   struct Level
+   {
+      UINT width, height;
+      UINT tilesX;     // 4x4 tiles across
+      size_t offset;   // of its first tile, in texels
+   };
+
+   const Level & level(UINT i) const { return m_levels[i]; }
+   const unsigned int * texels() const { return &m_texels[0]; }
+
+private:
+   std::vector<Level> m_levels;
+   std::vector<unsigned int> m_texels;
+};
+
+
+// the sampler states that matter here, as D3D values
+struct SamplerSettings
+{
+   DWORD minFilter, magFilter, mipFilter;   // D3DTEXF
+   DWORD addressU, addressV;                // D3DTADDRESS
+   DWORD maxAnisotropy;                     // 0 or 1 for none
+   float lodBias;                           // D3DSAMP_MIPMAPLODBIAS, as a float
+};
+
+// how the texture coordinates change from one pixel to the next, across
+// and down, in texture coordinates (0 to 1 over the texture)
+struct SampleGradients
+{
+   float dudx, dvdx, dudy, dvdy;
+};
+
+enum { SAMPLE_WIDTH = 8 };
+
+// 8 samples at u[i], v[i], out as r, g, b and a, 0 to 1, 8 of each
+void sampleTexture(const SampledTexture & texture, const SamplerSettings & settings, const float * u,
+                   const float * v, const SampleGradients & gradients, float out[4][SAMPLE_WIDTH]);
+
+const char * texSamplerPath();   // "avx2" or "scalar", whichever this was built with
+
+#endif
@@ -0,0 +1,313 @@
+/* Filename:  VertexTransform.cpp
+
+   This file accompanies VertexTransform.h.
+*/
+
+#include "VertexTransform.h"
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define VERTEX_AVX2 1
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VERTEX_SSE 1
+#endif
+
+
+const char * vertexTransformPath()
+{
+#if defined(VERTEX_AVX2)
+   return "avx2";
+#elif defined(VERTEX_SSE)
+   return "sse2";
+#else
+   return "scalar";
+#endif
+}
+
+
+// one vertex, and the ends of the batches that don't make a whole 8 or 4..
+// what the SIMD paths do, a lane at a time
+static unsigned int transformOne(const VertexTransform & t, const VertexStreams & s, unsigned int i)
+{
+   const float * m = t.matrix;
+   float x = s.x[i], y = s.y[i], z = s.z[i];
+   float cx = x * m[0] + y * m[4] + z * m[8] + m[12];
+   float cy = x * m[1] + y * m[5] + z * m[9] + m[13];
+   float cz = x * m[2] + y * m[6] + z * m[10] + m[14];
+   float cw = x * m[3] + y * m[7] + z * m[11] + m[15];
+   unsigned int code = 0;
+
+   if (s.clipX)
+   {
+      s.clipX[i] = cx;
+      s.clipY[i] = cy;
+      s.clipZ[i] = cz;
+      s.clipW[i] = cw;
+   }
+   if (cz < 0.0f)
+      code |= CLIP_NEAR;
+   if (cw - cz < 0.0f)
+      code |= CLIP_FAR;
+   if (cx + t.guardX * cw < 0.0f)
+      code |= CLIP_LEFT;
+   if (t.guardX * cw - cx < 0.0f)
+      code |= CLIP_RIGHT;
+   if (cy + t.guardY * cw < 0.0f)
+      code |= CLIP_BOTTOM;
+   if (t.guardY * cw - cy < 0.0f)
+      code |= CLIP_TOP;
+   if (s.clip)
+      s.clip[i] = (unsigned char) code;
+
+   if (s.screenX)
+   {
+      s.screenX[i] = (cx / cw + 1.0f) * 0.5f * t.width;
+      s.screenY[i] = (1.0f - cy / cw) * 0.5f * t.height;
+   }
+   if (s.screenZ)
+      s.screenZ[i] = cz / cw;
+   if (s.rhw)
+      s.rhw[i] = 1.0f / cw;
+   return code;
+}
+
+
+#if defined(VERTEX_AVX2)
+
+ClipCodes transformVertices(const VertexTransform & t, const VertexStreams & s, unsigned int first, unsigned int last)
+{
+   ClipCodes codes = { 0, 0 };
+   unsigned int i = first, code;
+   __m256 m[16], zero = _mm256_setzero_ps(), one = _mm256_set1_ps(1.0f), half = _mm256_set1_ps(0.5f);
+   __m256 width = _mm256_set1_ps(t.width), height = _mm256_set1_ps(t.height);
+   __m256 gx = _mm256_set1_ps(t.guardX), gy = _mm256_set1_ps(t.guardY);
+   __m256i any = _mm256_setzero_si256(), all = _mm256_set1_epi32(0x3F);
+   int k;
+
+   if (first >= last)
+      return codes;
+   for (k = 0; k < 16; k++)
+      m[k] = _mm256_set1_ps(t.matrix[k]);
+
+   for (; i + 8 <= last; i += 8)
+   {
+      __m256 x = _mm256_loadu_ps(s.x + i), y = _mm256_loadu_ps(s.y + i), z = _mm256_loadu_ps(s.z + i);
+      __m256 cx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[0]), _mm256_mul_ps(y, m[4])),
+                                              _mm256_mul_ps(z, m[8])), m[12]);
+      __m256 cy = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[1]), _mm256_mul_ps(y, m[5])),
+                                              _mm256_mul_ps(z, m[9])), m[13]);
+      __m256 cz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[2]), _mm256_mul_ps(y, m[6])),
+                                              _mm256_mul_ps(z, m[10])), m[14]);
+      __m256 cw = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(x, m[3]), _mm256_mul_ps(y, m[7])),
+                                              _mm256_mul_ps(z, m[11])), m[15]);
+
+      if (s.clipX)
+      {
+         _mm256_storeu_ps(s.clipX + i, cx);
+         _mm256_storeu_ps(s.clipY + i, cy);
+         _mm256_storeu_ps(s.clipZ + i, cz);
+         _mm256_storeu_ps(s.clipW + i, cw);
+      }
+
+      // each compare is all ones where the vertex is outside, so anded with its bit
+      __m256 gxw = _mm256_mul_ps(gx, cw), gyw = _mm256_mul_ps(gy, cw);
+      __m256i c = _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(cz, zero, _CMP_LT_OQ)), _mm256_set1_epi32(CLIP_NEAR));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(cw, cz), zero, _CMP_LT_OQ)),
+                                              _mm256_set1_epi32(CLIP_FAR)));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(cx, gxw), zero, _CMP_LT_OQ)),
+                                              _mm256_set1_epi32(CLIP_LEFT)));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(gxw, cx), zero, _CMP_LT_OQ)),
+                                              _mm256_set1_epi32(CLIP_RIGHT)));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_add_ps(cy, gyw), zero, _CMP_LT_OQ)),
+                                              _mm256_set1_epi32(CLIP_BOTTOM)));
+      c = _mm256_or_si256(c, _mm256_and_si256(_mm256_castps_si256(_mm256_cmp_ps(_mm256_sub_ps(gyw, cy), zero, _CMP_LT_OQ)),
+                                              _mm256_set1_epi32(CLIP_TOP)));
+      any = _mm256_or_si256(any, c);
+      all = _mm256_and_si256(all, c);
+      if (s.clip)
+      {
+         // 8 words to 8 bytes.. they are all under 64, so nothing saturates
+         __m128i w = _mm_packus_epi32(_mm256_castsi256_si128(c), _mm256_extracti128_si256(c, 1));
+         _mm_storel_epi64((__m128i *) (s.clip + i), _mm_packus_epi16(w, w));
+      }
+
+      if (s.screenX)
+      {
+         _mm256_storeu_ps(s.screenX + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_div_ps(cx, cw), one), half), width));
+         _mm256_storeu_ps(s.screenY + i, _mm256_mul_ps(_mm256_mul_ps(_mm256_sub_ps(one, _mm256_div_ps(cy, cw)), half), height));
+      }
+      if (s.screenZ)
+         _mm256_storeu_ps(s.screenZ + i, _mm256_div_ps(cz, cw));
+      if (s.rhw)
+         _mm256_storeu_ps(s.rhw + i, _mm256_div_ps(one, cw));
+   }
+
+   unsigned int lanesAny[8], lanesAll[8];
+   _mm256_storeu_si256((__m256i *) lanesAny, any);
+   _mm256_storeu_si256((__m256i *) lanesAll, all);
+   codes.all = 0x3F;
+   for (k = 0; k < 8; k++)
+   {
+      codes.any |= lanesAny[k];
+      codes.all &= lanesAll[k];
+   }
+   for (; i < last; i++)
+   {
+      code = transformOne(t, s, i);
+      codes.any |= code;
+      codes.all &= code;
+   }
+   return codes;
+}
+
+#elif defined(VERTEX_SSE)
+
+ClipCodes transformVertices(const VertexTransform & t, const VertexStreams & s, unsigned int first, unsigned int last)
+{
+   ClipCodes codes = { 0, 0 };
+   unsigned int i = first, code;
+   __m128 m[16], zero = _mm_setzero_ps(), one = _mm_set1_ps(1.0f), half = _mm_set1_ps(0.5f);
+   __m128 width = _mm_set1_ps(t.width), height = _mm_set1_ps(t.height);
+   __m128 gx = _mm_set1_ps(t.guardX), gy = _mm_set1_ps(t.guardY);
+   __m128i any = _mm_setzero_si128(), all = _mm_set1_epi32(0x3F);
+   int k;
+
+   if (first >= last)
+      return codes;
+   for (k = 0; k < 16; k++)
+      m[k] = _mm_set1_ps(t.matrix[k]);
+
+   for (; i + 4 <= last; i += 4)
+   {
+      __m128 x = _mm_loadu_ps(s.x + i), y = _mm_loadu_ps(s.y + i), z = _mm_loadu_ps(s.z + i);
+      __m128 cx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[0]), _mm_mul_ps(y, m[4])), _mm_mul_ps(z, m[8])), m[12]);
+      __m128 cy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[1]), _mm_mul_ps(y, m[5])), _mm_mul_ps(z, m[9])), m[13]);
+      __m128 cz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[2]), _mm_mul_ps(y, m[6])), _mm_mul_ps(z, m[10])), m[14]);
+      __m128 cw = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m[3]), _mm_mul_ps(y, m[7])), _mm_mul_ps(z, m[11])), m[15]);
+
+      if (s.clipX)
+      {
+         _mm_storeu_ps(s.clipX + i, cx);
+         _mm_storeu_ps(s.clipY + i, cy);
+         _mm_storeu_ps(s.clipZ + i, cz);
+         _mm_storeu_ps(s.clipW + i, cw);
+      }
+
+      __m128 gxw = _mm_mul_ps(gx, cw), gyw = _mm_mul_ps(gy, cw);
+      __m128i c = _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(cz, zero)), _mm_set1_epi32(CLIP_NEAR));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(cw, cz), zero)), _mm_set1_epi32(CLIP_FAR)));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_add_ps(cx, gxw), zero)), _mm_set1_epi32(CLIP_LEFT)));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(gxw, cx), zero)), _mm_set1_epi32(CLIP_RIGHT)));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_add_ps(cy, gyw), zero)), _mm_set1_epi32(CLIP_BOTTOM)));
+      c = _mm_or_si128(c, _mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(_mm_sub_ps(gyw, cy), zero)), _mm_set1_epi32(CLIP_TOP)));
+      any = _mm_or_si128(any, c);
+      all = _mm_and_si128(all, c);
+      if (s.clip)
+      {
+         __m128i w = _mm_packs_epi32(c, c);
+         int bytes = _mm_cvtsi128_si32(_mm_packus_epi16(w, w));
+         memcpy(s.clip + i, &bytes, 4);
+      }
+
+      if (s.screenX)
+      {
+         _mm_storeu_ps(s.screenX + i, _mm_mul_ps(_mm_mul_ps(_mm_add_ps(_mm_div_ps(cx, cw), one), half), width));
+         _mm_storeu_ps(s.screenY + i, _mm_mul_ps(_mm_mul_ps(_mm_sub_ps(one, _mm_div_ps(cy, cw)), half), height));
+      }
+      if (s.screenZ)
+         _mm_storeu_ps(s.screenZ + i, _mm_div_ps(cz, cw));
+      if (s.rhw)
+         _mm_storeu_ps(s.rhw + i, _mm_div_ps(one, cw));
+   }
+
+   unsigned int lanesAny[4], lanesAll[4];
+   _mm_storeu_si128((__m128i *) lanesAny, any);
+   _mm_storeu_si128((__m128i *) lanesAll, all);
+   codes.all = 0x3F;
+   for (k = 0; k < 4; k++)
+   {
+      codes.any |= lanesAny[k];
+      codes.all &= lanesAll[k];
+   }
+   for (; i < last; i++)
+   {
+      code = transformOne(t, s, i);
+      codes.any |= code;
+      codes.all &= code;
+   }
+   return codes;
+}
+
+#else
+
+ClipCodes transformVertices(const VertexTransform & t, const VertexStreams & s, unsigned int first, unsigned int last)
+{
+   ClipCodes codes = { 0, 0x3F };
+   unsigned int i, code;
+
+   if (first >= last)
+      return ClipCodes();
+   for (i = first; i < last; i++)
+   {
+      code = transformOne(t, s, i);
+      codes.any |= code;
+      codes.all &= code;
+   }
+   return codes;
+}
+
+#endif
+
+
+//*******
+// threads
+
+static unsigned int threadCount(unsigned int numThreads)
+{
+   if (numThreads == 0)
+      numThreads = std::thread::hardware_concurrency();
+   return numThreads ? numThreads : 1;
+}
+
+
+static void transformRange(const VertexTransform * t, const VertexStreams * s, unsigned int first, unsigned int last,
+                           ClipCodes * codes)
+{
+   *codes = transformVertices(*t, *s, first, last);
+}
+
+
+ClipCodes transformVerticesParallel(const VertexTransform & t, const VertexStreams & s, unsigned int count,
+                                    unsigned int numThreads)
+{
+   unsigned int n = threadCount(numThreads);
+   unsigned int chunk = ((count + n - 1) / n + 7) & ~7u, th;
+   std::vector<ClipCodes> results(n);
+   std::vector<std::thread> threads;
+
+   if (n == 1 || count < 16384)   // not worth starting threads
+      return transformVertices(t, s, 0, count);
+
+   // the last lump is short, or empty when the others have them all
+   for (th = 1; th < n; th++)
+      threads.push_back(std::thread(transformRange, &t, &s, std::min(th * chunk, count),
+                                    std::min((th + 1) * chunk, count), &results[th]));
+   results[0] = transformVertices(t, s, 0, std::min(chunk, count));
+
+   ClipCodes codes = results[0];
+   for (th = 1; th < n; th++)
+   {
+      threads[th - 1].join();
+      if (th * chunk < count)
+      {
+         codes.any |= results[th].any;
+         codes.all &= results[th].all;
+      }
+   }
+   return codes;
+}
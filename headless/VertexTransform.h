@@ -0,0 +1,66 @@
+/* Filename:  VertexTransform.h
+
+   This file is used by the headless builds.  See d3d9.h.
+
+   The first part of SoftDevice's pipeline, many vertices at a time:
+   positions through a 4x4 matrix into clip space, a code saying which of
+   the clip planes each one is outside of, and the divide by w onto the
+   screen.  With AVX2 8 vertices are done at once, with SSE2 4, and with
+   neither one at a time, and all three give the same bits as each other
+   and as SoftDevice's own clipping: the sums are made in the same order,
+   the divides are real ones, not reciprocals, and nothing is fused into
+   a multiply-add.
+
+   The vertices are in streams, all the x's together, then the y's and
+   the z's (w is taken as 1), and what comes out is too, each part in an
+   array of its own.  A part nothing is wanted from can be left NULL.
+   The screen positions are only right for vertices with a code of 0; a
+   vertex outside a plane has to be clipped first, and one behind the eye
+   can have any w at all.
+
+   transformVerticesParallel() splits a big batch between threads, in
+   lumps of a multiple of 8 so only the last one has a ragged end.
+*/
+
+#ifndef VERTEXTRANSFORM_H
+#define VERTEXTRANSFORM_H
+
+
+// the planes a vertex can be outside of, in the order SoftDevice clips to
+// them.. the guard band stands in for the sides of the screen
+enum
+{
+   CLIP_NEAR = 1, CLIP_FAR = 2, CLIP_LEFT = 4, CLIP_RIGHT = 8, CLIP_BOTTOM = 16, CLIP_TOP = 32
+};
+
+struct VertexTransform
+{
+   float matrix[16];        // rows, D3D's way round: a position is a row vector on the left
+   float width, height;     // of the screen, in pixels
+   float guardX, guardY;    // how far out the sides are, 1 being the edge of the screen.. 2 * band / width - 1
+};
+
+struct VertexStreams
+{
+   const float * x, * y, * z;                    // in
+   float * clipX, * clipY, * clipZ, * clipW;     // out, any of them NULL
+   float * screenX, * screenY, * screenZ, * rhw; // out, any of them NULL.. screenZ is z / w, 0 to 1
+   unsigned char * clip;                         // out, the CLIP_ bits, NULL for none
+};
+
+struct ClipCodes
+{
+   unsigned int any;   // or of all the codes.. 0 if every vertex is inside
+   unsigned int all;   // and of them.. not 0 if every vertex is outside one plane
+};
+
+// vertices first up to last
+ClipCodes transformVertices(const VertexTransform & t, const VertexStreams & s, unsigned int first, unsigned int last);
+
+// all count of them, numThreads at once (0 for one per core)
+ClipCodes transformVerticesParallel(const VertexTransform & t, const VertexStreams & s, unsigned int count,
+                                    unsigned int numThreads = 0);
+
+const char * vertexTransformPath();   // "avx2", "sse2" or "scalar"
+
+#endif
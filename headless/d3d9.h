@@ -0,0 +1,493 @@
+/* Filename:  d3d9.h
+
+   This file is used by the headless builds (bench/, and the tools that
+   need a device) in place of the DirectX SDK's header.
+
+   Just the part of Direct3D 9 that the examples' classes and common/ use:
+   the types, the constants (with the SDK's values, so numbers in dumps and
+   captures mean the same thing on both sides) and the device, buffer and
+   texture interfaces.  The interfaces are plain abstract classes rather
+   than COM, which is all C++ code calling through a pointer can tell.
+   NullDevice.h has a device that implements them and draws nothing.
+
+   Only compile with this on machines that don't have the SDK; put
+   ../headless on the include path and <d3dx9.h> comes from here.
+*/
+
+#ifndef HEADLESS_D3D9_H
+#define HEADLESS_D3D9_H
+
+#include <string.h>
+#include <stddef.h>
+
+
+// windows.h types.. DWORD and HRESULT are 32 bits as they are on Windows
+typedef unsigned int DWORD;
+typedef unsigned int UINT;
+typedef unsigned int ULONG;
+typedef int LONG;
+typedef int INT;
+typedef int BOOL;
+typedef int HRESULT;
+typedef unsigned short WORD;
+typedef unsigned char BYTE;
+typedef float FLOAT;
+typedef void VOID;
+typedef void * HANDLE;
+typedef void * HWND;
+typedef const char * LPCSTR;
+
+struct RECT
+{
+   LONG left, top, right, bottom;
+};
+typedef RECT * LPRECT;
+struct RGNDATA;   // only ever passed as NULL
+
+#ifndef TRUE
+#define TRUE 1
+#define FALSE 0
+#endif
+
+#define FAILED(hr) ((HRESULT) (hr) < 0)
+#define SUCCEEDED(hr) ((HRESULT) (hr) >= 0)
+#define ZeroMemory(p, n) memset((p), 0, (n))
+#define CopyMemory(d, s, n) memcpy((d), (s), (n))
+
+// how the SDK declares and defines interface methods.. __stdcall on Windows
+#define STDMETHODCALLTYPE
+#define STDMETHOD(method) virtual HRESULT STDMETHODCALLTYPE method
+#define STDMETHOD_(type, method) virtual type STDMETHODCALLTYPE method
+#define STDMETHODIMP HRESULT STDMETHODCALLTYPE
+#define STDMETHODIMP_(type) type STDMETHODCALLTYPE
+
+#define S_OK ((HRESULT) 0)
+#define E_FAIL ((HRESULT) 0x80004005)
+#define E_OUTOFMEMORY ((HRESULT) 0x8007000E)
+#define D3D_OK S_OK
+#define D3DERR_DEVICELOST ((HRESULT) 0x88760868)
+#define D3DERR_DEVICENOTRESET ((HRESULT) 0x88760869)
+#define D3DERR_INVALIDCALL ((HRESULT) 0x8876086C)
+#define D3DERR_OUTOFVIDEOMEMORY ((HRESULT) 0x8876017C)
+
+
+typedef DWORD D3DCOLOR;
+#define D3DCOLOR_ARGB(a, r, g, b) \
+   ((D3DCOLOR) ((((a) & 0xff) << 24) | (((r) & 0xff) << 16) | (((g) & 0xff) << 8) | ((b) & 0xff)))
+#define D3DCOLOR_XRGB(r, g, b) D3DCOLOR_ARGB(0xff, r, g, b)
+
+struct D3DVECTOR
+{
+   float x, y, z;
+};
+
+struct D3DCOLORVALUE
+{
+   float r, g, b, a;
+};
+
+struct D3DMATRIX
+{
+   union
+   {
+      struct
+      {
+         float _11, _12, _13, _14;
+         float _21, _22, _23, _24;
+         float _31, _32, _33, _34;
+         float _41, _42, _43, _44;
+      };
+      float m[4][4];
+   };
+};
+
+struct D3DRECT
+{
+   LONG x1, y1, x2, y2;
+};
+
+
+typedef enum _D3DFORMAT
+{
+   D3DFMT_UNKNOWN = 0,
+   D3DFMT_R8G8B8 = 20,
+   D3DFMT_A8R8G8B8 = 21,
+   D3DFMT_X8R8G8B8 = 22,
+   D3DFMT_R5G6B5 = 23,
+   D3DFMT_X1R5G5B5 = 24,
+   D3DFMT_A1R5G5B5 = 25,
+   D3DFMT_A4R4G4B4 = 26,
+   D3DFMT_A8 = 28,
+   D3DFMT_P8 = 41,
+   D3DFMT_L8 = 50,
+   D3DFMT_D16 = 80,
+   D3DFMT_D24X8 = 77,
+   D3DFMT_D24S8 = 75,
+   D3DFMT_INDEX16 = 101,
+   D3DFMT_INDEX32 = 102,
+   D3DFMT_DXT1 = 0x31545844,
+   D3DFMT_DXT2 = 0x32545844,
+   D3DFMT_DXT3 = 0x33545844,
+   D3DFMT_DXT4 = 0x34545844,
+   D3DFMT_DXT5 = 0x35545844
+} D3DFORMAT;
+
+typedef enum _D3DPOOL
+{
+   D3DPOOL_DEFAULT = 0,
+   D3DPOOL_MANAGED = 1,
+   D3DPOOL_SYSTEMMEM = 2,
+   D3DPOOL_SCRATCH = 3
+} D3DPOOL;
+
+typedef enum _D3DRESOURCETYPE
+{
+   D3DRTYPE_SURFACE = 1,
+   D3DRTYPE_TEXTURE = 3,
+   D3DRTYPE_VERTEXBUFFER = 6,
+   D3DRTYPE_INDEXBUFFER = 7
+} D3DRESOURCETYPE;
+
+typedef enum _D3DPRIMITIVETYPE
+{
+   D3DPT_POINTLIST = 1,
+   D3DPT_LINELIST = 2,
+   D3DPT_LINESTRIP = 3,
+   D3DPT_TRIANGLELIST = 4,
+   D3DPT_TRIANGLESTRIP = 5,
+   D3DPT_TRIANGLEFAN = 6
+} D3DPRIMITIVETYPE;
+
+typedef enum _D3DTRANSFORMSTATETYPE
+{
+   D3DTS_VIEW = 2,
+   D3DTS_PROJECTION = 3,
+   D3DTS_TEXTURE0 = 16,
+   D3DTS_FORCE_DWORD = 0x7fffffff   // so the world matrices, 256 up, fit
+} D3DTRANSFORMSTATETYPE;
+#define D3DTS_WORLDMATRIX(index) ((D3DTRANSFORMSTATETYPE) ((index) + 256))
+#define D3DTS_WORLD D3DTS_WORLDMATRIX(0)
+
+typedef enum _D3DRENDERSTATETYPE
+{
+   D3DRS_ZENABLE = 7,
+   D3DRS_FILLMODE = 8,
+   D3DRS_SHADEMODE = 9,
+   D3DRS_ZWRITEENABLE = 14,
+   D3DRS_ALPHATESTENABLE = 15,
+   D3DRS_SRCBLEND = 19,
+   D3DRS_DESTBLEND = 20,
+   D3DRS_CULLMODE = 22,
+   D3DRS_ZFUNC = 23,
+   D3DRS_ALPHAREF = 24,
+   D3DRS_ALPHAFUNC = 25,
+   D3DRS_DITHERENABLE = 26,
+   D3DRS_ALPHABLENDENABLE = 27,
+   D3DRS_FOGENABLE = 28,
+   D3DRS_SPECULARENABLE = 29,
+   D3DRS_TEXTUREFACTOR = 60,
+   D3DRS_LIGHTING = 137,
+   D3DRS_AMBIENT = 139,
+   D3DRS_NORMALIZENORMALS = 143,
+   D3DRS_BLENDOP = 171,
+   D3DRS_BLENDFACTOR = 193
+} D3DRENDERSTATETYPE;
+
+typedef enum _D3DBLEND
+{
+   D3DBLEND_ZERO = 1,
+   D3DBLEND_ONE = 2,
+   D3DBLEND_SRCCOLOR = 3,
+   D3DBLEND_INVSRCCOLOR = 4,
+   D3DBLEND_SRCALPHA = 5,
+   D3DBLEND_INVSRCALPHA = 6,
+   D3DBLEND_DESTALPHA = 7,
+   D3DBLEND_INVDESTALPHA = 8,
+   D3DBLEND_DESTCOLOR = 9,
+   D3DBLEND_INVDESTCOLOR = 10,
+   D3DBLEND_SRCALPHASAT = 11,
+   D3DBLEND_BOTHSRCALPHA = 12,
+   D3DBLEND_BOTHINVSRCALPHA = 13,
+   D3DBLEND_BLENDFACTOR = 14,
+   D3DBLEND_INVBLENDFACTOR = 15
+} D3DBLEND;
+
+typedef enum _D3DBLENDOP
+{
+   D3DBLENDOP_ADD = 1,
+   D3DBLENDOP_SUBTRACT = 2,
+   D3DBLENDOP_REVSUBTRACT = 3,
+   D3DBLENDOP_MIN = 4,
+   D3DBLENDOP_MAX = 5
+} D3DBLENDOP;
+
+typedef enum _D3DCMPFUNC
+{
+   D3DCMP_NEVER = 1,
+   D3DCMP_LESS = 2,
+   D3DCMP_EQUAL = 3,
+   D3DCMP_LESSEQUAL = 4,
+   D3DCMP_GREATER = 5,
+   D3DCMP_NOTEQUAL = 6,
+   D3DCMP_GREATEREQUAL = 7,
+   D3DCMP_ALWAYS = 8
+} D3DCMPFUNC;
+
+typedef enum _D3DCULL
+{
+   D3DCULL_NONE = 1,
+   D3DCULL_CW = 2,
+   D3DCULL_CCW = 3
+} D3DCULL;
+
+typedef enum _D3DTEXTURESTAGESTATETYPE
+{
+   D3DTSS_COLOROP = 1,
+   D3DTSS_COLORARG1 = 2,
+   D3DTSS_COLORARG2 = 3,
+   D3DTSS_ALPHAOP = 4,
+   D3DTSS_ALPHAARG1 = 5,
+   D3DTSS_ALPHAARG2 = 6,
+   D3DTSS_TEXCOORDINDEX = 11
+} D3DTEXTURESTAGESTATETYPE;
+
+typedef enum _D3DTEXTUREOP
+{
+   D3DTOP_DISABLE = 1,
+   D3DTOP_SELECTARG1 = 2,
+   D3DTOP_SELECTARG2 = 3,
+   D3DTOP_MODULATE = 4,
+   D3DTOP_MODULATE2X = 5,
+   D3DTOP_MODULATE4X = 6,
+   D3DTOP_ADD = 7,
+   D3DTOP_ADDSIGNED = 8,
+   D3DTOP_ADDSIGNED2X = 9,
+   D3DTOP_SUBTRACT = 10,
+   D3DTOP_ADDSMOOTH = 11,
+   D3DTOP_BLENDDIFFUSEALPHA = 12,
+   D3DTOP_BLENDTEXTUREALPHA = 13
+} D3DTEXTUREOP;
+
+// texture stage arguments
+#define D3DTA_DIFFUSE 0x00000000
+#define D3DTA_CURRENT 0x00000001
+#define D3DTA_TEXTURE 0x00000002
+#define D3DTA_TFACTOR 0x00000003
+#define D3DTA_SPECULAR 0x00000004
+#define D3DTA_SELECTMASK 0x0000000f
+#define D3DTA_COMPLEMENT 0x00000010       // modifiers, or-ed with one of the above
+#define D3DTA_ALPHAREPLICATE 0x00000020
+
+typedef enum _D3DSAMPLERSTATETYPE
+{
+   D3DSAMP_ADDRESSU = 1,
+   D3DSAMP_ADDRESSV = 2,
+   D3DSAMP_ADDRESSW = 3,
+   D3DSAMP_BORDERCOLOR = 4,
+   D3DSAMP_MAGFILTER = 5,
+   D3DSAMP_MINFILTER = 6,
+   D3DSAMP_MIPFILTER = 7,
+   D3DSAMP_MIPMAPLODBIAS = 8,
+   D3DSAMP_MAXMIPLEVEL = 9,
+   D3DSAMP_MAXANISOTROPY = 10
+} D3DSAMPLERSTATETYPE;
+
+typedef enum _D3DTEXTUREADDRESS
+{
+   D3DTADDRESS_WRAP = 1,
+   D3DTADDRESS_MIRROR = 2,
+   D3DTADDRESS_CLAMP = 3,
+   D3DTADDRESS_BORDER = 4,
+   D3DTADDRESS_MIRRORONCE = 5
+} D3DTEXTUREADDRESS;
+
+typedef enum _D3DTEXTUREFILTERTYPE
+{
+   D3DTEXF_NONE = 0,
+   D3DTEXF_POINT = 1,
+   D3DTEXF_LINEAR = 2,
+   D3DTEXF_ANISOTROPIC = 3
+} D3DTEXTUREFILTERTYPE;
+
+typedef enum _D3DLIGHTTYPE
+{
+   D3DLIGHT_POINT = 1,
+   D3DLIGHT_SPOT = 2,
+   D3DLIGHT_DIRECTIONAL = 3
+} D3DLIGHTTYPE;
+
+typedef enum _D3DSWAPEFFECT
+{
+   D3DSWAPEFFECT_DISCARD = 1,
+   D3DSWAPEFFECT_FLIP = 2,
+   D3DSWAPEFFECT_COPY = 3
+} D3DSWAPEFFECT;
+
+// flexible vertex format bits
+#define D3DFVF_XYZ 0x002
+#define D3DFVF_XYZRHW 0x004
+#define D3DFVF_NORMAL 0x010
+#define D3DFVF_PSIZE 0x020
+#define D3DFVF_DIFFUSE 0x040
+#define D3DFVF_SPECULAR 0x080
+#define D3DFVF_TEXCOUNT_MASK 0xf00
+#define D3DFVF_TEXCOUNT_SHIFT 8
+#define D3DFVF_TEX0 0x000
+#define D3DFVF_TEX1 0x100
+#define D3DFVF_TEX2 0x200
+
+#define D3DCLEAR_TARGET 0x00000001
+#define D3DCLEAR_ZBUFFER 0x00000002
+#define D3DCLEAR_STENCIL 0x00000004
+
+#define D3DUSAGE_WRITEONLY 0x00000008
+#define D3DUSAGE_DYNAMIC 0x00000200
+
+#define D3DLOCK_READONLY 0x00000010
+#define D3DLOCK_NOOVERWRITE 0x00001000
+#define D3DLOCK_DISCARD 0x00002000
+
+
+struct D3DLIGHT9
+{
+   D3DLIGHTTYPE Type;
+   D3DCOLORVALUE Diffuse;
+   D3DCOLORVALUE Specular;
+   D3DCOLORVALUE Ambient;
+   D3DVECTOR Position;
+   D3DVECTOR Direction;
+   float Range;
+   float Falloff;
+   float Attenuation0;
+   float Attenuation1;
+   float Attenuation2;
+   float Theta;
+   float Phi;
+};
+
+struct D3DMATERIAL9
+{
+   D3DCOLORVALUE Diffuse;
+   D3DCOLORVALUE Ambient;
+   D3DCOLORVALUE Specular;
+   D3DCOLORVALUE Emissive;
+   float Power;
+};
+
+struct D3DLOCKED_RECT
+{
+   INT Pitch;
+   void * pBits;
+};
+
+struct D3DSURFACE_DESC
+{
+   D3DFORMAT Format;
+   D3DRESOURCETYPE Type;
+   DWORD Usage;
+   D3DPOOL Pool;
+   DWORD MultiSampleType;
+   DWORD MultiSampleQuality;
+   UINT Width;
+   UINT Height;
+};
+
+struct D3DPRESENT_PARAMETERS
+{
+   UINT BackBufferWidth;
+   UINT BackBufferHeight;
+   D3DFORMAT BackBufferFormat;
+   UINT BackBufferCount;
+   DWORD MultiSampleType;
+   DWORD MultiSampleQuality;
+   D3DSWAPEFFECT SwapEffect;
+   HWND hDeviceWindow;
+   BOOL Windowed;
+   BOOL EnableAutoDepthStencil;
+   D3DFORMAT AutoDepthStencilFormat;
+   DWORD Flags;
+   UINT FullScreen_RefreshRateInHz;
+   UINT PresentationInterval;
+};
+
+
+// the interfaces.. only the methods something here calls
+struct IUnknown
+{
+   virtual ULONG AddRef() = 0;
+   virtual ULONG Release() = 0;
+
+protected:
+   virtual ~IUnknown() {}
+};
+
+struct IDirect3DVertexBuffer9 : public IUnknown
+{
+   virtual HRESULT Lock(UINT offset, UINT bytes, void ** data, DWORD flags) = 0;
+   virtual HRESULT Unlock() = 0;
+};
+
+struct IDirect3DIndexBuffer9 : public IUnknown
+{
+   virtual HRESULT Lock(UINT offset, UINT bytes, void ** data, DWORD flags) = 0;
+   virtual HRESULT Unlock() = 0;
+};
+
+struct IDirect3DBaseTexture9 : public IUnknown
+{
+};
+
+struct IDirect3DTexture9 : public IDirect3DBaseTexture9
+{
+   virtual DWORD GetLevelCount() = 0;
+   virtual HRESULT GetLevelDesc(UINT level, D3DSURFACE_DESC * desc) = 0;
+   virtual HRESULT LockRect(UINT level, D3DLOCKED_RECT * rect, const RECT * area, DWORD flags) = 0;
+   virtual HRESULT UnlockRect(UINT level) = 0;
+};
+
+struct IDirect3DDevice9 : public IUnknown
+{
+   virtual HRESULT TestCooperativeLevel() = 0;
+   virtual HRESULT Reset(D3DPRESENT_PARAMETERS * params) = 0;
+   virtual HRESULT Present(const RECT * src, const RECT * dst, HWND window, const RGNDATA * dirty) = 0;
+
+   virtual HRESULT CreateTexture(UINT width, UINT height, UINT levels, DWORD usage, D3DFORMAT format,
+                                 D3DPOOL pool, IDirect3DTexture9 ** texture, HANDLE * shared) = 0;
+   virtual HRESULT CreateVertexBuffer(UINT bytes, DWORD usage, DWORD fvf, D3DPOOL pool,
+                                      IDirect3DVertexBuffer9 ** buffer, HANDLE * shared) = 0;
+   virtual HRESULT CreateIndexBuffer(UINT bytes, DWORD usage, D3DFORMAT format, D3DPOOL pool,
+                                     IDirect3DIndexBuffer9 ** buffer, HANDLE * shared) = 0;
+
+   virtual HRESULT BeginScene() = 0;
+   virtual HRESULT EndScene() = 0;
+   virtual HRESULT Clear(DWORD count, const D3DRECT * rects, DWORD flags, D3DCOLOR color, float z,
+                         DWORD stencil) = 0;
+
+   virtual HRESULT SetTransform(D3DTRANSFORMSTATETYPE state, const D3DMATRIX * matrix) = 0;
+   virtual HRESULT GetTransform(D3DTRANSFORMSTATETYPE state, D3DMATRIX * matrix) = 0;
+   virtual HRESULT SetMaterial(const D3DMATERIAL9 * material) = 0;
+   virtual HRESULT SetLight(DWORD index, const D3DLIGHT9 * light) = 0;
+   virtual HRESULT LightEnable(DWORD index, BOOL enable) = 0;
+   virtual HRESULT SetRenderState(D3DRENDERSTATETYPE state, DWORD value) = 0;
+   virtual HRESULT GetRenderState(D3DRENDERSTATETYPE state, DWORD * value) = 0;
+   virtual HRESULT SetTexture(DWORD stage, IDirect3DBaseTexture9 * texture) = 0;
+   virtual HRESULT SetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD value) = 0;
+   virtual HRESULT GetTextureStageState(DWORD stage, D3DTEXTURESTAGESTATETYPE type, DWORD * value) = 0;
+   virtual HRESULT SetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD value) = 0;
+   virtual HRESULT GetSamplerState(DWORD sampler, D3DSAMPLERSTATETYPE type, DWORD * value) = 0;
+
+   virtual HRESULT DrawPrimitive(D3DPRIMITIVETYPE type, UINT startVertex, UINT count) = 0;
+   virtual HRESULT DrawIndexedPrimitive(D3DPRIMITIVETYPE type, INT baseVertex, UINT minIndex,
+                                        UINT numVertices, UINT startIndex, UINT count) = 0;
+   virtual HRESULT SetFVF(DWORD fvf) = 0;
+   virtual HRESULT SetStreamSource(UINT stream, IDirect3DVertexBuffer9 * buffer, UINT offset,
+                                   UINT stride) = 0;
+   virtual HRESULT SetIndices(IDirect3DIndexBuffer9 * buffer) = 0;
+};
+
+typedef IDirect3DDevice9 * LPDIRECT3DDEVICE9;
+typedef IDirect3DVertexBuffer9 * LPDIRECT3DVERTEXBUFFER9;
+typedef IDirect3DIndexBuffer9 * LPDIRECT3DINDEXBUFFER9;
+typedef IDirect3DTexture9 * LPDIRECT3DTEXTURE9;
+
+#endif
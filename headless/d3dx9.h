@@ -0,0 +1,75 @@
+/* Filename:  d3dx9.h
+
+   This file is used by the headless builds in place of the DirectX SDK's
+   header.  See d3d9.h.
+
+   The D3DX maths the examples' classes use, done the same way D3DX does
+   it (left handed, row vectors, so a point goes through scale, then
+   rotation, then translation when they are multiplied in that order), in
+   D3DXMath.cpp.  Textures that aren't bitmaps can't be loaded without the
+   real D3DX; D3DXCreateTextureFromFileInMemory says so.
+*/
+
+#ifndef HEADLESS_D3DX9_H
+#define HEADLESS_D3DX9_H
+
+#include "d3d9.h"
+#include <math.h>
+
+#define D3DX_PI ((float) 3.141592654f)
+#define D3DX_DEFAULT ((UINT) -1)
+
+
+struct D3DXVECTOR3 : public D3DVECTOR
+{
+   D3DXVECTOR3() {}
+   D3DXVECTOR3(float fx, float fy, float fz) { x = fx;  y = fy;  z = fz; }
+   D3DXVECTOR3(const D3DVECTOR & v) { x = v.x;  y = v.y;  z = v.z; }
+
+   operator float * () { return &x; }
+   operator const float * () const { return &x; }
+};
+
+struct D3DXMATRIX : public D3DMATRIX
+{
+   D3DXMATRIX() {}
+   D3DXMATRIX(const float * f) { memcpy(&_11, f, sizeof(D3DMATRIX)); }
+   D3DXMATRIX(const D3DMATRIX & mat) { memcpy(&_11, &mat, sizeof(D3DMATRIX)); }
+
+   float & operator () (UINT row, UINT col) { return m[row][col]; }
+   float operator () (UINT row, UINT col) const { return m[row][col]; }
+
+   operator float * () { return &_11; }
+   operator const float * () const { return &_11; }
+
+   D3DXMATRIX operator * (const D3DXMATRIX & mat) const;
+};
+
+
+// a font only has to come back after a lost device.. nothing is drawn
+struct ID3DXFont : public IUnknown
+{
+   virtual HRESULT OnLostDevice() = 0;
+   virtual HRESULT OnResetDevice() = 0;
+};
+typedef ID3DXFont * LPD3DXFONT;
+
+
+D3DXMATRIX * D3DXMatrixIdentity(D3DXMATRIX * out);
+D3DXMATRIX * D3DXMatrixMultiply(D3DXMATRIX * out, const D3DXMATRIX * m1, const D3DXMATRIX * m2);
+D3DXMATRIX * D3DXMatrixTranslation(D3DXMATRIX * out, float x, float y, float z);
+D3DXMATRIX * D3DXMatrixScaling(D3DXMATRIX * out, float sx, float sy, float sz);
+D3DXMATRIX * D3DXMatrixRotationX(D3DXMATRIX * out, float angle);
+D3DXMATRIX * D3DXMatrixRotationY(D3DXMATRIX * out, float angle);
+D3DXMATRIX * D3DXMatrixRotationZ(D3DXMATRIX * out, float angle);
+D3DXMATRIX * D3DXMatrixRotationYawPitchRoll(D3DXMATRIX * out, float yaw, float pitch, float roll);
+D3DXMATRIX * D3DXMatrixLookAtLH(D3DXMATRIX * out, const D3DXVECTOR3 * eye, const D3DXVECTOR3 * at,
+                                const D3DXVECTOR3 * up);
+D3DXMATRIX * D3DXMatrixPerspectiveFovLH(D3DXMATRIX * out, float fovy, float aspect, float zn, float zf);
+D3DXVECTOR3 * D3DXVec3Normalize(D3DXVECTOR3 * out, const D3DXVECTOR3 * v);
+
+// always D3DERR_INVALIDCALL.. there is no image loader here
+HRESULT D3DXCreateTextureFromFileInMemory(LPDIRECT3DDEVICE9 dev, const void * data, UINT bytes,
+                                          LPDIRECT3DTEXTURE9 * texture);
+
+#endif
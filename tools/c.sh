@@ -0,0 +1,3 @@
+g++ -O2 -std=c++11 -pthread -o mipgen mipgen.cpp ../common/BmpLoader.cpp ../common/MappedFile.cpp ../common/MipGen.cpp ../common/BlockCompress.cpp ../common/Dds.cpp ../common/Hash.cpp
+g++ -O2 -std=c++11 -o pack pack.cpp ../common/AssetPack.cpp ../common/MappedFile.cpp ../common/Hash.cpp
+g++ -O2 -std=c++11 -I../headless -o capstat capstat.cpp ../common/DeviceCapture.cpp ../common/CountingDevice.cpp ../common/MappedFile.cpp ../common/Hash.cpp
\ No newline at end of file
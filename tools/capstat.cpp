@@ -0,0 +1,133 @@
+/* Filename:  capstat.cpp
+
+   Says what is in a device capture (see DeviceCapture.h): how many of
+   each record there are and the bytes they take, then the spread of
+   calls and of bytes over the frames as two small histograms, so a frame
+   that does far more than the others stands out.  With -f, a line for
+   every frame as well.
+
+      ../bench/examplebench04 -frames 300 -capture cubes.d3dcap
+      ../tools/capstat -f cubes.d3dcap
+
+   usage:  capstat [-f] capture
+*/
+
+#include "../common/DeviceCapture.h"
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+struct FrameTotals
+{
+   unsigned int calls, draws, primitives, states;
+   size_t bytes;
+};
+
+
+// one row of # for each of ten ranges of the values, scaled to the biggest row
+static void histogram(const char * title, const std::vector<double> & values)
+{
+   enum { ROWS = 10, WIDTH = 50 };
+   unsigned int rows[ROWS] = { 0 }, most = 0, i, row;
+   double lo = values[0], hi = values[0], size;
+
+   for (i = 1; i < values.size(); i++)
+   {
+      lo = values[i] < lo ? values[i] : lo;
+      hi = values[i] > hi ? values[i] : hi;
+   }
+   size = (hi - lo) / ROWS;
+   for (i = 0; i < values.size(); i++)
+   {
+      row = size > 0.0 ? (unsigned int) ((values[i] - lo) / size) : 0;
+      rows[row < ROWS ? row : ROWS - 1]++;
+   }
+   for (i = 0; i < ROWS; i++)
+      most = rows[i] > most ? rows[i] : most;
+
+   printf("\n%s\n", title);
+   for (i = 0; i < ROWS; i++)
+   {
+      if (size <= 0.0 && i > 0)
+         break;   // all the same
+      printf("%12.0f %6u ", lo + size * i, rows[i]);
+      for (row = 0; row < (rows[i] * WIDTH + most - 1) / most; row++)
+         putchar('#');
+      putchar('\n');
+   }
+}
+
+
+int main(int argc, char ** argv)
+{
+   CaptureReader reader;
+   CaptureRecord r;
+   unsigned int counts[CAPTURE_OPS] = { 0 }, i;
+   size_t bytes[CAPTURE_OPS] = { 0 }, total = 8;
+   std::vector<FrameTotals> frames;
+   FrameTotals fr = { 0, 0, 0, 0, 0 };
+   bool perFrame = argc == 3 && strcmp(argv[1], "-f") == 0;
+
+   if (argc != 2 && !perFrame)
+   {
+      printf("usage:  capstat [-f] capture\n");
+      return 1;
+   }
+   if (!reader.open(argv[argc - 1]))
+   {
+      printf("%s isn't a capture\n", argv[argc - 1]);
+      return 1;
+   }
+
+   while (reader.next(r))
+   {
+      counts[r.op]++;
+      bytes[r.op] += r.bytes;
+      total += r.bytes;
+      fr.bytes += r.bytes;
+      if (r.op == CAP_FRAME)
+      {
+         frames.push_back(fr);
+         memset(&fr, 0, sizeof(fr));
+         continue;
+      }
+      fr.calls++;
+      if (r.op == CAP_DRAW || r.op == CAP_DRAW_INDEXED)
+      {
+         fr.draws++;
+         fr.primitives += r.op == CAP_DRAW ? r.args[2] : r.args[5];
+      }
+      else if (r.op == CAP_RENDER_STATE || r.op == CAP_STAGE_STATE || r.op == CAP_SAMPLER_STATE)
+         fr.states++;
+   }
+
+   printf("%s: %lu bytes, %lu frames%s\n", argv[argc - 1], (unsigned long) total, (unsigned long) frames.size(),
+          reader.damaged() ? ", damaged" : "");
+   if (fr.calls)
+      printf("and %u calls after the last frame, left out of the frames\n", fr.calls);
+   printf("\n%-16s %10s %12s %10s\n", "record", "count", "bytes", "per frame");
+   for (i = 1; i < CAPTURE_OPS; i++)
+      if (counts[i])
+         printf("%-16s %10u %12lu %10.2f\n", CaptureReader::opName((CaptureOp) i), counts[i],
+                (unsigned long) bytes[i], frames.empty() ? 0.0 : (double) counts[i] / frames.size());
+
+   if (frames.empty())
+      return reader.damaged() ? 1 : 0;
+
+   if (perFrame)
+   {
+      printf("\n%6s %8s %8s %10s %8s %12s\n", "frame", "calls", "draws", "primitives", "states", "bytes");
+      for (i = 0; i < frames.size(); i++)
+         printf("%6u %8u %8u %10u %8u %12lu\n", i, frames[i].calls, frames[i].draws, frames[i].primitives,
+                frames[i].states, (unsigned long) frames[i].bytes);
+   }
+
+   std::vector<double> values(frames.size());
+   for (i = 0; i < frames.size(); i++)
+      values[i] = frames[i].calls;
+   histogram("calls a frame", values);
+   for (i = 0; i < frames.size(); i++)
+      values[i] = (double) frames[i].bytes;
+   histogram("bytes a frame", values);
+   return reader.damaged() ? 1 : 0;
+}
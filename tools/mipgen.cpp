@@ -0,0 +1,114 @@
+/* Filename:  mipgen.cpp
+
+   Builds the mip levels of the examples' bitmaps ahead of time, so the
+   first run of an example doesn't have to.  For each tex1.bmp it writes
+   tex1.bmp.dds next to it, the same file TextureCache would save, and
+   says how long the filtering and compressing took and, for DXT, how
+   close the top level came to the bitmap (PSNR).
+
+   usage:  mipgen [-box | -kaiser] [-rgb | -bc1 | -bc3] [-threads n] file.bmp ...
+*/
+
+#include "../common/BmpLoader.h"
+#include "../common/MipGen.h"
+#include "../common/BlockCompress.h"
+#include "../common/Dds.h"
+#include "../common/Hash.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+
+typedef std::chrono::steady_clock Clock;
+
+static double msSince(Clock::time_point start)
+{
+   return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+
+int main(int argc, char ** argv)
+{
+   MipFilter filter = MIP_KAISER;
+   DdsFormat format = DDS_DXT1;
+   unsigned int threads = 0;
+   int i, failed = 0;
+
+   if (argc < 2)
+   {
+      printf("usage:  mipgen [-box | -kaiser] [-rgb | -bc1 | -bc3] [-threads n] file.bmp ...\n");
+      return 1;
+   }
+
+   for (i = 1; i < argc; i++)
+   {
+      if (strcmp(argv[i], "-box") == 0)
+         filter = MIP_BOX;
+      else if (strcmp(argv[i], "-kaiser") == 0)
+         filter = MIP_KAISER;
+      else if (strcmp(argv[i], "-rgb") == 0)
+         format = DDS_BGRX8;
+      else if (strcmp(argv[i], "-bc1") == 0)
+         format = DDS_DXT1;
+      else if (strcmp(argv[i], "-bc3") == 0)
+         format = DDS_DXT5;
+      else if (strcmp(argv[i], "-threads") == 0 && i + 1 < argc)
+         threads = atoi(argv[++i]);
+      else
+      {
+         std::string out = std::string(argv[i]) + ".dds";
+         std::vector<unsigned int> pixels, back;
+         std::vector<unsigned char> blocks;
+         const void * bits;
+         double psnr = 0;
+         MappedFile file;
+         BmpInfo info;
+         MipChain chain;
+
+         if (!file.open(argv[i]) || !readBmpInfo(file.data(), file.size(), info))
+         {
+            printf("%s: not a 24 bit bitmap\n", argv[i]);
+            failed++;
+            continue;
+         }
+
+         Clock::time_point start = Clock::now();
+         pixels.resize((size_t) info.width * info.height);
+         convertBmp(info, file.data(), &pixels[0], info.width * 4);
+         buildMipChain(&pixels[0], info.width, info.height, info.width * 4, filter, chain, threads);
+         bits = &chain.pixels[0];
+         if (format != DDS_BGRX8)
+         {
+            BlockFormat bf = format == DDS_DXT1 ? BLOCK_BC1 : BLOCK_BC3;
+            compressMipChain(bf, chain, blocks, threads);
+            bits = &blocks[0];
+         }
+         double ms = msSince(start);
+
+         if (format != DDS_BGRX8)
+         {
+            back.resize(pixels.size());
+            decompressBlocks(format == DDS_DXT1 ? BLOCK_BC1 : BLOCK_BC3, bits, info.width, info.height,
+                             &back[0], info.width * 4);
+            psnr = imagePsnr(&pixels[0], info.width * 4, &back[0], info.width * 4,
+                             info.width, info.height, false);
+         }
+
+         if (!writeDds(out.c_str(), format, info.width, info.height, chain.levels(),
+                       bits, xxHash64(file.data(), file.size())))
+         {
+            printf("%s: can't write %s\n", argv[i], out.c_str());
+            failed++;
+            continue;
+         }
+         printf("%s  %dx%d  %u levels  %.2f ms", out.c_str(), info.width, info.height,
+                chain.levels(), ms);
+         if (format != DDS_BGRX8)
+            printf("  %.2f dB", psnr);
+         printf("\n");
+      }
+   }
+   return failed ? 1 : 0;
+}
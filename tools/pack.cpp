@@ -0,0 +1,102 @@
+/* Filename:  pack.cpp
+
+   Builds the pack file an example loads everything from (see
+   AssetPack.h), or lists and checks one.  Files keep the names they are
+   given on the command line, with / between folders, so run it from the
+   example's folder:
+
+      cd 09
+      ../tools/mipgen tex1.bmp tex2.bmp tex4.bmp tex5.bmp
+      ../tools/pack -lz4 assets.pak tex*.bmp tex*.bmp.dds
+
+   usage:  pack [-lz4] out.pak file ...
+           pack -l file.pak
+*/
+
+#include "../common/AssetPack.h"
+#include "../common/MappedFile.h"
+#include "../common/Hash.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+
+static int list(const char * filename)
+{
+   AssetPack pack;
+   std::vector<unsigned char> scratch;
+   unsigned int i, bad = 0;
+
+   if (!pack.open(filename))
+   {
+      printf("%s isn't a pack\n", filename);
+      return 1;
+   }
+   for (i = 0; i < pack.count(); i++)
+   {
+      PackItem item = pack.item(i);
+      const unsigned char * data = pack.contents(item, scratch);
+      bool ok = data && xxHash64(data, item.rawBytes) == item.hash;
+      printf("%10lu %10lu %s  %s%s\n", (unsigned long) item.rawBytes, (unsigned long) item.bytes,
+             item.compressed ? "lz4" : "   ", item.name, ok ? "" : "  (damaged)");
+      bad += !ok;
+   }
+   return bad ? 1 : 0;
+}
+
+
+int main(int argc, char ** argv)
+{
+   std::vector<MappedFile *> files;
+   std::vector<PackInput> inputs;
+   size_t raw = 0, i;
+   bool compress = false;
+   int arg = 1, result = 0;
+
+   if (argc == 3 && strcmp(argv[1], "-l") == 0)
+      return list(argv[2]);
+   if (arg < argc && strcmp(argv[arg], "-lz4") == 0)
+   {
+      compress = true;
+      arg++;
+   }
+   if (argc - arg < 2)
+   {
+      printf("usage:  pack [-lz4] out.pak file ...\n"
+             "        pack -l file.pak\n");
+      return 1;
+   }
+
+   for (i = arg + 1; i < (size_t) argc; i++)
+   {
+      MappedFile * file = new MappedFile;
+      PackInput in;
+      files.push_back(file);
+      if (!file->open(argv[i]))
+      {
+         printf("can't read %s\n", argv[i]);
+         result = 1;
+         break;
+      }
+      in.name = argv[i];
+      std::replace(in.name.begin(), in.name.end(), '\\', '/');
+      in.data = file->data();
+      in.bytes = file->size();
+      inputs.push_back(in);
+      raw += in.bytes;
+   }
+
+   if (result == 0 && !writePack(argv[arg], inputs, compress))
+   {
+      printf("can't write %s (or two files have the same name)\n", argv[arg]);
+      result = 1;
+   }
+   else if (result == 0)
+      printf("%lu files, %lu bytes in %s\n", (unsigned long) inputs.size(), (unsigned long) raw, argv[arg]);
+
+   for (i = 0; i < files.size(); i++)
+      delete files[i];
+   return result;
+}